@@ -10,15 +10,19 @@
 #include <cnoid/MeshExtractor>
 #include <cnoid/ThreadPool>
 #include <algorithm>
-#include <random>
+#include <map>
 #include <set>
+#include <mutex>
+#include <atomic>
+#include <thread>
 
 using namespace std;
 using namespace cnoid;
 
 namespace {
 
-const bool ENABLE_SHUFFLE = false;
+// The pairs are divided into this number of chunks per thread for the load balancing
+constexpr int NumChunksPerThread = 8;
 
 typedef CollisionDetector::GeometryHandle GeometryHandle;
 
@@ -44,8 +48,24 @@ public:
     bool isStatic;
     stdx::optional<Position> localPosition;
     ColdetModelExPtr sibling;
+    std::atomic<bool> isTreeBuilt;
+    std::mutex treeBuildMutex;
     
-    ColdetModelEx() : isStatic(false) { }
+    ColdetModelEx() : isStatic(false), isTreeBuilt(false) { }
+
+    /**
+       The bounding volume tree is built when the model is first used. This function may be called
+       from the background building threads and the collision detection threads at the same time.
+    */
+    void buildTreeIfNecessary(){
+        if(!isTreeBuilt.load(std::memory_order_acquire)){
+            std::lock_guard<std::mutex> lock(treeBuildMutex);
+            if(!isTreeBuilt.load(std::memory_order_relaxed)){
+                build();
+                isTreeBuilt.store(true, std::memory_order_release);
+            }
+        }
+    }
 };
 
 class ColdetModelPairEx;
@@ -83,6 +103,11 @@ public:
         return static_cast<ColdetModelEx*>(ColdetModelPair::model(which));
     }
 
+    void buildTreesIfNecessary(){
+        model(0)->buildTreeIfNecessary();
+        model(1)->buildTreeIfNecessary();
+    }
+
     ColdetModelPairExPtr sibling;
 };
 
@@ -142,19 +167,57 @@ public:
     stdx::optional<GeometryHandle> addGeometry(SgNode* geometry);
     void addMesh(ColdetModelEx* model);
     void makeReady();
+    void startBackgroundTreeBuilding();
+    void stopBackgroundTreeBuilding();
     void detectCollisions(std::function<void(const CollisionPair&)> callback);
     void detectCollisionsInParallel(std::function<void(const CollisionPair&)> callback);
 
     // for multithread version
     int numThreads;
     unique_ptr<ThreadPool> threadPool;
-    vector<int> shuffledPairIndices;
+    int chunkSize;
+    int numChunks;
+    std::atomic<int> nextChunkIndex;
+    // The collision pairs detected in each chunk
     vector<vector<CollisionPair>> collisionPairArrays;
-    mt19937 randomEngine;
+
+    unique_ptr<ThreadPool> treeBuildThreadPool;
+    std::atomic<bool> isTreeBuildingCanceled;
+    std::atomic<int> numTreesToBuildInBackground;
     
+    void extractCollisionsOfChunks();
     void extractCollisionsOfAssignedPairs(
         int pairIndexBegin, int pairIndexEnd, vector<CollisionPair>& collisionPairs);    
     void dispatchCollisionsInCollisionPairArrays(std::function<void(const CollisionPair&)> callback);    
+
+    // for the batched distance computation
+    struct DistanceQuery
+    {
+        ColdetModelEx* model1;
+        ColdetModelEx* model2;
+        int* closestTriangles;
+        double distance;
+        Vector3 point1;
+        Vector3 point2;
+    };
+    vector<DistanceQuery> distanceQueries;
+    struct ClosestTriangles
+    {
+        int triangles[2];
+        // Used to detect a pair given twice in a computation
+        int computationId;
+    };
+    // The closest triangle pairs found by the previous distance computation of each geometry pair
+    map<CollisionDetectorDistanceAPI::GeometryPair, ClosestTriangles> closestTriangleMap;
+    int distanceComputationId;
+    unique_ptr<ThreadPool> distanceThreadPool;
+    int distanceChunkSize;
+    std::atomic<int> nextDistanceQueryIndex;
+
+    int detectDistances(
+        const vector<CollisionDetectorDistanceAPI::GeometryPair>& pairs, double maxDistance,
+        vector<CollisionDetectorDistanceAPI::DistanceResult>& out_results);
+    void computeDistancesOfChunks(double maxDistance);
 };
 
 }
@@ -169,19 +232,23 @@ AISTCollisionDetector::AISTCollisionDetector()
 AISTCollisionDetectorImpl::AISTCollisionDetectorImpl()
 {
     isReady = false;
+    isTreeBuildingCanceled = false;
+    numTreesToBuildInBackground = 0;
     maxNumThreads = 0;
     numThreads = 0;
+    chunkSize = 0;
+    numChunks = 0;
+    nextChunkIndex = 0;
+    distanceChunkSize = 1;
+    distanceComputationId = 0;
+    nextDistanceQueryIndex = 0;
     meshExtractor = new MeshExtractor;
-
-    if(ENABLE_SHUFFLE){
-        random_device seed;
-        randomEngine.seed(seed());
-    }
 }
 
 
 AISTCollisionDetectorImpl::~AISTCollisionDetectorImpl()
 {
+    stopBackgroundTreeBuilding();
     delete meshExtractor;
 
 }
@@ -213,9 +280,11 @@ void AISTCollisionDetector::setNumThreads(int n)
         
 void AISTCollisionDetector::clearGeometries()
 {
+    impl->stopBackgroundTreeBuilding();
     impl->models.clear();
     impl->modelPairs.clear();
     impl->ignoredPairs.clear();
+    impl->closestTriangleMap.clear();
     impl->isReady = false;
 }
 
@@ -238,8 +307,8 @@ stdx::optional<GeometryHandle> AISTCollisionDetectorImpl::addGeometry(SgNode* ge
         ColdetModelExPtr model = new ColdetModelEx;
         if(meshExtractor->extract(geometry, [&]() { addMesh(model); })){
             model->setName(geometry->name());
-            model->build();
-            if(model->isValid()){
+            // The tree is built later by buildTreeIfNecessary
+            if(model->getNumTriangles() > 0){
                 models.push_back(model);
                 isReady = false;
                 return getHandle(model);
@@ -339,19 +408,78 @@ void AISTCollisionDetectorImpl::makeReady()
     } else {
         numThreads = (maxNumThreads > numPairs) ? numPairs : maxNumThreads;
         threadPool.reset(new ThreadPool(numThreads));
-        if(ENABLE_SHUFFLE){
-            shuffledPairIndices.resize(modelPairs.size());
-            for(size_t i=0; i < shuffledPairIndices.size(); ++i){
-                shuffledPairIndices[i] = i;
-            }
+        if(numThreads > 0){
+            chunkSize = std::max(1, numPairs / (numThreads * NumChunksPerThread));
+            numChunks = (numPairs + chunkSize - 1) / chunkSize;
+        } else {
+            chunkSize = 0;
+            numChunks = 0;
         }
-        collisionPairArrays.resize(numThreads);
+        collisionPairArrays.resize(numChunks);
     }
 
+    startBackgroundTreeBuilding();
+
     isReady = true;
 }
 
 
+/**
+   The trees of the models that are included in the pairs to check are built in the background
+   so that the setup of a scene is not blocked by them. When a pair is checked before the trees
+   are built, the trees are built in the thread checking the pair or the thread waits for the
+   building to finish. The trees of the other models are built when they are used first.
+*/
+void AISTCollisionDetectorImpl::startBackgroundTreeBuilding()
+{
+    vector<ColdetModelExPtr> modelsToBuild;
+    set<ColdetModelEx*> modelSet;
+    for(ColdetModelPairEx* modelPair : modelPairs){
+        do {
+            for(int i=0; i < 2; ++i){
+                ColdetModelEx* model = modelPair->model(i);
+                if(!model->isTreeBuilt && modelSet.insert(model).second){
+                    modelsToBuild.push_back(model);
+                }
+            }
+            modelPair = modelPair->sibling;
+        } while(modelPair);
+    }
+    if(modelsToBuild.empty()){
+        return;
+    }
+    
+    if(!treeBuildThreadPool){
+        int numThreads = std::thread::hardware_concurrency();
+        if(numThreads < 1){
+            numThreads = 1;
+        }
+        treeBuildThreadPool.reset(new ThreadPool(numThreads));
+    }
+    numTreesToBuildInBackground += modelsToBuild.size();
+    for(auto& model : modelsToBuild){
+        treeBuildThreadPool->start(
+            [this, model](){
+                if(!isTreeBuildingCanceled){
+                    model->buildTreeIfNecessary();
+                }
+                --numTreesToBuildInBackground;
+            });
+    }
+}
+
+
+void AISTCollisionDetectorImpl::stopBackgroundTreeBuilding()
+{
+    if(treeBuildThreadPool){
+        isTreeBuildingCanceled = true;
+        treeBuildThreadPool.reset();
+        isTreeBuildingCanceled = false;
+        numTreesToBuildInBackground = 0;
+    }
+}
+
+
 void AISTCollisionDetector::updatePosition(GeometryHandle geometry, const Position& position)
 {
     auto model = getColdetModel(geometry);
@@ -390,6 +518,9 @@ void AISTCollisionDetector::detectCollisions(std::function<void(const CollisionP
 {
     if(!impl->isReady){
         impl->makeReady();
+    } else if(impl->treeBuildThreadPool && impl->numTreesToBuildInBackground == 0){
+        // Release the idle threads
+        impl->treeBuildThreadPool.reset();
     }
     if(impl->numThreads > 0){
         impl->detectCollisionsInParallel(callback);
@@ -411,6 +542,7 @@ void AISTCollisionDetectorImpl::detectCollisions(std::function<void(const Collis
     for(ColdetModelPairEx* modelPair : modelPairs){ // Do not use auto&
         collisions.clear();
         do {
+            modelPair->buildTreesIfNecessary();
             if(!modelPair->detectCollisions().empty()){
                 copyCollisionPairCollisions(modelPair, collisionPair);
             }
@@ -424,28 +556,19 @@ void AISTCollisionDetectorImpl::detectCollisions(std::function<void(const Collis
 }
 
 
+/**
+   The pairs are divided into the chunks of successive pairs, and each thread takes the next
+   chunk to check when it finishes the previous one so that the threads are kept busy even if
+   the costs of the pairs are unbalanced. The collisions of each chunk are stored separately
+   and dispatched in the order of the pairs, which is the same as the order of the single
+   thread version. Hence the result does not depend on the number of threads or the timing
+   of the threads.
+*/
 void AISTCollisionDetectorImpl::detectCollisionsInParallel(std::function<void(const CollisionPair&)> callback)
 {
-    if(ENABLE_SHUFFLE){
-        std::shuffle(shuffledPairIndices.begin(), shuffledPairIndices.end(), randomEngine);
-    }
-
-    const int numPairs = modelPairs.size();
-    const int minSize = numPairs / numThreads;
-    int remainder = numPairs % numThreads;
-    int index = 0;
+    nextChunkIndex = 0;
     for(int i=0; i < numThreads; ++i){
-        int size = minSize;
-        if(remainder > 0){
-            ++size;
-            --remainder;
-        }
-        if(size == 0){
-            break;
-        }
-        threadPool->start([this, i, index, size](){
-                extractCollisionsOfAssignedPairs(index, index + size, collisionPairArrays[i]); });
-        index += size;
+        threadPool->start([this](){ extractCollisionsOfChunks(); });
     }
     threadPool->waitLoop();
     //threadPool->wait();
@@ -454,22 +577,33 @@ void AISTCollisionDetectorImpl::detectCollisionsInParallel(std::function<void(co
 }
 
 
+void AISTCollisionDetectorImpl::extractCollisionsOfChunks()
+{
+    const int numPairs = modelPairs.size();
+    while(true){
+        const int chunkIndex = nextChunkIndex++;
+        if(chunkIndex >= numChunks){
+            break;
+        }
+        const int pairIndexBegin = chunkIndex * chunkSize;
+        const int pairIndexEnd = std::min(pairIndexBegin + chunkSize, numPairs);
+        extractCollisionsOfAssignedPairs(pairIndexBegin, pairIndexEnd, collisionPairArrays[chunkIndex]);
+    }
+}
+
+
 void AISTCollisionDetectorImpl::extractCollisionsOfAssignedPairs
 (int pairIndexBegin, int pairIndexEnd, vector<CollisionPair>& collisionPairs)
 {
     collisionPairs.clear();
 
     for(int i=pairIndexBegin; i < pairIndexEnd; ++i){
-        ColdetModelPairEx* modelPair;
-        if(ENABLE_SHUFFLE){
-            modelPair = modelPairs[shuffledPairIndices[i]];
-        } else {
-            modelPair = modelPairs[i];
-        }
+        ColdetModelPairEx* modelPair = modelPairs[i];
 
         collisionPairs.push_back(CollisionPair());
         CollisionPair& collisionPair = collisionPairs.back();
         do {
+            modelPair->buildTreesIfNecessary();
             if(!modelPair->detectCollisions().empty()){
                 copyCollisionPairCollisions(modelPair, collisionPair, true);
             }
@@ -485,8 +619,7 @@ void AISTCollisionDetectorImpl::extractCollisionsOfAssignedPairs
 void AISTCollisionDetectorImpl::dispatchCollisionsInCollisionPairArrays
 (std::function<void(const CollisionPair&)> callback)
 {
-    for(int i=0; i < numThreads; ++i){
-        const vector<CollisionPair>& collisionPairs = collisionPairArrays[i];
+    for(auto& collisionPairs : collisionPairArrays){
         for(size_t j=0; j < collisionPairs.size(); ++j){
             callback(collisionPairs[j]);
         }
@@ -497,6 +630,103 @@ void AISTCollisionDetectorImpl::dispatchCollisionsInCollisionPairArrays
 double AISTCollisionDetector::detectDistance
 (GeometryHandle geometry1, GeometryHandle geometry2, Vector3& out_point1, Vector3& out_point2)
 {
-    return ColdetModelPair::computeDistance(
-        getColdetModel(geometry1), getColdetModel(geometry2), out_point1.data(), out_point2.data());
+    auto model1 = getColdetModel(geometry1);
+    auto model2 = getColdetModel(geometry2);
+    model1->buildTreeIfNecessary();
+    model2->buildTreeIfNecessary();
+    return ColdetModelPair::computeDistance(model1, model2, out_point1.data(), out_point2.data());
+}
+
+
+int AISTCollisionDetector::detectDistances
+(const std::vector<GeometryPair>& pairs, double maxDistance, std::vector<DistanceResult>& out_results)
+{
+    return impl->detectDistances(pairs, maxDistance, out_results);
+}
+
+
+/**
+   The closest triangle pair of each geometry pair is stored and used as the initial estimate of
+   the next computation, which makes the pruning of the tree traversal effective from the beginning
+   when the geometries move continuously. The pairs are processed in parallel by the threads specified
+   with setNumThreads, and the results are output in the order of the given pairs.
+*/
+int AISTCollisionDetectorImpl::detectDistances
+(const vector<CollisionDetectorDistanceAPI::GeometryPair>& pairs, double maxDistance,
+ vector<CollisionDetectorDistanceAPI::DistanceResult>& out_results)
+{
+    out_results.clear();
+
+    const int numQueries = pairs.size();
+    distanceQueries.resize(numQueries);
+    for(int i=0; i < numQueries; ++i){
+        auto& pair = pairs[i];
+        auto& query = distanceQueries[i];
+        query.model1 = getColdetModel(pair.first);
+        query.model2 = getColdetModel(pair.second);
+        auto& closest = closestTriangleMap.insert(make_pair(pair, ClosestTriangles{ { -1, -1 }, -1 })).first->second;
+        if(closest.computationId != distanceComputationId){
+            closest.computationId = distanceComputationId;
+            query.closestTriangles = closest.triangles;
+        } else {
+            // The entry must not be shared by the threads
+            query.closestTriangles = nullptr;
+        }
+    }
+    ++distanceComputationId;
+
+    int numThreadsToUse = std::min(maxNumThreads, numQueries);
+    if(numThreadsToUse <= 1){
+        distanceChunkSize = std::max(1, numQueries);
+        nextDistanceQueryIndex = 0;
+        computeDistancesOfChunks(maxDistance);
+    } else {
+        if(!distanceThreadPool || distanceThreadPool->size() != maxNumThreads){
+            distanceThreadPool.reset(new ThreadPool(maxNumThreads));
+        }
+        distanceChunkSize = std::max(1, numQueries / (numThreadsToUse * NumChunksPerThread));
+        nextDistanceQueryIndex = 0;
+        for(int i=0; i < numThreadsToUse; ++i){
+            distanceThreadPool->start([this, maxDistance](){ computeDistancesOfChunks(maxDistance); });
+        }
+        distanceThreadPool->wait();
+    }
+
+    for(int i=0; i < numQueries; ++i){
+        auto& query = distanceQueries[i];
+        if(query.distance >= 0.0 && query.distance < maxDistance){
+            out_results.emplace_back();
+            auto& result = out_results.back();
+            result.geometry1 = pairs[i].first;
+            result.geometry2 = pairs[i].second;
+            result.distance = query.distance;
+            result.point1 = query.point1;
+            result.point2 = query.point2;
+        }
+    }
+
+    return out_results.size();
+}
+
+
+void AISTCollisionDetectorImpl::computeDistancesOfChunks(double maxDistance)
+{
+    const int numQueries = distanceQueries.size();
+    while(true){
+        const int indexBegin = nextDistanceQueryIndex.fetch_add(distanceChunkSize);
+        if(indexBegin >= numQueries){
+            break;
+        }
+        const int indexEnd = std::min(indexBegin + distanceChunkSize, numQueries);
+        for(int i=indexBegin; i < indexEnd; ++i){
+            auto& query = distanceQueries[i];
+            query.model1->buildTreeIfNecessary();
+            query.model2->buildTreeIfNecessary();
+            int triangles[2] = { -1, -1 };
+            int* closestTriangles = query.closestTriangles ? query.closestTriangles : triangles;
+            query.distance = ColdetModelPair::computeDistance(
+                query.model1, query.model2, maxDistance,
+                closestTriangles[0], query.point1.data(), closestTriangles[1], query.point2.data());
+        }
+    }
 }
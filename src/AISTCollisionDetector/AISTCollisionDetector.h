@@ -33,6 +33,8 @@ public:
 
     // CollisionDetectorDistanceAPI
     virtual double detectDistance(GeometryHandle geometry1, GeometryHandle geometry2, Vector3& out_point1, Vector3& out_point2) override;
+    virtual int detectDistances(
+        const std::vector<GeometryPair>& pairs, double maxDistance, std::vector<DistanceResult>& out_results) override;
 
     // experimental
     void setNumThreads(int n);
@@ -651,6 +651,45 @@ double ColdetModelPair::computeDistance(int& triangle0, double* point0, int& tri
 }
 
 
+double ColdetModelPair::computeDistance
+(ColdetModel* model0, ColdetModel* model1, double maxDistance,
+ int& io_triangle0, double* out_point0, int& io_triangle1, double* out_point1)
+{
+    if(model0->isValid() && model1->isValid()){
+
+        Opcode::BVTCache colCache;
+
+        colCache.Model0 = &model1->internalModel->model;
+        colCache.Model1 = &model0->internalModel->model;
+
+        bool useCachedPrimitives = (io_triangle0 >= 0 && io_triangle1 >= 0);
+        if(useCachedPrimitives){
+            colCache.id0 = io_triangle1;
+            colCache.id1 = io_triangle0;
+        }
+        
+        Opcode::SSVTreeCollider collider;
+        
+        float d;
+        Point p0, p1;
+        float maxD = (maxDistance < MAX_FLOAT) ? maxDistance : MAX_FLOAT;
+        collider.Distance(colCache, d, p0, p1,
+                          model1->transform, model0->transform, useCachedPrimitives, maxD);
+        out_point0[0] = p1.x;
+        out_point0[1] = p1.y;
+        out_point0[2] = p1.z;
+        out_point1[0] = p0.x;
+        out_point1[1] = p0.y;
+        out_point1[2] = p0.z;
+        io_triangle1 = colCache.id0;
+        io_triangle0 = colCache.id1;
+        return d;
+    }
+
+    return -1.0;
+}
+
+
 bool ColdetModelPair::detectIntersection()
 {
     if(models[0]->isValid() && models[1]->isValid()){
@@ -50,6 +50,17 @@ public:
     */
     double computeDistance(int& out_triangle0, double* out_point0, int& out_triangle1, double* out_point1);
 
+    /**
+       The triangle pair given by io_triangle0 and io_triangle1 is used as the initial estimate of the
+       distance if their indices are not negative, and the indices are updated to the closest triangle pair.
+       Giving the result of the previous computation makes the computation faster when the models move
+       continuously. The subtrees farther than maxDistance are not traversed, so the returned value
+       is not necessarily the minimum distance if it is not less than maxDistance.
+    */
+    static double computeDistance(
+        ColdetModel* model0, ColdetModel* model1, double maxDistance,
+        int& io_triangle0, double* out_point0, int& io_triangle1, double* out_point1);
+
     bool detectIntersection();
 
     double tolerance() const { return tolerance_; }
@@ -13,7 +13,8 @@ SSVTreeCollider::SSVTreeCollider()
     
 bool SSVTreeCollider::Distance(BVTCache& cache, 
                                float& minD, Point &point0, Point&point1,
-                               const Matrix4x4* world0, const Matrix4x4* world1)
+                               const Matrix4x4* world0, const Matrix4x4* world1,
+                               bool useCachedPrimitives, float maxD)
 {
     // Checkings
     if(!cache.Model0 || !cache.Model1)                             return false;
@@ -26,43 +27,59 @@ bool SSVTreeCollider::Distance(BVTCache& cache,
     // Simple double-dispatch
     const AABBCollisionTree* T0 = (const AABBCollisionTree*)cache.Model0->GetTree();
     const AABBCollisionTree* T1 = (const AABBCollisionTree*)cache.Model1->GetTree();
-    Distance(T0, T1, world0, world1, &cache, minD, point0, point1);
+    Distance(T0, T1, world0, world1, &cache, minD, point0, point1, useCachedPrimitives, maxD);
     return true;
 }
 
 void SSVTreeCollider::Distance(const AABBCollisionTree* tree0, 
                                const AABBCollisionTree* tree1, 
                                const Matrix4x4* world0, const Matrix4x4* world1, 
-                               Pair* cache, float& minD, Point &point0, Point&point1)
+                               Pair* cache, float& minD, Point &point0, Point&point1,
+                               bool useCachedPrimitives, float maxD)
 {
     if (debug) std::cout << "Distance()" << std::endl;
     // Init collision query
     InitQuery(world0, world1);
     
     // Compute initial value using temporal coherency
-    // todo : cache should be used 
-
-    const AABBCollisionNode *n;
-    for (unsigned int i=0; i<tree0->GetNbNodes(); i++){
-        n = tree0->GetNodes()+i;
-        if (n->IsLeaf()){
-            mId0 = n->GetPrimitive();
-            break;
+    if(useCachedPrimitives &&
+       cache->id0 < mIMesh0->GetNbTriangles() && cache->id1 < mIMesh1->GetNbTriangles()){
+        mId0 = cache->id0;
+        mId1 = cache->id1;
+    } else {
+        const AABBCollisionNode *n;
+        for (unsigned int i=0; i<tree0->GetNbNodes(); i++){
+            n = tree0->GetNodes()+i;
+            if (n->IsLeaf()){
+                mId0 = n->GetPrimitive();
+                break;
+            }
+        } 
+        for (unsigned int i=0; i<tree1->GetNbNodes(); i++){
+            n = tree1->GetNodes()+i;
+            if (n->IsLeaf()){
+                mId1 = n->GetPrimitive();
+                break;
+            }
         }
-    } 
-    for (unsigned int i=0; i<tree1->GetNbNodes(); i++){
-        n = tree1->GetNodes()+i;
-        if (n->IsLeaf()){
-            mId1 = n->GetPrimitive();
-            break;
-        }
-    } 
+    }
     Point p0, p1;
     minD = PrimDist(mId0, mId1, p0, p1);
+
+    // The pairs of the nodes farther than maxD are pruned
+    const float initialD = minD;
+    if(minD > maxD){
+        minD = maxD;
+    }
     
     // Perform distance computation
     _Distance(tree0->GetNodes(), tree1->GetNodes(), minD, p0, p1);
 
+    if(initialD > maxD && minD == maxD){
+        // No primitive pair closer than maxD was found
+        minD = initialD;
+    }
+
     // transform points
     TransformPoint4x3(point0, p0, *world1);
     TransformPoint4x3(point1, p1, *world1);
@@ -28,10 +28,15 @@ public:
      * @param point1 the closest point on the second link
      * @param world0 transformation of the first link
      * @param world1 transformation of the second link
+     * @param useCachedPrimitives If true, the closest primitives of the previous query stored
+     *        in the cache are used for the initial estimate of the distance
+     * @param maxD the subtrees farther than this value are not traversed. If the distance is not
+     *        less than this value, minD may be larger than the actual minimum distance.
      * @return true if computed successfully, false otherwise
      */
     bool Distance(BVTCache& cache, float& minD, Point &point0, Point&point1,
-                  const Matrix4x4* world0=null, const Matrix4x4* world1=null);
+                  const Matrix4x4* world0=null, const Matrix4x4* world1=null,
+                  bool useCachedPrimitives=false, float maxD=MAX_FLOAT);
 
     /**
      * @brief detect collision between links. 
@@ -67,7 +72,8 @@ private:
     void Distance(const AABBCollisionTree* tree0, 
                   const AABBCollisionTree* tree1, 
                   const Matrix4x4* world0, const Matrix4x4* world1, 
-                  Pair* cache, float& minD,  Point &point0, Point&point1);
+                  Pair* cache, float& minD,  Point &point0, Point&point1,
+                  bool useCachedPrimitives, float maxD);
 
     void _Distance(const AABBCollisionNode* b0, const AABBCollisionNode* b1,
                    float& minD, Point& point0, Point& point1);
@@ -177,6 +177,17 @@ App::Impl::Impl(App* self, int& argc, char** argv)
 
     doQuit = false;
 
+#ifdef Q_OS_LINUX
+    /*
+      Use the offscreen platform when no display is available so that batch processes
+      such as the batch simulation can be run on display-less machines.
+    */
+    if(qEnvironmentVariableIsEmpty("DISPLAY") && qEnvironmentVariableIsEmpty("WAYLAND_DISPLAY") &&
+       !qEnvironmentVariableIsSet("QT_QPA_PLATFORM")){
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+#endif
+
     qapplication = new QApplication(argc, argv);
 
 #ifdef Q_OS_UNIX
@@ -10,6 +10,7 @@
 #include <cnoid/SceneLights>
 #include <cnoid/SceneEffects>
 #include <cnoid/EigenUtil>
+#include <cnoid/BoundingVolumeHierarchy>
 #include <cnoid/NullOut>
 #include <fmt/format.h>
 #include <GL/glu.h>
@@ -209,6 +210,30 @@ struct SgObjectPtrHash {
 
 typedef std::unordered_map<SgObjectPtr, GLResourcePtr, SgObjectPtrHash> GLResourceMap;
 
+/**
+   The triangle tree of a mesh or the point tree of a point set used in the ray picking.
+   The tree is rebuilt when the mesh or the point set is updated.
+*/
+class RayPickingMeshResource : public Referenced
+{
+public:
+    BoundingVolumeHierarchy primitiveTree;
+    bool isValid;
+    unsigned int sceneId;
+    ScopedConnection connection;
+
+    RayPickingMeshResource(SgObject* object)
+        : isValid(false),
+          sceneId(0)
+    {
+        connection.reset(
+            object->sigUpdated().connect(
+                [this](const SgUpdate&){ isValid = false; }));
+    }
+};
+
+typedef ref_ptr<RayPickingMeshResource> RayPickingMeshResourcePtr;
+
 class ScopedShaderProgramActivator
 {
     GLSLSceneRenderer::Impl* renderer;
@@ -384,6 +409,40 @@ public:
     Vector3 pickedPoint;
     int overlayPickIndex0;
 
+    // Variables for the ray picking
+    enum RayPickingPrimitiveType {
+        MESH_PRIMITIVE,
+        BOUNDING_BOX_PRIMITIVE,
+        POINT_PRIMITIVE,
+        LINE_PRIMITIVE
+    };
+    struct RayPickingPrimitive
+    {
+        SgNodePtr node;
+        Affine3 T;
+        int type;
+        int pickIndex;
+        // The point size or the line width in pixels
+        float size;
+    };
+    typedef vector<RayPickingPrimitive, Eigen::aligned_allocator<RayPickingPrimitive>> RayPickingPrimitiveArray;
+    enum RayPickingResult { RAY_PICKING_MISSED, RAY_PICKING_HIT, RAY_PICKING_UNDETERMINED };
+
+    bool isRayPickingEnabled;
+    bool isRayPicking;
+    bool isRayPickingOverlay;
+    bool hasRayPickingUnsupportedNodes;
+    bool isRayPickingSceneValid;
+    unsigned int rayPickingSceneId;
+    Matrix4 rayPickingPV;
+    Array4i rayPickingViewport;
+    vector<SgNodePathPtr> rayPickingNodePathList;
+    RayPickingPrimitiveArray rayPickingPrimitives;
+    RayPickingPrimitiveArray rayPickingOverlayPrimitives;
+    vector<int> rayPickingPlotIndices;
+    BoundingVolumeHierarchy rayPickingShapeTree;
+    unordered_map<SgObjectPtr, RayPickingMeshResourcePtr, SgObjectPtrHash> rayPickingMeshResourceMap;
+
     ostream* os_;
     ostream& os() { return *os_; }
 
@@ -412,6 +471,15 @@ public:
     void doRender();
     void setupFullLightingRendering();
     bool doPick(int x, int y);
+    int doRayPick(int x, int y);
+    bool updateRayPickingScene();
+    void clearRayPickingScene();
+    void addRayPickingPrimitive(SgNode* node, int type, float size);
+    RayPickingMeshResource* getOrCreateRayPickingMeshResource(SgMesh* mesh);
+    RayPickingMeshResource* getOrCreateRayPickingPointResource(SgPlot* pointSet);
+    bool intersectRayWithMesh(
+        const RayPickingPrimitive& primitive, const Vector3& origin, const Vector3& direction, float& io_distance);
+    bool pickPlotWithRay(const RayPickingPrimitive& primitive, const Vector2& pixel, double& io_depth);
     bool renderShadowMap(int lightIndex);
     void beginRendering();
     void renderCamera(SgCamera* camera, const Affine3& cameraPosition);
@@ -647,6 +715,13 @@ void GLSLSceneRenderer::Impl::initialize()
 
     pickedPoint.setZero();
 
+    isRayPickingEnabled = true;
+    isRayPicking = false;
+    isRayPickingOverlay = false;
+    hasRayPickingUnsupportedNodes = false;
+    isRayPickingSceneValid = false;
+    rayPickingSceneId = 0;
+
     clearGL(false, true, false);
 
     activateNormalRenderingFunctions();
@@ -826,6 +901,9 @@ void GLSLSceneRenderer::Impl::clearResourceMap()
     isResourceClearRequested = false;
     currentResourceMap = &resourceMaps[0];
     nextResourceMap = &resourceMaps[1];
+
+    clearRayPickingScene();
+    rayPickingMeshResourceMap.clear();
 }
 
 
@@ -1038,6 +1116,8 @@ void GLSLSceneRenderer::onSceneGraphUpdated(const SgUpdate& update)
         requestToClearResources();
     }
     
+    impl->isRayPickingSceneValid = false;
+    
     GLSceneRenderer::onSceneGraphUpdated(update);
 }
 
@@ -1106,6 +1186,9 @@ void GLSLSceneRenderer::Impl::pushProgram(ShaderProgram& program)
 
 void GLSLSceneRenderer::pushShaderProgram(ShaderProgram& program)
 {
+    if(impl->isRayPicking){
+        impl->hasRayPickingUnsupportedNodes = true;
+    }
     impl->programStack.emplace_back(program, impl);
 }
 
@@ -1139,6 +1222,8 @@ void GLSLSceneRenderer::Impl::doRender()
 
     if(self->applyNewExtensions()){
         normalRenderingFunctions.updateDispatchTable();
+        // The new rendering functions may collect the scene differently
+        isRayPickingSceneValid = false;
     }
 
     beginRendering();
@@ -1265,6 +1350,13 @@ bool GLSLSceneRenderer::doPick(int x, int y)
 
 bool GLSLSceneRenderer::Impl::doPick(int x, int y)
 {
+    if(isRayPickingEnabled && !isPickingImageOutputEnabled){
+        int result = doRayPick(x, y);
+        if(result != RAY_PICKING_UNDETERMINED){
+            return (result == RAY_PICKING_HIT);
+        }
+    }
+    
     if(isGLCleared){
         initializeGLForRendering();
     }
@@ -1410,6 +1502,510 @@ bool GLSLSceneRenderer::getPickingImage(Image& out_image)
 }
 
 
+void GLSLSceneRenderer::setRayPickingEnabled(bool on)
+{
+    impl->isRayPickingEnabled = on;
+    if(!on){
+        impl->clearRayPickingScene();
+        impl->rayPickingMeshResourceMap.clear();
+    }
+}
+
+
+void GLSLSceneRenderer::Impl::clearRayPickingScene()
+{
+    rayPickingNodePathList.clear();
+    rayPickingPrimitives.clear();
+    rayPickingOverlayPrimitives.clear();
+    rayPickingPlotIndices.clear();
+    rayPickingShapeTree.clear();
+    isRayPickingSceneValid = false;
+}
+
+
+/**
+   The scene is traversed with the normal rendering functions so that the custom nodes
+   registered as extensions are processed in the same way as the picking image rendering.
+   The traversal only collects the primitives and does not call any OpenGL functions.
+   The collected primitives are reused while the scene and the camera are not changed.
+*/
+bool GLSLSceneRenderer::Impl::updateRayPickingScene()
+{
+    self->extractPreprocessedNodes();
+
+    auto camera = self->currentCamera();
+    if(!camera){
+        return false;
+    }
+    renderCamera(camera, self->currentCameraPosition());
+
+    const Array4i vp = self->viewport();
+    if(isRayPickingSceneValid && PV == rayPickingPV && (vp == rayPickingViewport).all()){
+        return !hasRayPickingUnsupportedNodes;
+    }
+
+    clearRayPickingScene();
+    rayPickingPV = PV;
+    rayPickingViewport = vp;
+    ++rayPickingSceneId;
+
+    bool wasRenderingVisibleImage = isRenderingVisibleImage;
+    isRenderingVisibleImage = false;
+    isRenderingPickingImage = true;
+    isRayPicking = true;
+    hasRayPickingUnsupportedNodes = false;
+    currentNodePath.clear();
+    pickingNodePathList.clear();
+    transparentRenderingQueue.clear();
+    overlayRenderingQueue.clear();
+
+    renderingFunctions->dispatch(self->sceneRoot());
+
+    // The functions in the transparent rendering queue only change the rendering states here
+    transparentRenderingQueue.clear();
+
+    isRayPickingOverlay = true;
+    for(auto& func : overlayRenderingQueue){
+        func();
+    }
+    overlayRenderingQueue.clear();
+    transparentRenderingQueue.clear();
+    isRayPickingOverlay = false;
+    
+    isRayPicking = false;
+    isRenderingPickingImage = false;
+    isRenderingVisibleImage = wasRenderingVisibleImage;
+    currentNodePath.clear();
+    rayPickingNodePathList.swap(pickingNodePathList);
+    pickingNodePathList.clear();
+
+    const int n = rayPickingPrimitives.size();
+    vector<BoundingBoxf> boxes;
+    boxes.reserve(n);
+    for(int i=0; i < n; ++i){
+        auto& primitive = rayPickingPrimitives[i];
+        if(primitive.type != MESH_PRIMITIVE){
+            boxes.emplace_back();
+            rayPickingPlotIndices.push_back(i);
+        } else {
+            auto mesh = static_cast<SgShape*>(primitive.node.get())->mesh();
+            BoundingBox bbox = mesh->boundingBox();
+            if(bbox.empty()){
+                for(auto& v : *mesh->vertices()){
+                    bbox.expandBy(v.cast<double>());
+                }
+            }
+            bbox.transform(primitive.T);
+            boxes.emplace_back(bbox);
+        }
+    }
+    rayPickingShapeTree.build(boxes, 2);
+
+    // Remove the trees of the meshes and the point sets that are no longer in the scene
+    for(auto& primitives : { &rayPickingPrimitives, &rayPickingOverlayPrimitives }){
+        for(auto& primitive : *primitives){
+            SgObject* object = nullptr;
+            if(primitive.type == MESH_PRIMITIVE){
+                object = static_cast<SgShape*>(primitive.node.get())->mesh();
+            } else if(primitive.type == POINT_PRIMITIVE){
+                object = primitive.node.get();
+            }
+            if(object){
+                auto p = rayPickingMeshResourceMap.find(object);
+                if(p != rayPickingMeshResourceMap.end()){
+                    p->second->sceneId = rayPickingSceneId;
+                }
+            }
+        }
+    }
+    auto p = rayPickingMeshResourceMap.begin();
+    while(p != rayPickingMeshResourceMap.end()){
+        if(p->second->sceneId != rayPickingSceneId){
+            p = rayPickingMeshResourceMap.erase(p);
+        } else {
+            ++p;
+        }
+    }
+    
+    isRayPickingSceneValid = true;
+
+    return !hasRayPickingUnsupportedNodes;
+}
+
+
+void GLSLSceneRenderer::Impl::addRayPickingPrimitive(SgNode* node, int type, float size)
+{
+    auto& primitives = isRayPickingOverlay ? rayPickingOverlayPrimitives : rayPickingPrimitives;
+    primitives.emplace_back();
+    auto& primitive = primitives.back();
+    primitive.node = node;
+    primitive.T = modelMatrixStack.back();
+    primitive.type = type;
+    primitive.pickIndex = pushPickNode(node, false);
+    primitive.size = size;
+    popPickNode();
+}
+
+
+RayPickingMeshResource* GLSLSceneRenderer::Impl::getOrCreateRayPickingMeshResource(SgMesh* mesh)
+{
+    auto& resource = rayPickingMeshResourceMap[mesh];
+    if(!resource){
+        resource = new RayPickingMeshResource(mesh);
+    }
+    resource->sceneId = rayPickingSceneId;
+    
+    if(!resource->isValid){
+        const auto& vertices = *mesh->vertices();
+        const int numVertices = vertices.size();
+        const int numTriangles = mesh->numTriangles();
+        vector<BoundingBoxf> boxes(numTriangles);
+        for(int i=0; i < numTriangles; ++i){
+            auto triangle = mesh->triangle(i);
+            if((triangle >= 0).all() && (triangle < numVertices).all()){
+                auto& box = boxes[i];
+                box.expandBy(vertices[triangle[0]]);
+                box.expandBy(vertices[triangle[1]]);
+                box.expandBy(vertices[triangle[2]]);
+            }
+        }
+        resource->primitiveTree.build(boxes);
+        resource->isValid = true;
+    }
+
+    return resource;
+}
+
+
+RayPickingMeshResource* GLSLSceneRenderer::Impl::getOrCreateRayPickingPointResource(SgPlot* pointSet)
+{
+    auto& resource = rayPickingMeshResourceMap[pointSet];
+    if(!resource){
+        resource = new RayPickingMeshResource(pointSet);
+    }
+    resource->sceneId = rayPickingSceneId;
+    
+    if(!resource->isValid){
+        vector<BoundingBoxf> boxes;
+        if(auto vertices = pointSet->vertices()){
+            boxes.reserve(vertices->size());
+            for(auto& v : *vertices){
+                // A box of a single point is regarded as empty and the box is slightly inflated
+                const Vector3f e = Vector3f::Constant(1.0e-6f * std::max(1.0f, v.cwiseAbs().maxCoeff()));
+                boxes.emplace_back(v - e, v + e);
+            }
+        }
+        resource->primitiveTree.build(boxes, 8);
+        resource->isValid = true;
+    }
+
+    return resource;
+}
+
+
+/**
+   The distance is the parameter of the ray given as origin + distance * direction.
+   The ray is transformed into the local coordinate of the mesh so that the parameter
+   is common to all the meshes.
+*/
+bool GLSLSceneRenderer::Impl::intersectRayWithMesh
+(const RayPickingPrimitive& primitive, const Vector3& origin, const Vector3& direction, float& io_distance)
+{
+    auto mesh = static_cast<SgShape*>(primitive.node.get())->mesh();
+    auto resource = getOrCreateRayPickingMeshResource(mesh);
+
+    const Affine3 Tinv = primitive.T.inverse(Eigen::Affine);
+    const Vector3f o = (Tinv * origin).cast<float>();
+    const Vector3f d = (Tinv.linear() * direction).cast<float>();
+
+    bool isCullingEnabled;
+    switch(backFaceCullingMode){
+    case ENABLE_BACK_FACE_CULLING:
+        isCullingEnabled = mesh->isSolid();
+        break;
+    case DISABLE_BACK_FACE_CULLING:
+        isCullingEnabled = false;
+        break;
+    case FORCE_BACK_FACE_CULLING:
+    default:
+        isCullingEnabled = true;
+        break;
+    }
+    // The front face is inverted by a mirroring transform
+    const float frontSign = (primitive.T.linear().determinant() < 0.0) ? -1.0f : 1.0f;
+
+    const auto& vertices = *mesh->vertices();
+    bool isHit = false;
+    
+    resource->primitiveTree.traverseRay(
+        o, d, io_distance,
+        [&](int index, float& io_t){
+            auto triangle = mesh->triangle(index);
+            const Vector3f& v0 = vertices[triangle[0]];
+            const Vector3f e1 = vertices[triangle[1]] - v0;
+            const Vector3f e2 = vertices[triangle[2]] - v0;
+            const Vector3f p = d.cross(e2);
+            const float det = e1.dot(p);
+            // The determinant is positive when the ray hits the front face
+            if(isCullingEnabled ? (frontSign * det <= 0.0f) : (det == 0.0f)){
+                return;
+            }
+            const float invDet = 1.0f / det;
+            const Vector3f s = o - v0;
+            const float u = s.dot(p) * invDet;
+            if(u < 0.0f || u > 1.0f){
+                return;
+            }
+            const Vector3f q = s.cross(e1);
+            const float v = d.dot(q) * invDet;
+            if(v < 0.0f || u + v > 1.0f){
+                return;
+            }
+            const float t = e2.dot(q) * invDet;
+            if(t >= 0.0f && t < io_t){
+                io_t = t;
+                isHit = true;
+            }
+        });
+
+    return isHit;
+}
+
+
+/**
+   The points and lines are tested in the window coordinate with the same pixel sizes
+   as the picking image rendering.
+   \param io_depth The depth in the window coordinate
+*/
+bool GLSLSceneRenderer::Impl::pickPlotWithRay
+(const RayPickingPrimitive& primitive, const Vector2& pixel, double& io_depth)
+{
+    const Matrix4 M = rayPickingPV * primitive.T.matrix();
+    const Array4i& vp = rayPickingViewport;
+    const double r = primitive.size / 2.0;
+    bool isHit = false;
+
+    auto toWindow = [&](const Vector4& c){
+        return Vector3(
+            vp[0] + (c.x() / c.w() + 1.0) * vp[2] / 2.0,
+            vp[1] + (c.y() / c.w() + 1.0) * vp[3] / 2.0,
+            (c.z() / c.w() + 1.0) / 2.0);
+    };
+
+    auto checkSegment = [&](const Vector3f& v0, const Vector3f& v1){
+        Vector4 a = M * Vector4(v0.x(), v0.y(), v0.z(), 1.0);
+        Vector4 b = M * Vector4(v1.x(), v1.y(), v1.z(), 1.0);
+        // Clip the segment by the near plane
+        const double da = a.z() + a.w();
+        const double db = b.z() + b.w();
+        if(da < 0.0 && db < 0.0){
+            return;
+        } else if(da < 0.0){
+            a += (b - a) * (da / (da - db));
+        } else if(db < 0.0){
+            b = a + (b - a) * (da / (da - db));
+        }
+        if(a.w() <= 0.0 || b.w() <= 0.0){
+            return;
+        }
+        const Vector3 pa = toWindow(a);
+        const Vector3 pb = toWindow(b);
+        const Vector2 e = pb.head<2>() - pa.head<2>();
+        const double l2 = e.squaredNorm();
+        double u = 0.0;
+        if(l2 > 0.0){
+            u = std::max(0.0, std::min(1.0, (pixel - pa.head<2>()).dot(e) / l2));
+        }
+        if((pa.head<2>() + u * e - pixel).norm() > r){
+            return;
+        }
+        // Perspective correct interpolation
+        const double s = u * a.w() / ((1.0 - u) * b.w() + u * a.w());
+        const Vector4 c = a + s * (b - a);
+        const double depth = (c.z() / c.w() + 1.0) / 2.0;
+        if(depth >= 0.0 && depth <= 1.0 && depth < io_depth){
+            io_depth = depth;
+            isHit = true;
+        }
+    };
+
+    if(primitive.type == POINT_PRIMITIVE){
+        auto pointSet = static_cast<SgPlot*>(primitive.node.get());
+        if(!pointSet->hasVertices()){
+            return false;
+        }
+        const auto& vertices = *pointSet->vertices();
+        auto resource = getOrCreateRayPickingPointResource(pointSet);
+
+        // Only the points in the nodes whose window rectangles contain the pixel are projected
+        auto isNodeAccepted = [&](const Vector3f& min, const Vector3f& max){
+            Vector3 wmin, wmax;
+            for(int i=0; i < 8; ++i){
+                const Vector4 c = M * Vector4(
+                    (i & 4) ? max.x() : min.x(), (i & 2) ? max.y() : min.y(), (i & 1) ? max.z() : min.z(), 1.0);
+                if(c.w() <= 0.0){
+                    // The box crossing the eye plane is not projected correctly
+                    return true;
+                }
+                const Vector3 p = toWindow(c);
+                if(i == 0){
+                    wmin = wmax = p;
+                } else {
+                    wmin = wmin.cwiseMin(p);
+                    wmax = wmax.cwiseMax(p);
+                }
+            }
+            return (wmin.x() - r <= pixel.x() && pixel.x() <= wmax.x() + r &&
+                    wmin.y() - r <= pixel.y() && pixel.y() <= wmax.y() + r &&
+                    wmin.z() < io_depth && wmax.z() >= 0.0);
+        };
+
+        resource->primitiveTree.traverse(
+            isNodeAccepted,
+            [&](int index){
+                const Vector3f& v = vertices[index];
+                const Vector4 c = M * Vector4(v.x(), v.y(), v.z(), 1.0);
+                if(c.w() <= 0.0){
+                    return;
+                }
+                const Vector3 p = toWindow(c);
+                if(p.z() >= 0.0 && p.z() <= 1.0 && p.z() < io_depth &&
+                   fabs(p.x() - pixel.x()) <= r && fabs(p.y() - pixel.y()) <= r){
+                    io_depth = p.z();
+                    isHit = true;
+                }
+            });
+
+    } else if(primitive.type == LINE_PRIMITIVE){
+        auto lineSet = static_cast<SgLineSet*>(primitive.node.get());
+        const auto& vertices = *lineSet->vertices();
+        const int numVertices = vertices.size();
+        const int numLines = lineSet->numLines();
+        for(int i=0; i < numLines; ++i){
+            auto line = lineSet->line(i);
+            if(line[0] < numVertices && line[1] < numVertices){
+                checkSegment(vertices[line[0]], vertices[line[1]]);
+            }
+        }
+
+    } else if(primitive.type == BOUNDING_BOX_PRIMITIVE){
+        const BoundingBoxf bbox(static_cast<SgShape*>(primitive.node.get())->mesh()->boundingBox());
+        const Vector3f& min = bbox.min();
+        const Vector3f& max = bbox.max();
+        Vector3f corners[8];
+        for(int i=0; i < 8; ++i){
+            corners[i] << ((i & 4) ? max.x() : min.x()), ((i & 2) ? max.y() : min.y()), ((i & 1) ? max.z() : min.z());
+        }
+        // The same edges as the bounding box rendering
+        static const int edges[12][2] = {
+            { 0, 1 }, { 0, 2 }, { 0, 4 }, { 1, 3 }, { 1, 5 }, { 2, 3 },
+            { 2, 6 }, { 3, 7 }, { 4, 5 }, { 4, 6 }, { 5, 7 }, { 6, 7 } };
+        for(auto& edge : edges){
+            checkSegment(corners[edge[0]], corners[edge[1]]);
+        }
+    }
+
+    return isHit;
+}
+
+
+/**
+   The overlay primitives are prior to the other primitives as well as the picking image
+   rendering, where the overlays are rendered with the separate depth buffer.
+*/
+int GLSLSceneRenderer::Impl::doRayPick(int x, int y)
+{
+    if(!updateRayPickingScene()){
+        return RAY_PICKING_UNDETERMINED;
+    }
+
+    const Vector2 pixel(x + 0.5, y + 0.5);
+    const Array4i& vp = rayPickingViewport;
+    const Matrix4 PVinv = rayPickingPV.inverse();
+    auto unprojectWindowPoint = [&](double depth, Vector3& out_point){
+        const Vector4 p(
+            2.0 * (pixel.x() - vp[0]) / vp[2] - 1.0,
+            2.0 * (pixel.y() - vp[1]) / vp[3] - 1.0,
+            2.0 * depth - 1.0,
+            1.0);
+        const Vector4 q = PVinv * p;
+        if(q[3] == 0.0){
+            return false;
+        }
+        out_point = q.head<3>() / q[3];
+        return true;
+    };
+    auto getWindowDepth = [&](const Vector3& point){
+        const Vector4 c = rayPickingPV * Vector4(point.x(), point.y(), point.z(), 1.0);
+        return (c.z() / c.w() + 1.0) / 2.0;
+    };
+
+    Vector3 origin, end;
+    if(!unprojectWindowPoint(0.0, origin) || !unprojectWindowPoint(1.0, end)){
+        return RAY_PICKING_UNDETERMINED;
+    }
+    const Vector3 direction = end - origin;
+
+    int pickIndex = -1;
+    double depth = std::numeric_limits<double>::max();
+    Vector3 point;
+
+    for(auto& primitive : rayPickingOverlayPrimitives){
+        if(primitive.type == MESH_PRIMITIVE){
+            float t = 1.0f;
+            if(intersectRayWithMesh(primitive, origin, direction, t)){
+                const Vector3 p = origin + t * direction;
+                const double d = getWindowDepth(p);
+                if(d < depth){
+                    depth = d;
+                    point = p;
+                    pickIndex = primitive.pickIndex;
+                }
+            }
+        } else if(pickPlotWithRay(primitive, pixel, depth)){
+            if(unprojectWindowPoint(depth, point)){
+                pickIndex = primitive.pickIndex;
+            }
+        }
+    }
+
+    if(pickIndex < 0){
+        float t = 1.0f;
+        int shapeIndex = -1;
+        rayPickingShapeTree.traverseRay(
+            origin.cast<float>(), direction.cast<float>(), t,
+            [&](int index, float& io_t){
+                if(intersectRayWithMesh(rayPickingPrimitives[index], origin, direction, io_t)){
+                    shapeIndex = index;
+                }
+            });
+        if(shapeIndex >= 0){
+            point = origin + t * direction;
+            depth = getWindowDepth(point);
+            pickIndex = rayPickingPrimitives[shapeIndex].pickIndex;
+        }
+        for(auto& index : rayPickingPlotIndices){
+            auto& primitive = rayPickingPrimitives[index];
+            if(pickPlotWithRay(primitive, pixel, depth)){
+                if(unprojectWindowPoint(depth, point)){
+                    pickIndex = primitive.pickIndex;
+                }
+            }
+        }
+    }
+
+    pickedNodePath.clear();
+
+    if(pickIndex >= 0 && pickIndex < static_cast<int>(rayPickingNodePathList.size())){
+        pickedNodePath = *rayPickingNodePathList[pickIndex];
+        pickedPoint = point;
+        return RAY_PICKING_HIT;
+    }
+
+    return RAY_PICKING_MISSED;
+}
+
+
 bool GLSLSceneRenderer::Impl::renderShadowMap(int lightIndex)
 {
     SgLight* light;
@@ -1622,7 +2218,10 @@ void GLSLSceneRenderer::dispatchToTransparentPhase
 (ReferencedPtr object, int id,
  const std::function<void(Referenced* object, const Affine3& position, int id)>& renderingFunction)
 {
-    if(!impl->isRenderingShadowMap){
+    if(impl->isRayPicking){
+        // The objects rendered in the transparent phase cannot be handled by the ray picking
+        impl->hasRayPickingUnsupportedNodes = true;
+    } else if(!impl->isRenderingShadowMap){
         int matrixIndex = impl->modelMatrixBuffer.size();
         impl->modelMatrixBuffer.push_back(impl->modelMatrixStack.back());
         impl->transparentRenderingQueue.emplace_back(
@@ -1785,7 +2384,7 @@ int GLSLSceneRenderer::Impl::pushPickNode(SgNode* node, bool doSetColor)
         pickIndex = pickingNodePathList.size();
         currentNodePath.push_back(node);
         pickingNodePathList.push_back(std::make_shared<SgNodePath>(currentNodePath));
-        if(doSetColor){
+        if(doSetColor && !isRayPicking){
             setPickColor(pickIndex);
         }
     }
@@ -1987,6 +2586,15 @@ void GLSLSceneRenderer::Impl::renderShape(SgShape* shape)
 {
     SgMesh* mesh = shape->mesh();
     if(mesh && mesh->hasVertices()){
+        if(isRayPicking){
+            if(isBoundingBoxRenderingMode){
+                addRayPickingPrimitive(
+                    shape, BOUNDING_BOX_PRIMITIVE, std::max(defaultLineWidth, MinLineWidthForPicking));
+            } else {
+                addRayPickingPrimitive(shape, MESH_PRIMITIVE, 0.0f);
+            }
+            return;
+        }
         SgMaterial* material = shape->material();
         bool isTransparent = false;
         if(currentProgram->hasCapability(ShaderProgram::Transparency)){
@@ -2713,6 +3321,13 @@ void GLSLSceneRenderer::Impl::renderPointSet(SgPointSet* pointSet)
         return;
     }
 
+    if(isRayPicking){
+        const float s = pointSet->pointSize();
+        addRayPickingPrimitive(
+            pointSet, POINT_PRIMITIVE, std::max((s > 0.0f) ? s : defaultPointSize, MinLineWidthForPicking));
+        return;
+    }
+
     ScopedShaderProgramActivator programActivator(*solidColorProgram, this);
 
     const double s = pointSet->pointSize();
@@ -2834,6 +3449,12 @@ void GLSLSceneRenderer::Impl::renderLineSet(SgLineSet* lineSet)
     if(width <= 0.0f){
         width = defaultLineWidth;
     }
+
+    if(isRayPicking){
+        addRayPickingPrimitive(lineSet, LINE_PRIMITIVE, std::max(width, MinLineWidthForPicking));
+        return;
+    }
+    
     SolidColorProgram* lineShader;
     if(width == 1.0f){
         lineShader = solidColorProgram.get();
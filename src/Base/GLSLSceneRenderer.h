@@ -89,6 +89,15 @@ class CNOID_EXPORT GLSLSceneRenderer : public GLSceneRenderer
     virtual void setPickingImageOutputEnabled(bool on) override;
     virtual bool getPickingImage(Image& out_image) override;
 
+    /**
+       When this is enabled, picking is first done by casting a ray to the scene in the CPU
+       using the bounding volume hierarchies of the shapes and the mesh triangles instead of
+       rendering the picking image. The picking image is still rendered when the ray picking
+       cannot determine the result, such as when the scene contains custom nodes rendered
+       with their own shader programs. This mode is enabled by default.
+    */
+    void setRayPickingEnabled(bool on);
+
     virtual bool isShadowCastingAvailable() const override;
 
     class Impl;
@@ -48,6 +48,101 @@ struct EditHistory
 typedef std::shared_ptr<EditHistory> EditHistoryPtr;
 typedef deque<EditHistoryPtr> EditHistoryList;
 
+// The number of frames fetched by a data request when the data is updated
+constexpr int DataRequestChunkSize = 4096;
+
+/**
+   The min / max values of the blocks of 2^(level + 2) frames. The pyramid is valid for the
+   frames from the beginning to numValidFrames, and only the blocks after the first invalid
+   frame are recalculated when the pyramid is updated. This makes the cost of the update
+   proportional to the number of the appended frames while a motion is being recorded.
+*/
+class MinMaxPyramid
+{
+public:
+    struct Block
+    {
+        float min;
+        float max;
+        bool isMinFirst;
+    };
+
+    static constexpr int MinBlockSize = 4;
+
+    MinMaxPyramid() : numValidFrames(0) { }
+
+    void invalidate(int frame) {
+        if(frame < numValidFrames){
+            numValidFrames = std::max(frame, 0);
+        }
+    }
+
+    int numLevels() const { return levels.size(); }
+    const vector<Block>& blocks(int level) const { return levels[level]; }
+
+    template<class ValueFunction>
+    static Block calcBlock(int frameBegin, int frameEnd, ValueFunction value) {
+        double min = value(frameBegin);
+        double max = min;
+        int minFrame = frameBegin;
+        int maxFrame = frameBegin;
+        for(int frame = frameBegin + 1; frame < frameEnd; ++frame){
+            const double v = value(frame);
+            if(v > max){
+                max = v;
+                maxFrame = frame;
+            } else if(v < min){
+                min = v;
+                minFrame = frame;
+            }
+        }
+        return Block{ static_cast<float>(min), static_cast<float>(max), minFrame <= maxFrame };
+    }
+
+    template<class ValueFunction>
+    void update(int numFrames, ValueFunction value) {
+        numValidFrames = std::min(numValidFrames, numFrames);
+        int level = 0;
+        for(int blockSize = MinBlockSize; numFrames / blockSize > 0; blockSize *= 2){
+            if(level == static_cast<int>(levels.size())){
+                levels.emplace_back();
+            }
+            vector<Block>& blocks = levels[level];
+            const int numBlocks = numFrames / blockSize;
+            blocks.resize(numBlocks);
+            for(int i = numValidFrames / blockSize; i < numBlocks; ++i){
+                if(level == 0){
+                    blocks[i] = calcBlock(i * blockSize, (i + 1) * blockSize, value);
+                } else {
+                    const vector<Block>& lower = levels[level - 1];
+                    blocks[i] = mergeBlocks(lower[i * 2], lower[i * 2 + 1]);
+                }
+            }
+            ++level;
+        }
+        levels.resize(level);
+        numValidFrames = numFrames;
+    }
+
+private:
+    vector<vector<Block>> levels;
+    int numValidFrames;
+
+    static Block mergeBlocks(const Block& a, const Block& b) {
+        const bool isMinInA = !(b.min < a.min);
+        const bool isMaxInA = !(b.max > a.max);
+        Block merged;
+        merged.min = isMinInA ? a.min : b.min;
+        merged.max = isMaxInA ? a.max : b.max;
+        if(isMinInA == isMaxInA){
+            merged.isMinFirst = isMinInA ? a.isMinFirst : b.isMinFirst;
+        } else {
+            merged.isMinFirst = isMinInA;
+        }
+        return merged;
+    }
+};
+
 }
 
 namespace cnoid {
@@ -86,6 +181,16 @@ public:
     vector<bool> controlPointMask;
     bool isControlPointUpdateNeeded;
 
+    // Used for drawing the trajectories decimated to the screen resolution
+    MinMaxPyramid valuePyramid;
+    MinMaxPyramid velocityPyramid;
+
+    void invalidatePyramids(int frame){
+        valuePyramid.invalidate(frame);
+        // The velocity of a frame depends on the values of the adjacent frames
+        velocityPyramid.invalidate(frame - 1);
+    }
+
     GraphDataHandler::DataRequestCallback dataRequestCallback;
     GraphDataHandler::DataModifiedCallback dataModifiedCallback;
 };
@@ -230,6 +335,10 @@ public:
     void selectEditTargetByClicking(double screenX, double screenY);
     bool onScreenPaintEvent(QPaintEvent* event);
     void drawTrajectory(QPainter& painter, const QRect& rect, GraphDataHandlerImpl* data);
+    template<class ValueFunction>
+    void setDecimatedPolyline(
+        MinMaxPyramid& pyramid, int numFrames, int frame, int frameEnd, int frameOrigin,
+        double screenOffsetX, double xratio, ValueFunction value);
     void drawLimits(QPainter& painter, GraphDataHandlerImpl* data);
     void updateControlPoints(GraphDataHandlerImpl* data);
     void drawGrid(QPainter& painter);
@@ -250,6 +359,7 @@ GraphDataHandler::GraphDataHandler()
 
 GraphDataHandlerImpl::GraphDataHandlerImpl()
 {
+    numFrames = 0;
     offset = 0.0;
     stepRatio = 1.0;
 
@@ -290,9 +400,15 @@ void GraphDataHandler::setLabel(const std::string& label)
 
 void GraphDataHandler::setFrameProperties(int numFrames, double frameRate, double offset)
 {
+    const double stepRatio = 1.0 / frameRate;
+    if(stepRatio != impl->stepRatio){
+        impl->invalidatePyramids(0);
+    } else if(numFrames != impl->numFrames){
+        impl->invalidatePyramids(std::min(numFrames, impl->numFrames));
+    }
     impl->values.resize(numFrames + 2);
     impl->numFrames = numFrames;
-    impl->stepRatio = 1.0 / frameRate;
+    impl->stepRatio = stepRatio;
     impl->offset = offset;
     impl->isControlPointUpdateNeeded = true;
 }
@@ -534,8 +650,26 @@ void GraphWidgetImpl::updateData(GraphDataHandlerPtr handler)
     }
     
     if(data->dataRequestCallback){
-        vector<double>& values = data->values;
-        data->dataRequestCallback(0, data->numFrames, &(values[1]));
+        /*
+          The data is requested by chunks and compared with the current values to find the
+          first modified frame so that the pyramids are not rebuilt when frames are appended.
+        */
+        double* values = &data->values[1];
+        const int numFrames = data->numFrames;
+        vector<double> buf(std::min(numFrames, DataRequestChunkSize));
+        int firstModifiedFrame = numFrames;
+        for(int frame = 0; frame < numFrames; frame += DataRequestChunkSize){
+            const int size = std::min(DataRequestChunkSize, numFrames - frame);
+            data->dataRequestCallback(frame, size, &buf[0]);
+            if(firstModifiedFrame == numFrames){
+                auto p = std::mismatch(buf.begin(), buf.begin() + size, &values[frame]);
+                if(p.first != buf.begin() + size){
+                    firstModifiedFrame = frame + (p.first - buf.begin());
+                }
+            }
+            std::copy(buf.begin(), buf.begin() + size, &values[frame]);
+        }
+        data->invalidatePyramids(firstModifiedFrame);
     }
     screen->update();
 }
@@ -1403,11 +1537,13 @@ void GraphWidgetImpl::doTrajectoryEdit(int screenX, int screenY, Qt::KeyboardMod
     if(editMode == GraphWidget::LINE_MODE){
         EditHistoryPtr& history = editTarget->editHistories.back();
         std::copy(history->orgValues.begin(), history->orgValues.end(), &values[history->frame]);
+        editTarget->invalidatePyramids(history->frame);
     }
 
     if(frameBegin < frameEnd){
 
         storeOrgValuesToHistory(frameBegin, frameEnd);
+        editTarget->invalidatePyramids(frameBegin);
 
         if(inAdjacentFrames){
             values[frameBegin] = min(max(y[TO], editTarget->lowerValueLimit), editTarget->upperValueLimit);
@@ -1503,6 +1639,7 @@ void GraphWidgetImpl::undoTrajectoryEdit()
             EditHistoryPtr history = editTarget->editHistories[currentHistory];
             std::copy(history->orgValues.begin(), history->orgValues.end(),
                       editTarget->values.begin() + history->frame + 1);
+            editTarget->invalidatePyramids(history->frame);
             editTarget->dataModifiedCallback(history->frame, history->orgValues.size(), &history->orgValues[0]);
             screen->update();
         }
@@ -1519,6 +1656,7 @@ void GraphWidgetImpl::redoTrajectoryEdit()
             EditHistoryPtr history = editTarget->editHistories[currentHistory];
             std::copy(history->newValues.begin(), history->newValues.end(),
                       editTarget->values.begin() + history->frame + 1);
+            editTarget->invalidatePyramids(history->frame);
             editTarget->dataModifiedCallback(history->frame, history->newValues.size(), &history->newValues[0]);
             currentHistory++;
             screen->update();
@@ -1640,6 +1778,61 @@ static inline double calcVelocity(int frame, double* values, double stepRatio2)
 }
 
 
+/**
+   The frames are divided into the blocks of a power-of-two size corresponding to about a half
+   pixel, and the min / max values of each block are taken from the pyramid. The blocks are
+   aligned to the multiples of the block size so that the decimated shape does not change
+   when the graph is scrolled.
+*/
+template<class ValueFunction>
+void GraphWidgetImpl::setDecimatedPolyline
+(MinMaxPyramid& pyramid, int numFrames, int frame, int frameEnd, int frameOrigin,
+ double screenOffsetX, double xratio, ValueFunction value)
+{
+    const int m = (int)(0.5 / xratio);
+    int blockSize = m;
+    int level = -1;
+    if(m >= MinMaxPyramid::MinBlockSize){
+        pyramid.update(numFrames, value);
+        if(pyramid.numLevels() > 0){
+            blockSize = MinMaxPyramid::MinBlockSize;
+            level = 0;
+            while(blockSize * 2 <= m && level + 1 < pyramid.numLevels()){
+                blockSize *= 2;
+                ++level;
+            }
+        }
+    }
+    const int numBlocksInPyramid = (level >= 0) ? pyramid.blocks(level).size() : 0;
+
+    frame = (frame / blockSize) * blockSize;
+    const int n = (frameEnd - frame + blockSize - 1) / blockSize;
+    polyline.resize(n * 2);
+    for(int i=0; i < n; ++i){
+        const int blockIndex = frame / blockSize;
+        MinMaxPyramid::Block block;
+        if(blockIndex < numBlocksInPyramid){
+            block = pyramid.blocks(level)[blockIndex];
+        } else {
+            // The last frames which are not covered by the pyramid
+            block = MinMaxPyramid::calcBlock(frame, std::min(frame + blockSize, frameEnd), value);
+        }
+        const double px0 = screenOffsetX + (frame - frameOrigin) * xratio;
+        const double px1 = px0 + (blockSize / 2) * xratio;
+        const double upper = screenCenterY - (block.max + centerY) * scaleY;
+        const double lower = screenCenterY - (block.min + centerY) * scaleY;
+        if(block.isMinFirst){
+            polyline[i*2] = QPointF(px0, lower);
+            polyline[i*2+1] = QPointF(px1, upper);
+        } else {
+            polyline[i*2] = QPointF(px0, upper);
+            polyline[i*2+1] = QPointF(px1, lower);
+        }
+        frame += blockSize;
+    }
+}
+
+
 void GraphWidgetImpl::drawTrajectory
 (QPainter& painter, const QRect& rect, GraphDataHandlerImpl* data)
 {
@@ -1700,37 +1893,9 @@ void GraphWidgetImpl::drawTrajectory
                     ++frame;
                 }
             } else {
-                const int m = (int)(0.5 / xratio);
-                const int n = ceil(double(frame_end - frame) / m);
-                polyline.resize(n * 2);
-                for(int i=0; i < n; ++i){
-                    double px_min = screenOffsetX + (frame - frame_begin) * xratio;
-                    double px_max = px_min;
-                    const int next = std::min(frame + m, frame_end);
-                    double min = calcVelocity(frame++, values, stepRatio2);
-                    double max = min;
-                    while(frame < next){
-                        const double v = calcVelocity(frame, values, stepRatio2);
-                        if(v > max){
-                            max = v;
-                            px_max = screenOffsetX + (frame - frame_begin) * xratio;
-                        } else if(v < min){
-                            min = v;
-                            px_min = screenOffsetX + (frame - frame_begin) * xratio;
-                        }
-                        frame++;
-                    }
-                    const double upper = screenCenterY - (max + centerY) * scaleY;
-                    const double lower = screenCenterY - (min + centerY) * scaleY;
-
-                    if(px_min <= px_max){
-                        polyline[i*2] = QPointF(px_min, lower);
-                        polyline[i*2+1] = QPointF(px_max, upper);
-                    } else {
-                        polyline[i*2] = QPointF(px_max, upper);
-                        polyline[i*2+1] = QPointF(px_min, lower);
-                    }
-                }
+                setDecimatedPolyline(
+                    data->velocityPyramid, numFrames, frame, frame_end, frame_begin, screenOffsetX, xratio,
+                    [values, stepRatio2](int frame){ return calcVelocity(frame, values, stepRatio2); });
             }
 
             painter.drawPolyline(polyline);
@@ -1756,35 +1921,9 @@ void GraphWidgetImpl::drawTrajectory
                     ++frame;
                 }
             } else {
-                const int m = (int)(0.5 / xratio);
-                const int n = ceil(double(frame_end - frame) / m);
-                polyline.resize(n * 2);
-                for(int i=0; i < n; ++i){
-                    double px_min = screenOffsetX + (frame - frame_begin) * xratio;
-                    double px_max = px_min;
-                    const int next = std::min(frame + m, frame_end);
-                    double min = values[frame++];
-                    double max = min;
-                    while(frame < next){
-                        const double v = values[frame++];
-                        if(v > max){
-                            max = v;
-                            px_max = screenOffsetX + (frame - frame_begin) * xratio;
-                        } else if(v < min){
-                            min = v;
-                            px_min = screenOffsetX + (frame - frame_begin) * xratio;
-                        }
-                    }
-                    const double upper = screenCenterY - (max + centerY) * scaleY;
-                    const double lower = screenCenterY - (min + centerY) * scaleY;
-                    if(px_min <= px_max){
-                        polyline[i*2] = QPointF(px_min, lower);
-                        polyline[i*2+1] = QPointF(px_max, upper);
-                    } else {
-                        polyline[i*2] = QPointF(px_max, upper);
-                        polyline[i*2+1] = QPointF(px_min, lower);
-                    }
-                }
+                setDecimatedPolyline(
+                    data->valuePyramid, numFrames, frame, frame_end, frame_begin, screenOffsetX, xratio,
+                    [values](int frame){ return values[frame]; });
             }
 
             painter.drawPolyline(polyline);
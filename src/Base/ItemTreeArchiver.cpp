@@ -11,7 +11,11 @@
 #include "Archive.h"
 #include <cnoid/YAMLReader>
 #include <cnoid/YAMLWriter>
+#include <cnoid/ThreadPool>
 #include <set>
+#include <map>
+#include <memory>
+#include <thread>
 #include <fmt/format.h>
 #include "gettext.h"
 
@@ -19,6 +23,21 @@ using namespace std;
 using namespace cnoid;
 using fmt::format;
 
+namespace {
+
+struct FilePrefetcher
+{
+    std::function<std::function<void()>(const std::string& filename)> prefetch;
+    std::function<void()> clear;
+};
+
+map<pair<string, string>, FilePrefetcher> filePrefetcherMap;
+
+// Prefetching is only done by the outermost restoration when sub projects are restored
+int restorationDepth = 0;
+
+}
+
 namespace cnoid {
 
 class ItemTreeArchiver::Impl
@@ -41,6 +60,10 @@ public:
         Archive& archive, Item* parentItem, ItemList<>& restoredItems, string& out_itemName, bool& io_isOptional);
     void restoreAddons(Archive& archive, Item* item);
     void restoreItemStates(Archive& archive, Item* item);
+    void startFilePrefetch(Archive& archive, unique_ptr<ThreadPool>& threadPool);
+    void collectFilesToPrefetch(
+        Archive& archive, vector<pair<const FilePrefetcher*, string>>& files, set<string>& filenames);
+    void finishFilePrefetch(unique_ptr<ThreadPool>& threadPool);
 };
 
 }
@@ -247,6 +270,12 @@ ItemList<> ItemTreeArchiver::Impl::restore
     ItemList<> restoredItems;
 
     archive.setCurrentParentItem(nullptr);
+
+    unique_ptr<ThreadPool> prefetchThreadPool;
+    if(restorationDepth++ == 0 && !filePrefetcherMap.empty()){
+        startFilePrefetch(archive, prefetchThreadPool);
+    }
+    
     try {
         restoreItemIter(archive, parentItem, restoredItems);
     } catch (const ValueNode::Exception& ex){
@@ -254,11 +283,109 @@ ItemList<> ItemTreeArchiver::Impl::restore
     }
     archive.setCurrentParentItem(nullptr);
 
+    if(--restorationDepth == 0 && !filePrefetcherMap.empty()){
+        finishFilePrefetch(prefetchThreadPool);
+    }
+
     numRestoredItems = restoredItems.size();
     return restoredItems;
 }
 
 
+void ItemTreeArchiver::registerFilePrefetcher
+(const std::string& pluginName, const std::string& className,
+ std::function<std::function<void()>(const std::string& filename)> prefetch, std::function<void()> clear)
+{
+    auto& prefetcher = filePrefetcherMap[make_pair(pluginName, className)];
+    prefetcher.prefetch = prefetch;
+    prefetcher.clear = clear;
+}
+
+
+/**
+   The files of the items are read by worker threads in the order of the item tree so that
+   the reading of the files to restore next overlaps the restoration of the preceding items
+   in the main thread.
+*/
+void ItemTreeArchiver::Impl::startFilePrefetch(Archive& archive, unique_ptr<ThreadPool>& threadPool)
+{
+    vector<pair<const FilePrefetcher*, string>> files;
+    set<string> filenames;
+    try {
+        collectFilesToPrefetch(archive, files, filenames);
+    } catch (const ValueNode::Exception& ex){
+        // The error is reported by the restoration
+    }
+    if(files.empty()){
+        return;
+    }
+    
+    int numThreads = std::thread::hardware_concurrency();
+    if(numThreads < 1){
+        numThreads = 1;
+    } else if(numThreads > static_cast<int>(files.size())){
+        numThreads = files.size();
+    }
+    // All the files are registered before the workers start so that no item reads its file
+    // while the prefetch of it is still waiting in the queue
+    vector<std::function<void()>> tasks;
+    for(auto& file : files){
+        if(auto task = file.first->prefetch(file.second)){
+            tasks.push_back(task);
+        }
+    }
+    threadPool.reset(new ThreadPool(numThreads));
+    for(auto& task : tasks){
+        threadPool->start(task);
+    }
+}
+
+
+void ItemTreeArchiver::Impl::collectFilesToPrefetch
+(Archive& archive, vector<pair<const FilePrefetcher*, string>>& files, set<string>& filenames)
+{
+    string pluginName;
+    string className;
+    if(archive.read("plugin", pluginName) && archive.read("class", className)){
+        auto p = filePrefetcherMap.find(make_pair(pluginName, className));
+        if(p != filePrefetcherMap.end()){
+            auto dataArchive = archive.findSubArchive("data");
+            if(dataArchive->isValid()){
+                string filename = dataArchive->readItemFilePath();
+                if(!filename.empty() && filenames.insert(filename).second){
+                    files.emplace_back(&p->second, filename);
+                }
+            }
+        }
+    }
+    ListingPtr children = archive.findListing("children");
+    if(children->isValid()){
+        for(int i=0; i < children->size(); ++i){
+            Archive* childArchive = dynamic_cast<Archive*>(children->at(i)->toMapping());
+            if(childArchive){
+                childArchive->inheritSharedInfoFrom(archive);
+                collectFilesToPrefetch(*childArchive, files, filenames);
+            }
+        }
+    }
+}
+
+
+void ItemTreeArchiver::Impl::finishFilePrefetch(unique_ptr<ThreadPool>& threadPool)
+{
+    if(threadPool){
+        threadPool->wait();
+        threadPool.reset();
+    }
+    for(auto& kv : filePrefetcherMap){
+        auto& clear = kv.second.clear;
+        if(clear){
+            clear();
+        }
+    }
+}
+
+
 void ItemTreeArchiver::Impl::restoreItemIter(Archive& archive, Item* parentItem, ItemList<>& restoredItems)
 {
     ItemPtr item;
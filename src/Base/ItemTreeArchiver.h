@@ -8,6 +8,8 @@
 #include "Archive.h"
 #include "ItemList.h"
 #include <set>
+#include <string>
+#include <functional>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -25,6 +27,20 @@ public:
     int numArchivedItems() const;
     int numRestoredItems() const;
 
+    /**
+       Registers functions to read the files of the items of a given class in advance.
+       When a project is restored, the prefetch function is called in the main thread for the
+       file of each item of the class found in the archive before any item is restored, and the
+       function returned by it is executed in a worker thread while the items are restored in
+       the original order in the main thread. The returned function must be thread-safe and
+       must not access the GUI. The data read by it should be kept until the item loads the
+       file or the clear function is called after the restoration.
+    */
+    static void registerFilePrefetcher(
+        const std::string& pluginName, const std::string& className,
+        std::function<std::function<void()>(const std::string& filename)> prefetch,
+        std::function<void()> clear);
+
 private:
     class Impl;
     Impl* impl;
@@ -28,7 +28,6 @@
 #include <cnoid/ConnectionSet>
 #include <cnoid/Selection>
 #include <cnoid/UTF8>
-#include <cnoid/stdx/variant>
 #include <cnoid/stdx/filesystem>
 #include <QPainter>
 #include <QDialogButtonBox>
@@ -39,6 +38,8 @@
 #include <mutex>
 #include <condition_variable>
 #include <deque>
+#include <vector>
+#include <cstdio>
 #include <fmt/format.h>
 #include <fmt/ostream.h>
 
@@ -50,6 +51,11 @@ const bool ENABLE_MOUSE_CURSOR_CAPTURE = true;
 const bool ENABLE_MOUSE_CURSOR_CAPTURE = false;
 #endif
 
+#ifndef _WIN32
+#include <csignal>
+#include <pthread.h>
+#endif
+
 #include "gettext.h"
 
 using namespace std;
@@ -61,6 +67,29 @@ namespace {
 
 enum RecordinMode { OFFLINE_MODE, ONLINE_MODE, DIRECT_MODE, N_RECORDING_MODES };
 
+enum OutputFormat { IMAGE_SEQUENCE_OUTPUT, Y4M_FILE_OUTPUT, Y4M_PIPE_OUTPUT, N_OUTPUT_FORMATS };
+
+// Captured images wait for the output threads in the queue up to this number
+constexpr int MaxNumQueuedImages = 32;
+
+FILE* openPipe(const char* command)
+{
+#ifdef _WIN32
+    return _popen(command, "wb");
+#else
+    return popen(command, "w");
+#endif
+}
+
+int closePipe(FILE* pipe)
+{
+#ifdef _WIN32
+    return _pclose(pipe);
+#else
+    return pclose(pipe);
+#endif
+}
+
 MovieRecorder* movieRecorder = nullptr;
 
 class MovieRecorderBar : public ToolBar
@@ -109,6 +138,8 @@ public:
     LineEdit directoryEntry;
     PushButton directoryButton;
     LineEdit basenameEntry;
+    ComboBox outputFormatCombo;
+    LineEdit pipeCommandEntry;
     CheckBox startTimeCheck;
     DoubleSpinBox startTimeSpin;
     CheckBox finishTimeCheck;
@@ -148,6 +179,12 @@ public:
         recordingToggle.setChecked(on);
         recordingToggle.blockSignals(false);
     }
+    void setOutputFormatCombo(int format){
+        outputFormatCombo.blockSignals(true);
+        outputFormatCombo.setCurrentIndex(format);
+        outputFormatCombo.blockSignals(false);
+        pipeCommandEntry.setEnabled(format == Y4M_PIPE_OUTPUT);
+    }
 
     ConfigDialog(MovieRecorderImpl* recorder);
     virtual void showEvent(QShowEvent* event);
@@ -155,6 +192,7 @@ public:
     void updateViewCombo();
     void onTargetViewIndexChanged(int index);
     void onRecordingModeRadioClicked(int mode);
+    void onOutputFormatComboChanged(int format);
     void showDirectorySelectionDialog();
     bool store(Mapping& archive);
     void restore(const Mapping& archive);
@@ -179,6 +217,8 @@ class MovieRecorderImpl
 {
 public:
     Selection recordingMode;
+    Selection outputFormat;
+    int activeOutputFormat;
     bool isRecording;
     bool isBeforeFirstFrameCapture;
     bool requestStopRecording;
@@ -208,21 +248,34 @@ public:
     
     Timer flashTimer;
 
-    typedef stdx::variant<QPixmap, QImage> ImageVariant;
-
     class CapturedImage : public Referenced {
     public:
-        ImageVariant image;
+        QImage image;
         int frame;
+        int sequenceIndex;
     };
     typedef ref_ptr<CapturedImage> CapturedImagePtr;
 
     deque<CapturedImagePtr> capturedImages;
+    int numCapturedImages;
     vector<quint32> tmpImageBuf;
-    std::thread imageOutputThread;
+    vector<std::thread> imageOutputThreads;
     std::mutex imageQueueMutex;
     std::condition_variable imageQueueCondition;
+    bool isImageOutputFailed;
     string filenameFormat;
+
+    // Y4M stream output
+    FILE* videoStream;
+    bool isVideoStreamPipe;
+    string videoStreamName;
+    QSize videoFrameSize;
+    int videoFrameRateNumerator;
+    int videoFrameRateDenominator;
+    int nextSequenceIndexToWrite;
+    bool isVideoStreamBroken;
+    std::mutex videoStreamMutex;
+    std::condition_variable videoStreamCondition;
     
     MovieRecorderImpl(ExtensionManager* ext);
     ~MovieRecorderImpl();
@@ -232,8 +285,11 @@ public:
     void setTargetView(const std::string& name);
     void onViewCreated(View* view);
     void setRecordingMode(const std::string& symbol);
+    void setOutputFormat(const std::string& symbol);
     void activateRecording(bool on, bool isActivatedByDialog);
     bool setupViewAndFilenameFormat();
+    bool openVideoStream(const filesystem::path& directory);
+    void closeVideoStream();
     bool doOfflineModeRecording();
     void setupOnlineModeRecording();
     void startOnlineModeRecording();
@@ -241,11 +297,13 @@ public:
     void onPlaybackStopped(bool isStoppedManually);
     void startDirectModeRecording();
     void onDirectModeTimerTimeout();
-    void captureViewImage(bool waitForPrevOutput);
+    void captureViewImage();
     void drawMouseCursorImage(QPainter& painter);
     void captureSceneWidgets(QWidget* widget, QPixmap& pixmap);
     void startImageOutput();
+    void stopImageOutput();
     void outputImages();
+    bool writeVideoStreamFrame(CapturedImage* captured, vector<uchar>& buf);
     void onImageOutputFailed(std::string message);
     void stopRecording(bool isFinished);
     void onViewMarkerToggled(bool on);
@@ -287,12 +345,26 @@ MovieRecorder::MovieRecorder(ExtensionManager* ext)
 
 MovieRecorderImpl::MovieRecorderImpl(ExtensionManager* ext)
     : recordingMode(N_RECORDING_MODES, CNOID_GETTEXT_DOMAIN_NAME),
+      outputFormat(N_OUTPUT_FORMATS, CNOID_GETTEXT_DOMAIN_NAME),
       mv(MessageView::instance())
 
 {
     recordingMode.setSymbol(OFFLINE_MODE, N_("Offline"));
     recordingMode.setSymbol(ONLINE_MODE, N_("Online"));
     recordingMode.setSymbol(DIRECT_MODE, N_("Direct"));
+
+    outputFormat.setSymbol(IMAGE_SEQUENCE_OUTPUT, N_("PNG files"));
+    outputFormat.setSymbol(Y4M_FILE_OUTPUT, N_("Y4M file"));
+    outputFormat.setSymbol(Y4M_PIPE_OUTPUT, N_("Y4M pipe"));
+    outputFormat.select(IMAGE_SEQUENCE_OUTPUT);
+    activeOutputFormat = IMAGE_SEQUENCE_OUTPUT;
+
+    numCapturedImages = 0;
+    isImageOutputFailed = false;
+    videoStream = nullptr;
+    isVideoStreamPipe = false;
+    nextSequenceIndexToWrite = 0;
+    isVideoStreamBroken = false;
     
     dialog = new ConfigDialog(this);
     toolBar = new MovieRecorderBar(this);
@@ -382,6 +454,20 @@ ConfigDialog::ConfigDialog(MovieRecorderImpl* recorder)
     hbox->addStretch();
     vbox->addLayout(hbox);
 
+    hbox = new QHBoxLayout();
+    hbox->addWidget(new QLabel(_("Output")));
+    for(int i=0; i < N_OUTPUT_FORMATS; ++i){
+        outputFormatCombo.addItem(recorder->outputFormat.label(i));
+    }
+    outputFormatCombo.sigCurrentIndexChanged().connect(
+        [&](int format){ onOutputFormatComboChanged(format); });
+    hbox->addWidget(&outputFormatCombo);
+    hbox->addWidget(new QLabel(_("Command")));
+    pipeCommandEntry.setPlaceholderText("ffmpeg -y -i - scene.mp4");
+    pipeCommandEntry.setEnabled(false);
+    hbox->addWidget(&pipeCommandEntry);
+    vbox->addLayout(hbox);
+
     hbox = new QHBoxLayout();
     hbox->addWidget(new QLabel(_("Frame rate")));
     fpsSpin.setDecimals(1);
@@ -475,11 +561,12 @@ MovieRecorder::~MovieRecorder()
 
 MovieRecorderImpl::~MovieRecorderImpl()
 {
-    if(imageOutputThread.joinable()){
+    if(!imageOutputThreads.empty()){
         requestStopRecording = true;
-        imageQueueCondition.notify_all();
-        imageOutputThread.join();
+        isRecording = false;
+        stopImageOutput();
     }
+    closeVideoStream();
     
     timeBarConnections.disconnect();
     store(*AppConfig::archive()->openMapping("MovieRecorder"));
@@ -640,6 +727,21 @@ void ConfigDialog::onRecordingModeRadioClicked(int mode)
 }
 
 
+void MovieRecorderImpl::setOutputFormat(const std::string& symbol)
+{
+    if(outputFormat.select(symbol)){
+        dialog->setOutputFormatCombo(outputFormat.which());
+    }
+}
+
+
+void ConfigDialog::onOutputFormatComboChanged(int format)
+{
+    recorder->outputFormat.select(format);
+    pipeCommandEntry.setEnabled(format == Y4M_PIPE_OUTPUT);
+}
+
+
 void ConfigDialog::showDirectorySelectionDialog()
 {
     QString directory =
@@ -711,10 +813,15 @@ bool MovieRecorderImpl::setupViewAndFilenameFormat()
         return false;
     }
 
+    activeOutputFormat = outputFormat.which();
+    
     filesystem::path directory(fromUTF8(dialog->directoryEntry.string()));
     filesystem::path basename(fromUTF8(dialog->basenameEntry.string() + "{:08d}.png"));
 
-    if(directory.empty()){
+    if(activeOutputFormat == Y4M_PIPE_OUTPUT){
+        // The directory is not used
+
+    } else if(directory.empty()){
         showWarningDialog(_("Please set a directory to output image files."));
         return false;
 
@@ -731,6 +838,13 @@ bool MovieRecorderImpl::setupViewAndFilenameFormat()
 
     filenameFormat = toUTF8((directory / basename).string());
 
+    closeVideoStream();
+    if(activeOutputFormat != IMAGE_SEQUENCE_OUTPUT){
+        if(!openVideoStream(directory)){
+            return false;
+        }
+    }
+
     if(dialog->imageSizeCheck.isChecked()){
         int width = dialog->imageWidthSpin.value();
         int height = dialog->imageHeightSpin.value();
@@ -742,11 +856,68 @@ bool MovieRecorderImpl::setupViewAndFilenameFormat()
 
     std::lock_guard<std::mutex> lock(imageQueueMutex);
     capturedImages.clear();
+    numCapturedImages = 0;
+    isImageOutputFailed = false;
     
     return true;
 }
 
 
+/**
+   The frames are written as an uncompressed YUV4MPEG2 stream so that an external encoder
+   such as ffmpeg can read it from the file or the pipe without any library linked here.
+*/
+bool MovieRecorderImpl::openVideoStream(const filesystem::path& directory)
+{
+    if(activeOutputFormat == Y4M_PIPE_OUTPUT){
+        videoStreamName = dialog->pipeCommandEntry.string();
+        if(videoStreamName.empty()){
+            showWarningDialog(_("Please set a command to pipe the video stream to."));
+            return false;
+        }
+        videoStream = openPipe(videoStreamName.c_str());
+        isVideoStreamPipe = true;
+    } else {
+        filesystem::path filename(fromUTF8(dialog->basenameEntry.string() + ".y4m"));
+        videoStreamName = toUTF8((directory / filename).string());
+        videoStream = fopen(videoStreamName.c_str(), "wb");
+        isVideoStreamPipe = false;
+    }
+    if(!videoStream){
+        showWarningDialog(format(_("\"{}\" cannot be opened."), videoStreamName));
+        return false;
+    }
+
+    // The frame rate is set with the precision of the dialog
+    int rate10 = static_cast<int>(dialog->frameRate() * 10.0 + 0.5);
+    if(rate10 % 10 == 0){
+        videoFrameRateNumerator = rate10 / 10;
+        videoFrameRateDenominator = 1;
+    } else {
+        videoFrameRateNumerator = rate10;
+        videoFrameRateDenominator = 10;
+    }
+    videoFrameSize = QSize();
+    nextSequenceIndexToWrite = 0;
+    isVideoStreamBroken = false;
+    
+    return true;
+}
+
+
+void MovieRecorderImpl::closeVideoStream()
+{
+    if(videoStream){
+        if(isVideoStreamPipe){
+            closePipe(videoStream);
+        } else {
+            fclose(videoStream);
+        }
+        videoStream = nullptr;
+    }
+}
+
+
 bool MovieRecorderImpl::doOfflineModeRecording()
 {
     double time = startTime;
@@ -769,7 +940,7 @@ bool MovieRecorderImpl::doOfflineModeRecording()
             break;
         }
 
-        captureViewImage(true);
+        captureViewImage();
 
         time += timeStep;
         frame++;
@@ -834,7 +1005,7 @@ bool MovieRecorderImpl::onTimeChanged(double time)
             stopRecording(true);
         } else {
             while(time >= nextFrameTime){
-                captureViewImage(false);
+                captureViewImage();
                 ++frame;
                 nextFrameTime += timeStep;
             }
@@ -864,12 +1035,17 @@ void MovieRecorderImpl::startDirectModeRecording()
 
 void MovieRecorderImpl::onDirectModeTimerTimeout()
 {
-    captureViewImage(false);
+    captureViewImage();
     ++frame;
 }
 
 
-void MovieRecorderImpl::captureViewImage(bool waitForPrevOutput)
+/**
+   The captured image is converted to QImage here because QPixmap can only be used in the main
+   thread. When the output threads do not keep up with the capturing, this function waits for
+   them so that the queued images do not exhaust the memory.
+*/
+void MovieRecorderImpl::captureViewImage()
 {
     CapturedImagePtr captured = new CapturedImage();
     captured->frame = frame;
@@ -877,27 +1053,38 @@ void MovieRecorderImpl::captureViewImage(bool waitForPrevOutput)
     if(SceneView* sceneView = dynamic_cast<SceneView*>(targetView)){
         captured->image = sceneView->sceneWidget()->getImage();
         if(dialog->mouseCursorCheck.isChecked()){
-            QPainter painter(&stdx::get<QImage>(captured->image));
+            QPainter painter(&captured->image);
             drawMouseCursorImage(painter);
         }
     } else {
-        captured->image = targetView->grab();
-        QPixmap& pixmap = stdx::get<QPixmap>(captured->image);
+        QPixmap pixmap = targetView->grab();
         captureSceneWidgets(targetView, pixmap);
 
         if(dialog->mouseCursorCheck.isChecked()){
             QPainter painter(&pixmap);
             drawMouseCursorImage(painter);
         }
+        captured->image = pixmap.toImage();
+    }
+
+    if(activeOutputFormat != IMAGE_SEQUENCE_OUTPUT){
+        // The frame size of a video stream is fixed by the first frame
+        if(videoFrameSize.isEmpty()){
+            videoFrameSize = captured->image.size();
+        } else if(captured->image.size() != videoFrameSize){
+            captured->image = captured->image.scaled(videoFrameSize);
+        }
     }
 
     {
         std::unique_lock<std::mutex> lock(imageQueueMutex);
-        if(waitForPrevOutput){
-            while(!capturedImages.empty()){
-                imageQueueCondition.wait(lock);
-            }
+        while(static_cast<int>(capturedImages.size()) >= MaxNumQueuedImages && !isImageOutputFailed){
+            imageQueueCondition.wait(lock);
         }
+        if(isImageOutputFailed){
+            return;
+        }
+        captured->sequenceIndex = numCapturedImages++;
         capturedImages.push_back(captured);
     }
     imageQueueCondition.notify_all();
@@ -951,17 +1138,45 @@ void MovieRecorderImpl::captureSceneWidgets(QWidget* widget, QPixmap& pixmap)
 }
 
 
+/**
+   The images are encoded by multiple output threads. The files of an image sequence can be
+   written in any order, and the frames of a video stream are written in the captured order.
+*/
 void MovieRecorderImpl::startImageOutput()
 {
-    if(!imageOutputThread.joinable()){
-        imageOutputThread = std::thread(
-            [&](){ outputImages(); });
+    if(imageOutputThreads.empty()){
+        // One core is left for the main thread capturing the images
+        int numThreads = std::thread::hardware_concurrency();
+        numThreads = (numThreads > 2) ? (numThreads - 1) : 1;
+        for(int i=0; i < numThreads; ++i){
+            imageOutputThreads.emplace_back([&](){ outputImages(); });
+        }
     }
 }
 
 
+void MovieRecorderImpl::stopImageOutput()
+{
+    imageQueueCondition.notify_all();
+    for(auto& thread : imageOutputThreads){
+        thread.join();
+    }
+    imageOutputThreads.clear();
+}
+
+
 void MovieRecorderImpl::outputImages()
 {
+#ifndef _WIN32
+    // Writing to a pipe closed by the command results in an error instead of the signal
+    sigset_t signalSet;
+    sigemptyset(&signalSet);
+    sigaddset(&signalSet, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &signalSet, nullptr);
+#endif
+    
+    vector<uchar> frameBuf;
+    
     while(true){
         CapturedImagePtr captured;
         {
@@ -978,31 +1193,90 @@ void MovieRecorderImpl::outputImages()
         imageQueueCondition.notify_all();
         
         bool saved = false;
+        string message;
 
-        string filename = format(filenameFormat, captured->frame);
-        
-        if(stdx::get_variant_index(captured->image) == 0){
-            QPixmap& pixmap = stdx::get<QPixmap>(captured->image);
-            saved = pixmap.save(filename.c_str());
+        if(activeOutputFormat == IMAGE_SEQUENCE_OUTPUT){
+            string filename = format(filenameFormat, captured->frame);
+            saved = captured->image.save(filename.c_str());
+            if(!saved){
+                message = format(_("Saving an image to \"{}\" failed."), filename);
+            }
         } else {
-            QImage& image = stdx::get<QImage>(captured->image);
-            saved = image.save(filename.c_str());
+            saved = writeVideoStreamFrame(captured, frameBuf);
+            if(!saved){
+                message = format(_("Writing a frame to \"{}\" failed."), videoStreamName);
+            }
         }
 
         if(!saved){
-            string message = format(_("Saving an image to \"{}\" failed."), filename);
-            callLater([this, message](){ onImageOutputFailed(message); });
+            bool isFirstFailure = false;
             {
                 std::lock_guard<std::mutex> lock(imageQueueMutex);
                 capturedImages.clear();
+                if(!isImageOutputFailed){
+                    isImageOutputFailed = true;
+                    isFirstFailure = true;
+                }
             }
             imageQueueCondition.notify_all();
+            if(isFirstFailure){
+                callLater([this, message](){ onImageOutputFailed(message); });
+            }
             break;
         }
     }
 }
 
 
+bool MovieRecorderImpl::writeVideoStreamFrame(CapturedImage* captured, vector<uchar>& buf)
+{
+    // The conversion to the planar YCbCr 4:4:4 format (BT.601) is done in parallel
+    const QImage image = captured->image.convertToFormat(QImage::Format_RGB32);
+    const int width = image.width();
+    const int height = image.height();
+    const int planeSize = width * height;
+    buf.resize(planeSize * 3);
+    uchar* py = &buf[0];
+    uchar* pu = py + planeSize;
+    uchar* pv = pu + planeSize;
+    for(int i=0; i < height; ++i){
+        auto line = reinterpret_cast<const QRgb*>(image.constScanLine(i));
+        for(int j=0; j < width; ++j){
+            const int r = qRed(line[j]);
+            const int g = qGreen(line[j]);
+            const int b = qBlue(line[j]);
+            *py++ = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+            *pu++ = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+            *pv++ = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(videoStreamMutex);
+    while(captured->sequenceIndex != nextSequenceIndexToWrite && !isVideoStreamBroken){
+        videoStreamCondition.wait(lock);
+    }
+    bool written = false;
+    if(!isVideoStreamBroken){
+        if(captured->sequenceIndex == 0){
+            fmt::print(videoStream, "YUV4MPEG2 W{0} H{1} F{2}:{3} Ip A1:1 C444\n",
+                       width, height, videoFrameRateNumerator, videoFrameRateDenominator);
+        }
+        written =
+            (fputs("FRAME\n", videoStream) >= 0) &&
+            (fwrite(&buf[0], 1, buf.size(), videoStream) == buf.size());
+        if(written){
+            ++nextSequenceIndexToWrite;
+        } else {
+            isVideoStreamBroken = true;
+        }
+    }
+    lock.unlock();
+    videoStreamCondition.notify_all();
+
+    return written;
+}
+
+
 void MovieRecorderImpl::onImageOutputFailed(std::string message)
 {
     showWarningDialog(message);
@@ -1050,8 +1324,7 @@ void MovieRecorderImpl::stopRecording(bool isFinished)
 
         isRecording = false;
         requestStopRecording = true;
-        imageQueueCondition.notify_all();
-        imageOutputThread.join();
+        stopImageOutput();
 
         if(isFinished){
             mv->putln(format(_("Recording of {} has been finished."), targetView->name()));
@@ -1062,6 +1335,8 @@ void MovieRecorderImpl::stopRecording(bool isFinished)
     
     timeBarConnections.disconnect();
 
+    closeVideoStream();
+
     toolBar->setRecordingToggle(false);
     dialog->setRecordingToggle(false);
 }
@@ -1175,6 +1450,7 @@ bool MovieRecorderImpl::store(Mapping& archive)
         archive.write("target", targetView->name());
     }
     archive.write("recordingMode", recordingMode.selectedSymbol());
+    archive.write("outputFormat", outputFormat.selectedSymbol());
     return dialog->store(archive);
 }
 
@@ -1184,6 +1460,7 @@ bool ConfigDialog::store(Mapping& archive)
     archive.write("showViewMarker", viewMarkerCheck.isChecked());
     archive.write("directory", directoryEntry.string());
     archive.write("basename", basenameEntry.string());
+    archive.write("pipeCommand", pipeCommandEntry.string());
     archive.write("checkStartTime", startTimeCheck.isChecked());
     archive.write("startTime", startTimeSpin.value());
     archive.write("checkFinishTime", finishTimeCheck.isChecked());
@@ -1206,6 +1483,9 @@ void MovieRecorderImpl::restore(const Mapping& archive)
     if(archive.read("recordingMode", symbol)){
         setRecordingMode(symbol);
     }
+    if(archive.read("outputFormat", symbol)){
+        setOutputFormat(symbol);
+    }
     dialog->restore(archive);
 }
 
@@ -1215,6 +1495,7 @@ void ConfigDialog::restore(const Mapping& archive)
     viewMarkerCheck.setChecked(archive.get("showViewMarker", viewMarkerCheck.isChecked()));
     directoryEntry.setText(archive.get("directory", directoryEntry.string()));
     basenameEntry.setText(archive.get("basename", basenameEntry.string()));
+    pipeCommandEntry.setText(archive.get("pipeCommand", pipeCommandEntry.string()));
     startTimeCheck.setChecked(archive.get("checkStartTime", startTimeCheck.isChecked()));
     startTimeSpin.setValue(archive.get("startTime", startTimeSpin.value()));
     finishTimeCheck.setChecked(archive.get("checkFinishTime", finishTimeCheck.isChecked()));
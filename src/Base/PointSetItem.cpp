@@ -119,10 +119,10 @@ static bool loadPCD(PointSetItem* item, const std::string& filename, std::ostrea
 }
 
 
-static bool saveAsPCD(PointSetItem* item, const std::string& filename, std::ostream& os)
+static bool saveAsPCD(PointSetItem* item, const std::string& filename, std::ostream& os, PCDDataType dataType)
 {
     try {
-        cnoid::savePCD(item->pointSet(), filename, item->offsetTransform());
+        cnoid::savePCD(item->pointSet(), filename, item->offsetTransform(), dataType);
         return true;
     } catch (boost::exception& ex) {
         if(std::string const * message = boost::get_error_info<error_info_message>(ex)){
@@ -143,7 +143,13 @@ void PointSetItem::initializeClass(ExtensionManager* ext)
         im.addLoaderAndSaver<PointSetItem>(
             _("Point Cloud (PCD)"), "PCD-FILE", "pcd",
             [](PointSetItem* item, const std::string& filename, std::ostream& os, Item*){ return ::loadPCD(item, filename, os); },
-            [](PointSetItem* item, const std::string& filename, std::ostream& os, Item*){ return ::saveAsPCD(item, filename, os); },
+            [](PointSetItem* item, const std::string& filename, std::ostream& os, Item*){
+                return ::saveAsPCD(item, filename, os, PCD_ASCII); },
+            ItemManager::PRIORITY_CONVERSION);
+        im.addSaver<PointSetItem>(
+            _("Point Cloud (Binary Compressed PCD)"), "PCD-FILE-BINARY-COMPRESSED", "pcd",
+            [](PointSetItem* item, const std::string& filename, std::ostream& os, Item*){
+                return ::saveAsPCD(item, filename, os, PCD_BINARY_COMPRESSED); },
             ItemManager::PRIORITY_CONVERSION);
         
         initialized = true;
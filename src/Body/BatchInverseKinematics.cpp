@@ -0,0 +1,302 @@
+#include "BatchInverseKinematics.h"
+#include "Body.h"
+#include "JointPath.h"
+#include "LinkKinematicsKit.h"
+#include <cnoid/CoordinateFrame>
+#include <cnoid/EigenUtil>
+#include <cnoid/ThreadPool>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+using namespace std;
+using namespace cnoid;
+
+namespace cnoid {
+
+class BatchInverseKinematics::Impl
+{
+public:
+    BodyPtr body;
+    LinkPtr baseLink;
+    LinkPtr endLink;
+    LinkKinematicsKitPtr kit;
+    // The base frame and the offset frame of the kit at the time of solving
+    Position T_baseFrame;
+    bool isBaseFrameGlobal;
+    Position T_offsetInverse;
+    int numThreads;
+    std::function<void(JointPath& path)> jointPathSetupFunction;
+    bool needToUpdateWorkers;
+
+    struct Worker
+    {
+        BodyPtr body;
+        shared_ptr<JointPath> jointPath;
+        VectorXd q0;
+    };
+    vector<Worker> workers;
+    unique_ptr<ThreadPool> threadPool;
+    std::atomic<int> nextTargetIndex;
+
+    Impl(Body* body, Link* baseLink, Link* endLink, LinkKinematicsKit* kit);
+    void updateWorkers();
+    void updateKitFrames();
+    Position getKitBasePosition(Link* baseLink) const;
+    void solveTargets(
+        Worker& worker, const vector<Position>& targets, const vector<VectorXd>& seeds,
+        vector<Solution>& solutions, std::atomic<int>& numSolved);
+};
+
+}
+
+
+BatchInverseKinematics::BatchInverseKinematics(Body* body, Link* baseLink, Link* endLink)
+{
+    impl = new Impl(body, baseLink, endLink, nullptr);
+}
+
+
+BatchInverseKinematics::BatchInverseKinematics(LinkKinematicsKit* kit)
+{
+    impl = new Impl(kit->body(), kit->baseLink(), kit->link(), kit);
+}
+
+
+BatchInverseKinematics::Impl::Impl(Body* body, Link* baseLink, Link* endLink, LinkKinematicsKit* kit)
+    : body(body),
+      baseLink(baseLink ? baseLink : body->rootLink()),
+      endLink(endLink),
+      kit(kit)
+{
+    T_baseFrame.setIdentity();
+    isBaseFrameGlobal = false;
+    T_offsetInverse.setIdentity();
+
+    numThreads = std::thread::hardware_concurrency();
+    if(numThreads < 1){
+        numThreads = 1;
+    }
+    needToUpdateWorkers = true;
+    nextTargetIndex = 0;
+}
+
+
+BatchInverseKinematics::~BatchInverseKinematics()
+{
+    delete impl;
+}
+
+
+Body* BatchInverseKinematics::body()
+{
+    return impl->body;
+}
+
+
+Link* BatchInverseKinematics::baseLink()
+{
+    return impl->baseLink;
+}
+
+
+Link* BatchInverseKinematics::endLink()
+{
+    return impl->endLink;
+}
+
+
+void BatchInverseKinematics::setNumThreads(int n)
+{
+    if(n < 1){
+        n = 1;
+    }
+    if(n != impl->numThreads){
+        impl->numThreads = n;
+        impl->needToUpdateWorkers = true;
+    }
+}
+
+
+int BatchInverseKinematics::numThreads() const
+{
+    return impl->numThreads;
+}
+
+
+void BatchInverseKinematics::setJointPathSetupFunction(std::function<void(JointPath& path)> func)
+{
+    impl->jointPathSetupFunction = func;
+    impl->needToUpdateWorkers = true;
+}
+
+
+void BatchInverseKinematics::Impl::updateWorkers()
+{
+    if(needToUpdateWorkers){
+        workers.clear();
+        workers.resize(numThreads);
+        for(auto& worker : workers){
+            worker.body = body->clone();
+            worker.jointPath = JointPath::getCustomPath(
+                worker.body, worker.body->link(baseLink->index()), worker.body->link(endLink->index()));
+            if(jointPathSetupFunction){
+                jointPathSetupFunction(*worker.jointPath);
+            }
+        }
+        if(numThreads > 1){
+            threadPool.reset(new ThreadPool(numThreads));
+        } else {
+            threadPool.reset();
+        }
+        needToUpdateWorkers = false;
+    }
+
+    // Synchronize the states of the clones with the original body
+    const int numLinks = body->numLinks();
+    for(auto& worker : workers){
+        auto clone = worker.body;
+        clone->rootLink()->setPosition(body->rootLink()->position());
+        for(int i=0; i < numLinks; ++i){
+            clone->link(i)->q() = body->link(i)->q();
+        }
+        clone->calcForwardKinematics();
+        auto& path = *worker.jointPath;
+        const int n = path.numJoints();
+        worker.q0.resize(n);
+        for(int i=0; i < n; ++i){
+            worker.q0[i] = path.joint(i)->q();
+        }
+    }
+}
+
+
+int BatchInverseKinematics::solve
+(const std::vector<Position>& targets, const std::vector<VectorXd>& seeds, std::vector<Solution>& out_solutions)
+{
+    const int numTargets = targets.size();
+    if(seeds.size() > 1 && static_cast<int>(seeds.size()) != numTargets){
+        out_solutions.clear();
+        return 0;
+    }
+    out_solutions.resize(numTargets);
+    if(numTargets == 0){
+        return 0;
+    }
+
+    impl->updateWorkers();
+    if(impl->kit){
+        impl->updateKitFrames();
+    }
+
+    std::atomic<int> numSolved(0);
+    impl->nextTargetIndex = 0;
+
+    if(!impl->threadPool){
+        impl->solveTargets(impl->workers.front(), targets, seeds, out_solutions, numSolved);
+    } else {
+        for(auto& worker : impl->workers){
+            auto pWorker = &worker;
+            impl->threadPool->start(
+                [this, pWorker, &targets, &seeds, &out_solutions, &numSolved](){
+                    impl->solveTargets(*pWorker, targets, seeds, out_solutions, numSolved); });
+        }
+        impl->threadPool->wait();
+    }
+
+    return numSolved;
+}
+
+
+void BatchInverseKinematics::Impl::updateKitFrames()
+{
+    auto baseFrame = kit->currentBaseFrame();
+    T_baseFrame = baseFrame->T();
+    isBaseFrameGlobal = baseFrame->isGlobal();
+    T_offsetInverse = kit->currentOffsetFrame()->T().inverse(Eigen::Isometry);
+}
+
+
+Position BatchInverseKinematics::Impl::getKitBasePosition(Link* baseLink) const
+{
+    if(isBaseFrameGlobal){
+        return T_baseFrame;
+    }
+    return baseLink->T() * T_baseFrame;
+}
+
+
+Position BatchInverseKinematics::targetFromGlobalEndPosition(const Position& T_end)
+{
+    if(!impl->kit){
+        return T_end;
+    }
+    impl->updateKitFrames();
+    Position T_base = impl->getKitBasePosition(impl->baseLink);
+    return T_base.inverse(Eigen::Isometry) * T_end * impl->T_offsetInverse.inverse(Eigen::Isometry);
+}
+
+
+/**
+   The targets are taken one by one from the shared index so that the threads are kept busy
+   even if the numbers of iterations differ between the targets. The solution of each target
+   only depends on its seed, so the result does not depend on which thread solves it.
+*/
+void BatchInverseKinematics::Impl::solveTargets
+(Worker& worker, const vector<Position>& targets, const vector<VectorXd>& seeds,
+ vector<Solution>& solutions, std::atomic<int>& numSolved)
+{
+    auto& path = *worker.jointPath;
+    Link* end = path.endLink();
+    const int n = path.numJoints();
+    const int numTargets = targets.size();
+
+    // The base link is not moved by the IK of the path
+    Position T_base;
+    if(kit){
+        T_base = getKitBasePosition(path.baseLink());
+    }
+
+    while(true){
+        const int index = nextTargetIndex++;
+        if(index >= numTargets){
+            break;
+        }
+        const VectorXd* seed = nullptr;
+        if(seeds.size() == 1){
+            seed = &seeds.front();
+        } else if(!seeds.empty()){
+            seed = &seeds[index];
+        }
+        for(int i=0; i < n; ++i){
+            if(seed && i < seed->size()){
+                path.joint(i)->q() = (*seed)[i];
+            } else {
+                path.joint(i)->q() = worker.q0[i];
+            }
+        }
+        path.calcForwardKinematics();
+
+        Position T;
+        if(kit){
+            T = T_base * targets[index] * T_offsetInverse;
+        } else {
+            T = targets[index];
+        }
+        auto& solution = solutions[index];
+        solution.isSolved = path.calcInverseKinematics(T);
+
+        solution.q.resize(n);
+        for(int i=0; i < n; ++i){
+            solution.q[i] = path.joint(i)->q();
+        }
+        Vector6 error;
+        error.head<3>() = T.translation() - end->p();
+        error.tail<3>() = end->R() * omegaFromRot(end->R().transpose() * T.linear());
+        solution.error = error.norm();
+
+        if(solution.isSolved){
+            ++numSolved;
+        }
+    }
+}
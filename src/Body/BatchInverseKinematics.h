@@ -0,0 +1,83 @@
+#ifndef CNOID_BODY_BATCH_INVERSE_KINEMATICS_H
+#define CNOID_BODY_BATCH_INVERSE_KINEMATICS_H
+
+#include <cnoid/EigenTypes>
+#include <vector>
+#include <functional>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+class Link;
+class JointPath;
+class LinkKinematicsKit;
+
+/**
+   This class solves the inverse kinematics of a joint path for many target positions in parallel.
+   Each thread solves the problems with its own clone of the body so that the link states of the
+   original body are not changed.
+*/
+class CNOID_EXPORT BatchInverseKinematics
+{
+public:
+    //! The root link is used as the base link if baseLink is null.
+    BatchInverseKinematics(Body* body, Link* baseLink, Link* endLink);
+
+    /**
+       The targets are the end positions in the current base frame of the kit with its current
+       offset frame as in LinkKinematicsKit::setEndPosition. The frames are read when solve()
+       is called. The root link is used as the base link if the kit does not have it.
+    */
+    BatchInverseKinematics(LinkKinematicsKit* kit);
+    ~BatchInverseKinematics();
+
+    Body* body();
+    Link* baseLink();
+    Link* endLink();
+
+    //! The number of hardware threads is used by default.
+    void setNumThreads(int n);
+    int numThreads() const;
+
+    //! The function is called for the joint path of each thread to set the IK parameters.
+    void setJointPathSetupFunction(std::function<void(JointPath& path)> func);
+
+    struct Solution
+    {
+        //! Joint displacements of the joint path
+        VectorXd q;
+        //! Norm of the remaining position and orientation error
+        double error;
+        bool isSolved;
+    };
+
+    /**
+       Solves the IK for the target positions of the end link in the global coordinate system
+       or in the frames of the kit if the kit is given.
+       The current state of the original body is used as the initial state of each problem.
+       The joint displacements of the path are replaced with the seeds if they are given.
+       The number of the seeds must be zero, one or the number of the targets.
+       \return The number of the solved problems
+    */
+    int solve(const std::vector<Position>& targets, const std::vector<VectorXd>& seeds,
+              std::vector<Solution>& out_solutions);
+
+    int solve(const std::vector<Position>& targets, std::vector<Solution>& out_solutions){
+        return solve(targets, std::vector<VectorXd>(), out_solutions);
+    }
+
+    /**
+       Converts the global position of the end link into the target given to solve().
+       The current frames of the kit are used if the kit is given.
+    */
+    Position targetFromGlobalEndPosition(const Position& T_end);
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
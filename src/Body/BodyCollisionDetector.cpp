@@ -7,17 +7,429 @@
 #include "Body.h"
 #include "Link.h"
 #include <cnoid/SceneGraph>
+#include <cnoid/SceneDrawables>
+#include <cnoid/MeshExtractor>
+#include <cnoid/MeshFilter>
 #include <cnoid/ValueTree>
+#include <cnoid/UTF8>
+#include <cnoid/stdx/filesystem>
+#include <fmt/format.h>
 #include <unordered_map>
 #include <vector>
+#include <algorithm>
+#include <mutex>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <limits>
 
 using namespace std;
 using namespace cnoid;
+namespace filesystem = cnoid::stdx::filesystem;
+using fmt::format;
 
 namespace {
 
 typedef CollisionDetector::GeometryHandle GeometryHandle;
 
+/**
+   The source mesh size and the generation parameters of a proxy.
+   They are stored with a cached proxy and checked when the proxy is found by the hash
+   so that a hash collision or a stale cache file is not accepted.
+*/
+struct ProxySource
+{
+    uint32_t numVertices;
+    uint32_t numTriangles;
+    int32_t proxyType;
+    int32_t maxNumProxyTriangles;
+
+    bool operator==(const ProxySource& rhs) const {
+        return numVertices == rhs.numVertices && numTriangles == rhs.numTriangles &&
+            proxyType == rhs.proxyType && maxNumProxyTriangles == rhs.maxNumProxyTriangles;
+    }
+};
+
+struct ProxyCacheEntry
+{
+    ProxySource source;
+    weak_ref_ptr<SgShape> proxy;
+};
+
+/**
+   The proxy shapes generated in the current process.
+   The key is the hash of the original mesh and the generation parameters.
+   The entries of the released proxies are removed when a new proxy is registered.
+*/
+std::mutex proxyCacheMutex;
+unordered_map<uint64_t, ProxyCacheEntry> proxyCache;
+
+const char proxyFileMagic[8] = { 'C', 'N', 'O', 'I', 'D', 'C', 'S', 'P' };
+const uint32_t proxyFileVersion = 3;
+
+// The maximum number of the convex parts of a convex decomposition proxy
+const int maxNumConvexParts = 8;
+
+class HashGenerator
+{
+public:
+    uint64_t hash = 14695981039346656037ULL;
+    void add(const void* data, size_t size){
+        auto bytes = static_cast<const unsigned char*>(data);
+        for(size_t i=0; i < size; ++i){
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+    }
+    template<class T> void add(const T& value){
+        add(&value, sizeof(T));
+    }
+};
+
+SgMesh* loadProxyMeshFile(const filesystem::path& path, const ProxySource& expectedSource)
+{
+    ifstream is(path.string(), ios::binary);
+    if(!is){
+        return nullptr;
+    }
+    char magic[8];
+    uint32_t version, numVertices, numTriangles;
+    ProxySource source;
+    is.read(magic, sizeof(magic));
+    is.read(reinterpret_cast<char*>(&version), sizeof(version));
+    if(!is || memcmp(magic, proxyFileMagic, sizeof(magic)) != 0 || version != proxyFileVersion){
+        return nullptr;
+    }
+    is.read(reinterpret_cast<char*>(&source), sizeof(source));
+    is.read(reinterpret_cast<char*>(&numVertices), sizeof(numVertices));
+    is.read(reinterpret_cast<char*>(&numTriangles), sizeof(numTriangles));
+    if(!is || !(source == expectedSource)){
+        return nullptr;
+    }
+    SgMeshPtr mesh = new SgMesh;
+    auto& vertices = *mesh->getOrCreateVertices(numVertices);
+    is.read(reinterpret_cast<char*>(vertices.data()), sizeof(float) * 3 * numVertices);
+    mesh->setNumTriangles(numTriangles);
+    auto& triangles = mesh->triangleVertices();
+    is.read(reinterpret_cast<char*>(triangles.data()), sizeof(int) * 3 * numTriangles);
+    if(!is){
+        return nullptr;
+    }
+    for(auto& index : triangles){
+        if(index < 0 || index >= static_cast<int>(numVertices)){
+            return nullptr;
+        }
+    }
+    mesh->updateBoundingBox();
+    return mesh.retn();
+}
+
+void saveProxyMeshFile(SgMesh* mesh, const ProxySource& source, const filesystem::path& path)
+{
+    // Write to a temporary file first so that other processes never read an incomplete file
+    filesystem::path tmpPath(path);
+    tmpPath += ".tmp";
+    {
+        ofstream os(tmpPath.string(), ios::binary);
+        if(!os){
+            return;
+        }
+        auto& vertices = *mesh->vertices();
+        const uint32_t numVertices = vertices.size();
+        const uint32_t numTriangles = mesh->numTriangles();
+        os.write(proxyFileMagic, sizeof(proxyFileMagic));
+        os.write(reinterpret_cast<const char*>(&proxyFileVersion), sizeof(proxyFileVersion));
+        os.write(reinterpret_cast<const char*>(&source), sizeof(source));
+        os.write(reinterpret_cast<const char*>(&numVertices), sizeof(numVertices));
+        os.write(reinterpret_cast<const char*>(&numTriangles), sizeof(numTriangles));
+        os.write(reinterpret_cast<const char*>(vertices.data()), sizeof(float) * 3 * numVertices);
+        os.write(reinterpret_cast<const char*>(mesh->triangleVertices().data()), sizeof(int) * 3 * numTriangles);
+        if(!os){
+            return;
+        }
+    }
+    try {
+        filesystem::rename(tmpPath, path);
+    }
+    catch(const filesystem::filesystem_error&){
+        filesystem::remove(tmpPath);
+    }
+}
+
+/**
+   Scale a convex mesh about the centroid of its vertices so that it encloses the given points.
+   This keeps a convex proxy conservative after its triangles are reduced by decimation.
+*/
+void enclosePointsWithConvexMesh(SgMesh* convexMesh, const SgVertexArray& points)
+{
+    auto& vertices = *convexMesh->vertices();
+    Vector3 center = Vector3::Zero();
+    for(auto& v : vertices){
+        center += v.cast<double>();
+    }
+    center /= vertices.size();
+
+    double scale = 1.0;
+    const int numTriangles = convexMesh->numTriangles();
+    for(int i=0; i < numTriangles; ++i){
+        auto triangle = convexMesh->triangle(i);
+        const Vector3 a = vertices[triangle[0]].cast<double>();
+        const Vector3 b = vertices[triangle[1]].cast<double>();
+        const Vector3 c = vertices[triangle[2]].cast<double>();
+        Vector3 normal = (b - a).cross(c - a);
+        const double norm = normal.norm();
+        if(norm < 1.0e-12){
+            continue;
+        }
+        normal /= norm;
+        double h = normal.dot(a - center);
+        if(h < 0.0){
+            normal = -normal;
+            h = -h;
+        }
+        if(h < 1.0e-9){
+            continue;
+        }
+        for(auto& p : points){
+            const double d = normal.dot(p.cast<double>() - center) - h;
+            if(d > 0.0){
+                scale = std::max(scale, 1.0 + d / h);
+            }
+        }
+    }
+    if(scale > 1.0){
+        // A small extra margin absorbs the rounding errors of the single precision vertices
+        scale *= 1.0 + 1.0e-5;
+        for(auto& v : vertices){
+            v = (center + scale * (v.cast<double>() - center)).cast<float>();
+        }
+    }
+}
+
+
+Vector3 closestPointOnTriangle(const Vector3& p, const Vector3& a, const Vector3& b, const Vector3& c)
+{
+    const Vector3 ab = b - a;
+    const Vector3 ac = c - a;
+    const Vector3 ap = p - a;
+    const double d1 = ab.dot(ap);
+    const double d2 = ac.dot(ap);
+    if(d1 <= 0.0 && d2 <= 0.0){
+        return a;
+    }
+    const Vector3 bp = p - b;
+    const double d3 = ab.dot(bp);
+    const double d4 = ac.dot(bp);
+    if(d3 >= 0.0 && d4 <= d3){
+        return b;
+    }
+    const double vc = d1 * d4 - d3 * d2;
+    if(vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0){
+        return a + (d1 / (d1 - d3)) * ab;
+    }
+    const Vector3 cp = p - c;
+    const double d5 = ab.dot(cp);
+    const double d6 = ac.dot(cp);
+    if(d6 >= 0.0 && d5 <= d6){
+        return c;
+    }
+    const double vb = d5 * d2 - d1 * d6;
+    if(vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0){
+        return a + (d2 / (d2 - d6)) * ac;
+    }
+    const double va = d3 * d6 - d5 * d4;
+    if(va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0){
+        return b + ((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b);
+    }
+    const double denom = 1.0 / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+
+/**
+   Move the vertices of a decimated mesh outward along the vertex normals by the largest distance
+   of the original vertices outside the decimated surface. Each face is moved by at least that
+   distance, so the proxy covers the original surface except around sharp concave features.
+*/
+void inflateDecimatedMesh(SgMesh* decimated, const SgMesh* original)
+{
+    auto& vertices = *decimated->vertices();
+    const int numVertices = vertices.size();
+    const int numTriangles = decimated->numTriangles();
+
+    // The normals point outward when the signed volume is positive
+    double volume = 0.0;
+    for(int i=0; i < numTriangles; ++i){
+        auto triangle = decimated->triangle(i);
+        volume += vertices[triangle[0]].cast<double>().dot(
+            vertices[triangle[1]].cast<double>().cross(vertices[triangle[2]].cast<double>()));
+    }
+    const double orientation = (volume >= 0.0) ? 1.0 : -1.0;
+
+    vector<Vector3> faceNormals(numTriangles);
+    vector<Vector3> centers(numTriangles);
+    vector<double> radii(numTriangles);
+    vector<Vector3> vertexNormals(numVertices, Vector3::Zero());
+    for(int i=0; i < numTriangles; ++i){
+        auto triangle = decimated->triangle(i);
+        const Vector3 a = vertices[triangle[0]].cast<double>();
+        const Vector3 b = vertices[triangle[1]].cast<double>();
+        const Vector3 c = vertices[triangle[2]].cast<double>();
+        const Vector3 n = orientation * (b - a).cross(c - a);
+        for(int j=0; j < 3; ++j){
+            vertexNormals[triangle[j]] += n; // weighted by the area
+        }
+        const double norm = n.norm();
+        faceNormals[i] = (norm > 1.0e-12) ? Vector3(n / norm) : Vector3::Zero();
+        centers[i] = (a + b + c) / 3.0;
+        radii[i] = std::max({ (a - centers[i]).norm(), (b - centers[i]).norm(), (c - centers[i]).norm() });
+    }
+
+    double margin = 0.0;
+    for(auto& v : *original->vertices()){
+        const Vector3 p = v.cast<double>();
+        double minDistance = std::numeric_limits<double>::max();
+        double signedDistance = 0.0;
+        for(int i=0; i < numTriangles; ++i){
+            if((p - centers[i]).norm() - radii[i] >= minDistance){
+                continue;
+            }
+            auto triangle = decimated->triangle(i);
+            const Vector3 q = closestPointOnTriangle(
+                p, vertices[triangle[0]].cast<double>(), vertices[triangle[1]].cast<double>(),
+                vertices[triangle[2]].cast<double>());
+            const double distance = (p - q).norm();
+            if(distance < minDistance){
+                minDistance = distance;
+                signedDistance = faceNormals[i].dot(p - q);
+            }
+        }
+        if(signedDistance > 0.0){
+            margin = std::max(margin, minDistance);
+        }
+    }
+    if(margin <= 0.0){
+        return;
+    }
+
+    // The offset along the vertex normal is increased for the faces tilted from the normal
+    vector<double> minCos(numVertices, 1.0);
+    for(int i=0; i < numVertices; ++i){
+        const double norm = vertexNormals[i].norm();
+        if(norm > 1.0e-12){
+            vertexNormals[i] /= norm;
+        }
+    }
+    for(int i=0; i < numTriangles; ++i){
+        auto triangle = decimated->triangle(i);
+        for(int j=0; j < 3; ++j){
+            const int index = triangle[j];
+            minCos[index] = std::min(minCos[index], vertexNormals[index].dot(faceNormals[i]));
+        }
+    }
+    for(int i=0; i < numVertices; ++i){
+        const double offset = margin * (1.0 + 1.0e-5) / std::max(minCos[i], 0.3);
+        vertices[i] = (vertices[i].cast<double>() + offset * vertexNormals[i]).cast<float>();
+    }
+}
+
+
+/**
+   Split the triangles into spatial clusters and create the convex hull of each cluster.
+   The union of the hulls encloses the surface of the original mesh.
+*/
+SgMesh* createConvexDecomposition(SgMesh* mesh, int maxNumTriangles)
+{
+    auto& vertices = *mesh->vertices();
+    const int numTriangles = mesh->numTriangles();
+    vector<Vector3f> centroids(numTriangles);
+    vector<vector<int>> parts(1);
+    parts[0].resize(numTriangles);
+    for(int i=0; i < numTriangles; ++i){
+        auto triangle = mesh->triangle(i);
+        centroids[i] = (vertices[triangle[0]] + vertices[triangle[1]] + vertices[triangle[2]]) / 3.0f;
+        parts[0][i] = i;
+    }
+
+    // Split the part with the most triangles at the median along the longest axis
+    vector<bool> isSplittable(1, true);
+    while(static_cast<int>(parts.size()) < maxNumConvexParts){
+        int target = -1;
+        for(size_t i=0; i < parts.size(); ++i){
+            if(isSplittable[i] && parts[i].size() >= 2 &&
+               (target < 0 || parts[i].size() > parts[target].size())){
+                target = i;
+            }
+        }
+        if(target < 0){
+            break;
+        }
+        auto& part = parts[target];
+        Vector3f lower = centroids[part.front()];
+        Vector3f upper = lower;
+        for(auto& index : part){
+            lower = lower.cwiseMin(centroids[index]);
+            upper = upper.cwiseMax(centroids[index]);
+        }
+        int axis;
+        if((upper - lower).maxCoeff(&axis) <= 0.0f){
+            isSplittable[target] = false;
+            continue;
+        }
+        auto middle = part.begin() + part.size() / 2;
+        std::nth_element(
+            part.begin(), middle, part.end(),
+            [&](int i1, int i2){ return centroids[i1][axis] < centroids[i2][axis]; });
+        vector<int> upperPart(middle, part.end());
+        part.erase(middle, part.end());
+        parts.push_back(std::move(upperPart));
+        isSplittable.push_back(true);
+    }
+
+    MeshFilter meshFilter;
+    SgMeshPtr decomposition = new SgMesh;
+    auto& allVertices = *decomposition->getOrCreateVertices();
+    const int maxNumPartTriangles = std::max(4, maxNumTriangles / static_cast<int>(parts.size()));
+
+    for(auto& part : parts){
+        SgMeshPtr partMesh = new SgMesh;
+        auto& partVertices = *partMesh->getOrCreateVertices();
+        for(auto& index : part){
+            auto triangle = mesh->triangle(index);
+            for(int i=0; i < 3; ++i){
+                partVertices.push_back(vertices[triangle[i]]);
+            }
+        }
+        SgMeshPtr hull = meshFilter.createConvexHull(partMesh);
+        if(hull){
+            if(hull->numTriangles() > maxNumPartTriangles){
+                SgVertexArrayPtr hullVertices = new SgVertexArray(*hull->vertices());
+                if(meshFilter.decimate(hull, maxNumPartTriangles)){
+                    enclosePointsWithConvexMesh(hull, *hullVertices);
+                }
+            }
+        } else {
+            // A flat part is used as it is
+            hull = partMesh;
+            const int n = partVertices.size() / 3;
+            for(int i=0; i < n; ++i){
+                hull->addTriangle(i * 3, i * 3 + 1, i * 3 + 2);
+            }
+        }
+        const int offset = allVertices.size();
+        for(auto& v : *hull->vertices()){
+            allVertices.push_back(v);
+        }
+        const int n = hull->numTriangles();
+        for(int i=0; i < n; ++i){
+            auto triangle = hull->triangle(i);
+            decomposition->addTriangle(triangle[0] + offset, triangle[1] + offset, triangle[2] + offset);
+        }
+    }
+
+    return decomposition.retn();
+}
+
 }
 
 namespace cnoid {
@@ -30,11 +442,19 @@ public:
     std::function<Referenced*(Link* link, CollisionDetector::GeometryHandle geometry)> funcToGetObjectAssociatedWithLink;
     bool hasCustomObjectsAssociatedWithLinks;
     bool isGeometryHandleMapEnabled;
+    int defaultProxyType;
+    int defaultMaxNumProxyTriangles;
+    string proxyCacheDirectory;
+    // The proxy shapes used by the current bodies
+    vector<SgShapePtr> proxyShapes;
 
     BodyCollisionDetectorImpl();
     bool addBody(Body* body, bool isSelfCollisionEnabled);
     bool addLinkRecursively(
-        Link* link, vector<GeometryHandle>& linkIndexToGeometryIdSetMap, vector<bool>& exclusions, bool isParentStatic);
+        Link* link, vector<GeometryHandle>& linkIndexToGeometryIdSetMap, vector<bool>& exclusions, bool isParentStatic,
+        int proxyType, int maxNumProxyTriangles);
+    SgNode* getProxyShape(SgNode* shape, int proxyType, int maxNumProxyTriangles);
+    SgMesh* generateProxyMesh(SgMesh* mesh, int proxyType, int maxNumProxyTriangles);
     void ignoreLinkPair(int link1Index, int link2Index, vector<GeometryHandle>& linkIndexToGeometryIdSetMap);
     void ignoreLinkPairs(
         Body* body, vector<GeometryHandle>& linkIndexToGeometryIdSetMap,
@@ -55,6 +475,16 @@ BodyCollisionDetectorImpl::BodyCollisionDetectorImpl()
 {
     hasCustomObjectsAssociatedWithLinks = false;
     isGeometryHandleMapEnabled = false;
+    defaultProxyType = BodyCollisionDetector::NO_PROXY;
+    defaultMaxNumProxyTriangles = 1000;
+
+    try {
+        auto directory = filesystem::temp_directory_path() / "cnoid-collision-shape-proxies";
+        proxyCacheDirectory = toUTF8(directory.string());
+    }
+    catch(const filesystem::filesystem_error&){
+
+    }
 }
 
 
@@ -86,12 +516,26 @@ void BodyCollisionDetector::enableGeometryHandleMap(bool on)
 }
 
 
+void BodyCollisionDetector::setDefaultCollisionShapeProxy(int type, int maxNumTriangles)
+{
+    impl->defaultProxyType = type;
+    impl->defaultMaxNumProxyTriangles = maxNumTriangles;
+}
+
+
+void BodyCollisionDetector::setCollisionShapeProxyCacheDirectory(const std::string& directory)
+{
+    impl->proxyCacheDirectory = directory;
+}
+
+
 void BodyCollisionDetector::clearBodies()
 {
     if(impl->collisionDetector){
         impl->collisionDetector->clearGeometries();
     }
     impl->linkToGeometryHandleMap.clear();
+    impl->proxyShapes.clear();
     impl->hasCustomObjectsAssociatedWithLinks = false;
 }
 
@@ -123,10 +567,26 @@ bool BodyCollisionDetectorImpl::addBody(Body* body, bool isSelfCollisionDetectio
     
     vector<bool> exclusions(numLinks);
     vector<vector<int>> excludeLinkGroups;
+
+    int proxyType = defaultProxyType;
+    int maxNumProxyTriangles = defaultMaxNumProxyTriangles;
     
     auto cdInfo = body->info()->findMapping("collisionDetection");
     if(cdInfo->isValid()){
         excludeTreeDepth = cdInfo->get("excludeTreeDepth", excludeTreeDepth);
+        string proxy;
+        if(cdInfo->read("shapeProxy", proxy)){
+            if(proxy == "decimation"){
+                proxyType = BodyCollisionDetector::DECIMATED_MESH_PROXY;
+            } else if(proxy == "convexHull"){
+                proxyType = BodyCollisionDetector::CONVEX_HULL_PROXY;
+            } else if(proxy == "convexDecomposition"){
+                proxyType = BodyCollisionDetector::CONVEX_DECOMPOSITION_PROXY;
+            } else if(proxy == "none"){
+                proxyType = BodyCollisionDetector::NO_PROXY;
+            }
+        }
+        cdInfo->read("shapeProxyMaxTriangles", maxNumProxyTriangles);
         const Listing& excludeLinks = *cdInfo->findListing("excludeLinks");
         for(size_t i=0; i < excludeLinks.size(); ++i){
             Link* link = body->link(excludeLinks[i].toString());
@@ -158,7 +618,8 @@ bool BodyCollisionDetectorImpl::addBody(Body* body, bool isSelfCollisionDetectio
 
     vector<GeometryHandle> linkIndexToGeometryHandleMap(numLinks);
 
-    bool added = addLinkRecursively(body->rootLink(), linkIndexToGeometryHandleMap, exclusions, true);
+    bool added = addLinkRecursively(
+        body->rootLink(), linkIndexToGeometryHandleMap, exclusions, true, proxyType, maxNumProxyTriangles);
 
     if(isSelfCollisionDetectionEnabled){
         ignoreLinkPairs(
@@ -181,13 +642,18 @@ bool BodyCollisionDetectorImpl::addBody(Body* body, bool isSelfCollisionDetectio
 
 
 bool BodyCollisionDetectorImpl::addLinkRecursively
-(Link* link, vector<GeometryHandle>& linkIndexToGeometryHandleMap, vector<bool>& exclusions, bool isParentStatic)
+(Link* link, vector<GeometryHandle>& linkIndexToGeometryHandleMap, vector<bool>& exclusions, bool isParentStatic,
+ int proxyType, int maxNumProxyTriangles)
 {
     bool added = false;
     bool isStatic = isParentStatic && link->isFixedJoint();
 
     if(!exclusions[link->index()]){
-        auto handle = collisionDetector->addGeometry(link->collisionShape());
+        SgNode* shape = link->collisionShape();
+        if(shape && proxyType != BodyCollisionDetector::NO_PROXY){
+            shape = getProxyShape(shape, proxyType, maxNumProxyTriangles);
+        }
+        auto handle = collisionDetector->addGeometry(shape);
         if(handle){
             Referenced* object;
             if(funcToGetObjectAssociatedWithLink){
@@ -207,13 +673,141 @@ bool BodyCollisionDetectorImpl::addLinkRecursively
         }
     }    
     for(Link* child = link->child(); child; child = child->sibling()){
-        added |= addLinkRecursively(child, linkIndexToGeometryHandleMap, exclusions, isStatic);
+        added |= addLinkRecursively(
+            child, linkIndexToGeometryHandleMap, exclusions, isStatic, proxyType, maxNumProxyTriangles);
     }
 
     return added;
 }
 
 
+/**
+   \return The proxy shape of a given collision shape, or the given shape itself if it has
+   maxNumProxyTriangles or fewer triangles or the proxy cannot be generated.
+*/
+SgNode* BodyCollisionDetectorImpl::getProxyShape(SgNode* shape, int proxyType, int maxNumProxyTriangles)
+{
+    MeshExtractor meshExtractor;
+    SgMeshPtr mesh = meshExtractor.integrate(shape);
+    if(!mesh->hasVertices() || mesh->numTriangles() <= maxNumProxyTriangles){
+        return shape;
+    }
+
+    auto& vertices = *mesh->vertices();
+    auto& triangles = mesh->triangleVertices();
+    ProxySource source;
+    source.numVertices = vertices.size();
+    source.numTriangles = mesh->numTriangles();
+    source.proxyType = proxyType;
+    source.maxNumProxyTriangles = maxNumProxyTriangles;
+
+    HashGenerator hash;
+    hash.add(proxyFileVersion);
+    hash.add(source);
+    hash.add(vertices.data(), sizeof(float) * 3 * vertices.size());
+    hash.add(triangles.data(), sizeof(int) * triangles.size());
+    const uint64_t key = hash.hash;
+
+    SgShapePtr proxy;
+    {
+        std::lock_guard<std::mutex> lock(proxyCacheMutex);
+        auto p = proxyCache.find(key);
+        if(p != proxyCache.end() && p->second.source == source){
+            proxy = p->second.proxy.lock();
+        }
+    }
+
+    /*
+      The proxy is loaded or generated without locking the mutex so that the proxies of
+      different meshes are created in parallel. If the same proxy is created by another
+      thread in the meantime, the one registered first is used.
+    */
+    if(!proxy){
+        SgMeshPtr proxyMesh;
+        filesystem::path cacheFile;
+        if(!proxyCacheDirectory.empty()){
+            cacheFile = filesystem::path(fromUTF8(proxyCacheDirectory)) / format("{:016x}.csp", key);
+            proxyMesh = loadProxyMeshFile(cacheFile, source);
+        }
+        if(!proxyMesh){
+            proxyMesh = generateProxyMesh(mesh, proxyType, maxNumProxyTriangles);
+            if(!proxyMesh){
+                return shape;
+            }
+            if(!cacheFile.empty()){
+                try {
+                    filesystem::create_directories(cacheFile.parent_path());
+                    saveProxyMeshFile(proxyMesh, source, cacheFile);
+                }
+                catch(const filesystem::filesystem_error&){
+
+                }
+            }
+        }
+        proxy = new SgShape;
+        proxy->setMesh(proxyMesh);
+
+        std::lock_guard<std::mutex> lock(proxyCacheMutex);
+        auto& entry = proxyCache[key];
+        SgShapePtr registered = (entry.source == source) ? entry.proxy.lock() : nullptr;
+        if(registered){
+            proxy = registered;
+        } else {
+            entry.source = source;
+            entry.proxy = proxy;
+            for(auto p = proxyCache.begin(); p != proxyCache.end(); ){
+                if(p->second.proxy.expired()){
+                    p = proxyCache.erase(p);
+                } else {
+                    ++p;
+                }
+            }
+        }
+    }
+    proxyShapes.push_back(proxy);
+
+    return proxy;
+}
+
+
+/**
+   The convex hull and the convex decomposition proxies enclose the original mesh even when
+   their triangles are reduced by decimation. The decimated mesh proxy is inflated by the
+   distance of the original vertices outside the decimated surface.
+*/
+SgMesh* BodyCollisionDetectorImpl::generateProxyMesh(SgMesh* mesh, int proxyType, int maxNumProxyTriangles)
+{
+    MeshFilter meshFilter;
+    SgMeshPtr proxyMesh;
+
+    if(proxyType == BodyCollisionDetector::CONVEX_HULL_PROXY){
+        proxyMesh = meshFilter.createConvexHull(mesh);
+        if(proxyMesh && proxyMesh->numTriangles() > maxNumProxyTriangles){
+            SgVertexArrayPtr hullVertices = new SgVertexArray(*proxyMesh->vertices());
+            if(meshFilter.decimate(proxyMesh, maxNumProxyTriangles)){
+                enclosePointsWithConvexMesh(proxyMesh, *hullVertices);
+            }
+        }
+    } else if(proxyType == BodyCollisionDetector::DECIMATED_MESH_PROXY){
+        SgMeshPtr decimated = new SgMesh;
+        decimated->setVertices(new SgVertexArray(*mesh->vertices()));
+        decimated->triangleVertices() = mesh->triangleVertices();
+        if(meshFilter.decimate(decimated, maxNumProxyTriangles)){
+            inflateDecimatedMesh(decimated, mesh);
+            proxyMesh = decimated;
+        }
+    } else if(proxyType == BodyCollisionDetector::CONVEX_DECOMPOSITION_PROXY){
+        proxyMesh = createConvexDecomposition(mesh, maxNumProxyTriangles);
+    }
+
+    if(proxyMesh){
+        proxyMesh->updateBoundingBox();
+    }
+
+    return proxyMesh.retn();
+}
+
+
 void BodyCollisionDetectorImpl::ignoreLinkPair
 (int link1Index, int link2Index, vector<GeometryHandle>& linkIndexToGeometryHandleMap)
 {
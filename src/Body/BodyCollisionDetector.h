@@ -29,6 +29,25 @@ public:
     void enableGeometryHandleMap(bool on);
     stdx::optional<CollisionDetector::GeometryHandle> findGeometryHandle(Link* link);
 
+    enum CollisionShapeProxyType {
+        NO_PROXY, DECIMATED_MESH_PROXY, CONVEX_HULL_PROXY, CONVEX_DECOMPOSITION_PROXY
+    };
+
+    /**
+       Set the simplified shape used as the collision shape of a link whose collision shape has
+       more triangles than maxNumTriangles. The proxy encloses the original shape so that the
+       collisions of the original shape are not missed. The "shapeProxy" ("none", "decimation",
+       "convexHull" or "convexDecomposition") and "shapeProxyMaxTriangles" values in the
+       "collisionDetection" mapping of the body information override this setting.
+    */
+    void setDefaultCollisionShapeProxy(int type, int maxNumTriangles = 1000);
+
+    /**
+       The generated proxy shapes are stored in this directory and reused by the later loads.
+       The cache is disabled by giving an empty string.
+    */
+    void setCollisionShapeProxyCacheDirectory(const std::string& directory);
+
     void addBody(Body* body, bool isSelfCollisionDetectionEnabled);
     void addBody(Body* body, bool isSelfCollisionDetectionEnabled,
                  std::function<Referenced*(Link* link, CollisionDetector::GeometryHandle geometry)> getObjectAssociatedWithLink);
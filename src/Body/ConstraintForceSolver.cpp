@@ -318,6 +318,9 @@ public:
     void initExtraJointSub(ExtraJoint& extrajoint, int bodyIndex0, int bodyIndex1);
     void init2Dconstraint(int bodyIndex);
     void initialize(void);
+    void resetState();
+    double* writeState(double* out_buf) const;
+    const double* readState(const double* buf);
     void initializeContactMaterials();
     ContactMaterialEx* createContactMaterialFromMaterialPair(int material1, int material2);
     void clearExternalForces();
@@ -658,6 +661,17 @@ void CFSImpl::initialize(void)
 
     bodyCollisionDetector.makeReady();
 
+    resetState();
+}
+
+
+/**
+   The state carried over from the previous step is cleared so that the next step gives the same result
+   as the first step after the initialization. The collision models and the link pairs are kept.
+*/
+void CFSImpl::resetState()
+{
+    constrainedLinkPairs.clear();
     prevGlobalNumConstraintVectors = 0;
     prevGlobalNumFrictionVectors = 0;
     numUnconverged = 0;
@@ -668,6 +682,42 @@ void CFSImpl::initialize(void)
 }
 
 
+double* CFSImpl::writeState(double* out_buf) const
+{
+    *out_buf++ = prevGlobalNumConstraintVectors;
+    *out_buf++ = prevGlobalNumFrictionVectors;
+    *out_buf++ = globalNumContactNormalVectors;
+    *out_buf++ = numUnconverged;
+    const int n = (prevGlobalNumConstraintVectors > 0) ? solution.size() : 0;
+    *out_buf++ = n;
+    std::copy(solution.data(), solution.data() + n, out_buf);
+    return out_buf + n;
+}
+
+
+const double* CFSImpl::readState(const double* buf)
+{
+    constrainedLinkPairs.clear();
+    globalNumConstraintVectors = *buf++;
+    globalNumFrictionVectors = *buf++;
+    globalNumContactNormalVectors = *buf++;
+    numUnconverged = *buf++;
+    const int n = *buf++;
+
+    // The matrices are only resized when the number of the constraints changes
+    if(globalNumConstraintVectors > 0){
+        initMatrices();
+    }
+    if(n == solution.size()){
+        std::copy(buf, buf + n, solution.data());
+    }
+    prevGlobalNumConstraintVectors = globalNumConstraintVectors;
+    prevGlobalNumFrictionVectors = globalNumFrictionVectors;
+
+    return buf + n;
+}
+
+
 void CFSImpl::initializeContactMaterials()
 {
     if(!orgMaterialTable){
@@ -2454,6 +2504,31 @@ void ConstraintForceSolver::initialize(void)
 }
 
 
+void ConstraintForceSolver::resetState()
+{
+    impl->resetState();
+}
+
+
+int ConstraintForceSolver::stateSize() const
+{
+    const int n = (impl->prevGlobalNumConstraintVectors > 0) ? impl->solution.size() : 0;
+    return 5 + n;
+}
+
+
+double* ConstraintForceSolver::writeState(double* out_buf) const
+{
+    return impl->writeState(out_buf);
+}
+
+
+const double* ConstraintForceSolver::readState(const double* buf)
+{
+    return impl->readState(buf);
+}
+
+
 void ConstraintForceSolver::solve()
 {
     impl->solve();
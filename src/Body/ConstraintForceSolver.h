@@ -60,6 +60,18 @@ public:
     void enableConstraintForceOutput(bool on);
 
     void initialize(void);
+
+    //! Clears the state kept between the steps without rebuilding the collision models
+    void resetState();
+
+    /**
+       Functions to save the state kept between the steps, such as the previous solution used as the
+       initial value of the iterative solver, and to restore it. The convention is the same as DeviceState.
+    */
+    int stateSize() const;
+    double* writeState(double* out_buf) const;
+    const double* readState(const double* buf);
+
     void solve();
     void clearExternalForces();
 
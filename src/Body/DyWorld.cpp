@@ -120,6 +120,48 @@ void WorldBase::initialize()
 }
 
 
+void WorldBase::resetState()
+{
+    for(auto& info : bodyInfoArray){
+        DyLink* root = info.body->rootLink();
+        root->vo().noalias() = root->v() - root->w().cross(root->p());
+        root->dvo().noalias() = root->dv() - root->dw().cross(root->p()) - root->w().cross(root->v());
+    }
+    WorldBase::initialize();
+}
+
+
+int WorldBase::stateSize() const
+{
+    return bodyInfoArray.size() * 6;
+}
+
+
+double* WorldBase::writeState(double* out_buf) const
+{
+    for(auto& info : bodyInfoArray){
+        DyLink* root = info.body->rootLink();
+        Vector3::Map(out_buf) = root->vo();
+        Vector3::Map(out_buf + 3) = root->dvo();
+        out_buf += 6;
+    }
+    return out_buf;
+}
+
+
+const double* WorldBase::readState(const double* buf)
+{
+    for(auto& info : bodyInfoArray){
+        DyLink* root = info.body->rootLink();
+        root->vo() = Vector3::Map(buf);
+        root->dvo() = Vector3::Map(buf + 3);
+        buf += 6;
+    }
+    WorldBase::initialize();
+    return buf;
+}
+
+
 void WorldBase::setVirtualJointForces()
 {
     for(size_t i=0; i < bodyInfoArray.size(); ++i){
@@ -145,6 +145,22 @@ public:
     */
     virtual void initialize();
 
+    /**
+       @brief re-initialize the dynamics for the current states of the registered bodies.
+       The velocities of the root links are taken from the non-spatial velocities.
+    */
+    virtual void resetState();
+
+    /**
+       @brief functions to save the state of the dynamics which is not contained in the link states
+       and to restore it after the link states are restored. The forward dynamics is re-initialized
+       by readState so that the simulation is resumed in the same way as it was continued.
+       The functions follow the same convention as the ones of DeviceState.
+    */
+    virtual int stateSize() const;
+    virtual double* writeState(double* out_buf) const;
+    virtual const double* readState(const double* buf);
+
     void setVirtualJointForces();
         
     /**
@@ -212,6 +228,24 @@ public:
         constraintForceSolver.initialize();
     }
 
+    //! Unlike initialize(), the collision models of the constraint force solver are not rebuilt.
+    virtual void resetState() {
+        WorldBase::resetState();
+        constraintForceSolver.resetState();
+    }
+
+    virtual int stateSize() const {
+        return WorldBase::stateSize() + constraintForceSolver.stateSize();
+    }
+
+    virtual double* writeState(double* out_buf) const {
+        return constraintForceSolver.writeState(WorldBase::writeState(out_buf));
+    }
+
+    virtual const double* readState(const double* buf) {
+        return constraintForceSolver.readState(WorldBase::readState(buf));
+    }
+
     virtual void calcNextState(){
         WorldBase::setVirtualJointForces();
         constraintForceSolver.solve();
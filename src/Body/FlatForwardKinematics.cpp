@@ -0,0 +1,177 @@
+#include "FlatForwardKinematics.h"
+#include "Body.h"
+#include "Link.h"
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+enum JointTypeId : unsigned char { Fixed, Rotational, Slide };
+
+}
+
+
+FlatForwardKinematics::FlatForwardKinematics()
+    : body_(nullptr)
+{
+
+}
+
+
+FlatForwardKinematics::FlatForwardKinematics(Body* body)
+    : body_(nullptr)
+{
+    setBody(body);
+}
+
+
+bool FlatForwardKinematics::setBody(Body* body)
+{
+    body_ = body;
+    parents_.clear();
+
+    if(!body){
+        return false;
+    }
+    const int n = body->numLinks();
+    for(int i=1; i < n; ++i){
+        Link* parent = body->link(i)->parent();
+        if(!parent || parent->index() >= i){
+            return false; // The links are not in the topological order
+        }
+    }
+
+    parents_.resize(n);
+    jointTypes.resize(n);
+    Rb_.resize(n);
+    b_.resize(n);
+    a_.resize(n);
+    q_.resize(n);
+    dq_.resize(n);
+    R_.resize(n);
+    p_.resize(n);
+    w_.resize(n);
+    v_.resize(n);
+
+    for(int i=0; i < n; ++i){
+        Link* link = body->link(i);
+        parents_[i] = link->parent() ? link->parent()->index() : -1;
+        switch(link->jointType()){
+        case Link::ROTATIONAL_JOINT: jointTypes[i] = Rotational; break;
+        case Link::SLIDE_JOINT: jointTypes[i] = Slide; break;
+        default: jointTypes[i] = Fixed; break;
+        }
+        Rb_[i] = link->Rb();
+        b_[i] = link->b();
+        a_[i] = link->a();
+    }
+
+    readState(true);
+
+    return true;
+}
+
+
+void FlatForwardKinematics::readState(bool readVelocity)
+{
+    const int n = parents_.size();
+    if(n == 0){
+        return;
+    }
+    Link* root = body_->rootLink();
+    R_[0] = root->R();
+    p_[0] = root->p();
+    if(readVelocity){
+        w_[0] = root->w();
+        v_[0] = root->v();
+    }
+    for(int i=1; i < n; ++i){
+        Link* link = body_->link(i);
+        q_[i] = link->q();
+        if(readVelocity){
+            dq_[i] = link->dq();
+        }
+    }
+}
+
+
+void FlatForwardKinematics::calcForwardKinematics(bool calcVelocity)
+{
+    const int n = parents_.size();
+    Vector3 arm;
+
+    for(int i=1; i < n; ++i){
+        const int parent = parents_[i];
+        const Matrix3& parentR = R_[parent];
+        Matrix3& R = R_[i];
+
+        switch(jointTypes[i]){
+
+        case Rotational:
+            R.noalias() = parentR * (Rb_[i] * AngleAxisd(q_[i], a_[i]).toRotationMatrix());
+            arm.noalias() = parentR * b_[i];
+            break;
+
+        case Slide:
+            R.noalias() = parentR * Rb_[i];
+            arm.noalias() = parentR * (b_[i] + Rb_[i] * (q_[i] * a_[i]));
+            break;
+
+        default:
+            R.noalias() = parentR * Rb_[i];
+            arm.noalias() = parentR * b_[i];
+            break;
+        }
+        p_[i].noalias() = p_[parent] + arm;
+
+        if(calcVelocity){
+            const Vector3& parentW = w_[parent];
+            const Vector3 vw = v_[parent] + parentW.cross(arm);
+            switch(jointTypes[i]){
+            case Rotational:
+                w_[i].noalias() = parentW + (parentR * (Rb_[i] * a_[i])) * dq_[i];
+                v_[i] = vw;
+                break;
+            case Slide:
+                // The same as LinkTraverse::calcForwardKinematics
+                w_[i] = parentW;
+                v_[i].noalias() = v_[parent] + (parentR * (Rb_[i] * a_[i])) * dq_[i];
+                break;
+            default:
+                w_[i] = parentW;
+                v_[i] = vw;
+                break;
+            }
+        }
+    }
+}
+
+
+void FlatForwardKinematics::writeLinkPositions(bool writeVelocity) const
+{
+    const int n = parents_.size();
+    for(int i=1; i < n; ++i){
+        Link* link = body_->link(i);
+        link->R() = R_[i];
+        link->p() = p_[i];
+        if(writeVelocity){
+            link->w() = w_[i];
+            link->v() = v_[i];
+        }
+    }
+}
+
+
+void FlatForwardKinematics::calcBodyForwardKinematics(bool calcVelocity)
+{
+    if(parents_.empty()){
+        if(body_){
+            body_->calcForwardKinematics(calcVelocity);
+        }
+        return;
+    }
+    readState(calcVelocity);
+    calcForwardKinematics(calcVelocity);
+    writeLinkPositions(calcVelocity);
+}
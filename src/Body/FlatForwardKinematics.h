@@ -0,0 +1,77 @@
+#ifndef CNOID_BODY_FLAT_FORWARD_KINEMATICS_H
+#define CNOID_BODY_FLAT_FORWARD_KINEMATICS_H
+
+#include <cnoid/EigenTypes>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+
+/**
+   The kinematic state of a body stored in contiguous arrays indexed by the link index.
+   Since the link indices of a body are in the topological order, the forward kinematics is
+   computed by a single pass over the arrays without accessing the Link objects. The state is
+   exchanged with the links by the read and write functions.
+*/
+class CNOID_EXPORT FlatForwardKinematics
+{
+public:
+    FlatForwardKinematics();
+    FlatForwardKinematics(Body* body);
+
+    /**
+       The link offsets and the joint axes are copied from the body.
+       False is returned if the links are not in the topological order. The body is kept in
+       that case so that calcBodyForwardKinematics can use the forward kinematics of the body.
+    */
+    bool setBody(Body* body);
+    Body* body() { return body_; }
+    //! True if the arrays are available for the body.
+    bool isFlat() const { return !parents_.empty(); }
+
+    int numLinks() const { return parents_.size(); }
+    int parent(int linkIndex) const { return parents_[linkIndex]; }
+
+    double& q(int linkIndex) { return q_[linkIndex]; }
+    double& dq(int linkIndex) { return dq_[linkIndex]; }
+    Matrix3& R(int linkIndex) { return R_[linkIndex]; }
+    Vector3& p(int linkIndex) { return p_[linkIndex]; }
+    Vector3& w(int linkIndex) { return w_[linkIndex]; }
+    Vector3& v(int linkIndex) { return v_[linkIndex]; }
+    const Matrix3& R(int linkIndex) const { return R_[linkIndex]; }
+    const Vector3& p(int linkIndex) const { return p_[linkIndex]; }
+    const Vector3& w(int linkIndex) const { return w_[linkIndex]; }
+    const Vector3& v(int linkIndex) const { return v_[linkIndex]; }
+
+    //! Reads the root link state and the joint displacements (and velocities) from the links.
+    void readState(bool readVelocity = false);
+    void calcForwardKinematics(bool calcVelocity = false);
+    //! Writes the link positions (and velocities) to the links.
+    void writeLinkPositions(bool writeVelocity = false) const;
+
+    /**
+       readState, calcForwardKinematics and writeLinkPositions.
+       Body::calcForwardKinematics is used instead if the arrays are not available.
+    */
+    void calcBodyForwardKinematics(bool calcVelocity = false);
+
+private:
+    Body* body_;
+    std::vector<int> parents_;
+    std::vector<unsigned char> jointTypes;
+    std::vector<Matrix3> Rb_;
+    std::vector<Vector3> b_;
+    std::vector<Vector3> a_;
+    std::vector<double> q_;
+    std::vector<double> dq_;
+    std::vector<Matrix3> R_;
+    std::vector<Vector3> p_;
+    std::vector<Vector3> w_;
+    std::vector<Vector3> v_;
+};
+
+}
+
+#endif
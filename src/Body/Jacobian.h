@@ -13,9 +13,12 @@ CNOID_EXPORT void calcCMJacobian(Body* body, Link* base, Eigen::MatrixXd& J);
 
 CNOID_EXPORT void calcAngularMomentumJacobian(Body* body, Link* base, Eigen::MatrixXd& H);
 
-template<int elementMask, int rowOffset, int colOffset, bool useTargetLinkLocalPos>
+/**
+   The output matrix can be a fixed size matrix as well as MatrixXd.
+*/
+template<int elementMask, int rowOffset, int colOffset, bool useTargetLinkLocalPos, class Derived>
 void setJacobian(const JointPath& path, Link* targetLink, const Vector3& targetLinkLocalPos,
-                 MatrixXd& out_J) {
+                 Eigen::MatrixBase<Derived>& out_J) {
 
     const bool isTranslationValid = (elementMask & 0x7);
 
@@ -26,7 +29,7 @@ void setJacobian(const JointPath& path, Link* targetLink, const Vector3& targetL
         Link* link = path.joint(i);
         int row = rowOffset;
 
-        MatrixXd::ColXpr Ji = out_J.col(i + colOffset);
+        auto Ji = out_J.col(i + colOffset);
                 
         switch(link->jointType()){
                 
@@ -88,7 +91,7 @@ void setJacobian(const JointPath& path, Link* targetLink, const Vector3& targetL
     }
 
     while(i < n){
-        MatrixXd::ColXpr Ji = out_J.col(i + colOffset);
+        auto Ji = out_J.col(i + colOffset);
         int row = rowOffset;
         if(elementMask & 0x1)  Ji(row++) = 0.0;
         if(elementMask & 0x2)  Ji(row++) = 0.0;
@@ -100,8 +103,8 @@ void setJacobian(const JointPath& path, Link* targetLink, const Vector3& targetL
     }
 }
 
-template<int elementMask, int rowOffset, int colOffset>
-void setJacobian(const JointPath& path, Link* targetLink, MatrixXd& out_J) {
+template<int elementMask, int rowOffset, int colOffset, class Derived>
+void setJacobian(const JointPath& path, Link* targetLink, Eigen::MatrixBase<Derived>& out_J) {
     static const Vector3 targetLinkLocalPos(Vector3::Zero());
     setJacobian<elementMask, rowOffset, colOffset, false>(
         path, targetLink, targetLinkLocalPos, out_J);
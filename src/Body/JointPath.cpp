@@ -57,10 +57,12 @@ public:
     VectorXd dq;
     vector<double> q0;
     MatrixXd JJ;
+    VectorXd JJinvTask;
     Eigen::ColPivHouseholderQR<MatrixXd> QR;
     TruncatedSVD<MatrixXd> svd;
     std::function<double(VectorXd& out_error)> errorFunc;
     std::function<void(MatrixXd& out_Jacobian)> jacobianFunc;
+    bool isTargetCustomized;
 
     NumericalIK() {
         deltaScale = JointPath::numericalIKdefaultDeltaScale();
@@ -72,14 +74,98 @@ public:
         maxIKerrorSqr = e * e;
         double d = JointPath::numericalIKdefaultDampingConstant();
         dampingConstantSqr = d * d;
+        isTargetCustomized = false;
     }
 
     void resize(int numJoints){
         J.resize(dTask.size(), numJoints);
         dq.resize(numJoints);
     }
+
+    template<int NumJoints>
+    bool calcFixedSizeInverseKinematics(JointPath& path, const Position& T);
 };
 
+
+/**
+   This function does the same computation as the damped least squares method of
+   JointPath::calcInverseKinematics for the end link position and orientation, but the
+   matrices and vectors have the compile-time sizes so that the solution is computed
+   without any heap allocation.
+*/
+template<int NumJoints>
+bool NumericalIK::calcFixedSizeInverseKinematics(JointPath& path, const Position& T)
+{
+    typedef Eigen::Matrix<double, 6, NumJoints> JacobianMatrix;
+    typedef Eigen::Matrix<double, NumJoints, 1> JointVector;
+    typedef Eigen::Matrix<double, 6, 1> TaskVector;
+    typedef Eigen::Matrix<double, 6, 6> DampedMatrix;
+
+    JacobianMatrix J;
+    DampedMatrix JJ;
+    Eigen::ColPivHouseholderQR<DampedMatrix> QR;
+    TaskVector dTask;
+    JointVector dq;
+    JointVector q0;
+    Link* target = path.endLink();
+
+    if(!isBestEffortIKmode){
+        for(int i=0; i < NumJoints; ++i){
+            q0[i] = path.joint(i)->q();
+        }
+    }
+
+    double prevErrsqr = std::numeric_limits<double>::max();
+    bool completed = false;
+
+    for(iteration = 0; iteration < maxIterations; ++iteration){
+
+        dTask.head<3>() = T.translation() - target->p();
+        dTask.segment<3>(3) = target->R() * omegaFromRot(target->R().transpose() * T.linear());
+        const double errorSqr = dTask.squaredNorm();
+
+        if(errorSqr < maxIKerrorSqr){
+            completed = true;
+            break;
+        }
+        if(prevErrsqr - errorSqr < maxIKerrorSqr){
+            if(isBestEffortIKmode && (errorSqr > prevErrsqr)){
+                for(int j=0; j < NumJoints; ++j){
+                    path.joint(j)->q() = q0[j];
+                }
+                path.calcForwardKinematics();
+            }
+            break;
+        }
+        prevErrsqr = errorSqr;
+
+        setJacobian<0x3f, 0, 0>(path, target, J);
+
+        JJ.noalias() = J * J.transpose();
+        JJ.diagonal().array() += dampingConstantSqr;
+        dq.noalias() = J.transpose() * QR.compute(JJ).solve(dTask);
+
+        for(int j=0; j < NumJoints; ++j){
+            double& q = path.joint(j)->q();
+            if(isBestEffortIKmode){
+                q0[j] = q;
+            }
+            q += deltaScale * dq[j];
+        }
+
+        path.calcForwardKinematics();
+    }
+
+    if(!completed && !isBestEffortIKmode){
+        for(int i=0; i < NumJoints; ++i){
+            path.joint(i)->q() = q0[i];
+        }
+        path.calcForwardKinematics();
+    }
+    
+    return completed;
+}
+
 }
 
 
@@ -275,6 +361,7 @@ void JointPath::customizeTarget
     nuIK->dTask.resize(numTargetElements);
     nuIK->errorFunc = errorFunc;
     nuIK->jacobianFunc = jacobianFunc;
+    nuIK->isTargetCustomized = true;
 }
 
 
@@ -317,6 +404,21 @@ bool JointPath::calcInverseKinematics(const Position& T)
 
     auto nuIK = getOrCreateNumericalIK();
     
+    if(needForwardKinematicsBeforeIK){
+        calcForwardKinematics();
+        needForwardKinematicsBeforeIK = false;
+    }
+
+    // The kernels specialized for the common chain lengths
+    if(!nuIK->isTargetCustomized && !USE_USUAL_INVERSE_SOLUTION_FOR_6x6_NON_BEST_EFFORT_PROBLEM &&
+       !USE_SVD_FOR_BEST_EFFORT_IK){
+        switch(n){
+        case 6: return nuIK->calcFixedSizeInverseKinematics<6>(*this, T);
+        case 7: return nuIK->calcFixedSizeInverseKinematics<7>(*this, T);
+        default: break;
+        }
+    }
+    
     if(!nuIK->jacobianFunc){
         nuIK->jacobianFunc = [&](MatrixXd& out_Jacobian){ setJacobian<0x3f, 0, 0>(*this, endLink(), out_Jacobian); };
     }
@@ -324,11 +426,6 @@ bool JointPath::calcInverseKinematics(const Position& T)
     
     Link* target = linkPath_.endLink();
 
-    if(needForwardKinematicsBeforeIK){
-        calcForwardKinematics();
-        needForwardKinematicsBeforeIK = false;
-    }
-
     nuIK->q0.resize(n);
     if(!nuIK->isBestEffortIKmode){
         for(int i=0; i < n; ++i){
@@ -385,8 +482,10 @@ bool JointPath::calcInverseKinematics(const Position& T)
                 nuIK->svd.compute(nuIK->J).solve(nuIK->dTask, nuIK->dq);
             } else {
                 // The damped least squares (singurality robust inverse) method
-                nuIK->JJ = nuIK->J * nuIK->J.transpose() + nuIK->dampingConstantSqr * MatrixXd::Identity(nuIK->J.rows(), nuIK->J.rows());
-                nuIK->dq = nuIK->J.transpose() * nuIK->QR.compute(nuIK->JJ).solve(nuIK->dTask);
+                nuIK->JJ.noalias() = nuIK->J * nuIK->J.transpose();
+                nuIK->JJ.diagonal().array() += nuIK->dampingConstantSqr;
+                nuIK->JJinvTask = nuIK->QR.compute(nuIK->JJ).solve(nuIK->dTask);
+                nuIK->dq.noalias() = nuIK->J.transpose() * nuIK->JJinvTask;
             }
         }
 
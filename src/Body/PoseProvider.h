@@ -27,6 +27,13 @@ public:
     virtual void getJointPositions(std::vector<stdx::optional<double>>& out_q) const = 0;
     virtual stdx::optional<Vector3> ZMP() const = 0;
 
+    /**
+       Create an independent provider that gives the same poses.
+       The clone is used to generate poses in another thread.
+       @return nullptr if the provider does not support cloning
+    */
+    virtual PoseProvider* clone() const { return nullptr; }
+
 #ifdef CNOID_BACKWARD_COMPATIBILITY
     bool getBaseLinkPosition(Vector3& out_p, Matrix3& out_R) const {
         Position T;
@@ -9,6 +9,8 @@
 #include "BodyMotion.h"
 #include "ZMPSeq.h"
 #include "PoseProvider.h"
+#include <cnoid/ThreadPool>
+#include <memory>
 
 using namespace std;
 using namespace cnoid;
@@ -41,19 +43,23 @@ void PoseProviderToBodyMotionConverter::setAllLinkPositionOutput(bool on)
 }
 
 
-bool PoseProviderToBodyMotionConverter::convert(Body* body, PoseProvider* provider, BodyMotion& motion)
+namespace {
+
+/*
+  The number of frames processed by a thread is limited to this value or more because
+  the poses must be prepared for each thread by cloning the body and the pose provider.
+*/
+constexpr int MinNumFramesPerThread = 200;
+
+bool convertFrameRange
+(Body* body, PoseProvider* provider, BodyMotion& motion, int beginningFrame, int endingFrame,
+ int numLinksToPut, bool allLinkPositionOutputMode)
 {
     const double frameRate = motion.frameRate();
-    const int beginningFrame = static_cast<int>(frameRate * std::max(provider->beginningTime(), lowerTime));
-    const int endingFrame = static_cast<int>(frameRate * std::min(provider->endingTime(), upperTime));
     const int numJoints = body->numJoints();
-    const int numLinksToPut = (allLinkPositionOutputMode ? body->numLinks() : 1);
-    
-    motion.setDimension(endingFrame + 1, numJoints, numLinksToPut, true);
-
     MultiValueSeq& qseq = *motion.jointPosSeq();
     MultiSE3Seq& pseq = *motion.linkPosSeq();
-    ZMPSeq& zmpseq = *getOrCreateZMPSeq(motion);
+    ZMPSeq& zmpseq = *getZMPSeq(motion);
     bool isZmpValid = false;
 
     Link* rootLink = body->rootLink();
@@ -66,13 +72,10 @@ bool PoseProviderToBodyMotionConverter::convert(Body* body, PoseProvider* provid
         fkTraverse = make_shared<LinkPath>(baseLink, rootLink);
     }
 
-    // store the original state
-    vector<double> orgq(numJoints);
-    for(int i=0; i < numJoints; ++i){
-        orgq[i] = body->joint(i)->q();
+    // The previous frame gives the initial state of the inverse kinematics
+    if(beginningFrame > 0){
+        provider->seek((beginningFrame - 1) / frameRate);
     }
-    Vector3 p0 = rootLink->p();
-    Matrix3 R0 = rootLink->R();
 
     std::vector<stdx::optional<double>> jointPositions(numJoints);
 
@@ -116,9 +119,122 @@ bool PoseProviderToBodyMotionConverter::convert(Body* body, PoseProvider* provid
             zmpseq[frame] = *zmp;
             isZmpValid = true;
         }
+    }
+
+    return isZmpValid;
+}
+
+}
+
+
+bool PoseProviderToBodyMotionConverter::convert(Body* body, PoseProvider* provider, BodyMotion& motion)
+{
+    const double frameRate = motion.frameRate();
+    const int beginningFrame = static_cast<int>(frameRate * std::max(provider->beginningTime(), lowerTime));
+    const int endingFrame = static_cast<int>(frameRate * std::min(provider->endingTime(), upperTime));
+    const int numLinksToPut = (allLinkPositionOutputMode ? body->numLinks() : 1);
+    
+    motion.setDimension(endingFrame + 1, body->numJoints(), numLinksToPut, true);
+
+    return convertFrames(body, provider, motion, beginningFrame, endingFrame, numLinksToPut);
+}
+
+
+bool PoseProviderToBodyMotionConverter::update
+(Body* body, PoseProvider* provider, BodyMotion& motion, double lower, double upper)
+{
+    const double frameRate = motion.frameRate();
+    const int numJoints = body->numJoints();
+    const int numLinksToPut = (allLinkPositionOutputMode ? body->numLinks() : 1);
+    const int prevNumFrames = motion.numFrames();
 
+    if(prevNumFrames == 0 || motion.numJoints() != numJoints || motion.numLinks() != numLinksToPut){
+        return convert(body, provider, motion);
     }
+    
+    const int minFrame = static_cast<int>(frameRate * std::max(provider->beginningTime(), lowerTime));
+    const int endingFrame = static_cast<int>(frameRate * std::min(provider->endingTime(), upperTime));
+
+    int beginningFrame = std::max(minFrame, static_cast<int>(floor(frameRate * lower)));
+    int lastFrame = std::min(endingFrame, static_cast<int>(ceil(frameRate * upper)));
+    if(endingFrame >= prevNumFrames){
+        beginningFrame = std::min(beginningFrame, prevNumFrames);
+        lastFrame = endingFrame;
+    }
+
+    motion.setDimension(endingFrame + 1, numJoints, numLinksToPut, true);
+
+    if(beginningFrame > lastFrame){
+        return true;
+    }
+    
+    return convertFrames(body, provider, motion, beginningFrame, lastFrame, numLinksToPut);
+}
 
+
+bool PoseProviderToBodyMotionConverter::convertFrames
+(Body* body, PoseProvider* provider, BodyMotion& motion, int beginningFrame, int endingFrame, int numLinksToPut)
+{
+    const int numJoints = body->numJoints();
+    Link* rootLink = body->rootLink();
+
+    // store the original state
+    vector<double> orgq(numJoints);
+    for(int i=0; i < numJoints; ++i){
+        orgq[i] = body->joint(i)->q();
+    }
+    Vector3 p0 = rootLink->p();
+    Matrix3 R0 = rootLink->R();
+
+    getOrCreateZMPSeq(motion);
+
+    const int numFrames = endingFrame - beginningFrame + 1;
+    int numThreads = std::min(static_cast<int>(std::thread::hardware_concurrency()), numFrames / MinNumFramesPerThread);
+
+    // Each thread except the current one uses the clones of the body and the provider
+    vector<BodyPtr> bodies;
+    vector<unique_ptr<PoseProvider>> providers;
+    for(int i=1; i < numThreads; ++i){
+        unique_ptr<PoseProvider> clonedProvider(provider->clone());
+        if(!clonedProvider){
+            break;
+        }
+        bodies.push_back(body->clone());
+        providers.push_back(std::move(clonedProvider));
+    }
+    numThreads = providers.size() + 1;
+
+    bool isZmpValid = false;
+
+    if(numThreads == 1){
+        isZmpValid = convertFrameRange(
+            body, provider, motion, beginningFrame, endingFrame, numLinksToPut, allLinkPositionOutputMode);
+
+    } else {
+        vector<char> zmpValidities(numThreads, false);
+        ThreadPool threadPool(numThreads - 1);
+        for(int i=1; i < numThreads; ++i){
+            const int frame0 = beginningFrame + static_cast<int>(static_cast<int64_t>(numFrames) * i / numThreads);
+            const int frame1 = beginningFrame + static_cast<int>(static_cast<int64_t>(numFrames) * (i + 1) / numThreads) - 1;
+            threadPool.start(
+                [&, i, frame0, frame1](){
+                    zmpValidities[i] = convertFrameRange(
+                        bodies[i-1], providers[i-1].get(), motion, frame0, frame1,
+                        numLinksToPut, allLinkPositionOutputMode);
+                });
+        }
+        const int frame1 = beginningFrame + numFrames / numThreads - 1;
+        zmpValidities[0] = convertFrameRange(
+            body, provider, motion, beginningFrame, frame1, numLinksToPut, allLinkPositionOutputMode);
+        threadPool.wait();
+
+        for(auto valid : zmpValidities){
+            if(valid){
+                isZmpValid = true;
+            }
+        }
+    }
+    
     if(!isZmpValid){
         //bodyMotionItem->clearRelativeZmpSeq();
     }
@@ -22,10 +22,21 @@ public:
     void setAllLinkPositionOutput(bool on);
     bool convert(Body* body, PoseProvider* provider, BodyMotion& motion);
 
+    /**
+       Regenerate the frames in the given time range and keep the other frames of the motion.
+       The number of frames is adjusted to the ending time of the provider and the appended
+       frames are also generated. The whole motion is generated if the dimension of the existing
+       motion does not match the body.
+    */
+    bool update(Body* body, PoseProvider* provider, BodyMotion& motion, double lower, double upper);
+
 private:
     double lowerTime;
     double upperTime;
     bool allLinkPositionOutputMode;
+
+    bool convertFrames(
+        Body* body, PoseProvider* provider, BodyMotion& motion, int beginningFrame, int endingFrame, int numLinksToPut);
 };
 
 }
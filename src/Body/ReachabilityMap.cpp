@@ -0,0 +1,121 @@
+#include "ReachabilityMap.h"
+#include "BatchInverseKinematics.h"
+#include "Link.h"
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+// The targets are solved in chunks to limit the memory used for the solutions
+constexpr int MaxNumTargetsInChunk = 4096;
+
+}
+
+
+ReachabilityMap::ReachabilityMap()
+    : lower_(Vector3::Zero()),
+      voxelSize_(0.0),
+      resolution_(Vector3i::Zero())
+{
+
+}
+
+
+void ReachabilityMap::setRegion(const Vector3& lower, const Vector3& upper, double voxelSize)
+{
+    lower_ = lower;
+    voxelSize_ = voxelSize;
+    if(voxelSize > 0.0){
+        for(int i=0; i < 3; ++i){
+            resolution_[i] = std::max(0, static_cast<int>(std::ceil((upper[i] - lower[i]) / voxelSize)));
+        }
+    } else {
+        resolution_.setZero();
+    }
+    values_.clear();
+}
+
+
+void ReachabilityMap::setEndOrientations(const std::vector<Matrix3>& orientations)
+{
+    endOrientations = orientations;
+}
+
+
+bool ReachabilityMap::build(BatchInverseKinematics& ik)
+{
+    const int numVoxels = resolution_.x() * resolution_.y() * resolution_.z();
+    if(numVoxels == 0){
+        values_.clear();
+        return false;
+    }
+    values_.assign(numVoxels, 0.0f);
+
+    vector<Matrix3> orientations = endOrientations;
+    if(orientations.empty()){
+        orientations.push_back(ik.endLink()->R());
+    }
+    const int numOrientations = orientations.size();
+
+    vector<Position> targets;
+    targets.reserve(MaxNumTargetsInChunk);
+    vector<BatchInverseKinematics::Solution> solutions;
+    vector<int> targetVoxelIndices;
+    targetVoxelIndices.reserve(MaxNumTargetsInChunk);
+
+    auto solveChunk = [&](){
+        ik.solve(targets, solutions);
+        for(size_t i=0; i < solutions.size(); ++i){
+            if(solutions[i].isSolved){
+                values_[targetVoxelIndices[i]] += 1.0f;
+            }
+        }
+        targets.clear();
+        targetVoxelIndices.clear();
+    };
+
+    for(int iz=0; iz < resolution_.z(); ++iz){
+        for(int iy=0; iy < resolution_.y(); ++iy){
+            for(int ix=0; ix < resolution_.x(); ++ix){
+                const int index = voxelIndex(ix, iy, iz);
+                Position T;
+                T.translation() = voxelCenter(ix, iy, iz);
+                for(auto& R : orientations){
+                    T.linear() = R;
+                    targets.push_back(ik.targetFromGlobalEndPosition(T));
+                    targetVoxelIndices.push_back(index);
+                    if(static_cast<int>(targets.size()) == MaxNumTargetsInChunk){
+                        solveChunk();
+                    }
+                }
+            }
+        }
+    }
+    if(!targets.empty()){
+        solveChunk();
+    }
+
+    for(auto& value : values_){
+        value /= numOrientations;
+    }
+
+    return true;
+}
+
+
+float ReachabilityMap::reachability(const Vector3& p) const
+{
+    if(values_.empty() || voxelSize_ <= 0.0){
+        return 0.0f;
+    }
+    int v[3];
+    for(int i=0; i < 3; ++i){
+        v[i] = static_cast<int>(std::floor((p[i] - lower_[i]) / voxelSize_));
+        if(v[i] < 0 || v[i] >= resolution_[i]){
+            return 0.0f;
+        }
+    }
+    return reachability(v[0], v[1], v[2]);
+}
@@ -0,0 +1,61 @@
+#ifndef CNOID_BODY_REACHABILITY_MAP_H
+#define CNOID_BODY_REACHABILITY_MAP_H
+
+#include <cnoid/EigenTypes>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class BatchInverseKinematics;
+
+/**
+   A voxel map of the reachability of the end link of a joint path.
+   The value of each voxel is the ratio of the end link orientations that the IK is solved
+   for at the center of the voxel.
+   The region and the orientations are given for the origin of the end link in the global
+   coordinate system even if the IK is constructed with a kit, in which case they are converted
+   into the frames of the kit when the map is built.
+*/
+class CNOID_EXPORT ReachabilityMap
+{
+public:
+    ReachabilityMap();
+
+    void setRegion(const Vector3& lower, const Vector3& upper, double voxelSize);
+
+    //! The current global orientation of the end link is used if no orientation is given.
+    void setEndOrientations(const std::vector<Matrix3>& orientations);
+
+    bool build(BatchInverseKinematics& ik);
+
+    const Vector3& lower() const { return lower_; }
+    double voxelSize() const { return voxelSize_; }
+    const Vector3i& resolution() const { return resolution_; }
+    int numVoxels() const { return values_.size(); }
+
+    int voxelIndex(int ix, int iy, int iz) const {
+        return ix + resolution_.x() * (iy + resolution_.y() * iz);
+    }
+    Vector3 voxelCenter(int ix, int iy, int iz) const {
+        return lower_ + voxelSize_ * Vector3(ix + 0.5, iy + 0.5, iz + 0.5);
+    }
+    float reachability(int ix, int iy, int iz) const {
+        return values_[voxelIndex(ix, iy, iz)];
+    }
+    //! Zero is returned for the position outside the region.
+    float reachability(const Vector3& p) const;
+
+    const std::vector<float>& reachabilities() const { return values_; }
+
+private:
+    Vector3 lower_;
+    double voxelSize_;
+    Vector3i resolution_;
+    std::vector<Matrix3> endOrientations;
+    std::vector<float> values_;
+};
+
+}
+
+#endif
@@ -0,0 +1,264 @@
+#include "SimulationCheckpoint.h"
+#include "Body.h"
+#include <cnoid/stdx/filesystem>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+
+using namespace std;
+using namespace cnoid;
+namespace filesystem = cnoid::stdx::filesystem;
+
+namespace {
+
+const char checkpointFileMagic[8] = { 'C', 'N', 'O', 'I', 'D', 'S', 'C', 'P' };
+const uint32_t checkpointFileVersion = 2;
+
+// R, p, v, w, dv, dw, F_ext, q, dq, ddq, u, q_target, dq_target
+constexpr int NumLinkStateElements = 9 + 3 * 5 + 6 + 6;
+
+// index, name size, link state size, device state size and the number of controllers
+constexpr size_t MinBodyDataSize = 5 * 4;
+// name size and data size
+constexpr size_t MinControllerDataSize = 2 * 4;
+
+template<class T>
+void writeValue(ofstream& os, const T& value)
+{
+    os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+
+template<class T>
+void writeArray(ofstream& os, const vector<T>& values)
+{
+    const uint32_t size = values.size();
+    writeValue(os, size);
+    os.write(reinterpret_cast<const char*>(values.data()), sizeof(T) * size);
+}
+
+
+void writeString(ofstream& os, const string& str)
+{
+    const uint32_t size = str.size();
+    writeValue(os, size);
+    os.write(str.data(), size);
+}
+
+
+/**
+   The sizes in the file are checked against the remaining length of the file before the
+   memory is allocated so that a broken file does not cause a huge allocation.
+*/
+class CheckpointReader
+{
+public:
+    ifstream is;
+    uint64_t remainingSize;
+
+    CheckpointReader(const string& filename)
+        : is(filename, ios::binary),
+          remainingSize(0)
+    {
+        if(is){
+            is.seekg(0, ios::end);
+            auto size = is.tellg();
+            is.seekg(0, ios::beg);
+            if(size > 0){
+                remainingSize = size;
+            }
+        }
+    }
+
+    bool read(char* buf, uint64_t size){
+        if(size > remainingSize){
+            return false;
+        }
+        is.read(buf, size);
+        remainingSize -= size;
+        return !is.fail();
+    }
+
+    template<class T>
+    bool readValue(T& out_value){
+        return read(reinterpret_cast<char*>(&out_value), sizeof(T));
+    }
+
+    bool readCount(uint32_t& out_count, size_t minElementSize){
+        return readValue(out_count) && out_count * static_cast<uint64_t>(minElementSize) <= remainingSize;
+    }
+
+    template<class T>
+    bool readArray(vector<T>& out_values){
+        uint32_t size;
+        if(!readCount(size, sizeof(T))){
+            return false;
+        }
+        out_values.resize(size);
+        return read(reinterpret_cast<char*>(out_values.data()), sizeof(T) * static_cast<uint64_t>(size));
+    }
+
+    bool readString(string& out_str){
+        uint32_t size;
+        if(!readCount(size, 1)){
+            return false;
+        }
+        out_str.resize(size);
+        return read(&out_str[0], size);
+    }
+};
+
+}
+
+
+SimulationCheckpoint::SimulationCheckpoint()
+    : frame(0),
+      timeStep(0.0),
+      hasEngineData(false)
+{
+
+}
+
+
+bool SimulationCheckpoint::write(const std::string& filename) const
+{
+    filesystem::path path(filename);
+    filesystem::path tmpPath(path);
+    tmpPath += ".tmp";
+    {
+        ofstream os(tmpPath.string(), ios::binary);
+        if(!os){
+            return false;
+        }
+        os.write(checkpointFileMagic, sizeof(checkpointFileMagic));
+        writeValue(os, checkpointFileVersion);
+        writeValue(os, static_cast<int32_t>(frame));
+        writeValue(os, timeStep);
+        writeValue(os, static_cast<uint32_t>(bodies.size()));
+        for(auto& body : bodies){
+            writeValue(os, static_cast<int32_t>(body.index));
+            writeString(os, body.name);
+            writeArray(os, body.linkStates);
+            writeArray(os, body.deviceStates);
+            writeValue(os, static_cast<uint32_t>(body.controllerData.size()));
+            for(auto& data : body.controllerData){
+                writeString(os, data.first);
+                writeArray(os, data.second);
+            }
+        }
+        writeValue(os, static_cast<uint8_t>(hasEngineData));
+        writeArray(os, engineData);
+        if(!os){
+            return false;
+        }
+    }
+    try {
+        filesystem::rename(tmpPath, path);
+    }
+    catch(const filesystem::filesystem_error&){
+        filesystem::remove(tmpPath);
+        return false;
+    }
+    return true;
+}
+
+
+bool SimulationCheckpoint::read(const std::string& filename)
+{
+    CheckpointReader reader(filename);
+    if(!reader.is){
+        return false;
+    }
+    char magic[8];
+    uint32_t version;
+    if(!reader.read(magic, sizeof(magic)) || !reader.readValue(version) ||
+       memcmp(magic, checkpointFileMagic, sizeof(magic)) != 0 || version != checkpointFileVersion){
+        return false;
+    }
+    int32_t frame;
+    uint32_t numBodies;
+    if(!reader.readValue(frame) ||
+       !reader.readValue(timeStep) ||
+       !reader.readCount(numBodies, MinBodyDataSize)){
+        return false;
+    }
+    this->frame = frame;
+    bodies.resize(numBodies);
+    for(auto& body : bodies){
+        int32_t index;
+        uint32_t numControllers;
+        if(!reader.readValue(index) ||
+           !reader.readString(body.name) ||
+           !reader.readArray(body.linkStates) ||
+           !reader.readArray(body.deviceStates) ||
+           !reader.readCount(numControllers, MinControllerDataSize)){
+            return false;
+        }
+        body.index = index;
+        body.controllerData.resize(numControllers);
+        for(auto& data : body.controllerData){
+            if(!reader.readString(data.first) || !reader.readArray(data.second)){
+                return false;
+            }
+        }
+    }
+    uint8_t hasEngineData;
+    if(!reader.readValue(hasEngineData) || !reader.readArray(engineData)){
+        return false;
+    }
+    this->hasEngineData = hasEngineData;
+    return true;
+}
+
+
+void SimulationCheckpoint::storeLinkStates(const Body* body, std::vector<double>& out_states)
+{
+    const int numLinks = body->numLinks();
+    out_states.resize(numLinks * NumLinkStateElements);
+    double* buf = out_states.data();
+    for(int i=0; i < numLinks; ++i){
+        Link* link = body->link(i);
+        Matrix3::Map(buf) = link->R();
+        Vector3::Map(buf + 9) = link->p();
+        Vector3::Map(buf + 12) = link->v();
+        Vector3::Map(buf + 15) = link->w();
+        Vector3::Map(buf + 18) = link->dv();
+        Vector3::Map(buf + 21) = link->dw();
+        Vector6::Map(buf + 24) = link->F_ext();
+        buf[30] = link->q();
+        buf[31] = link->dq();
+        buf[32] = link->ddq();
+        buf[33] = link->u();
+        buf[34] = link->q_target();
+        buf[35] = link->dq_target();
+        buf += NumLinkStateElements;
+    }
+}
+
+
+bool SimulationCheckpoint::restoreLinkStates(Body* body, const std::vector<double>& states)
+{
+    const int numLinks = body->numLinks();
+    if(static_cast<int>(states.size()) != numLinks * NumLinkStateElements){
+        return false;
+    }
+    const double* buf = states.data();
+    for(int i=0; i < numLinks; ++i){
+        Link* link = body->link(i);
+        link->R() = Matrix3::Map(buf);
+        link->p() = Vector3::Map(buf + 9);
+        link->v() = Vector3::Map(buf + 12);
+        link->w() = Vector3::Map(buf + 15);
+        link->dv() = Vector3::Map(buf + 18);
+        link->dw() = Vector3::Map(buf + 21);
+        link->F_ext() = Vector6::Map(buf + 24);
+        link->q() = buf[30];
+        link->dq() = buf[31];
+        link->ddq() = buf[32];
+        link->u() = buf[33];
+        link->q_target() = buf[34];
+        link->dq_target() = buf[35];
+        buf += NumLinkStateElements;
+    }
+    return true;
+}
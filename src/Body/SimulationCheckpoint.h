@@ -0,0 +1,55 @@
+#ifndef CNOID_BODY_SIMULATION_CHECKPOINT_H
+#define CNOID_BODY_SIMULATION_CHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+
+/**
+   The state of a simulation which is written to a checkpoint file to resume the simulation later.
+*/
+class CNOID_EXPORT SimulationCheckpoint
+{
+public:
+    SimulationCheckpoint();
+
+    int frame;
+    double timeStep;
+
+    struct BodyData
+    {
+        // The index in the simulation bodies
+        int index;
+        std::string name;
+        std::vector<double> linkStates;
+        std::vector<double> deviceStates;
+        std::vector<std::pair<std::string, std::vector<char>>> controllerData;
+    };
+    // The data of all the simulation bodies including the ones without a body
+    std::vector<BodyData> bodies;
+
+    bool hasEngineData;
+    std::vector<double> engineData;
+
+    /**
+       The checkpoint is written to a temporary file first so that the existing file is kept
+       if the process is terminated while writing.
+    */
+    bool write(const std::string& filename) const;
+
+    //! False is returned if the file is not a valid checkpoint file or it is truncated.
+    bool read(const std::string& filename);
+
+    //! The positions, velocities, accelerations, forces and joint states of all the links
+    static void storeLinkStates(const Body* body, std::vector<double>& out_states);
+    static bool restoreLinkStates(Body* body, const std::vector<double>& states);
+};
+
+}
+
+#endif
@@ -14,6 +14,35 @@ using namespace std;
 using namespace cnoid;
 namespace py = pybind11;
 
+namespace {
+
+/*
+  The joint states are stored in each Link object and are not contiguous in memory,
+  so they are gathered into or scattered from a NumPy array in a single call.
+*/
+VectorX getJointStates(const Body& body, double& (Link::*state)())
+{
+    const int n = body.numJoints();
+    VectorX values(n);
+    for(int i=0; i < n; ++i){
+        values[i] = (body.joint(i)->*state)();
+    }
+    return values;
+}
+
+void setJointStates(Body& body, double& (Link::*state)(), Eigen::Ref<const VectorX> values)
+{
+    const int n = body.numJoints();
+    if(values.size() != n){
+        throw py::value_error("The size of the array must be the number of joints");
+    }
+    for(int i=0; i < n; ++i){
+        (body.joint(i)->*state)() = values[i];
+    }
+}
+
+}
+
 namespace cnoid {
 
 void exportPyBody(py::module& m)
@@ -56,6 +85,18 @@ void exportPyBody(py::module& m)
              joints.resize(self.numJoints());
              return joints; })
         .def_property_readonly("allJoints", &Body::allJoints)
+        .def_property("jointPositions",
+                      [](Body& self){ return getJointStates(self, &Link::q); },
+                      [](Body& self, Eigen::Ref<const VectorX> q){ setJointStates(self, &Link::q, q); })
+        .def_property("jointVelocities",
+                      [](Body& self){ return getJointStates(self, &Link::dq); },
+                      [](Body& self, Eigen::Ref<const VectorX> dq){ setJointStates(self, &Link::dq, dq); })
+        .def_property("jointAccelerations",
+                      [](Body& self){ return getJointStates(self, &Link::ddq); },
+                      [](Body& self, Eigen::Ref<const VectorX> ddq){ setJointStates(self, &Link::ddq, ddq); })
+        .def_property("jointEfforts",
+                      [](Body& self){ return getJointStates(self, &Link::u); },
+                      [](Body& self, Eigen::Ref<const VectorX> u){ setJointStates(self, &Link::u, u); })
         .def_property_readonly("numDevices", &Body::numDevices)
         .def("device", &Body::device)
         .def("findDevice", [](Body& self, const string& name){ return self.findDevice(name); })
@@ -53,6 +53,9 @@ public:
     KinematicWalkBody(DyBody* body, LeggedBodyHelper* legged)
         : AISTSimBody(body),
           legged(legged) {
+        initializeSupportFoot();
+    }
+    void initializeSupportFoot() {
         supportFootIndex = 0;
         for(int i=1; i < legged->numFeet(); ++i){
             if(legged->footLink(i)->p().z() < legged->footLink(supportFootIndex)->p().z()){
@@ -111,6 +114,9 @@ public:
     AISTSimulatorItemImpl(AISTSimulatorItem* self);
     AISTSimulatorItemImpl(AISTSimulatorItem* self, const AISTSimulatorItemImpl& org);
     bool initializeSimulation(const std::vector<SimulationBody*>& simBodies);
+    bool resetSimulationState(const std::vector<SimulationBody*>& simBodies);
+    void initializeSupportFeet(const std::vector<SimulationBody*>& simBodies);
+    bool restoreCheckpointData(const std::vector<double>& data);
     void addBody(AISTSimBody* simBody);
     void clearExternalForces();
     void stepKinematicsSimulation(const std::vector<SimulationBody*>& activeSimBodies);
@@ -462,6 +468,67 @@ bool AISTSimulatorItemImpl::initializeSimulation(const std::vector<SimulationBod
 }
 
 
+bool AISTSimulatorItem::resetSimulationState(const std::vector<SimulationBody*>& simBodies)
+{
+    return impl->resetSimulationState(simBodies);
+}
+
+
+/**
+   The bodies and the collision models registered in the world are reused, and only the states
+   of the forward dynamics and the constraint force solver are re-initialized.
+*/
+bool AISTSimulatorItemImpl::resetSimulationState(const std::vector<SimulationBody*>& simBodies)
+{
+    initializeSupportFeet(simBodies);
+    world.resetState();
+    return true;
+}
+
+
+void AISTSimulatorItemImpl::initializeSupportFeet(const std::vector<SimulationBody*>& simBodies)
+{
+    if(isKinematicWalkingEnabled){
+        for(auto& simBody : simBodies){
+            if(auto walkBody = dynamic_cast<KinematicWalkBody*>(simBody)){
+                walkBody->initializeSupportFoot();
+            }
+        }
+    }
+}
+
+
+bool AISTSimulatorItem::storeCheckpointData(std::vector<double>& out_data)
+{
+    out_data.resize(impl->world.stateSize());
+    impl->world.writeState(out_data.data());
+    return true;
+}
+
+
+bool AISTSimulatorItem::restoreCheckpointData(const std::vector<double>& data)
+{
+    return impl->restoreCheckpointData(data);
+}
+
+
+/**
+   The spatial velocities of the root links and the previous solution of the constraint forces are
+   restored so that the simulation continues in the same way as it did when the checkpoint was taken.
+*/
+bool AISTSimulatorItemImpl::restoreCheckpointData(const std::vector<double>& data)
+{
+    // The minimum size of the state of the world with the constraint force solver
+    if(static_cast<int>(data.size()) < world.numBodies() * 6 + 5){
+        return false;
+    }
+    initializeSupportFeet(self->simulationBodies());
+    const double* end = world.readState(data.data());
+    world.setCurrentTime(self->currentTime());
+    return end == data.data() + data.size();
+}
+
+
 void AISTSimulatorItemImpl::addBody(AISTSimBody* simBody)
 {
     DyBody* body = static_cast<DyBody*>(simBody->body());
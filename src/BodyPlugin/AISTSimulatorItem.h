@@ -70,6 +70,9 @@ protected:
     virtual SimulationBody* createSimulationBody(Body* orgBody, CloneMap& cloneMap) override;
     virtual bool initializeSimulation(const std::vector<SimulationBody*>& simBodies) override;
     virtual bool stepSimulation(const std::vector<SimulationBody*>& activeSimBodies) override;
+    virtual bool resetSimulationState(const std::vector<SimulationBody*>& simBodies) override;
+    virtual bool storeCheckpointData(std::vector<double>& out_data) override;
+    virtual bool restoreCheckpointData(const std::vector<double>& data) override;
     virtual void finalizeSimulation() override;
     virtual std::shared_ptr<CollisionLinkPairList> getCollisions() override;
         
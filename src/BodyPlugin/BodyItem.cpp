@@ -21,6 +21,7 @@
 #include <cnoid/TimeBar>
 #include <cnoid/ItemManager>
 #include <cnoid/ItemFileIO>  
+#include <cnoid/ItemTreeArchiver>
 #include <cnoid/SceneItemFileIO>
 #include <cnoid/OptionManager>
 #include <cnoid/MenuManager>
@@ -40,6 +41,10 @@
 #include <fmt/format.h>
 #include <bitset>
 #include <deque>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <sstream>
 #include <iostream>
 #include <algorithm>
 #include "gettext.h"
@@ -202,6 +207,93 @@ public:
 
 namespace {
 
+/**
+   Keeps the bodies loaded by the worker threads of ItemTreeArchiver while a project is restored.
+   Each body is passed to the first item that loads the file, and the other items loading the
+   same file load it by themselves.
+*/
+class BodyFilePrefetcher
+{
+    struct Entry
+    {
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool isLoaded;
+        BodyPtr body;
+        string message;
+        Entry() : isLoaded(false) { }
+    };
+    typedef shared_ptr<Entry> EntryPtr;
+
+    std::mutex mutex;
+    // A null entry means that the file has already been loaded by an item
+    map<string, EntryPtr> entries;
+
+public:
+    //! This is called in the main thread and the returned function is executed by a worker thread
+    std::function<void()> prefetch(const std::string& filename)
+    {
+        auto entry = make_shared<Entry>();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto inserted = entries.emplace(filename, entry);
+            if(!inserted.second){
+                return nullptr;
+            }
+        }
+        return [entry, filename](){ load(entry, filename); };
+    }
+
+    static void load(EntryPtr entry, const std::string& filename)
+    {
+        BodyLoader bodyLoader;
+        ostringstream os;
+        bodyLoader.setMessageSink(os);
+        BodyPtr body = new Body;
+        if(!bodyLoader.load(body, filename)){
+            body.reset();
+        }
+        {
+            std::lock_guard<std::mutex> lock(entry->mutex);
+            entry->body = body;
+            entry->message = os.str();
+            entry->isLoaded = true;
+        }
+        entry->condition.notify_all();
+    }
+
+    BodyPtr take(const std::string& filename, std::string& out_message)
+    {
+        EntryPtr entry;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto p = entries.find(filename);
+            if(p == entries.end()){
+                return nullptr;
+            }
+            entry.swap(p->second);
+        }
+        if(!entry){
+            return nullptr;
+        }
+        std::unique_lock<std::mutex> lock(entry->mutex);
+        while(!entry->isLoaded){
+            entry->condition.wait(lock);
+        }
+        out_message = entry->message;
+        return entry->body;
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+    }
+};
+
+BodyFilePrefetcher bodyFilePrefetcher;
+
+
 class BodyFileIO : public ItemFileIOBase<BodyItem>
 {
     BodyLoader bodyLoader;
@@ -220,9 +312,16 @@ public:
 
     virtual bool load(BodyItem* item, const std::string& filename) override
     {
-        BodyPtr newBody = new Body;
-        if(!bodyLoader.load(newBody, filename)){
-            return false;
+        string message;
+        BodyPtr newBody = bodyFilePrefetcher.take(filename, message);
+        if(newBody){
+            os() << message;
+        } else {
+            // The file is loaded again to report the errors if the prefetch failed
+            newBody = new Body;
+            if(!bodyLoader.load(newBody, filename)){
+                return false;
+            }
         }
         item->setBody(newBody);
 
@@ -313,6 +412,11 @@ void BodyItem::initializeClass(ExtensionManager* ext)
     ::meshFileIO = new SceneFileIO;
     im.registerFileIO<BodyItem>(::meshFileIO);
 
+    ItemTreeArchiver::registerFilePrefetcher(
+        "Body", "BodyItem",
+        [](const std::string& filename){ return bodyFilePrefetcher.prefetch(filename); },
+        [](){ bodyFilePrefetcher.clear(); });
+
     OptionManager& om = ext->optionManager();
     om.addOption("body", boost::program_options::value< vector<string> >(), "load a body file");
     om.sigOptionsParsed().connect(onSigOptionsParsed);
@@ -30,6 +30,7 @@
 #include "BodySelectionManager.h"
 #include "KinematicFaultChecker.h"
 #include "SplineFilterDialog.h"
+#include "SimulationBatchRunner.h"
 #include "LinkDeviceListView.h"
 #include "LinkPositionView.h"
 #include "LinkPropertyView.h"
@@ -121,6 +122,7 @@ public:
         EditableSceneBody::initializeClass(this);
 
         SimulationBar::initialize(this);
+        initializeSimulationBatchRunner(this);
         addToolBar(BodyBar::instance());
         addToolBar(LeggedBodyBar::instance());
         addToolBar(KinematicsBar::instance());
@@ -88,6 +88,18 @@ void ControllerItem::stop()
 }
 
 
+bool ControllerItem::storeCheckpointData(std::vector<char>& /* out_data */)
+{
+    return false;
+}
+
+
+bool ControllerItem::restoreCheckpointData(const std::vector<char>& /* data */)
+{
+    return false;
+}
+
+
 void ControllerItem::onOptionsChanged()
 {
 
@@ -74,6 +74,16 @@ public:
     */
     virtual void stop();
 
+    /**
+       These functions are called to write the internal state of the controller into a simulation
+       checkpoint and to restore it when the simulation is resumed from the checkpoint. The data is
+       opaque to the simulator. The default implementations do nothing and return false.
+       \note storeCheckpointData is called from the simulation thread between the steps, and
+       restoreCheckpointData is called from the main thread after start() is called.
+    */
+    virtual bool storeCheckpointData(std::vector<char>& out_data);
+    virtual bool restoreCheckpointData(const std::vector<char>& data);
+
     //! \deprecated Use isNoDelayMode.
     bool isImmediateMode() const { return isNoDelayMode(); }
     //! \deprecated Use setsNoDelayMode.
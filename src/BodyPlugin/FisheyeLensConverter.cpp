@@ -4,6 +4,11 @@
 */
 
 #include "FisheyeLensConverter.h"
+#include <cnoid/ThreadPool>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include <cmath>
 #include <iostream>
 
@@ -14,11 +19,24 @@ namespace {
 
 static const bool DEBUG_MESSAGE2 = false;
 
+constexpr int WeightBits = 14;
+constexpr int WeightScale = 1 << WeightBits;
+
 int clamp(int i, int min, int max)
 {
     return i < min ? min : i < max ? i : max - 1;
 }
 
+/**
+   The thread pool shared by all the converters. The calling thread also converts a part
+   of the image, so the pool has one thread less than the hardware concurrency.
+*/
+ThreadPool* getSharedThreadPool()
+{
+    static ThreadPool threadPool(std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1));
+    return &threadPool;
+}
+
 }
 
 
@@ -26,6 +44,7 @@ FisheyeLensConverter::FisheyeLensConverter()
 {
     isImageRotationEnabled = false;
     isAntiAliasingEnabled = false;
+    numThreads = 1;
 }
 
 
@@ -36,8 +55,8 @@ void FisheyeLensConverter::initialize(int width_, int height_, double fov_, int
     height = height_;
     fov = fov_;
     screenWidth = screenWidth_;
-    fisheyeLensMap.clear();
-    fisheyeLensInterpolationMap.clear();
+    pixelSources.clear();
+    interpolatedPixelSources.clear();
 
     screenImages.clear();
 }
@@ -52,8 +71,8 @@ void FisheyeLensConverter::addScreenImage(std::shared_ptr<Image> image)
 void FisheyeLensConverter::setImageRotationEnabled(bool on)
 {
     if(on != isImageRotationEnabled){
-        fisheyeLensMap.clear();
-        fisheyeLensInterpolationMap.clear();
+        pixelSources.clear();
+        interpolatedPixelSources.clear();
         isImageRotationEnabled = on;
     }
 }
@@ -65,6 +84,16 @@ void FisheyeLensConverter::setAntiAliasingEnabled(bool on)
 }
 
 
+/**
+   The rows of the converted image are divided into the given number of blocks, which are
+   converted in parallel by the calling thread and the thread pool shared by the converters.
+*/
+void FisheyeLensConverter::setNumThreads(int n)
+{
+    numThreads = std::max(1, n);
+}
+
+
 void FisheyeLensConverter::setCornerPoint(int i, Corner corner)
 {
     switch(corner){
@@ -197,26 +226,113 @@ void FisheyeLensConverter::setHorizontalBorder(int id0, int id1, double sx)
 }
 
 
-void  FisheyeLensConverter::convertImage(Image* image)
+/**
+   The source pixels of each converted pixel only depend on the image sizes and the field
+   of view, so the map of them is created at the first conversion and the following
+   conversions only gather the pixels of the screen images.
+*/
+void FisheyeLensConverter::convertImage(Image* image)
 {
     if(!isAntiAliasingEnabled){
-        convertImageWithoutAntiAliasing(image);
+        updatePixelSourceMap();
     } else {
-        convertImageWithAntiAliasing(image);
+        updateInterpolatedPixelSourceMap();
     }
+
+    image->setSize(width, height, 3);
+
+    const int numScreens = screenImages.size();
+    for(int i=0; i < numScreens; ++i){
+        screenPixels[i] = screenImages[i]->pixels();
+    }
+
+    if(numThreads == 1 || height < numThreads){
+        convertRows(image, 0, height);
+        return;
+    }
+
+    /*
+      The shared pool may be used by the converters of other cameras at the same time,
+      so the completion of the tasks of this conversion is counted instead of waiting
+      for the pool to be idle.
+    */
+    const int numBlocks = numThreads;
+    std::atomic<int> nextBlock(0);
+    auto convertBlocks = [&](){
+        int block;
+        while((block = nextBlock++) < numBlocks){
+            convertRows(image, height * block / numBlocks, height * (block + 1) / numBlocks);
+        }
+    };
+    const int numTasks = numThreads - 1;
+    int numFinishedTasks = 0;
+    std::mutex mutex;
+    std::condition_variable finished;
+    auto threadPool = getSharedThreadPool();
+    for(int i=0; i < numTasks; ++i){
+        threadPool->start([&](){
+            convertBlocks();
+            std::lock_guard<std::mutex> lock(mutex);
+            ++numFinishedTasks;
+            finished.notify_one();
+        });
+    }
+    convertBlocks();
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&](){ return numFinishedTasks == numTasks; });
 }
 
 
-void FisheyeLensConverter::convertImageWithoutAntiAliasing(Image* image)
+void FisheyeLensConverter::convertRows(Image* image, int beginRow, int endRow)
 {
-    image->setSize(width, height, 3);
-    unsigned char* pixels = image->pixels();
+    unsigned char* pix = image->pixels() + beginRow * width * 3;
+    const int begin = beginRow * width;
+    const int end = endRow * width;
 
-    if(fisheyeLensMap.empty()){
-        fisheyeLensMap.resize(height);
-        for(int i=0; i<height; i++){
-            fisheyeLensMap[i].resize(width);
+    if(!isAntiAliasingEnabled){
+        for(int i = begin; i < end; ++i){
+            const PixelSource& source = pixelSources[i];
+            if(source.screenId != NO_SCREEN){
+                const unsigned char* src = screenPixels[source.screenId] + source.offset;
+                pix[0] = src[0];
+                pix[1] = src[1];
+                pix[2] = src[2];
+            }else{
+                pix[0] = pix[1] = pix[2] = 0;
+            }
+            pix += 3;
         }
+    } else {
+        constexpr unsigned int half = 1 << (WeightBits - 1);
+        for(int i = begin; i < end; ++i){
+            const InterpolatedPixelSource& source = interpolatedPixelSources[i];
+            if(source.screenId[0] != NO_SCREEN){
+                unsigned int c0 = half;
+                unsigned int c1 = half;
+                unsigned int c2 = half;
+                for(int k=0; k<4; k++){
+                    const unsigned char* src = screenPixels[source.screenId[k]] + source.offset[k];
+                    const unsigned int w = source.weight[k];
+                    c0 += w * src[0];
+                    c1 += w * src[1];
+                    c2 += w * src[2];
+                }
+                pix[0] = c0 >> WeightBits;
+                pix[1] = c1 >> WeightBits;
+                pix[2] = c2 >> WeightBits;
+            }else{
+                pix[0] = pix[1] = pix[2] = 0;
+            }
+            pix += 3;
+        }
+    }
+}
+
+
+void FisheyeLensConverter::updatePixelSourceMap()
+{
+    if(pixelSources.empty()){
+        pixelSources.resize(width * height);
 
         double height2 = height/2.0;
         double screenWidth2 = screenWidth / 2.0;
@@ -372,35 +488,12 @@ void FisheyeLensConverter::convertImageWithoutAntiAliasing(Image* image)
                         j_ = i - height;
                     }
                 }
-                unsigned char* pix = &pixels[(i_+j_*width)*3];
+                PixelSource& source = pixelSources[i_ + j_ * width];
                 if(picked){
-                    unsigned char* tempPixels = screenImages[screenId]->pixels();
-                    unsigned char* tempPix = &tempPixels[(int)((ii + jj * screenWidth) * 3)];
-                    pix[0] = tempPix[0];
-                    pix[1] = tempPix[1];
-                    pix[2] = tempPix[2];
-                    fisheyeLensMap[j_][i_].screenId = screenId;
-                    fisheyeLensMap[j_][i_].ix = ii;
-                    fisheyeLensMap[j_][i_].iy = jj;
-                }else{
-                    pix[0] = pix[1] = pix[2] = 0;
-                    fisheyeLensMap[j_][i_].screenId = NO_SCREEN;
-                }
-            }
-        }
-    }else{
-        for(int j=0; j<height; j++){
-            for(int i=0; i<width; i++){
-                unsigned char* pix = &pixels[(i+j*width)*3];
-                ScreenIndex& screenIndex = fisheyeLensMap[j][i];
-                if(screenIndex.screenId != NO_SCREEN){
-                    unsigned char* tempPixels = screenImages[screenIndex.screenId]->pixels();
-                    unsigned char* tempPix = &tempPixels[(int)((screenIndex.ix + screenIndex.iy * screenWidth) * 3)];
-                    pix[0] = tempPix[0];
-                    pix[1] = tempPix[1];
-                    pix[2] = tempPix[2];
+                    source.screenId = screenId;
+                    source.offset = (ii + jj * screenWidth) * 3;
                 }else{
-                    pix[0] = pix[1] = pix[2] = 0;
+                    source.screenId = NO_SCREEN;
                 }
             }
         }
@@ -408,16 +501,10 @@ void FisheyeLensConverter::convertImageWithoutAntiAliasing(Image* image)
 }
 
 
-void  FisheyeLensConverter::convertImageWithAntiAliasing(Image* image)
+void FisheyeLensConverter::updateInterpolatedPixelSourceMap()
 {
-    image->setSize(width, height, 3);
-    unsigned char* pixels = image->pixels();
-
-    if(fisheyeLensInterpolationMap.empty()){
-        fisheyeLensInterpolationMap.resize(height);
-        for(int i=0; i<height; i++){
-            fisheyeLensInterpolationMap[i].resize(width);
-        }
+    if(interpolatedPixelSources.empty()){
+        interpolatedPixelSources.resize(width * height);
 
         double height2 = height/2.0;
         double screenWidth2 = screenWidth / 2.0;
@@ -845,8 +932,7 @@ void  FisheyeLensConverter::convertImageWithAntiAliasing(Image* image)
                         j_ = i - height;
                     }
                 }
-                unsigned char* pix = &pixels[(i_+j_*width)*3];
-                ScreenIndex4& map = fisheyeLensInterpolationMap[j_][i_];
+                InterpolatedPixelSource& source = interpolatedPixelSources[i_ + j_ * width];
                 if(picked){
                     double dx, dy;
                     if(sx<0){
@@ -864,46 +950,25 @@ void  FisheyeLensConverter::convertImageWithAntiAliasing(Image* image)
                     bias[1] = dx*(1.0-dy);
                     bias[2] = (1.0-dx)*dy;
                     bias[3] = dx*dy;
-                    double pixd[3] = {0.0,0.0,0.0};
+                    // The weights are stored as fixed point numbers whose sum is exactly one
+                    int weight[4];
+                    int sum = 0;
+                    int kmax = 0;
                     for(int k=0; k<4; k++){
-                        unsigned char* tempPixels = screenImages[screenId[k]]->pixels();
-                        unsigned char* tempPix = &tempPixels[(int)((npx[k] + npy[k] * screenWidth) * 3)];
-                        for(int kk=0; kk<3; kk++){
-                            pixd[kk] += bias[k] * tempPix[kk];
+                        weight[k] = nearbyint(bias[k] * WeightScale);
+                        sum += weight[k];
+                        if(weight[k] > weight[kmax]){
+                            kmax = k;
                         }
-                        map.screenIndex[k].screenId = screenId[k];
-                        map.screenIndex[k].ix = npx[k];
-                        map.screenIndex[k].iy = npy[k];
-                        map.bias[k] = bias[k];
                     }
-                    for(int kk=0; kk<3; kk++){
-                        pix[kk] = nearbyint(pixd[kk]);
-                    }
-                }else{
-                    pix[0] = pix[1] = pix[2] = 0;
-                    map.screenIndex[0].screenId = NO_SCREEN;
-                }
-            }
-        }
-    }else{
-        for(int j=0; j<height; j++){
-            for(int i=0; i<width; i++){
-                unsigned char* pix = &pixels[(i+j*width)*3];
-                ScreenIndex4& map = fisheyeLensInterpolationMap[j][i];
-                if(map.screenIndex[0].screenId != NO_SCREEN){
-                    double pixd[3] = {0.0,0.0,0.0};
+                    weight[kmax] += WeightScale - sum;
                     for(int k=0; k<4; k++){
-                        unsigned char* tempPixels = screenImages[map.screenIndex[k].screenId]->pixels();
-                        unsigned char* tempPix = &tempPixels[(int)((map.screenIndex[k].ix + map.screenIndex[k].iy * screenWidth) * 3)];
-                        for(int kk=0; kk<3; kk++){
-                            pixd[kk] += map.bias[k] * tempPix[kk];
-                        }
-                    }
-                    for(int kk=0; kk<3; kk++){
-                        pix[kk] = nearbyint(pixd[kk]);
+                        source.screenId[k] = screenId[k];
+                        source.offset[k] = (npx[k] + npy[k] * screenWidth) * 3;
+                        source.weight[k] = weight[k];
                     }
                 }else{
-                    pix[0] = pix[1] = pix[2] = 0;
+                    source.screenId[0] = NO_SCREEN;
                 }
             }
         }
@@ -24,6 +24,7 @@ public:
     void addScreenImage(std::shared_ptr<Image> image);
     void setImageRotationEnabled(bool on);
     void setAntiAliasingEnabled(bool on);
+    void setNumThreads(int n);
     void convertImage(Image* image);
 
 private:
@@ -36,21 +37,27 @@ private:
     bool isImageRotationEnabled;
     bool isAntiAliasingEnabled;
 
-    struct ScreenIndex{
+    // The source pixel of each pixel of the converted image
+    struct PixelSource {
         int screenId;
-        int ix;
-        int iy;
+        // The offset of the pixel data in the screen image
+        int offset;
     };
-    std::vector<std::vector<ScreenIndex>> fisheyeLensMap;
+    std::vector<PixelSource> pixelSources;
 
     // for Interpolation
     int screenId[4];
     int npx[4],npy[4];
-    struct ScreenIndex4 {
-        ScreenIndex screenIndex[4];
-        double bias[4];
+    struct InterpolatedPixelSource {
+        int offset[4];
+        // Fixed point weights
+        unsigned short weight[4];
+        signed char screenId[4];
     };
-    std::vector<std::vector<ScreenIndex4>> fisheyeLensInterpolationMap;
+    std::vector<InterpolatedPixelSource> interpolatedPixelSources;
+
+    const unsigned char* screenPixels[6];
+    int numThreads;
 
     enum Corner {
         FRONT_UR,  FRONT_UL,  FRONT_DR,  FRONT_DL,
@@ -66,8 +73,9 @@ private:
     void setCenter(int id, double sx, double sy);
     void setVerticalBorder(int id0, int id1, double sy);
     void setHorizontalBorder(int id0, int id1, double sx);
-    void convertImageWithoutAntiAliasing(Image* image);
-    void convertImageWithAntiAliasing(Image* image);
+    void updatePixelSourceMap();
+    void updateInterpolatedPixelSourceMap();
+    void convertRows(Image* image, int beginRow, int endRow);
 };
 
 }
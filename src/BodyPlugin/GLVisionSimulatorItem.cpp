@@ -35,6 +35,7 @@
 #include <fmt/format.h>
 #include <mutex>
 #include <condition_variable>
+#include <thread>
 #include <queue>
 #include <iostream>
 #include "gettext.h"
@@ -640,6 +641,7 @@ SensorRenderer::SensorRenderer(GLVisionSimulatorItemImpl* simImpl, Device* devic
             fisheyeLensConverter.initialize(width, height, fov, resolution);
             fisheyeLensConverter.setImageRotationEnabled(camera->lensType() == Camera::DUAL_FISHEYE_LENS);
             fisheyeLensConverter.setAntiAliasingEnabled(simImpl->isAntiAliasingEnabled);
+            fisheyeLensConverter.setNumThreads(thread::hardware_concurrency());
             
             for(int i=0; i < numScreens; ++i){
                 auto cameraForRendering = new Camera(*camera);
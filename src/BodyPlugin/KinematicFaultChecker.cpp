@@ -9,6 +9,7 @@
 #include "BodySelectionManager.h"
 #include <cnoid/RootItem>
 #include <cnoid/BodyState>
+#include <cnoid/FlatForwardKinematics>
 #include <cnoid/Archive>
 #include <cnoid/MainWindow>
 #include <cnoid/MenuManager>
@@ -374,6 +375,8 @@ int KinematicFaultCheckerImpl::checkFaults
     bodyCollisionDetector.addBody(body, true);
     bodyCollisionDetector.makeReady();
 
+    FlatForwardKinematics fk(body);
+
     const int numJoints = std::min(body->numJoints(), qseq->numParts());
     const int numLinks = std::min(body->numLinks(), pseq->numParts());
 
@@ -444,7 +447,7 @@ int KinematicFaultCheckerImpl::checkFaults
                 link->R() = Matrix3d::Identity();
             }
 
-            body->calcForwardKinematics();
+            fk.calcBodyForwardKinematics();
 
             for(int i=1; i < numLinks; ++i){
                 link = body->link(i);
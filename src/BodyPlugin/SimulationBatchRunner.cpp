@@ -0,0 +1,606 @@
+/**
+   @author Shin'ichiro Nakaoka
+*/
+
+#include "SimulationBatchRunner.h"
+#include "SimulatorItem.h"
+#include "WorldItem.h"
+#include "WorldLogFileItem.h"
+#include "BodyMotionItem.h"
+#include <cnoid/ExtensionManager>
+#include <cnoid/OptionManager>
+#include <cnoid/RootItem>
+#include <cnoid/ItemList>
+#include <cnoid/MainWindow>
+#include <cnoid/MessageView>
+#include <cnoid/LazyCaller>
+#include <cnoid/PutPropertyFunction>
+#include <cnoid/ConnectionSet>
+#include <cnoid/UTF8>
+#include <cnoid/stdx/filesystem>
+#include <QCoreApplication>
+#include <fmt/format.h>
+#include <fstream>
+#include <thread>
+#include <cstdlib>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+namespace filesystem = cnoid::stdx::filesystem;
+
+namespace {
+
+struct PropertyOverride
+{
+    string itemPath;
+    string property;
+    string value;
+};
+
+struct Scenario
+{
+    string name;
+    vector<PropertyOverride> overrides;
+};
+
+struct Job
+{
+    string name;
+    WorldItemPtr worldItem;
+    SimulatorItemPtr simulatorItem;
+    vector<string> overrideStrings;
+    vector<string> resultFiles;
+    string logFile;
+    bool isStarted = false;
+    bool isSucceeded = false;
+    string error;
+    ScopedConnection connection;
+};
+
+
+/**
+   This class sets the value of an item property specified by the name
+   shown in the property view.
+*/
+class PropertySetter : public PutPropertyFunction
+{
+public:
+    const string& name;
+    const string& value;
+    bool isFound;
+    bool isDone;
+
+    PropertySetter(const string& name, const string& value)
+        : name(name), value(value), isFound(false), isDone(false) { }
+
+    virtual PutPropertyFunction& decimals(int) override { return *this; }
+    virtual PutPropertyFunction& min(double) override { return *this; }
+    virtual PutPropertyFunction& max(double) override { return *this; }
+    virtual PutPropertyFunction& min(int) override { return *this; }
+    virtual PutPropertyFunction& max(int) override { return *this; }
+    virtual PutPropertyFunction& reset() override { return *this; }
+
+    bool checkName(const string& name_) {
+        if(name_ == name){
+            isFound = true;
+            return true;
+        }
+        return false;
+    }
+
+    bool toInt(const string& s, int& out_value) {
+        char* end;
+        long v = strtol(s.c_str(), &end, 10);
+        if(s.empty() || *end != '\0'){
+            return false;
+        }
+        out_value = v;
+        return true;
+    }
+
+    virtual void operator()(const string& name, bool) override { checkName(name); }
+    virtual void operator()(const string& name, bool, const std::function<bool(bool)>& changeFunc) override {
+        if(checkName(name)){
+            if(value == "true" || value == "on" || value == "1"){
+                isDone = changeFunc(true);
+            } else if(value == "false" || value == "off" || value == "0"){
+                isDone = changeFunc(false);
+            }
+        }
+    }
+    virtual void operator()(const string& name, int) override { checkName(name); }
+    virtual void operator()(const string& name, int, const std::function<bool(int)>& changeFunc) override {
+        int v;
+        if(checkName(name) && toInt(value, v)){
+            isDone = changeFunc(v);
+        }
+    }
+    virtual void operator()(const string& name, double) override { checkName(name); }
+    virtual void operator()(const string& name, double, const std::function<bool(double)>& changeFunc) override {
+        if(checkName(name)){
+            char* end;
+            double v = strtod(value.c_str(), &end);
+            if(!value.empty() && *end == '\0'){
+                isDone = changeFunc(v);
+            }
+        }
+    }
+    virtual void operator()(const string& name, const string&) override { checkName(name); }
+    virtual void operator()(const string& name, const string&,
+                            const std::function<bool(const string&)>& changeFunc) override {
+        if(checkName(name)){
+            isDone = changeFunc(value);
+        }
+    }
+    virtual void operator()(const string& name, const Selection&) override { checkName(name); }
+    virtual void operator()(const string& name, const Selection& selection,
+                            const std::function<bool(int which)>& changeFunc) override {
+        if(checkName(name)){
+            int index = selection.index(value);
+            if(index < 0 && !toInt(value, index)){
+                return;
+            }
+            if(index >= 0 && index < selection.size()){
+                isDone = changeFunc(index);
+            }
+        }
+    }
+    virtual void operator()(const string& name, const FilePathProperty&) override { checkName(name); }
+    virtual void operator()(const string& name, const FilePathProperty&,
+                            const std::function<bool(const string&)>& changeFunc) override {
+        if(checkName(name)){
+            isDone = changeFunc(value);
+        }
+    }
+};
+
+
+string toJsonString(const string& s)
+{
+    string json;
+    json.reserve(s.size() + 2);
+    json += '"';
+    for(auto c : s){
+        switch(c){
+        case '"':  json += "\\\""; break;
+        case '\\': json += "\\\\"; break;
+        case '\n': json += "\\n"; break;
+        case '\r': json += "\\r"; break;
+        case '\t': json += "\\t"; break;
+        default:
+            if(static_cast<unsigned char>(c) < 0x20){
+                json += format("\\u{:04x}", static_cast<int>(c));
+            } else {
+                json += c;
+            }
+        }
+    }
+    json += '"';
+    return json;
+}
+
+
+string toJsonStringList(const vector<string>& strings)
+{
+    string json = "[";
+    for(size_t i=0; i < strings.size(); ++i){
+        if(i > 0){
+            json += ", ";
+        }
+        json += toJsonString(strings[i]);
+    }
+    json += "]";
+    return json;
+}
+
+
+class SimulationBatchRunner
+{
+public:
+    vector<Scenario> scenarios;
+    int maxNumConcurrentJobs;
+    filesystem::path outputDirectory;
+    vector<unique_ptr<Job>> jobs;
+    size_t nextJobIndex;
+    int numRunningJobs;
+    MessageView* mv;
+
+    SimulationBatchRunner();
+    bool parseScenario(const string& description);
+    void start();
+    void addJobs(WorldItem* orgWorldItem, SimulatorItem* orgSimulatorItem);
+    bool applyOverride(Job* job, const PropertyOverride& propertyOverride);
+    void startNextJobs();
+    void onSimulationFinished(Job* job);
+    void saveResults(Job* job);
+    string getJobSummary(Job* job);
+    void finish();
+    void quit(int exitCode);
+};
+
+SimulationBatchRunner* runner = nullptr;
+
+}
+
+
+SimulationBatchRunner::SimulationBatchRunner()
+{
+    maxNumConcurrentJobs = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    nextJobIndex = 0;
+    numRunningJobs = 0;
+    mv = MessageView::instance();
+}
+
+
+/**
+   The description is given in the form of NAME[,ITEM:PROPERTY=VALUE]...
+   where ITEM is the path of an item from the world item. The simulator item is
+   the target when ITEM is omitted.
+*/
+bool SimulationBatchRunner::parseScenario(const string& description)
+{
+    Scenario scenario;
+    size_t pos = 0;
+    bool isFirst = true;
+    while(pos <= description.size()){
+        size_t next = description.find(',', pos);
+        if(next == string::npos){
+            next = description.size();
+        }
+        string token = description.substr(pos, next - pos);
+        pos = next + 1;
+
+        if(isFirst){
+            scenario.name = token;
+            isFirst = false;
+            continue;
+        }
+        PropertyOverride propertyOverride;
+        auto equalPos = token.find('=');
+        if(equalPos == string::npos){
+            mv->putln(format(_("Invalid property override \"{0}\" in simulation scenario \"{1}\"."),
+                             token, description), MessageView::Error);
+            return false;
+        }
+        auto colonPos = token.rfind(':', equalPos);
+        if(colonPos != string::npos){
+            propertyOverride.itemPath = token.substr(0, colonPos);
+            propertyOverride.property = token.substr(colonPos + 1, equalPos - colonPos - 1);
+        } else {
+            propertyOverride.property = token.substr(0, equalPos);
+        }
+        propertyOverride.value = token.substr(equalPos + 1);
+        scenario.overrides.push_back(propertyOverride);
+    }
+    if(scenario.name.empty()){
+        mv->putln(format(_("Simulation scenario \"{}\" does not have a name."), description),
+                  MessageView::Error);
+        return false;
+    }
+    scenarios.push_back(scenario);
+    return true;
+}
+
+
+void SimulationBatchRunner::start()
+{
+    auto rootItem = RootItem::instance();
+
+    // One simulator is used for each world
+    auto simulatorItems = rootItem->selectedItems<SimulatorItem>();
+    if(simulatorItems.empty()){
+        simulatorItems = rootItem->descendantItems<SimulatorItem>();
+    }
+    vector<WorldItem*> worldItems;
+    for(auto& simulatorItem : simulatorItems){
+        auto worldItem = simulatorItem->findOwnerItem<WorldItem>();
+        if(worldItem && std::find(worldItems.begin(), worldItems.end(), worldItem) == worldItems.end()){
+            worldItems.push_back(worldItem);
+            addJobs(worldItem, simulatorItem);
+        }
+    }
+
+    if(jobs.empty()){
+        mv->putln(_("There is no simulation to run in the batch simulation."), MessageView::Error);
+        finish();
+        return;
+    }
+
+    if(filesystem::exists(outputDirectory)){
+        if(!filesystem::is_directory(outputDirectory)){
+            mv->putln(format(_("{} is not a directory."), toUTF8(outputDirectory.string())),
+                      MessageView::Error);
+            jobs.clear();
+            finish();
+            return;
+        }
+    } else {
+        filesystem::create_directories(outputDirectory);
+    }
+
+    mv->putln(format(_("Batch simulation of {0} runs with up to {1} concurrent runs has started."),
+                     jobs.size(), maxNumConcurrentJobs));
+
+    startNextJobs();
+}
+
+
+void SimulationBatchRunner::addJobs(WorldItem* orgWorldItem, SimulatorItem* orgSimulatorItem)
+{
+    if(scenarios.empty()){
+        auto job = new Job;
+        job->name = orgWorldItem->name();
+        job->worldItem = orgWorldItem;
+        job->simulatorItem = orgSimulatorItem;
+        jobs.emplace_back(job);
+        return;
+    }
+
+    // Each scenario is simulated in a copy of the world to run the scenarios concurrently
+    for(auto& scenario : scenarios){
+        auto job = new Job;
+        jobs.emplace_back(job);
+        job->name = orgWorldItem->name() + "-" + scenario.name;
+        job->worldItem = dynamic_cast<WorldItem*>(orgWorldItem->duplicateSubTree());
+        if(!job->worldItem){
+            job->error = _("The world item cannot be duplicated.");
+            continue;
+        }
+        job->worldItem->setName(job->name);
+        orgWorldItem->parentItem()->insertChild(orgWorldItem->nextItem(), job->worldItem);
+        job->simulatorItem = job->worldItem->findItem<SimulatorItem>(
+            [orgSimulatorItem](SimulatorItem* item){ return item->name() == orgSimulatorItem->name(); });
+        if(!job->simulatorItem){
+            job->error = format(_("{} is not found in the duplicated world."), orgSimulatorItem->name());
+            continue;
+        }
+        for(auto& propertyOverride : scenario.overrides){
+            if(!applyOverride(job, propertyOverride)){
+                break;
+            }
+        }
+    }
+}
+
+
+bool SimulationBatchRunner::applyOverride(Job* job, const PropertyOverride& propertyOverride)
+{
+    Item* item;
+    if(propertyOverride.itemPath.empty()){
+        item = job->simulatorItem;
+    } else {
+        item = job->worldItem->findItem(propertyOverride.itemPath);
+        if(!item){
+            job->error = format(_("Item \"{}\" is not found."), propertyOverride.itemPath);
+            return false;
+        }
+    }
+    PropertySetter setter(propertyOverride.property, propertyOverride.value);
+    item->putProperties(setter);
+    if(!setter.isFound){
+        job->error = format(_("Item \"{0}\" does not have property \"{1}\"."), item->name(), propertyOverride.property);
+        return false;
+    }
+    if(!setter.isDone){
+        job->error = format(_("Value \"{0}\" cannot be set to property \"{1}\" of item \"{2}\"."),
+                            propertyOverride.value, propertyOverride.property, item->name());
+        return false;
+    }
+    job->overrideStrings.push_back(
+        format("{0}:{1}={2}", propertyOverride.itemPath, propertyOverride.property, propertyOverride.value));
+    return true;
+}
+
+
+void SimulationBatchRunner::startNextJobs()
+{
+    while(numRunningJobs < maxNumConcurrentJobs && nextJobIndex < jobs.size()){
+        Job* job = jobs[nextJobIndex++].get();
+        if(!job->error.empty()){
+            mv->putln(format(_("Batch simulation \"{0}\" is skipped: {1}"), job->name, job->error),
+                      MessageView::Error);
+            continue;
+        }
+
+        auto simulatorItem = job->simulatorItem;
+        simulatorItem->setRealtimeSyncMode(false);
+
+        if(auto logItem = job->worldItem->findItem<WorldLogFileItem>()){
+            string extension = filesystem::path(fromUTF8(logItem->logFile())).extension().string();
+            if(extension.empty()){
+                extension = ".log";
+            }
+            job->logFile = toUTF8((outputDirectory / fromUTF8(job->name + extension)).string());
+            logItem->setLogFile(job->logFile);
+        }
+
+        job->connection = simulatorItem->sigSimulationFinished().connect(
+            [this, job](){ onSimulationFinished(job); });
+
+        if(simulatorItem->startSimulation(true)){
+            job->isStarted = true;
+            ++numRunningJobs;
+        } else {
+            job->connection.disconnect();
+            job->error = _("The simulation cannot be started.");
+            mv->putln(format(_("Batch simulation \"{0}\" failed: {1}"), job->name, job->error),
+                      MessageView::Error);
+        }
+    }
+
+    if(numRunningJobs == 0 && nextJobIndex >= jobs.size()){
+        finish();
+    }
+}
+
+
+void SimulationBatchRunner::onSimulationFinished(Job* job)
+{
+    job->connection.disconnect();
+    --numRunningJobs;
+
+    auto simulatorItem = job->simulatorItem;
+    job->isSucceeded = simulatorItem->isSimulationCompleted();
+    if(!job->isSucceeded){
+        job->error = format(_("The simulation was stopped at {} [s] before the end of its time range."),
+                            simulatorItem->finishTime());
+    }
+
+    saveResults(job);
+
+    if(job->isSucceeded){
+        mv->putln(format(_("Batch simulation \"{0}\" has finished ({1} / {2})."),
+                         job->name, nextJobIndex - numRunningJobs, jobs.size()));
+    } else {
+        mv->putln(format(_("Batch simulation \"{0}\" failed ({1} / {2}): {3}"),
+                         job->name, nextJobIndex - numRunningJobs, jobs.size(), job->error),
+                  MessageView::Error);
+    }
+
+    // The next jobs are started after the finalization of the finished simulation
+    callLater([this](){ startNextJobs(); });
+}
+
+
+void SimulationBatchRunner::saveResults(Job* job)
+{
+    const string prefix = job->simulatorItem->name() + "-";
+    for(auto& motionItem : job->worldItem->descendantItems<BodyMotionItem>()){
+        if(motionItem->name().compare(0, prefix.size(), prefix) == 0){
+            auto filename = toUTF8((outputDirectory / fromUTF8(job->name + "-" + motionItem->name() + ".seq")).string());
+            if(motionItem->motion()->save(filename)){
+                job->resultFiles.push_back(filename);
+            } else {
+                mv->putln(format(_("The result motion cannot be saved to \"{}\"."), filename), MessageView::Error);
+            }
+        }
+    }
+
+    auto filename = (outputDirectory / fromUTF8(job->name + ".json")).string();
+    ofstream ofs(filename);
+    ofs << getJobSummary(job) << "\n";
+}
+
+
+string SimulationBatchRunner::getJobSummary(Job* job)
+{
+    string json = "{\n";
+    json += format("  \"name\": {},\n", toJsonString(job->name));
+    json += format("  \"overrides\": {},\n", toJsonStringList(job->overrideStrings));
+    json += format("  \"succeeded\": {},\n", job->isSucceeded ? "true" : "false");
+    if(!job->error.empty()){
+        json += format("  \"error\": {},\n", toJsonString(job->error));
+    }
+    // The statistics and the results of a stopped simulation are also output for inspection
+    if(job->isStarted){
+        auto simulatorItem = job->simulatorItem;
+        double averageTime, minTime, maxTime;
+        int numSteps = simulatorItem->getStepTimeStatistics(averageTime, minTime, maxTime);
+        const double finishTime = simulatorItem->finishTime();
+        const double actualTime = simulatorItem->actualSimulationTime();
+        json += format("  \"simulator\": {},\n", toJsonString(simulatorItem->name()));
+        json += format("  \"timeStep\": {},\n", simulatorItem->worldTimeStep());
+        json += format("  \"finishTime\": {},\n", finishTime);
+        json += format("  \"actualTime\": {},\n", actualTime);
+        json += format("  \"realtimeRatio\": {},\n", (actualTime > 0.0) ? (finishTime / actualTime) : 0.0);
+        json += format("  \"numSteps\": {},\n", numSteps);
+        json += format("  \"averageStepTime\": {},\n", averageTime);
+        json += format("  \"minStepTime\": {},\n", minTime);
+        json += format("  \"maxStepTime\": {},\n", maxTime);
+        if(!job->logFile.empty()){
+            json += format("  \"logFile\": {},\n", toJsonString(job->logFile));
+        }
+        json += format("  \"resultFiles\": {},\n", toJsonStringList(job->resultFiles));
+    }
+    json += format("  \"started\": {}\n", job->isStarted ? "true" : "false");
+    json += "}";
+    return json;
+}
+
+
+void SimulationBatchRunner::finish()
+{
+    int numFailedJobs = 0;
+    string json = "[\n";
+    for(size_t i=0; i < jobs.size(); ++i){
+        auto job = jobs[i].get();
+        if(!job->isSucceeded){
+            ++numFailedJobs;
+        }
+        if(i > 0){
+            json += ",\n";
+        }
+        json += getJobSummary(job);
+    }
+    json += "\n]\n";
+
+    if(!jobs.empty()){
+        ofstream ofs((outputDirectory / "summary.json").string());
+        ofs << json;
+    }
+
+    mv->putln(format(_("Batch simulation has finished. {0} of {1} runs failed."), numFailedJobs, jobs.size()));
+
+    quit((jobs.empty() || numFailedJobs > 0) ? 1 : 0);
+}
+
+
+void SimulationBatchRunner::quit(int exitCode)
+{
+    callLater([exitCode](){
+        MainWindow::instance()->close();
+        QCoreApplication::exit(exitCode);
+    });
+}
+
+
+static void onSigOptionsParsed(boost::program_options::variables_map& v)
+{
+    if(v.count("batch-simulation") && !runner){
+        runner = new SimulationBatchRunner;
+        bool isScenarioValid = true;
+        if(v.count("simulation-scenario")){
+            for(auto& description : v["simulation-scenario"].as<vector<string>>()){
+                if(!runner->parseScenario(description)){
+                    isScenarioValid = false;
+                }
+            }
+        }
+        if(!isScenarioValid){
+            // The batch is not run with a part of the given scenarios
+            runner->mv->putln(_("Batch simulation is not started due to the invalid scenarios."),
+                              MessageView::Error);
+            runner->quit(1);
+            return;
+        }
+        if(v.count("simulation-jobs")){
+            runner->maxNumConcurrentJobs = std::max(1, v["simulation-jobs"].as<int>());
+        }
+        if(v.count("simulation-output")){
+            runner->outputDirectory = fromUTF8(v["simulation-output"].as<string>());
+        } else {
+            runner->outputDirectory = filesystem::current_path();
+        }
+        callLater([](){ runner->start(); });
+    }
+}
+
+
+void cnoid::initializeSimulationBatchRunner(ExtensionManager* ext)
+{
+    ext->optionManager()
+        .addOption("batch-simulation",
+                   "run the simulations of the loaded project without the realtime sync "
+                   "and quit after all the simulations finish")
+        .addOption("simulation-scenario", boost::program_options::value<vector<string>>(),
+                   "add a scenario of the batch simulation in the form of NAME[,ITEM:PROPERTY=VALUE]... "
+                   "where ITEM is the item path from the world item, which can be omitted for the simulator item, "
+                   "and PROPERTY is the property name shown in the property view")
+        .addOption("simulation-jobs", boost::program_options::value<int>(),
+                   "the maximum number of the batch simulations running concurrently")
+        .addOption("simulation-output", boost::program_options::value<string>(),
+                   "the directory to output the results of the batch simulation")
+        .sigOptionsParsed().connect(onSigOptionsParsed);
+}
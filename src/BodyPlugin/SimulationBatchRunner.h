@@ -0,0 +1,16 @@
+/**
+   @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_BODY_PLUGIN_SIMULATION_BATCH_RUNNER_H
+#define CNOID_BODY_PLUGIN_SIMULATION_BATCH_RUNNER_H
+
+namespace cnoid {
+
+class ExtensionManager;
+
+void initializeSimulationBatchRunner(ExtensionManager* ext);
+
+}
+
+#endif
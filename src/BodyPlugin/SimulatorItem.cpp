@@ -20,6 +20,7 @@
 #include <cnoid/MenuManager>
 #include <cnoid/ControllerIO>
 #include <cnoid/BodyState>
+#include <cnoid/SimulationCheckpoint>
 #include <cnoid/AppUtil>
 #include <cnoid/TimeBar>
 #include <cnoid/MessageView>
@@ -34,14 +35,17 @@
 #include <cnoid/FloatingNumberString>
 #include <cnoid/SceneGraph>
 #include <cnoid/CloneMap>
+#include <cnoid/ThreadPool>
 #include <QThread>
-#include <QMutex>
 #include <QElapsedTimer>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <set>
-#include <deque>
+#include <algorithm>
+#include <cmath>
 #include <fmt/format.h>
 #include "gettext.h"
 
@@ -55,8 +59,23 @@ enum { RESOLUTION_TIMESTEP, RESOLUTION_FRAMERATE, RESOLUTION_TIMEBAR, N_TEMPORAR
 
 typedef Deque2D<SE3, Eigen::aligned_allocator<SE3> > MultiSE3Deque;
 
+/**
+   The number of the result blocks used to pass the simulation results from the simulation
+   thread to the main thread. This must be a power of two so that the block index is kept
+   consistent when the block counters wrap around.
+*/
+constexpr int NumResultBlocks = 4;
+
+// The ratio of the time used to update the display of the results to the flushing interval
+constexpr double DisplayUpdateBudgetRatio = 0.5;
+
+// The interval of updating the bodies which are not shown in any scene view
+constexpr double HiddenBodyUpdateInterval = 1.0;
+
 typedef map<weak_ref_ptr<BodyItem>, SimulationBodyPtr> BodyItemToSimBodyMap;
 
+typedef shared_ptr<SimulationCheckpoint> SimulationCheckpointPtr;
+
 struct FunctionSet
 {
     struct FunctionInfo {
@@ -144,12 +163,32 @@ public:
     bool isDynamic;
     bool areShapesCloned;
 
-    Deque2D<double> jointPosBuf;
-    MultiSE3Deque linkPosBuf;
+    struct ResultBuffer
+    {
+        Deque2D<double> jointPosBuf;
+        MultiSE3Deque linkPosBuf;
+        Deque2D<DeviceStatePtr> deviceStateBuf;
+        // The index of the block frame stored in the first rows, which is not zero when the
+        // body is activated in the middle of the block
+        int firstBlockFrame;
+        int numFrames() const {
+            return std::max(std::max(jointPosBuf.rowSize(), linkPosBuf.rowSize()), deviceStateBuf.rowSize());
+        }
+    };
+    // The buffer of each result block, which is indexed in the same way as the blocks
+    ResultBuffer resultBuffers[NumResultBlocks];
+    int numJointsToRecord;
+    int numLinksToRecord;
+    int numDevicesToRecord;
+    bool isResultBufferInitializationRequested;
+    
     vector<Device*> devicesToNotifyResults;
+    bool isResultNotificationPending;
+    std::chrono::steady_clock::time_point lastResultNotificationTime;
     ScopedConnectionSet deviceStateConnections;
     vector<bool> deviceStateChangeFlag;
-    Deque2D<DeviceStatePtr> deviceStateBuf;
+    // The last buffered states, which are shared with the next frame if the states are not changed
+    vector<DeviceStatePtr> lastBufferedDeviceStates;
 
     ItemPtr parentOfResultItems;
     string resultItemPrefix;
@@ -160,6 +199,25 @@ public:
     vector<DeviceStatePtr> prevFlushedDeviceStateInDirectMode;
     shared_ptr<MultiDeviceStateSeq> deviceStateResults;
 
+    // The states at the start of the simulation, which are restored by the state reset
+    struct LinkState
+    {
+        Position T;
+        Vector3 v;
+        Vector3 w;
+        Vector3 dv;
+        Vector3 dw;
+        Vector6 F_ext;
+        double q;
+        double dq;
+        double ddq;
+        double u;
+        double q_target;
+        double dq_target;
+    };
+    vector<LinkState, Eigen::aligned_allocator<LinkState>> initialLinkStates;
+    vector<DeviceStatePtr> initialDeviceStates;
+
     Impl(SimulationBody* self, Body* body);
     void findControlSrcItems(Item* item, vector<Item*>& io_items, bool doPickCheckedItems = false);
     bool initialize(SimulatorItem* simulatorItem, BodyItem* bodyItem);
@@ -169,15 +227,22 @@ public:
     void cloneShapesOnce();
     void initializeResultData();
     void initializeResultBuffers();
+    void prepareResultBuffer(int blockIndex);
+    void trimResultBuffer(int blockIndex, int numBlockFramesToRemove);
     void initializeResultItems();
     void setInitialStateOfBodyMotion(shared_ptr<BodyMotion> bodyMotion);
     void setActive(bool on);
     void bufferResults();
-    void flushResults();
-    void flushResultsToBodyMotionItems();
-    void flushResultsToBody();
-    void flushResultsToWorldLogFile(int bufferFrame);
+    void flushResults(int blockIndex);
+    void flushResultsToBodyMotionItems(int blockIndex);
+    void flushResultsToBody(ResultBuffer& buffer);
+    void flushResultsToWorldLogFile(int blockIndex, int blockFrame);
+    bool isShownInScene() const;
     void notifyResults(double time);
+    void storeInitialState();
+    void restoreInitialState(Body* body);
+    void storeCheckpoint(SimulationCheckpoint::BodyData& out_data);
+    bool restoreCheckpoint(const SimulationCheckpoint::BodyData& data);
 };
 
 
@@ -205,15 +270,44 @@ public:
     int currentFrame;
     double worldFrameRate;
     double worldTimeStep_;
-    int frameAtLastBufferWriting;
-    int numBufferedFrames;
+    std::atomic<int> frameAtLastBufferWriting;
     Timer flushTimer;
 
+    /**
+       The results of the simulation steps are passed from the simulation thread to the main
+       thread through a single-producer single-consumer queue of these blocks. The simulation
+       thread writes the results into the block indexed by the number of the published blocks,
+       and the main thread flushes the blocks between the numbers of the consumed blocks and
+       the published blocks. Neither thread waits for the other.
+    */
+    struct ResultBlock
+    {
+        vector<SimulationBody*> simBodies;
+        vector<shared_ptr<CollisionLinkPairList>> collisionPairsBuf;
+        int numFrames;
+        int lastFrame;
+    };
+    ResultBlock resultBlocks[NumResultBlocks];
+    std::atomic<unsigned int> numPublishedResultBlocks;
+    std::atomic<unsigned int> numConsumedResultBlocks;
+    int resultBlockFrameCapacity;
+    int resultBlockIndexToFlush;
+    int lastFlushedFrame;
+    std::atomic<int> numPublishedResultFrames;
+    std::atomic<int> numDeferredResultFrames;
+    std::atomic<int> maxNumResultBlockFrames;
+
     FunctionSet preDynamicsFunctions;
     FunctionSet midDynamicsFunctions;
     FunctionSet postDynamicsFunctions;
     
+    // The bodies whose flushed results have not been notified yet in the order of flushing
     vector<SimulationBody::Impl*> simBodyImplsToNotifyResults;
+    std::chrono::steady_clock::duration displayUpdateBudget;
+    std::chrono::steady_clock::time_point nextDisplayUpdateTime;
+    std::chrono::steady_clock::time_point displayUpdateStartTime;
+    int numDisplayUpdates;
+    double displayUpdateRate;
     ItemList<SubSimulatorItem> subSimulatorItems;
 
     vector<ControllerItem*> activeControllers;
@@ -230,7 +324,6 @@ public:
     CollisionDetectorPtr collisionDetector;
 
     shared_ptr<CollisionSeq> collisionSeq;
-    deque<shared_ptr<CollisionLinkPairList>> collisionPairsBuf;
 
     Selection recordingMode;
     Selection timeRangeMode;
@@ -246,6 +339,23 @@ public:
     bool isDoingSimulationLoop;
     volatile bool stopRequested;
     volatile bool pauseRequested;
+    std::atomic<bool> isStateResetRequested;
+    bool isRestartRequested;
+
+    // The first frame of the simulation, which is not zero when it is resumed from a checkpoint
+    int initialFrame;
+    SimulationCheckpointPtr checkpointToResume;
+    // The checkpoint which the current simulation has been resumed from
+    SimulationCheckpointPtr resumedCheckpoint;
+    double checkpointInterval;
+    string checkpointFile;
+    int nextCheckpointFrame;
+    std::mutex checkpointMutex;
+    vector<string> requestedCheckpointFiles;
+    std::atomic<bool> isCheckpointRequested;
+    std::atomic<int> numPendingCheckpoints;
+    // The checkpoints are written by this thread in the order of the requests
+    unique_ptr<ThreadPool> checkpointWriter;
     bool isRealtimeSyncMode;
     bool needToUpdateSimBodyLists;
     bool hasActiveFreeBodies;
@@ -255,9 +365,15 @@ public:
 
     TimeBar* timeBar;
     int fillLevelId;
-    QMutex resultBufMutex;
     double actualSimulationTime;
     double finishTime;
+    bool isStoppedByError;
+    // True if the last simulation was not stopped before the end of its time range
+    bool isSimulationCompleted;
+    int numMeasuredSteps;
+    double totalStepTime;
+    double minStepTime;
+    double maxStepTime;
     MessageView* mv;
 
     bool doReset;
@@ -265,6 +381,7 @@ public:
     Signal<void()> sigSimulationStarted;
     Signal<void()> sigSimulationPaused;
     Signal<void()> sigSimulationResumed;
+    Signal<void()> sigSimulationStateReset;
     Signal<void()> sigSimulationFinished;
 
     WorldLogFileItemPtr worldLogFileItem;
@@ -307,10 +424,22 @@ public:
     virtual void run() override;
     void onSimulationLoopStarted();
     void updateSimBodyLists();
+    int writingResultBlockIndex() const {
+        return numPublishedResultBlocks.load(std::memory_order_relaxed) % NumResultBlocks;
+    }
+    void initializeResultBlocks();
+    void bufferResults(shared_ptr<CollisionLinkPairList>& collisionPairs);
+    void trimResultBlock(ResultBlock& block, int numFramesToRemove);
+    bool publishResultBlock();
     bool stepSimulationMain();
+    bool resetSimulationState();
+    void takeCheckpoint(const string& filename);
+    bool startSimulationFromCheckpoint(const string& filename);
+    bool restoreCheckpoint(const SimulationCheckpoint& checkpoint);
     void concurrentControlLoop();
-    void flushResults();
+    void flushResults(bool doNotifyAllResults = false);
     int flushMainResults();
+    void notifyResults(double time, bool doNotifyAll);
     void stopSimulation(bool doSync);
     void pauseSimulation();
     void restartSimulation();
@@ -464,6 +593,46 @@ public:
     }
 };
 
+
+template<class BufferType>
+void clearAndReserveBuffer(BufferType& buf, int numColumns, int numRows)
+{
+    if(buf.colSize() != numColumns){
+        buf.resize(0, numColumns);
+    } else {
+        buf.pop_front(buf.rowSize());
+    }
+    buf.reserveRows(numRows);
+}
+
+
+/**
+   Append the buffered frames to a result sequence whose number of frames is limited
+   to ringBufferSize. The oldest frames are removed before appending the new frames,
+   so the sequence does not reallocate its memory once the memory for ringBufferSize
+   frames is reserved. The buffered frames that would be removed soon are not copied.
+   \param copyFrame The function called as copyFrame(bufFrame, appendedFrame)
+*/
+template<class SeqType, class CopyFunction>
+void appendFramesToRingBuffer
+(SeqType& seq, int firstBufFrame, int endBufFrame, int ringBufferSize, int nextFrame, CopyFunction copyFrame)
+{
+    const int numFramesWithoutLimit = seq.numFrames() + (endBufFrame - firstBufFrame);
+    if(endBufFrame - firstBufFrame > ringBufferSize){
+        firstBufFrame = endBufFrame - ringBufferSize;
+    }
+    const int numOverflowFrames = seq.numFrames() + (endBufFrame - firstBufFrame) - ringBufferSize;
+    if(numOverflowFrames > 0){
+        seq.popFrontFrames(numOverflowFrames);
+    }
+    for(int i = firstBufFrame; i < endBufFrame; ++i){
+        copyFrame(i, seq.appendFrame());
+    }
+    if(seq.numFrames() < numFramesWithoutLimit){
+        seq.setOffsetTimeFrame(nextFrame - seq.numFrames());
+    }
+}
+
 }
 
 
@@ -552,7 +721,7 @@ bool ControllerInfo::enableLog()
 {
     logBuf.reset(new ReferencedObjectSeq);
     logBuf->setFrameRate(simImpl->worldFrameRate);
-    logBufFrameOffset = 0;
+    logBufFrameOffset = simImpl->initialFrame;
 
     string logName = simImpl->self->name() + "-" + controller->name();
     logItem = controller->findChildItem<ReferencedObjectSeqItem>(logName);
@@ -567,7 +736,7 @@ bool ControllerInfo::enableLog()
     log = logItem->seq();
     log->setNumFrames(0);
     log->setFrameRate(simImpl->worldFrameRate);
-    log->setOffsetTime(0.0);
+    log->setOffsetTimeFrame(simImpl->initialFrame);
     
     simImpl->loggedControllerInfos.push_back(this);
 
@@ -629,6 +798,11 @@ SimulationBody::Impl::Impl(SimulationBody* self, Body* body)
     areShapesCloned = false;
     isActive = false;
     isDynamic = false;
+    numJointsToRecord = 0;
+    numLinksToRecord = 0;
+    numDevicesToRecord = 0;
+    isResultBufferInitializationRequested = false;
+    isResultNotificationPending = false;
 }
 
 
@@ -737,8 +911,6 @@ bool SimulationBody::Impl::initialize(SimulatorItem::Impl* simImpl, ControllerIt
     }
     controllerInfos.push_back(info);
 
-    linkPosBuf.resizeColumn(0);
-
     return true;
 }
 
@@ -800,6 +972,140 @@ void SimulationBody::Impl::copyStateToBodyItem()
 }
 
 
+void SimulationBody::Impl::storeInitialState()
+{
+    const int numLinks = body_->numLinks();
+    initialLinkStates.resize(numLinks);
+    for(int i=0; i < numLinks; ++i){
+        Link* link = body_->link(i);
+        auto& state = initialLinkStates[i];
+        state.T = link->T();
+        state.v = link->v();
+        state.w = link->w();
+        state.dv = link->dv();
+        state.dw = link->dw();
+        state.F_ext = link->F_ext();
+        state.q = link->q();
+        state.dq = link->dq();
+        state.ddq = link->ddq();
+        state.u = link->u();
+        state.q_target = link->q_target();
+        state.dq_target = link->dq_target();
+    }
+
+    const DeviceList<>& devices = body_->devices();
+    initialDeviceStates.resize(devices.size());
+    for(size_t i=0; i < devices.size(); ++i){
+        initialDeviceStates[i] = devices[i]->cloneState();
+    }
+}
+
+
+/**
+   The states are also restored to the body of the body item so that the bodies can be cloned
+   from the body items again when the simulation is restarted.
+*/
+void SimulationBody::Impl::restoreInitialState(Body* body)
+{
+    const int numLinks = std::min(static_cast<int>(initialLinkStates.size()), body->numLinks());
+    for(int i=0; i < numLinks; ++i){
+        Link* link = body->link(i);
+        auto& state = initialLinkStates[i];
+        link->T() = state.T;
+        link->v() = state.v;
+        link->w() = state.w;
+        link->dv() = state.dv;
+        link->dw() = state.dw;
+        link->F_ext() = state.F_ext;
+        link->q() = state.q;
+        link->dq() = state.dq;
+        link->ddq() = state.ddq;
+        link->u() = state.u;
+        link->q_target() = state.q_target;
+        link->dq_target() = state.dq_target;
+    }
+
+    const DeviceList<>& devices = body->devices();
+    const size_t numDevices = std::min(initialDeviceStates.size(), devices.size());
+    for(size_t i=0; i < numDevices; ++i){
+        Device* device = devices[i];
+        device->copyStateFrom(*initialDeviceStates[i]);
+        device->notifyStateChange();
+    }
+}
+
+
+void SimulationBody::Impl::storeCheckpoint(SimulationCheckpoint::BodyData& out_data)
+{
+    out_data.deviceStates.clear();
+    out_data.controllerData.clear();
+
+    if(!body_){
+        out_data.name.clear();
+        out_data.linkStates.clear();
+    } else {
+        out_data.name = body_->name();
+        SimulationCheckpoint::storeLinkStates(body_, out_data.linkStates);
+        const DeviceList<>& devices = body_->devices();
+        int size = 0;
+        for(auto& device : devices){
+            size += device->stateSize();
+        }
+        out_data.deviceStates.resize(size);
+        double* buf = out_data.deviceStates.data();
+        for(auto& device : devices){
+            buf = device->writeState(buf);
+        }
+    }
+
+    for(auto& info : controllerInfos){
+        vector<char> data;
+        if(info->controller->storeCheckpointData(data)){
+            out_data.controllerData.emplace_back(info->controller->name(), std::move(data));
+        }
+    }
+}
+
+
+bool SimulationBody::Impl::restoreCheckpoint(const SimulationCheckpoint::BodyData& data)
+{
+    if(body_){
+        if(data.name != body_->name() || !SimulationCheckpoint::restoreLinkStates(body_, data.linkStates)){
+            return false;
+        }
+        const DeviceList<>& devices = body_->devices();
+        int size = 0;
+        for(auto& device : devices){
+            size += device->stateSize();
+        }
+        if(size != static_cast<int>(data.deviceStates.size())){
+            return false;
+        }
+        const double* buf = data.deviceStates.data();
+        for(auto& device : devices){
+            buf = device->readState(buf);
+            device->notifyStateChange();
+        }
+    }
+
+    for(auto& controllerData : data.controllerData){
+        for(auto& info : controllerInfos){
+            if(info->controller->name() == controllerData.first){
+                if(!info->controller->restoreCheckpointData(controllerData.second)){
+                    simImpl->mv->putln(
+                        format(_("The state of {} cannot be restored from the checkpoint."),
+                               info->controller->displayName()),
+                        MessageView::Warning);
+                }
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+
 void SimulationBody::cloneShapesOnce()
 {
     if(!impl->areShapesCloned){
@@ -838,12 +1144,11 @@ void SimulationBody::initializeResultBuffers()
 
 void SimulationBody::Impl::initializeResultBuffers()
 {
-    jointPosBuf.resizeColumn(body_->numAllJoints());
-    int numLinksToRecord = 0;
+    numJointsToRecord = body_->numAllJoints();
+    numLinksToRecord = 0;
     if(isDynamic){
         numLinksToRecord = simImpl->isAllLinkPositionOutputMode ? body_->numLinks() : 1;
     }
-    linkPosBuf.resizeColumn(numLinksToRecord);
 
     const DeviceList<>& devices = body_->devices();
     const int numDevices = devices.size();
@@ -851,19 +1156,15 @@ void SimulationBody::Impl::initializeResultBuffers()
     deviceStateChangeFlag.clear();
     deviceStateChangeFlag.resize(numDevices, true); // set all the bits to store the initial states
     devicesToNotifyResults.clear();
+    isResultNotificationPending = false;
+    lastBufferedDeviceStates.clear();
     
     if(devices.empty() || !simImpl->isDeviceStateOutputEnabled){
-        deviceStateBuf.clear();
+        numDevicesToRecord = 0;
         prevFlushedDeviceStateInDirectMode.clear();
     } else {
-        /**
-           Temporary code to avoid a bug in storing device states by reserving sufficient buffer size.
-           The original bug is in Deque2D's resize operation.
-        */
-        deviceStateBuf.resize(100, numDevices); 
-        
-        // This buf always has the first element to keep unchanged states
-        deviceStateBuf.resize(1, numDevices); 
+        numDevicesToRecord = numDevices;
+        lastBufferedDeviceStates.resize(numDevices);
         prevFlushedDeviceStateInDirectMode.resize(numDevices);
         for(size_t i=0; i < devices.size(); ++i){
             deviceStateConnections.add(
@@ -876,6 +1177,40 @@ void SimulationBody::Impl::initializeResultBuffers()
                     }));
         }
     }
+
+    prepareResultBuffer(simImpl->writingResultBlockIndex());
+}
+
+
+/**
+   Clear the buffer of a result block and reserve the memory for the frames usually stored
+   in a block. This function must be called in the thread writing the results to the block.
+*/
+void SimulationBody::Impl::prepareResultBuffer(int blockIndex)
+{
+    auto& buffer = resultBuffers[blockIndex];
+    const int numFramesToReserve = simImpl->resultBlockFrameCapacity * 2;
+    clearAndReserveBuffer(buffer.jointPosBuf, numJointsToRecord, numFramesToReserve);
+    clearAndReserveBuffer(buffer.linkPosBuf, numLinksToRecord, numFramesToReserve);
+    clearAndReserveBuffer(buffer.deviceStateBuf, numDevicesToRecord, numFramesToReserve);
+    buffer.firstBlockFrame = simImpl->resultBlocks[blockIndex].numFrames;
+}
+
+
+/**
+   Remove the rows of the given number of the first block frames.
+   This function must be called in the thread writing the results to the block.
+*/
+void SimulationBody::Impl::trimResultBuffer(int blockIndex, int numBlockFramesToRemove)
+{
+    auto& buffer = resultBuffers[blockIndex];
+    const int numRowsToRemove = std::min(buffer.numFrames(), numBlockFramesToRemove - buffer.firstBlockFrame);
+    if(numRowsToRemove > 0){
+        buffer.jointPosBuf.pop_front(numRowsToRemove);
+        buffer.linkPosBuf.pop_front(numRowsToRemove);
+        buffer.deviceStateBuf.pop_front(numRowsToRemove);
+    }
+    buffer.firstBlockFrame = std::max(0, buffer.firstBlockFrame - numBlockFramesToRemove);
 }
 
 
@@ -902,20 +1237,28 @@ void SimulationBody::Impl::initializeResultItems()
 
     motion = motionItem->motion();
     motion->setFrameRate(simImpl->worldFrameRate);
-    motion->setDimension(0, jointPosBuf.colSize(), linkPosBuf.colSize());
-    motion->setOffsetTime(0.0);
+    motion->setDimension(0, numJointsToRecord, numLinksToRecord);
+    motion->setOffsetTime(simImpl->initialFrame / simImpl->worldFrameRate);
     jointPosResults = motion->jointPosSeq();
     linkPosResultItem = motionItem->linkPosSeqItem();
     linkPosResults = motion->linkPosSeq();
 
-    const int numDevices = deviceStateBuf.colSize();
-    if(numDevices == 0 || !simImpl->isDeviceStateOutputEnabled){
+    if(numDevicesToRecord == 0){
         clearMultiDeviceStateSeq(*motion);
     } else {
         deviceStateResults = getOrCreateMultiDeviceStateSeq(*motion);
         deviceStateResults->initialize(body_->devices());
     }
 
+    if(simImpl->isRingBufferMode && simImpl->ringBufferSize < std::numeric_limits<int>::max()){
+        // Allocate the whole memory of the ring buffers so that it is not reallocated during the simulation
+        jointPosResults->reserveFrames(simImpl->ringBufferSize);
+        linkPosResults->reserveFrames(simImpl->ringBufferSize);
+        if(deviceStateResults){
+            deviceStateResults->reserveFrames(simImpl->ringBufferSize);
+        }
+    }
+
     if(doAddMotionItem){
         parentOfResultItems->addChildItem(motionItem);
     }
@@ -967,10 +1310,8 @@ void SimulationBody::Impl::setActive(bool on)
     if(body_){
         if(on){
             if(!isActive){
-                simImpl->resultBufMutex.lock();
-                self->initializeResultBuffers();
-                self->bufferResults();
-                simImpl->resultBufMutex.unlock();
+                // The result buffers are initialized by the simulation thread in updateSimBodyLists
+                isResultBufferInitializationRequested = true;
                 isActive = true;
                 simImpl->needToUpdateSimBodyLists = true;
             }
@@ -1000,31 +1341,30 @@ void SimulationBody::bufferResults()
 
 void SimulationBody::Impl::bufferResults()
 {
-    if(jointPosBuf.colSize() > 0){
-        Deque2D<double>::Row q = jointPosBuf.append();
+    auto& buffer = resultBuffers[simImpl->writingResultBlockIndex()];
+
+    if(buffer.jointPosBuf.colSize() > 0){
+        Deque2D<double>::Row q = buffer.jointPosBuf.append();
         for(int i=0; i < q.size() ; ++i){
             q[i] = body_->joint(i)->q();
         }
     }
-    if(linkPosBuf.colSize() > 0){
-        MultiSE3Deque::Row pos = linkPosBuf.append();
-        for(int i=0; i < linkPosBuf.colSize(); ++i){
+    if(buffer.linkPosBuf.colSize() > 0){
+        MultiSE3Deque::Row pos = buffer.linkPosBuf.append();
+        for(int i=0; i < pos.size(); ++i){
             Link* link = body_->link(i);
             pos[i].set(link->p(), link->R());
         }
     }
-    if(deviceStateBuf.colSize() > 0){
-        const int prevIndex = std::max(0, deviceStateBuf.rowSize() - 1);
-        Deque2D<DeviceStatePtr>::Row current = deviceStateBuf.append();
-        Deque2D<DeviceStatePtr>::Row prev = deviceStateBuf[prevIndex];
+    if(buffer.deviceStateBuf.colSize() > 0){
+        Deque2D<DeviceStatePtr>::Row current = buffer.deviceStateBuf.append();
         const DeviceList<>& devices = body_->devices();
         for(size_t i=0; i < devices.size(); ++i){
             if(deviceStateChangeFlag[i]){
-                current[i] = devices[i]->cloneState();
+                lastBufferedDeviceStates[i] = devices[i]->cloneState();
                 deviceStateChangeFlag[i] = false;
-            } else {
-                current[i] = prev[i];
             }
+            current[i] = lastBufferedDeviceStates[i];
         }
     }
 }
@@ -1032,89 +1372,68 @@ void SimulationBody::Impl::bufferResults()
 
 void SimulationBody::flushResults()
 {
-    impl->flushResults();
+    impl->flushResults(impl->simImpl->resultBlockIndexToFlush);
 }
 
 
-void SimulationBody::Impl::flushResults()
+void SimulationBody::Impl::flushResults(int blockIndex)
 {
     if(simImpl->isRecordingEnabled){
-        flushResultsToBodyMotionItems();
+        flushResultsToBodyMotionItems(blockIndex);
     } else {
-        flushResultsToBody();
+        flushResultsToBody(resultBuffers[blockIndex]);
     }
-
-    // clear buffers
-    linkPosBuf.resizeRow(0);
-    jointPosBuf.resizeRow(0);
-
-    // keep the last state so that unchanged states can be shared
-    const int numPops = (deviceStateBuf.rowSize() >= 2) ? (deviceStateBuf.rowSize() - 1) : 0;
-    deviceStateBuf.pop_front(numPops);
 }
 
 
-void SimulationBody::Impl::flushResultsToBodyMotionItems()
+void SimulationBody::Impl::flushResultsToBodyMotionItems(int blockIndex)
 {
     if(!linkPosResults){
         initializeResultItems();
     }
 
+    auto& buffer = resultBuffers[blockIndex];
+    auto& linkPosBuf = buffer.linkPosBuf;
+    auto& jointPosBuf = buffer.jointPosBuf;
+    auto& deviceStateBuf = buffer.deviceStateBuf;
     const int ringBufferSize = simImpl->ringBufferSize;
-    const int numBufFrames = linkPosBuf.rowSize();
-    const int nextFrame = simImpl->currentFrame + 1;
+    // The buffer does not cover the whole block when the body is activated or deactivated in it
+    auto& block = simImpl->resultBlocks[blockIndex];
+    const int nextFrame =
+        block.lastFrame - (block.numFrames - 1) + buffer.firstBlockFrame + buffer.numFrames();
 
     if(linkPosBuf.colSize() > 0){
-        bool offsetChanged = false;
-        for(int i=0; i < numBufFrames; ++i){
-            auto buf = linkPosBuf.row(i);
-            if(linkPosResults->numFrames() >= ringBufferSize){
-                linkPosResults->popFrontFrame();
-                offsetChanged = true;
-            }
-            std::copy(buf.begin(), buf.end(), linkPosResults->appendFrame().begin());
-        }
-        if(offsetChanged){
-            linkPosResults->setOffsetTimeFrame(nextFrame - linkPosResults->numFrames());
-        }
+        appendFramesToRingBuffer(
+            *linkPosResults, 0, linkPosBuf.rowSize(), ringBufferSize, nextFrame,
+            [&](int bufFrame, MultiSE3Seq::Frame frame){
+                auto buf = linkPosBuf.row(bufFrame);
+                std::copy(buf.begin(), buf.end(), frame.begin());
+            });
     }
     if(jointPosBuf.colSize() > 0){
-        bool offsetChanged = false;
-        for(int i=0; i < numBufFrames; ++i){
-            auto buf = jointPosBuf.row(i);
-            if(jointPosResults->numFrames() >= ringBufferSize){
-                jointPosResults->popFrontFrame();
-                offsetChanged = true;
-            }
-            std::copy(buf.begin(), buf.end(), jointPosResults->appendFrame().begin());
-        }
-        if(offsetChanged){
-            jointPosResults->setOffsetTimeFrame(nextFrame - jointPosResults->numFrames());
-        }
+        appendFramesToRingBuffer(
+            *jointPosResults, 0, jointPosBuf.rowSize(), ringBufferSize, nextFrame,
+            [&](int bufFrame, MultiValueSeq::Frame frame){
+                auto buf = jointPosBuf.row(bufFrame);
+                std::copy(buf.begin(), buf.end(), frame.begin());
+            });
     }
     if(deviceStateBuf.colSize() > 0){
-        bool offsetChanged = false;
-        // This loop begins with the second element to skip the first element to keep the unchanged states
-        for(int i=1; i < deviceStateBuf.rowSize(); ++i){ 
-            auto buf = deviceStateBuf.row(i);
-            if(deviceStateResults->numFrames() >= ringBufferSize){
-                deviceStateResults->popFrontFrame();
-                offsetChanged = true;
-            }
-            std::copy(buf.begin(), buf.end(), deviceStateResults->appendFrame().begin());
-        }
-        if(offsetChanged){
-            deviceStateResults->setOffsetTimeFrame(nextFrame - deviceStateResults->numFrames());
-        }
+        appendFramesToRingBuffer(
+            *deviceStateResults, 0, deviceStateBuf.rowSize(), ringBufferSize, nextFrame,
+            [&](int bufFrame, MultiDeviceStateSeq::Frame frame){
+                auto buf = deviceStateBuf.row(bufFrame);
+                std::copy(buf.begin(), buf.end(), frame.begin());
+            });
     }
 }
 
 
-void SimulationBody::Impl::flushResultsToBody()
+void SimulationBody::Impl::flushResultsToBody(ResultBuffer& buffer)
 {
     Body* orgBody = bodyItem->body();
-    if(!linkPosBuf.empty()){
-        auto last = linkPosBuf.last();
+    if(!buffer.linkPosBuf.empty()){
+        auto last = buffer.linkPosBuf.last();
         const int n = last.size();
         for(int i=0; i < n; ++i){
             SE3& pos = last[i];
@@ -1123,17 +1442,16 @@ void SimulationBody::Impl::flushResultsToBody()
             link->R() = pos.rotation().toRotationMatrix();
         }
     }
-    if(!jointPosBuf.empty()){
-        auto last = jointPosBuf.last();
+    if(!buffer.jointPosBuf.empty()){
+        auto last = buffer.jointPosBuf.last();
         const int n = body_->numJoints();
         for(int i=0; i < n; ++i){
             orgBody->joint(i)->q() = last[i];
         }
     }
-    if(!deviceStateBuf.empty()){
-        devicesToNotifyResults.clear();
+    if(!buffer.deviceStateBuf.empty()){
         const DeviceList<>& devices = orgBody->devices();
-        auto ds = deviceStateBuf.last();
+        auto ds = buffer.deviceStateBuf.last();
         const int ndevices = devices.size();
         for(int i=0; i < ndevices; ++i){
             const DeviceStatePtr& s = ds[i];
@@ -1141,31 +1459,46 @@ void SimulationBody::Impl::flushResultsToBody()
                 Device* device = devices[i];
                 device->copyStateFrom(*s);
                 prevFlushedDeviceStateInDirectMode[i] = s;
-                devicesToNotifyResults.push_back(device);
+                // The device may be waiting for the notification of the previous state
+                if(std::find(devicesToNotifyResults.begin(), devicesToNotifyResults.end(), device)
+                   == devicesToNotifyResults.end()){
+                    devicesToNotifyResults.push_back(device);
+                }
             }
         }
     }
+
+    if(!isResultNotificationPending){
+        isResultNotificationPending = true;
+        simImpl->simBodyImplsToNotifyResults.push_back(this);
+    }
 }
 
 
-void SimulationBody::Impl::flushResultsToWorldLogFile(int bufferFrame)
+void SimulationBody::Impl::flushResultsToWorldLogFile(int blockIndex, int blockFrame)
 {
-    //if(bufferFrame < linkPosBuf.rowSize()){
-    
+    auto& buffer = resultBuffers[blockIndex];
+    const int bufferFrame = blockFrame - buffer.firstBlockFrame;
+
     WorldLogFileItem* log = simImpl->worldLogFileItem;
     log->beginBodyStateOutput();
 
-    if(linkPosBuf.colSize() > 0){
-        auto posbuf = linkPosBuf.row(bufferFrame);
+    // The state is empty in the frames where the body is not active
+    if(bufferFrame < 0 || bufferFrame >= buffer.numFrames()){
+        log->endBodyStateOutput();
+        return;
+    }
+
+    if(buffer.linkPosBuf.colSize() > 0){
+        auto posbuf = buffer.linkPosBuf.row(bufferFrame);
         log->outputLinkPositions(posbuf.begin(), posbuf.size());
     }
-    if(jointPosBuf.colSize() > 0){
-        auto jointbuf = jointPosBuf.row(bufferFrame);
+    if(buffer.jointPosBuf.colSize() > 0){
+        auto jointbuf = buffer.jointPosBuf.row(bufferFrame);
         log->outputJointPositions(jointbuf.begin(), jointbuf.size());
     }
-    if(deviceStateBuf.colSize() > 0){
-        // Skip the first element because it is used for sharing an unchanged state
-        auto states = deviceStateBuf.row(bufferFrame + 1);
+    if(buffer.deviceStateBuf.colSize() > 0){
+        auto states = buffer.deviceStateBuf.row(bufferFrame);
         log->beginDeviceStateOutput();
         for(int i=0; i < states.size(); ++i){
             log->outputDeviceState(states[i]);
@@ -1174,8 +1507,12 @@ void SimulationBody::Impl::flushResultsToWorldLogFile(int bufferFrame)
     }
 
     log->endBodyStateOutput();
+}
 
-    //}
+
+bool SimulationBody::Impl::isShownInScene() const
+{
+    return bodyItem->existingSceneBody() && bodyItem->isChecked(Item::LogicalSumOfAllChecks);
 }
 
 
@@ -1193,6 +1530,9 @@ void SimulationBody::Impl::notifyResults(double time)
     for(Device* device : bodyItem->body()->devices()){
         device->notifyTimeChange(time);
     }
+    devicesToNotifyResults.clear();
+    isResultNotificationPending = false;
+    lastResultNotificationTime = std::chrono::steady_clock::now();
 }
 
 
@@ -1224,6 +1564,29 @@ SimulatorItem::Impl::Impl(SimulatorItem* self)
     worldFrameRate = 1.0;
     worldTimeStep_ = 1.0;
     frameAtLastBufferWriting = 0;
+    actualSimulationTime = 0.0;
+    finishTime = 0.0;
+    isStoppedByError = false;
+    isSimulationCompleted = false;
+    isRecordingEnabled = false;
+    isRingBufferMode = false;
+    maxFrame = std::numeric_limits<int>::max();
+    ringBufferSize = std::numeric_limits<int>::max();
+    numMeasuredSteps = 0;
+    totalStepTime = 0.0;
+    minStepTime = 0.0;
+    maxStepTime = 0.0;
+    numPublishedResultBlocks = 0;
+    numConsumedResultBlocks = 0;
+    resultBlockFrameCapacity = 1;
+    resultBlockIndexToFlush = 0;
+    lastFlushedFrame = 0;
+    numPublishedResultFrames = 0;
+    numDeferredResultFrames = 0;
+    maxNumResultBlockFrames = 0;
+    displayUpdateBudget = std::chrono::steady_clock::duration::zero();
+    numDisplayUpdates = 0;
+    displayUpdateRate = 0.0;
     flushTimer.sigTimeout().connect([&](){ flushResults(); });
 
     recordingMode.setSymbol(SimulatorItem::REC_FULL, N_("full"));
@@ -1242,6 +1605,13 @@ SimulatorItem::Impl::Impl(SimulatorItem* self)
     isAllLinkPositionOutputMode = true;
     isDeviceStateOutputEnabled = true;
     isDoingSimulationLoop = false;
+    isStateResetRequested = false;
+    isRestartRequested = false;
+    initialFrame = 0;
+    checkpointInterval = 0.0;
+    nextCheckpointFrame = 0;
+    isCheckpointRequested = false;
+    numPendingCheckpoints = 0;
     isRealtimeSyncMode = true;
     recordCollisionData = false;
 
@@ -1273,6 +1643,8 @@ SimulatorItem::Impl::Impl(SimulatorItem* self, const Impl& org)
     isRealtimeSyncMode = org.isRealtimeSyncMode;
     recordCollisionData = org.recordCollisionData;
     controllerOptionString_ = org.controllerOptionString_;
+    checkpointInterval = org.checkpointInterval;
+    checkpointFile = org.checkpointFile;
 }
     
 
@@ -1562,6 +1934,10 @@ void SimulatorItem::Impl::clearSimulation()
     allSimBodies.clear();
     simBodiesWithBody.clear();;
     activeSimBodies.clear();
+    simBodyImplsToNotifyResults.clear();
+    for(auto& block : resultBlocks){
+        block.simBodies.clear();
+    }
     needToUpdateSimBodyLists = true;
 
     preDynamicsFunctions.clear();
@@ -1606,6 +1982,11 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
     
     stopSimulation(true);
 
+    isStateResetRequested = false;
+    isRestartRequested = false;
+    isCheckpointRequested = false;
+    requestedCheckpointFiles.clear();
+
     if(!worldItem){
         mv->putln(format(_("{} must be in a WorldItem to do simulation."), self->displayName()),
                   MessageView::Error);
@@ -1620,9 +2001,17 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
 
     cloneMap.clear();
 
-    currentFrame = 0;
+    initialFrame = checkpointToResume ? checkpointToResume->frame : 0;
+    resumedCheckpoint = checkpointToResume;
+    currentFrame = initialFrame;
     worldTimeStep_ = self->worldTimeStep();
+
+    numMeasuredSteps = 0;
+    totalStepTime = 0.0;
+    minStepTime = 0.0;
+    maxStepTime = 0.0;
     worldFrameRate = 1.0 / worldTimeStep_;
+    initializeResultBlocks();
 
     if(recordingMode.is(SimulatorItem::REC_NONE)){
         isRecordingEnabled = false;
@@ -1632,6 +2021,19 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
         isRingBufferMode = recordingMode.is(SimulatorItem::REC_TAIL);
     }
 
+    // The ring buffer size is determined before the bodies reserve their result buffers
+    ringBufferSize = std::numeric_limits<int>::max();
+    if(timeRangeMode.is(SimulatorItem::TR_SPECIFIED)){
+        maxFrame = specifiedTimeLength / worldTimeStep_;
+    } else if(timeRangeMode.is(SimulatorItem::TR_TIMEBAR)){
+        maxFrame = TimeBar::instance()->maxTime() / worldTimeStep_;
+    } else if(isRingBufferMode){
+        maxFrame = std::numeric_limits<int>::max();
+        ringBufferSize = std::max(1, static_cast<int>(specifiedTimeLength / worldTimeStep_));
+    } else {
+        maxFrame = std::numeric_limits<int>::max();
+    }
+
     clearSimulation();
     bodyMotionEngines.clear();
 
@@ -1653,6 +2055,18 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
                           MessageView::Warning);
             } else {
                 if(simBody->body()){
+                    if(checkpointToResume){
+                        /*
+                          The clone starts from the positions in the checkpoint so that the engine is
+                          initialized with them. The other states are restored by restoreCheckpoint.
+                        */
+                        const int index = allSimBodies.size();
+                        auto& bodies = checkpointToResume->bodies;
+                        if(index < static_cast<int>(bodies.size()) && bodies[index].index == index &&
+                           bodies[index].name == simBody->body()->name()){
+                            SimulationCheckpoint::restoreLinkStates(simBody->body(), bodies[index].linkStates);
+                        }
+                    }
                     if(simBody->initialize(self, bodyItem)){
                         // copy the body state overwritten by the controller
                         simBody->impl->copyStateToBodyItem();
@@ -1680,10 +2094,12 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
         }
     }
 
-    numBufferedFrames = 1;
+    // The initial states put by the simulation bodies
+    auto& initialResultBlock = resultBlocks[writingResultBlockIndex()];
+    initialResultBlock.numFrames = 1;
+    initialResultBlock.lastFrame = initialFrame;
     
     if(isRecordingEnabled && recordCollisionData){
-        collisionPairsBuf.clear();
         string collisionSeqName = self->name() + "-collisions";
         auto collisionSeqItem = worldItem->findChildItem<CollisionSeqItem>(collisionSeqName);
         if(!collisionSeqItem){
@@ -1698,6 +2114,7 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
         collisionSeq->setFrameRate(worldFrameRate);
         collisionSeq->setNumParts(1);
         collisionSeq->setNumFrames(1);
+        collisionSeq->setOffsetTimeFrame(initialFrame);
         CollisionSeq::Frame frame0 = collisionSeq->frame(0);
         frame0[0]  = std::make_shared<CollisionLinkPairList>();
     }
@@ -1779,24 +2196,22 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
         }
     }
 
+    if(result && checkpointToResume){
+        result = restoreCheckpoint(*checkpointToResume);
+    }
+
     if(result){
-        frameAtLastBufferWriting = 0;
+        frameAtLastBufferWriting = initialFrame;
         isDoingSimulationLoop = true;
         isWaitingForSimulationToStop = false;
         stopRequested = false;
         pauseRequested = false;
+        isStoppedByError = false;
+        isSimulationCompleted = false;
 
-        ringBufferSize = std::numeric_limits<int>::max();
-        
-        if(timeRangeMode.is(SimulatorItem::TR_SPECIFIED)){
-            maxFrame = specifiedTimeLength / worldTimeStep_;
-        } else if(timeRangeMode.is(SimulatorItem::TR_TIMEBAR)){
-            maxFrame = TimeBar::instance()->maxTime() / worldTimeStep_;
-        } else if(isRingBufferMode){
-            maxFrame = std::numeric_limits<int>::max();
-            ringBufferSize = specifiedTimeLength / worldTimeStep_;
-        } else {
-            maxFrame = std::numeric_limits<int>::max();
+        if(isRingBufferMode && ringBufferSize < std::numeric_limits<int>::max() &&
+           isRecordingEnabled && recordCollisionData){
+            collisionSeq->reserveFrames(ringBufferSize);
         }
 
         useControllerThreads = useControllerThreadsProperty;
@@ -1834,13 +2249,13 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
                 }
                 worldLogFileItem->endHeaderOutput();
                 worldLogFileItem->notifyUpdate();
-                nextLogFrame = 0;
-                nextLogTime = 0.0;
                 double r = worldLogFileItem->recordingFrameRate();
                 if(r == 0.0){
                     r = worldFrameRate;
                 }
                 logTimeStep = 1.0 / r;
+                nextLogFrame = static_cast<int>(std::ceil(initialFrame * worldTimeStep_ / logTimeStep));
+                nextLogTime = nextLogFrame * logTimeStep;
             }
         }
 
@@ -1848,13 +2263,34 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
             fillLevelId = timeBar->startFillLevelUpdate();
         }
         if(!timeBar->isDoingPlayback()){
-            timeBar->setTime(0.0);
+            timeBar->setTime(initialFrame / worldFrameRate);
             timeBar->startPlayback();
         }
 
-        flushResults();
+        const double flushInterval = 1.0 / timeBar->playbackFrameRate();
+        displayUpdateBudget =
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(flushInterval * DisplayUpdateBudgetRatio));
+        simBodyImplsToNotifyResults.clear();
+        nextDisplayUpdateTime = std::chrono::steady_clock::now();
+        displayUpdateStartTime = nextDisplayUpdateTime;
+        numDisplayUpdates = 0;
+        displayUpdateRate = 0.0;
+
+        for(auto& simBody : simBodiesWithBody){
+            simBody->impl->storeInitialState();
+        }
+        if(checkpointInterval > 0.0 && !checkpointFile.empty()){
+            nextCheckpointFrame =
+                initialFrame + std::max(1, static_cast<int>(std::round(checkpointInterval * worldFrameRate)));
+        } else {
+            nextCheckpointFrame = std::numeric_limits<int>::max();
+        }
+
+        publishResultBlock();
+        flushResults(true);
         start();
-        flushTimer.start(1000.0 / timeBar->playbackFrameRate());
+        flushTimer.start(flushInterval * 1000.0);
 
         mv->notify(format(_("Simulation by {} has started."), self->displayName()));
 
@@ -1933,7 +2369,7 @@ void SimulatorItem::Impl::run()
     QElapsedTimer timer;
     timer.start();
 
-    int frame = 0;
+    int frame = currentFrame;
     bool isOnPause = false;
 
     if(isRealtimeSyncMode){
@@ -1951,6 +2387,8 @@ void SimulatorItem::Impl::run()
                     isOnPause = true;
                     sigSimulationPaused();
                 }
+                // Pass the remaining results so that the main thread can show the latest state
+                publishResultBlock();
                 QThread::msleep(50);
             } else {
                 if(isOnPause){
@@ -1988,6 +2426,8 @@ void SimulatorItem::Impl::run()
                     isOnPause = true;
                     sigSimulationPaused();
                 }
+                // Pass the remaining results so that the main thread can show the latest state
+                publishResultBlock();
                 QThread::msleep(50);
             } else {
                 if(isOnPause){
@@ -2008,6 +2448,14 @@ void SimulatorItem::Impl::run()
     actualSimulationTime = (elapsedTime / 1000.0);
     finishTime = frame / worldFrameRate;
 
+    /*
+      Without the frame limit, the loop only ends normally when all the controllers have
+      become inactive in the active control period mode.
+    */
+    isSimulationCompleted =
+        !stopRequested && !isStoppedByError &&
+        (frame >= maxFrame || doStopSimulationWhenNoActiveControllers);
+
     isDoingSimulationLoop = false;
 
     if(useControllerThreads){
@@ -2038,6 +2486,11 @@ void SimulatorItem::Impl::updateSimBodyLists()
         auto simBodyImpl = simBody->impl;
         auto& controllerInfos = simBodyImpl->controllerInfos;
         if(simBodyImpl->isActive){
+            if(simBodyImpl->isResultBufferInitializationRequested){
+                simBodyImpl->isResultBufferInitializationRequested = false;
+                simBody->initializeResultBuffers();
+                simBody->bufferResults();
+            }
             activeSimBodies.push_back(simBody);
             if(controllerInfos.empty()){
                 hasActiveFreeBodies = true;
@@ -2048,12 +2501,165 @@ void SimulatorItem::Impl::updateSimBodyLists()
        }
     }
 
+    // The bodies activated while writing the current block must be flushed with the block
+    auto& simBodiesInBlock = resultBlocks[writingResultBlockIndex()].simBodies;
+    for(auto& simBody : activeSimBodies){
+        if(std::find(simBodiesInBlock.begin(), simBodiesInBlock.end(), simBody) == simBodiesInBlock.end()){
+            simBodiesInBlock.push_back(simBody);
+        }
+    }
+
     needToUpdateSimBodyLists = false;
 }
 
 
+void SimulatorItem::Impl::initializeResultBlocks()
+{
+    numPublishedResultBlocks = 0;
+    numConsumedResultBlocks = 0;
+
+    // The number of frames simulated in a cycle of flushing the results at the normal speed
+    const double flushRate = timeBar->playbackFrameRate();
+    resultBlockFrameCapacity = (flushRate > 0.0) ? (static_cast<int>(worldFrameRate / flushRate) + 1) : 1;
+
+    for(auto& block : resultBlocks){
+        block.simBodies.clear();
+        block.collisionPairsBuf.clear();
+        block.collisionPairsBuf.reserve(resultBlockFrameCapacity * 2);
+        block.numFrames = 0;
+        block.lastFrame = initialFrame;
+    }
+    resultBlockIndexToFlush = 0;
+    lastFlushedFrame = initialFrame;
+    numPublishedResultFrames = 0;
+    numDeferredResultFrames = 0;
+    maxNumResultBlockFrames = 0;
+}
+
+
+/**
+   This function is called by the simulation thread
+*/
+void SimulatorItem::Impl::bufferResults(shared_ptr<CollisionLinkPairList>& collisionPairs)
+{
+    auto& block = resultBlocks[writingResultBlockIndex()];
+
+    for(auto& simBody : activeSimBodies){
+        simBody->bufferResults();
+    }
+    block.collisionPairsBuf.push_back(collisionPairs);
+    ++block.numFrames;
+    block.lastFrame = currentFrame;
+    frameAtLastBufferWriting.store(currentFrame, std::memory_order_relaxed);
+
+    if(!publishResultBlock() && block.numFrames > resultBlockFrameCapacity){
+        // The main thread does not keep up with the simulation
+        numDeferredResultFrames.fetch_add(1, std::memory_order_relaxed);
+
+        /*
+          The frames older than the ring buffer are discarded when they are flushed in the tail
+          recording mode, so they are discarded here to limit the block size while the main
+          thread stalls. The frames are kept for the world log file, which records all the frames.
+        */
+        if(isRingBufferMode && !worldLogFileItem && block.numFrames - ringBufferSize >= resultBlockFrameCapacity){
+            trimResultBlock(block, block.numFrames - ringBufferSize);
+        }
+    }
+}
+
+
+/**
+   Remove the first frames of the block being written.
+   This function must be called by the thread writing the results.
+*/
+void SimulatorItem::Impl::trimResultBlock(ResultBlock& block, int numFramesToRemove)
+{
+    const int blockIndex = writingResultBlockIndex();
+    for(auto& simBody : block.simBodies){
+        simBody->impl->trimResultBuffer(blockIndex, numFramesToRemove);
+    }
+    auto& collisionPairsBuf = block.collisionPairsBuf;
+    collisionPairsBuf.erase(
+        collisionPairsBuf.begin(),
+        collisionPairsBuf.begin() + std::min(numFramesToRemove, static_cast<int>(collisionPairsBuf.size())));
+    block.numFrames -= numFramesToRemove;
+}
+
+
+/**
+   Pass the block of the buffered results to the main thread when the main thread has flushed
+   all the published blocks or the block is filled with the frames of a flushing cycle.
+   This function does not wait for the main thread and must be called by the thread writing
+   the results.
+   \return true if the block is published
+*/
+bool SimulatorItem::Impl::publishResultBlock()
+{
+    const unsigned int numPublished = numPublishedResultBlocks.load(std::memory_order_relaxed);
+    const unsigned int numPending = numPublished - numConsumedResultBlocks.load(std::memory_order_acquire);
+    auto& block = resultBlocks[numPublished % NumResultBlocks];
+
+    if(block.numFrames == 0 || (numPending > 0 && block.numFrames < resultBlockFrameCapacity)){
+        return false;
+    }
+    // The next block must not be used by the main thread
+    if(numPending >= NumResultBlocks - 1){
+        return false;
+    }
+
+    if(block.numFrames > maxNumResultBlockFrames.load(std::memory_order_relaxed)){
+        maxNumResultBlockFrames.store(block.numFrames, std::memory_order_relaxed);
+    }
+    numPublishedResultFrames.fetch_add(block.numFrames, std::memory_order_relaxed);
+
+    const int nextBlockIndex = (numPublished + 1) % NumResultBlocks;
+    auto& nextBlock = resultBlocks[nextBlockIndex];
+    nextBlock.simBodies = activeSimBodies;
+    nextBlock.collisionPairsBuf.clear();
+    nextBlock.numFrames = 0;
+    nextBlock.lastFrame = block.lastFrame;
+    for(auto& simBody : activeSimBodies){
+        simBody->impl->prepareResultBuffer(nextBlockIndex);
+    }
+
+    numPublishedResultBlocks.store(numPublished + 1, std::memory_order_release);
+
+    return true;
+}
+
+
 bool SimulatorItem::Impl::stepSimulationMain()
 {
+    auto stepStartTime = std::chrono::steady_clock::now();
+    
+    if(isStateResetRequested){
+        isStateResetRequested = false;
+        if(!resetSimulationState()){
+            // The simulation is not stopped by an error when it is restarted
+            isStoppedByError = !isRestartRequested;
+            return false;
+        }
+    }
+
+    if(isCheckpointRequested){
+        vector<string> filenames;
+        {
+            std::lock_guard<std::mutex> lock(checkpointMutex);
+            filenames.swap(requestedCheckpointFiles);
+            isCheckpointRequested = false;
+        }
+        for(auto& filename : filenames){
+            takeCheckpoint(filename);
+        }
+    }
+    if(currentFrame >= nextCheckpointFrame){
+        // A periodic checkpoint is skipped while the previous one is being written
+        if(numPendingCheckpoints == 0){
+            takeCheckpoint(checkpointFile);
+        }
+        nextCheckpointFrame += std::max(1, static_cast<int>(std::round(checkpointInterval * worldFrameRate)));
+    }
+
     currentFrame++;
 
     if(needToUpdateSimBodyLists){
@@ -2110,18 +2716,7 @@ bool SimulatorItem::Impl::stepSimulationMain()
 
     postDynamicsFunctions.call();
 
-    {
-        resultBufMutex.lock();
-
-        ++numBufferedFrames;
-        for(size_t i=0; i < activeSimBodies.size(); ++i){
-            activeSimBodies[i]->bufferResults();
-        }
-        collisionPairsBuf.push_back(collisionPairs);
-        frameAtLastBufferWriting = currentFrame;
-
-        resultBufMutex.unlock();
-    }
+    bufferResults(collisionPairs);
 
     if(useControllerThreads){
         for(size_t i=0; i < activeControllers.size(); ++i){
@@ -2136,10 +2731,176 @@ bool SimulatorItem::Impl::stepSimulationMain()
         }
     }
 
+    const double stepTime =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - stepStartTime).count();
+    if(numMeasuredSteps == 0){
+        minStepTime = stepTime;
+        maxStepTime = stepTime;
+    } else if(stepTime < minStepTime){
+        minStepTime = stepTime;
+    } else if(stepTime > maxStepTime){
+        maxStepTime = stepTime;
+    }
+    totalStepTime += stepTime;
+    ++numMeasuredSteps;
+
     return doContinue;
 }
 
 
+void SimulatorItem::requestStateReset()
+{
+    impl->isStateResetRequested = true;
+}
+
+
+bool SimulatorItem::resetSimulationState(const std::vector<SimulationBody*>& /* simBodies */)
+{
+    return false;
+}
+
+
+/**
+   The bodies, the collision models and the controllers created at the start are reused as they are.
+   Only when the engine cannot update its internal state, the simulation loop is stopped and the
+   simulation is started again by the main thread.
+*/
+bool SimulatorItem::Impl::resetSimulationState()
+{
+    for(auto& simBody : simBodiesWithBody){
+        simBody->impl->restoreInitialState(simBody->body());
+    }
+    if(!self->resetSimulationState(simBodiesWithBody)){
+        isRestartRequested = true;
+        return false;
+    }
+    sigSimulationStateReset();
+    return true;
+}
+
+
+void SimulatorItem::requestCheckpoint(const std::string& filename)
+{
+    std::lock_guard<std::mutex> lock(impl->checkpointMutex);
+    impl->requestedCheckpointFiles.push_back(filename);
+    impl->isCheckpointRequested = true;
+}
+
+
+void SimulatorItem::setCheckpointInterval(double interval, const std::string& filename)
+{
+    impl->checkpointInterval = std::max(0.0, interval);
+    impl->checkpointFile = filename;
+}
+
+
+bool SimulatorItem::storeCheckpointData(std::vector<double>& /* out_data */)
+{
+    return false;
+}
+
+
+bool SimulatorItem::restoreCheckpointData(const std::vector<double>& /* data */)
+{
+    return false;
+}
+
+
+/**
+   The state is copied into memory here, and only the file output is done by the writer thread.
+*/
+void SimulatorItem::Impl::takeCheckpoint(const string& filename)
+{
+    auto checkpoint = std::make_shared<SimulationCheckpoint>();
+    checkpoint->frame = currentFrame;
+    checkpoint->timeStep = worldTimeStep_;
+    checkpoint->bodies.resize(allSimBodies.size());
+    for(size_t i=0; i < allSimBodies.size(); ++i){
+        checkpoint->bodies[i].index = i;
+        allSimBodies[i]->impl->storeCheckpoint(checkpoint->bodies[i]);
+    }
+    checkpoint->hasEngineData = self->storeCheckpointData(checkpoint->engineData);
+
+    if(!checkpointWriter){
+        checkpointWriter.reset(new ThreadPool(1));
+    }
+    ++numPendingCheckpoints;
+    auto mv = this->mv;
+    checkpointWriter->start(
+        [this, checkpoint, filename, mv](){
+            if(!checkpoint->write(filename)){
+                callLater([mv, filename](){
+                    mv->putln(format(_("The checkpoint cannot be written to \"{}\"."), filename),
+                              MessageView::Error); });
+            }
+            --numPendingCheckpoints;
+        });
+}
+
+
+bool SimulatorItem::startSimulationFromCheckpoint(const std::string& filename)
+{
+    return impl->startSimulationFromCheckpoint(filename);
+}
+
+
+bool SimulatorItem::Impl::startSimulationFromCheckpoint(const string& filename)
+{
+    auto checkpoint = std::make_shared<SimulationCheckpoint>();
+    if(!checkpoint->read(filename)){
+        mv->putln(format(_("\"{}\" is not a valid simulation checkpoint file."), filename),
+                  MessageView::Error);
+        return false;
+    }
+    if(checkpoint->timeStep != self->worldTimeStep()){
+        mv->putln(format(_("The time step of the checkpoint \"{0}\" is different from the one of {1}."),
+                         filename, self->displayName()),
+                  MessageView::Error);
+        return false;
+    }
+
+    checkpointToResume = checkpoint;
+    bool result = startSimulation(false);
+    checkpointToResume.reset();
+
+    if(result){
+        mv->putln(format(_("The simulation has been resumed from \"{0}\" at {1} [s]."),
+                         filename, initialFrame / worldFrameRate));
+    }
+    return result;
+}
+
+
+/**
+   This function is called after the engine and the controllers are initialized.
+*/
+bool SimulatorItem::Impl::restoreCheckpoint(const SimulationCheckpoint& checkpoint)
+{
+    bool restored = (checkpoint.bodies.size() == allSimBodies.size());
+    for(size_t i=0; restored && i < allSimBodies.size(); ++i){
+        auto& data = checkpoint.bodies[i];
+        restored = (data.index == static_cast<int>(i)) && allSimBodies[i]->impl->restoreCheckpoint(data);
+    }
+    if(!restored){
+        mv->putln(_("The bodies of the checkpoint do not match the ones of the simulation."),
+                  MessageView::Error);
+        return false;
+    }
+    if(!(checkpoint.hasEngineData && self->restoreCheckpointData(checkpoint.engineData))){
+        if(!self->resetSimulationState(simBodiesWithBody)){
+            mv->putln(format(_("{} cannot restore its state from the checkpoint."), self->displayName()),
+                      MessageView::Error);
+            return false;
+        }
+        if(checkpoint.hasEngineData){
+            mv->putln(format(_("The engine state in the checkpoint is not used by {}."), self->displayName()),
+                      MessageView::Warning);
+        }
+    }
+    return true;
+}
+
+
 void SimulatorItem::Impl::concurrentControlLoop()
 {
     while(true){
@@ -2176,7 +2937,7 @@ exitConcurrentControlLoop:
 }
 
 
-void SimulatorItem::Impl::flushResults()
+void SimulatorItem::Impl::flushResults(bool doNotifyAllResults)
 {
     int frame = flushMainResults();
 
@@ -2188,64 +2949,121 @@ void SimulatorItem::Impl::flushResults()
         double fillLevel = frame / worldFrameRate;
         timeBar->updateFillLevel(fillLevelId, fillLevel);
     } else {
-        const double time = frame / worldFrameRate;
-        for(size_t i=0; i < activeSimBodies.size(); ++i){
-            activeSimBodies[i]->impl->notifyResults(time);
+        notifyResults(frame / worldFrameRate, doNotifyAllResults);
+    }
+}
+
+
+/**
+   Notify the bodies of the results flushed in the no recording mode.
+   The bodies are notified in the order of waiting until the time budget for a display update
+   is used up, and the remaining bodies are notified in the next update. The bodies which are
+   not shown in any scene view are notified at a low rate. When an update takes longer than
+   the flushing interval, the following updates are skipped for the same time so that the
+   display updates do not occupy the main thread. The skipped results are coalesced into
+   the next update because only the latest state is kept in the bodies.
+*/
+void SimulatorItem::Impl::notifyResults(double time, bool doNotifyAll)
+{
+    using std::chrono::steady_clock;
+    
+    const auto startTime = steady_clock::now();
+    if(!doNotifyAll && startTime < nextDisplayUpdateTime){
+        return;
+    }
+    const auto deadline = startTime + displayUpdateBudget;
+    const auto hiddenBodyUpdateInterval =
+        std::chrono::duration_cast<steady_clock::duration>(std::chrono::duration<double>(HiddenBodyUpdateInterval));
+
+    auto& simBodyImpls = simBodyImplsToNotifyResults;
+    size_t numWaitingBodies = 0;
+    bool isBudgetUsedUp = false;
+    for(size_t i=0; i < simBodyImpls.size(); ++i){
+        auto simBodyImpl = simBodyImpls[i];
+        bool doNotify = doNotifyAll;
+        if(!doNotify && !isBudgetUsedUp){
+            doNotify = simBodyImpl->isShownInScene() ||
+                (startTime - simBodyImpl->lastResultNotificationTime >= hiddenBodyUpdateInterval);
+        }
+        if(doNotify){
+            simBodyImpl->notifyResults(time);
+            if(!doNotifyAll && steady_clock::now() >= deadline){
+                isBudgetUsedUp = true;
+            }
+        } else {
+            simBodyImpls[numWaitingBodies++] = simBodyImpl;
         }
-        timeBar->setTime(time);
+    }
+    simBodyImpls.resize(numWaitingBodies);
+
+    timeBar->setTime(time);
+
+    const auto endTime = steady_clock::now();
+    const auto updateTime = endTime - startTime;
+    if(updateTime > displayUpdateBudget * 2){
+        nextDisplayUpdateTime = endTime + updateTime;
+    } else {
+        nextDisplayUpdateTime = endTime;
+    }
+    ++numDisplayUpdates;
+    const double elapsedTime = std::chrono::duration<double>(endTime - displayUpdateStartTime).count();
+    if(elapsedTime > 0.0){
+        displayUpdateRate = numDisplayUpdates / elapsedTime;
     }
 }
 
 
+/**
+   This function is called by the main thread and flushes the result blocks published by the
+   simulation thread. The blocks are returned to the simulation thread after being flushed.
+*/
 int SimulatorItem::Impl::flushMainResults()
 {
-    resultBufMutex.lock();
+    const unsigned int numPublished = numPublishedResultBlocks.load(std::memory_order_acquire);
+    unsigned int numConsumed = numConsumedResultBlocks.load(std::memory_order_relaxed);
+
+    while(numConsumed != numPublished){
+        resultBlockIndexToFlush = numConsumed % NumResultBlocks;
+        auto& block = resultBlocks[resultBlockIndexToFlush];
 
-    if(worldLogFileItem){
-        if(numBufferedFrames > 0){
-            int firstFrame = frameAtLastBufferWriting - (numBufferedFrames - 1);
-            for(int bufFrame = 0; bufFrame < numBufferedFrames; ++bufFrame){
+        if(worldLogFileItem){
+            int firstFrame = block.lastFrame - (block.numFrames - 1);
+            for(int bufFrame = 0; bufFrame < block.numFrames; ++bufFrame){
                 double time = (firstFrame + bufFrame) * worldTimeStep_;
                 while(time >= nextLogTime){
                     worldLogFileItem->beginFrameOutput(time);
-                    for(size_t i=0; i < activeSimBodies.size(); ++i){
-                        activeSimBodies[i]->impl->flushResultsToWorldLogFile(bufFrame);
+                    for(auto& simBody : block.simBodies){
+                        simBody->impl->flushResultsToWorldLogFile(resultBlockIndexToFlush, bufFrame);
                     }
                     worldLogFileItem->endFrameOutput();
                     nextLogTime = ++nextLogFrame * logTimeStep;
                 }
             }
         }
-    }
     
-    for(auto& simBody : activeSimBodies){
-        simBody->flushResults();
-    }
-
-    bool offsetChanged;
-    if(isRecordingEnabled && recordCollisionData){
-        offsetChanged = false;
-        for(size_t i=0 ; i < collisionPairsBuf.size(); ++i){
-            if(collisionSeq->numFrames() >= ringBufferSize){
-                collisionSeq->popFrontFrame();
-                offsetChanged = true;
+        // Only the latest state is used when the results are not recorded
+        if(isRecordingEnabled || numConsumed + 1 == numPublished){
+            for(auto& simBody : block.simBodies){
+                simBody->flushResults();
             }
-            CollisionSeq::Frame collisionSeq0 = collisionSeq->appendFrame();
-            collisionSeq0[0] = collisionPairsBuf[i];
         }
-        if(offsetChanged){
-            collisionSeq->setOffsetTimeFrame(currentFrame + 1 - collisionSeq->numFrames());
+
+        if(isRecordingEnabled && recordCollisionData){
+            auto& collisionPairsBuf = block.collisionPairsBuf;
+            appendFramesToRingBuffer(
+                *collisionSeq, 0, collisionPairsBuf.size(), ringBufferSize, block.lastFrame + 1,
+                [&](int bufFrame, CollisionSeq::Frame frame){
+                    frame[0] = collisionPairsBuf[bufFrame];
+                });
+        }
+
+        if(block.numFrames > 0){
+            lastFlushedFrame = block.lastFrame;
         }
+        numConsumedResultBlocks.store(++numConsumed, std::memory_order_release);
     }
-    collisionPairsBuf.clear();
-
-    int frame = frameAtLastBufferWriting;
-    
-    numBufferedFrames = 0;
-    
-    resultBufMutex.unlock();
 
-    return frame;
+    return lastFlushedFrame;
 }
 
 
@@ -2320,7 +3138,10 @@ void SimulatorItem::Impl::onSimulationLoopStopped()
         subSimulator->finalizeSimulation();
     }
 
-    flushResults();
+    // The simulation thread has finished, and the block that it could not publish is flushed here
+    flushMainResults();
+    publishResultBlock();
+    flushResults(true);
 
     if(isRecordingEnabled){
         timeBar->stopFillLevelUpdate(fillLevelId);
@@ -2333,9 +3154,54 @@ void SimulatorItem::Impl::onSimulationLoopStopped()
                          actualSimulationTime, (actualSimulationTime / finishTime)));
     }
 
+    if(!isRecordingEnabled && numDisplayUpdates > 0){
+        mv->putln(format(_("The simulation results were displayed at {0:.1f} [Hz]."), displayUpdateRate));
+    }
+
+    if(numDeferredResultFrames > 0){
+        mv->putln(format(_("The results of {0} frames were kept waiting because the GUI could not keep up with "
+                           "the simulation. At most {1} frames were flushed at once."),
+                         numDeferredResultFrames.load(), maxNumResultBlockFrames.load()));
+    }
+
+    /*
+      The bodies of the restarted simulation are cloned from the body items when doReset is false,
+      so the body items are returned to the initial states, which are the states of the checkpoint
+      when the simulation has been resumed from it. The checkpoint is also resumed again.
+    */
+    SimulationCheckpointPtr checkpointToRestart;
+    if(isRestartRequested){
+        for(auto& simBody : simBodiesWithBody){
+            auto bodyItem = simBody->impl->bodyItem;
+            simBody->impl->restoreInitialState(bodyItem->body());
+            bodyItem->notifyKinematicStateChange();
+        }
+        checkpointToRestart = resumedCheckpoint;
+    }
+    resumedCheckpoint.reset();
+
     clearSimulation();
 
-    sigSimulationFinished();
+    /*
+      The restarted simulation continues the current one for the observers of the signals,
+      so sigSimulationFinished is only emitted when the restart fails. The restart is done
+      after returning from this function, which may be called in the handler of another signal.
+    */
+    if(isRestartRequested){
+        isRestartRequested = false;
+        mv->putln(format(_("{} does not support the state reset. The simulation is restarted."),
+                         self->displayName()));
+        callLater([this, checkpointToRestart](){
+            checkpointToResume = checkpointToRestart;
+            bool result = startSimulation(doReset);
+            checkpointToResume.reset();
+            if(!result){
+                sigSimulationFinished();
+            }
+        });
+    } else {
+        sigSimulationFinished();
+    }
 }
 
 
@@ -2377,18 +3243,58 @@ double SimulatorItem::Impl::currentTime() const
 
 int SimulatorItem::simulationFrame() const
 {
-    QMutexLocker locker(&impl->resultBufMutex);
     return impl->frameAtLastBufferWriting;
 }
 
 
 double SimulatorItem::simulationTime() const
 {
-    QMutexLocker locker(&impl->resultBufMutex);
     return impl->frameAtLastBufferWriting / impl->worldFrameRate;
 }
 
 
+double SimulatorItem::actualSimulationTime() const
+{
+    return impl->actualSimulationTime;
+}
+
+
+double SimulatorItem::finishTime() const
+{
+    return impl->finishTime;
+}
+
+
+bool SimulatorItem::isSimulationCompleted() const
+{
+    return impl->isSimulationCompleted;
+}
+
+
+int SimulatorItem::getStepTimeStatistics(double& out_averageTime, double& out_minTime, double& out_maxTime) const
+{
+    const int n = impl->numMeasuredSteps;
+    out_averageTime = (n > 0) ? (impl->totalStepTime / n) : 0.0;
+    out_minTime = impl->minStepTime;
+    out_maxTime = impl->maxStepTime;
+    return n;
+}
+
+
+double SimulatorItem::displayUpdateRate() const
+{
+    return impl->displayUpdateRate;
+}
+
+
+int SimulatorItem::getResultHandoffStatistics(int& out_numDeferredFrames, int& out_maxNumFramesPerBlock) const
+{
+    out_numDeferredFrames = impl->numDeferredResultFrames.load(std::memory_order_relaxed);
+    out_maxNumFramesPerBlock = impl->maxNumResultBlockFrames.load(std::memory_order_relaxed);
+    return impl->numPublishedResultFrames.load(std::memory_order_relaxed);
+}
+
+
 double SimulatorItem::Impl::timeStep() const
 {
     return worldTimeStep_;
@@ -2431,6 +3337,12 @@ SignalProxy<void()> SimulatorItem::sigSimulationResumed()
 }
 
 
+SignalProxy<void()> SimulatorItem::sigSimulationStateReset()
+{
+    return impl->sigSimulationStateReset;
+}
+
+
 SignalProxy<void()> SimulatorItem::sigSimulationFinished()
 {
     return impl->sigSimulationFinished;
@@ -2631,6 +3543,9 @@ void SimulatorItem::Impl::doPutProperties(PutPropertyFunction& putProperty)
                 changeProperty(useControllerThreadsProperty));
     putProperty(_("Controller options"), controllerOptionString_,
                 changeProperty(controllerOptionString_));
+    putProperty.min(0.0)(_("Checkpoint interval"), checkpointInterval, changeProperty(checkpointInterval));
+    putProperty.reset();
+    putProperty(_("Checkpoint file"), checkpointFile, changeProperty(checkpointFile));
 }
 
 
@@ -2656,6 +3571,12 @@ bool SimulatorItem::Impl::store(Archive& archive)
     archive.write("controllerThreads", useControllerThreadsProperty);
     archive.write("recordCollisionData", recordCollisionData);
     archive.write("controllerOptions", controllerOptionString_, DOUBLE_QUOTED);
+    if(checkpointInterval > 0.0){
+        archive.write("checkpointInterval", checkpointInterval);
+    }
+    if(!checkpointFile.empty()){
+        archive.writeRelocatablePath("checkpointFile", checkpointFile);
+    }
 
     ListingPtr idseq = new Listing();
     idseq->setFlowStyle(true);
@@ -2732,6 +3653,8 @@ bool SimulatorItem::Impl::restore(const Archive& archive)
     archive.read("recordCollisionData", recordCollisionData);
     archive.read("controllerThreads", useControllerThreadsProperty);
     archive.read("controllerOptions", controllerOptionString_);
+    archive.read("checkpointInterval", checkpointInterval);
+    archive.readRelocatablePath("checkpointFile", checkpointFile);
 
     archive.addPostProcess([&](){ restoreBodyMotionEngines(archive); });
     
@@ -97,6 +97,38 @@ public:
     virtual void stopSimulation();
     virtual void pauseSimulation();
     virtual void restartSimulation();
+
+    /**
+       Requests to return the simulation to the state just after it started.
+       The request is processed in the simulation thread before the next step. The states of the
+       bodies and the devices are restored from the ones stored at the start, and the engine updates
+       its internal state by resetSimulationState without rebuilding the world. If the engine does
+       not support it, the simulation is restarted from scratch instead.
+       \note The simulation frame continues from the current one so that the results are recorded
+       continuously.
+    */
+    void requestStateReset();
+
+    /**
+       Requests to write a checkpoint of the running simulation to a file.
+       The state is copied in the simulation thread before the next step, and the file is written
+       by a background thread so that the simulation is not stalled.
+    */
+    void requestCheckpoint(const std::string& filename);
+
+    /**
+       Checkpoints are written to the file every time the simulation time advances by the interval.
+       The file is replaced by each checkpoint. The interval of zero disables the periodic checkpoints.
+    */
+    void setCheckpointInterval(double interval, const std::string& filename);
+
+    /**
+       Starts the simulation from the state stored in a checkpoint file.
+       The bodies, the controllers and the engine must be the same as the ones of the simulation
+       in which the checkpoint was written.
+    */
+    bool startSimulationFromCheckpoint(const std::string& filename);
+
     bool isRunning() const;
     bool isPausing() const;
     bool isActive() const; ///< isRunning() && !isPausing()
@@ -112,10 +144,48 @@ public:
 
     //! This can be called from non simulation threads
     double simulationTime() const;
+
+    //! Elapsed real time in seconds taken by the last simulation
+    double actualSimulationTime() const;
+
+    //! Simulation time at which the last simulation finished
+    double finishTime() const;
+
+    /**
+       \return true if the last simulation ran to the end of its time range, false if it was
+       stopped by stopSimulation() or by an error before reaching the end
+    */
+    bool isSimulationCompleted() const;
+
+    /**
+       Get the statistics of the computation time taken by each simulation step in the last simulation.
+       The times are in seconds.
+       \return The number of the measured steps
+    */
+    int getStepTimeStatistics(double& out_averageTime, double& out_minTime, double& out_maxTime) const;
+
+    /**
+       Get the statistics of passing the results from the simulation thread to the main thread
+       in the current or last simulation.
+       \param out_numDeferredFrames The number of the frames kept in the simulation thread longer
+       than a flushing cycle because the main thread had not flushed the previous results
+       \param out_maxNumFramesPerBlock The maximum number of the frames passed at once
+       \return The number of the frames passed to the main thread
+    */
+    int getResultHandoffStatistics(int& out_numDeferredFrames, int& out_maxNumFramesPerBlock) const;
+
+    /**
+       The average rate [Hz] at which the results were displayed in the current or last simulation
+       without recording. The rate is lower than the playback frame rate of the time bar when the
+       display updates are coalesced because the GUI does not keep up with them.
+    */
+    double displayUpdateRate() const;
     
     SignalProxy<void()> sigSimulationStarted();
     SignalProxy<void()> sigSimulationPaused();
     SignalProxy<void()> sigSimulationResumed();
+    //! This signal is emitted from the simulation thread when the state has been reset
+    SignalProxy<void()> sigSimulationStateReset();
     SignalProxy<void()> sigSimulationFinished();
 
     enum RecordingMode { REC_FULL, REC_TAIL, REC_NONE, N_RECORDING_MODES };
@@ -234,6 +304,24 @@ protected:
     */
     virtual bool stepSimulation(const std::vector<SimulationBody*>& activeSimBodies) = 0;
 
+    /**
+       This function is called from the simulation loop thread when the state reset is requested.
+       The states of the bodies have been restored to the ones at the start of the simulation.
+       An engine which can update its internal state to them without rebuilding the world should
+       override this function and return true. The default implementation returns false.
+    */
+    virtual bool resetSimulationState(const std::vector<SimulationBody*>& simBodies);
+
+    /**
+       These functions save the internal state of the engine which is not contained in the states
+       of the bodies into a checkpoint and restore it. storeCheckpointData is called from the
+       simulation thread, and restoreCheckpointData is called from the main thread after the states
+       of the bodies have been restored. If the engine does not store the data, resetSimulationState
+       is used when the simulation is resumed. The default implementations return false.
+    */
+    virtual bool storeCheckpointData(std::vector<double>& out_data);
+    virtual bool restoreCheckpointData(const std::vector<double>& data);
+
     /**
        \note This function is called from the main thread.
     */
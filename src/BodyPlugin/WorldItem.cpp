@@ -73,6 +73,8 @@ public:
     ConnectionSet sigKinematicStateChangedConnections;
 
     Selection collisionDetectorType;
+    Selection collisionShapeProxyType;
+    int maxNumCollisionShapeProxyTriangles;
     BodyCollisionDetector bodyCollisionDetector;
     vector<ColdetBodyInfo> coldetBodyInfos;
     std::shared_ptr<vector<CollisionLinkPairPtr>> collisions;
@@ -91,6 +93,7 @@ public:
     ~WorldItemImpl();
     void init();
     bool selectCollisionDetector(int index);
+    void setCollisionShapeProxy(int type, int maxNumTriangles);
     void enableCollisionDetection(bool on);
     void clearCollisionDetector();
     void updateCollisionDetector(bool forceUpdate);
@@ -121,6 +124,7 @@ WorldItem::WorldItem()
 WorldItemImpl::WorldItemImpl(WorldItem* self)
     : self(self),
       os(mvout()),
+      collisionShapeProxyType(CNOID_GETTEXT_DOMAIN_NAME),
       updateCollisionsLater([&](){ updateCollisions(false); }),
       updateCollisionDetectorLater([&](){ updateCollisionDetector(false); })
 {
@@ -130,6 +134,14 @@ WorldItemImpl::WorldItemImpl(WorldItem* self)
         collisionDetectorType.setSymbol(i, CollisionDetector::factoryName(i));
     };
     collisionDetectorType.select("AISTCollisionDetector");
+
+    collisionShapeProxyType.setSymbol(BodyCollisionDetector::NO_PROXY, N_("None"));
+    collisionShapeProxyType.setSymbol(BodyCollisionDetector::DECIMATED_MESH_PROXY, N_("Decimation"));
+    collisionShapeProxyType.setSymbol(BodyCollisionDetector::CONVEX_HULL_PROXY, N_("Convex hull"));
+    collisionShapeProxyType.setSymbol(BodyCollisionDetector::CONVEX_DECOMPOSITION_PROXY, N_("Convex decomposition"));
+    collisionShapeProxyType.select(BodyCollisionDetector::NO_PROXY);
+    maxNumCollisionShapeProxyTriangles = 1000;
+
     isCollisionDetectionEnabled = false;
 
     init();
@@ -153,6 +165,8 @@ WorldItemImpl::WorldItemImpl(WorldItem* self, const WorldItemImpl& org)
       materialTableFile(org.materialTableFile)
 {
     collisionDetectorType = org.collisionDetectorType;
+    collisionShapeProxyType = org.collisionShapeProxyType;
+    maxNumCollisionShapeProxyTriangles = org.maxNumCollisionShapeProxyTriangles;
     isCollisionDetectionEnabled = org.isCollisionDetectionEnabled;
 
     init();
@@ -164,6 +178,8 @@ void WorldItemImpl::init()
     kinematicsBar = KinematicsBar::instance();
     bodyCollisionDetector.setCollisionDetector(CollisionDetector::create(collisionDetectorType.selectedIndex()));
     bodyCollisionDetector.enableGeometryHandleMap(true);
+    bodyCollisionDetector.setDefaultCollisionShapeProxy(
+        collisionShapeProxyType.which(), maxNumCollisionShapeProxyTriangles);
     collisions = std::make_shared<vector<CollisionLinkPairPtr>>();
     sceneCollision = new SceneCollision(collisions);
     sceneCollision->setName("Collisions");
@@ -223,6 +239,17 @@ bool WorldItemImpl::selectCollisionDetector(int index)
 }
 
 
+void WorldItemImpl::setCollisionShapeProxy(int type, int maxNumTriangles)
+{
+    collisionShapeProxyType.select(type);
+    maxNumCollisionShapeProxyTriangles = maxNumTriangles;
+    bodyCollisionDetector.setDefaultCollisionShapeProxy(type, maxNumTriangles);
+    if(isCollisionDetectionEnabled){
+        updateCollisionDetector(true);
+    }
+}
+
+
 CollisionDetector* WorldItem::collisionDetector()
 {
     return impl->bodyCollisionDetector.collisionDetector();
@@ -535,6 +562,14 @@ void WorldItem::doPutProperties(PutPropertyFunction& putProperty)
                 [&](bool on){ enableCollisionDetection(on); return true; });
     putProperty(_("Collision detector"), impl->collisionDetectorType,
                 [&](int index){ return impl->selectCollisionDetector(index); });
+    putProperty(_("Collision shape proxy"), impl->collisionShapeProxyType,
+                [&](int index){
+                    impl->setCollisionShapeProxy(index, impl->maxNumCollisionShapeProxyTriangles);
+                    return true; });
+    putProperty.min(1)(_("Max proxy triangles"), impl->maxNumCollisionShapeProxyTriangles,
+                       [&](int n){
+                           impl->setCollisionShapeProxy(impl->collisionShapeProxyType.which(), n);
+                           return true; });
 
     FilePathProperty materialFileProperty(impl->materialTableFile, { _("Contact material definition file (*.yaml)") });
     putProperty(_("Material table"), materialFileProperty,
@@ -546,6 +581,8 @@ bool WorldItem::store(Archive& archive)
 {
     archive.write("collisionDetection", isCollisionDetectionEnabled());
     archive.write("collisionDetector", impl->collisionDetectorType.selectedSymbol());
+    archive.write("collisionShapeProxy", impl->collisionShapeProxyType.selectedSymbol());
+    archive.write("maxCollisionShapeProxyTriangles", impl->maxNumCollisionShapeProxyTriangles);
     archive.writeRelocatablePath("materialTableFile", impl->materialTableFile);
     return true;
 }
@@ -557,6 +594,13 @@ bool WorldItem::restore(const Archive& archive)
     if(archive.read("collisionDetector", symbol)){
         selectCollisionDetector(symbol);
     }
+    int proxyType = impl->collisionShapeProxyType.which();
+    if(archive.read("collisionShapeProxy", symbol)){
+        impl->collisionShapeProxyType.select(symbol);
+        proxyType = impl->collisionShapeProxyType.which();
+    }
+    impl->setCollisionShapeProxy(
+        proxyType, archive.get("maxCollisionShapeProxyTriangles", impl->maxNumCollisionShapeProxyTriangles));
     if(archive.get("collisionDetection", false)){
         archive.addPostProcess([&](){ impl->enableCollisionDetection(true); });
     }
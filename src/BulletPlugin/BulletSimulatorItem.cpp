@@ -16,6 +16,7 @@
 #include <cnoid/BasicSensorSimulationHelper>
 #include <cnoid/MeshExtractor>
 #include <cnoid/SceneDrawables>
+#include <cnoid/ConnectionSet>
 #include <btBulletDynamicsCommon.h>
 #include <HACD/hacdHACD.h>
 #include <BulletCollision/Gimpact/btGImpactShape.h>
@@ -29,6 +30,7 @@
 #include <BulletDynamics/Featherstone/btMultiBodyJointMotor.h>
 #include <BulletDynamics/Featherstone/btMultiBodyPoint2Point.h>
 #include <BulletDynamics/Featherstone/btMultiBodyJointFeedback.h>
+#include <map>
 #include "gettext.h"
 
 using namespace std;
@@ -65,6 +67,45 @@ void diagonalizeInertia(const Vector3& c, const Matrix3& I, btVector3& localIner
     }
 }
 
+typedef vector<Affine3, Eigen::aligned_allocator<Affine3>> Affine3Array;
+
+/**
+   The collision shape merging the meshes of a link in the shifted link coordinate.
+   A static link uses a BVH triangle mesh shape and a dynamic link uses a GImpact mesh shape.
+   The shape is shared by the links which merge the same meshes with the same transforms and
+   the same shift, such as the links of repeated models or the clones of a body. The meshes are
+   compared instead of the collision shape nodes because a cloned link has its own top node.
+   The shape is kept by the simulator item over the simulation runs as long as the meshes exist.
+
+   The shape is invalidated when a mesh notifies an update. The modification of the vertices
+   without the notification is not detected.
+*/
+class MeshShape : public Referenced
+{
+public:
+    vector<weak_ref_ptr<SgMesh>> meshes;
+    Affine3Array transforms;
+    vector<btScalar> vertices;
+    vector<int> triangles;
+    btTriangleIndexVertexArray* meshData;
+    btCollisionShape* shape;
+    btTransform shift;
+    btScalar margin;
+    bool isInvalidated;
+    ScopedConnectionSet meshUpdateConnections;
+
+    MeshShape(const vector<SgMesh*>& meshes, const Affine3Array& transforms,
+              vector<btScalar>& vertices, vector<int>& triangles,
+              bool isStatic, const btTransform& shift, btScalar margin);
+    ~MeshShape();
+    bool isValidFor(const vector<SgMesh*>& meshes, const Affine3Array& transforms,
+                    const btTransform& shift, btScalar margin) const;
+};
+typedef ref_ptr<MeshShape> MeshShapePtr;
+
+// The key is the pair of the first mesh of a merged mesh shape and the static flag of the shape
+typedef map<pair<weak_ref_ptr<SgMesh>, bool>, vector<MeshShapePtr>> MeshShapeMap;
+
 class BulletBody;
 
 class BulletLink : public Referenced
@@ -77,10 +118,12 @@ public:
     btTransform invShift;
     vector<btScalar> vertices;
     vector<int> triangles;
+    // The meshes merged into the mesh shape and their transforms in the link coordinate
+    vector<SgMesh*> meshesToMerge;
+    Affine3Array meshTransforms;
 
-    btTriangleIndexVertexArray* pMeshData;
-    btTriangleMesh* trimesh;
     btCollisionShape* collisionShape;
+    MeshShapePtr meshShape;
 
     btDefaultMotionState* motionState;
     btRigidBody* body;
@@ -98,7 +141,10 @@ public:
     void createLinkBody(BulletSimulatorItemImpl* simImpl, BulletLink* parent, const Vector3& origin,
                         short group, bool isSelfCollisionDetectionEnabled);
     void addMesh(MeshExtractor* extractor, bool meshOnly);
+    void mergeMeshes();
+    void addChildShape(const Affine3& T, btCollisionShape* shape);
     void createGeometry();
+    void deleteCollisionShape();
     void getKinematicStateFromBullet();
     void setKinematicStateToBullet();
     void setTorqueToBullet();
@@ -160,6 +206,7 @@ public:
     bool useHACD;                           // Hierarchical Approximate Convex Decomposition
     double collisionMargin;
     bool usefeatherstoneAlgorithm;
+    MeshShapeMap meshShapeMap;
 
     BulletSimulatorItemImpl(BulletSimulatorItem* self);
     BulletSimulatorItemImpl(BulletSimulatorItem* self, const BulletSimulatorItemImpl& org);
@@ -172,6 +219,12 @@ public:
     void initialize();
     void clear();
     void addBody(BulletBody* bulletBody, short group);
+    MeshShape* findMeshShape(
+        const vector<SgMesh*>& meshes, const Affine3Array& transforms,
+        bool isStatic, const btTransform& shift);
+    MeshShape* createMeshShape(
+        const vector<SgMesh*>& meshes, const Affine3Array& transforms,
+        bool isStatic, const btTransform& shift, vector<btScalar>& vertices, vector<int>& triangles);
     void setSolverParameter();
 };
 
@@ -248,8 +301,6 @@ BulletLink::BulletLink(BulletSimulatorItemImpl* _simImpl, BulletBody* _bulletBod
 
     vertices.clear();
     triangles.clear();
-    pMeshData = 0;
-    trimesh = 0;
     collisionShape = 0;
     motionState = 0;
     body = 0;
@@ -271,61 +322,42 @@ BulletLink::BulletLink(BulletSimulatorItemImpl* _simImpl, BulletBody* _bulletBod
 void BulletLink::createGeometry()
 {
     if(link->collisionShape()){
+        // The meshes are merged into a concave shape unless the convex decomposition is used
+        bool useMeshShape = !simImpl->useHACD || isStatic;
+        meshesToMerge.clear();
+        meshTransforms.clear();
         MeshExtractor* extractor = new MeshExtractor;
         if(extractor->extract(link->collisionShape(), [&](){ addMesh( extractor, meshOnly); } )){
             if(!simImpl->useHACD && !isStatic){
                 if(!mixedPrimitiveMesh){
-                    if(!vertices.empty()){
+                    if(!meshesToMerge.empty()){
                         btCompoundShape* compoundShape = dynamic_cast<btCompoundShape*>(collisionShape);
                         if(compoundShape){
-                            int num = compoundShape->getNumChildShapes();
-                            for(int i=0; i<num; i++){
-                                delete compoundShape->getChildShape(i);
-                            }
-                            delete compoundShape;
-                            collisionShape = 0;
-                            vertices.clear();
-                            triangles.clear();
+                            deleteCollisionShape();
+                            meshesToMerge.clear();
+                            meshTransforms.clear();
                             extractor->extract(link->shape(), [&](){ addMesh( std::ref(extractor), true ); } );
                         }
                     }
                 }
-                if(!vertices.empty()){
-                    pMeshData = new btTriangleIndexVertexArray(triangles.size()/3, &triangles[0], sizeof(int)*3, 
-                                                               vertices.size()/3, &vertices[0], sizeof(btScalar)*3);
-                    btGImpactMeshShape* meshShape = new btGImpactMeshShape(pMeshData);
-                    meshShape->setLocalScaling(btVector3(1.f,1.f,1.f));
-                    meshShape->setMargin(simImpl->collisionMargin);
-                    meshShape->updateBound();
-                    btCompoundShape* compoundShape = dynamic_cast<btCompoundShape*>(collisionShape);
-                    if(compoundShape){
-                        btTransform T;
-                        T.setIdentity();
-                        compoundShape->addChildShape(T, meshShape);
-                    }else
-                        collisionShape = meshShape;
-                }
-            }else{
-                if(!vertices.empty()){
-                    trimesh = new btTriangleMesh();
-                    for (size_t i=0; i<triangles.size()/3; i++){
-                        int index0 = triangles[i*3];
-                        int index1 = triangles[i*3+1];
-                        int index2 = triangles[i*3+2];
-                        btVector3 vertex0(vertices[index0*3], vertices[index0*3+1], vertices[index0*3+2]);
-                        btVector3 vertex1(vertices[index1*3], vertices[index1*3+1], vertices[index1*3+2]);
-                        btVector3 vertex2(vertices[index2*3], vertices[index2*3+1], vertices[index2*3+2]);
-                        trimesh->addTriangle(vertex0,vertex1,vertex2);
+            }
+            if(useMeshShape && !meshesToMerge.empty()){
+                meshShape = simImpl->findMeshShape(meshesToMerge, meshTransforms, isStatic, shift);
+                if(!meshShape){
+                    mergeMeshes();
+                    if(!vertices.empty()){
+                        meshShape = simImpl->createMeshShape(
+                            meshesToMerge, meshTransforms, isStatic, shift, vertices, triangles);
                     }
-                    btBvhTriangleMeshShape* concaveShape = new btBvhTriangleMeshShape(trimesh, true);
-                    concaveShape->setMargin(simImpl->collisionMargin);
+                }
+                if(meshShape){
                     btCompoundShape* compoundShape = dynamic_cast<btCompoundShape*>(collisionShape);
                     if(compoundShape){
                         btTransform T;
                         T.setIdentity();
-                        compoundShape->addChildShape(T, concaveShape);
+                        compoundShape->addChildShape(T, meshShape->shape);
                     }else
-                        collisionShape = concaveShape;
+                        collisionShape = meshShape->shape;
                 }
             }
         }
@@ -413,22 +445,11 @@ void BulletLink::addMesh(MeshExtractor* extractor, bool meshOnly)
                 }
                 if(created){
                     primitiveShape->setMargin(simImpl->collisionMargin);
-                    btCompoundShape* compoundShape = dynamic_cast<btCompoundShape*>(collisionShape);
-                    if(!compoundShape){
-                        collisionShape = new btCompoundShape();
-                        collisionShape->setLocalScaling(btVector3(1.f,1.f,1.f));
-                        compoundShape = dynamic_cast<btCompoundShape*>(collisionShape);
-                    }
                     Affine3 T_ = extractor->currentTransformWithoutScaling();
                     if(translation){
                         T_ *= Translation3(*translation);
                     }
-                    btVector3 p(T_(0,3), T_(1,3), T_(2,3));
-                    btMatrix3x3 R(T_(0,0), T_(0,1), T_(0,2),
-                                  T_(1,0), T_(1,1), T_(1,2),
-                                  T_(2,0), T_(2,1), T_(2,2));
-                    btTransform btT(R, p);
-                    compoundShape->addChildShape(invShift * btT, primitiveShape);
+                    addChildShape(T_, primitiveShape);
                     meshAdded = true;
                 }
             }
@@ -436,25 +457,9 @@ void BulletLink::addMesh(MeshExtractor* extractor, bool meshOnly)
     }
     if(!meshAdded){
         if(!simImpl->useHACD || isStatic){
-            const int vertexIndexTop = vertices.size() / 3;
-
-            const SgVertexArray& vertices_ = *mesh->vertices();
-            const int numVertices = vertices_.size();
-            for(int i=0; i < numVertices; ++i){
-                const Vector3 v = T * vertices_[i].cast<Position::Scalar>();
-                btVector3 v0 = invShift * btVector3(v.x(), v.y(), v.z());
-                vertices.push_back(v0.x());
-                vertices.push_back(v0.y());
-                vertices.push_back(v0.z());
-            }
-
-            const int numTriangles = mesh->numTriangles();
-            for(int i=0; i < numTriangles; ++i){
-                SgMesh::TriangleRef tri = mesh->triangle(i);
-                triangles.push_back(vertexIndexTop + tri[0]);
-                triangles.push_back(vertexIndexTop + tri[1]);
-                triangles.push_back(vertexIndexTop + tri[2]);
-            }
+            // The vertices are only merged when no shared mesh shape is found for the meshes
+            meshesToMerge.push_back(mesh);
+            meshTransforms.push_back(T);
         }else{
             btConvexHullShape* convexHullShape = dynamic_cast<btConvexHullShape*>(collisionShape);
             if(convexHullShape){
@@ -830,24 +835,79 @@ void BulletLink::createLinkBody(BulletSimulatorItemImpl* simImpl, BulletLink* pa
 }
 
 
-BulletLink::~BulletLink()
+void BulletLink::mergeMeshes()
+{
+    vertices.clear();
+    triangles.clear();
+
+    for(size_t i=0; i < meshesToMerge.size(); ++i){
+        SgMesh* mesh = meshesToMerge[i];
+        const Affine3& T = meshTransforms[i];
+        const int vertexIndexTop = vertices.size() / 3;
+
+        const SgVertexArray& vertices_ = *mesh->vertices();
+        const int numVertices = vertices_.size();
+        for(int j=0; j < numVertices; ++j){
+            const Vector3 v = T * vertices_[j].cast<Position::Scalar>();
+            btVector3 v0 = invShift * btVector3(v.x(), v.y(), v.z());
+            vertices.push_back(v0.x());
+            vertices.push_back(v0.y());
+            vertices.push_back(v0.z());
+        }
+
+        const int numTriangles = mesh->numTriangles();
+        for(int j=0; j < numTriangles; ++j){
+            SgMesh::TriangleRef tri = mesh->triangle(j);
+            triangles.push_back(vertexIndexTop + tri[0]);
+            triangles.push_back(vertexIndexTop + tri[1]);
+            triangles.push_back(vertexIndexTop + tri[2]);
+        }
+    }
+}
+
+
+void BulletLink::addChildShape(const Affine3& T, btCollisionShape* shape)
 {
-    if(pMeshData)
-        delete pMeshData;
-    if(trimesh)
-        delete trimesh;
+    btCompoundShape* compoundShape = dynamic_cast<btCompoundShape*>(collisionShape);
+    if(!compoundShape){
+        collisionShape = new btCompoundShape();
+        collisionShape->setLocalScaling(btVector3(1.f,1.f,1.f));
+        compoundShape = dynamic_cast<btCompoundShape*>(collisionShape);
+    }
+    btVector3 p(T(0,3), T(1,3), T(2,3));
+    btMatrix3x3 R(T(0,0), T(0,1), T(0,2),
+                  T(1,0), T(1,1), T(1,2),
+                  T(2,0), T(2,1), T(2,2));
+    btTransform btT(R, p);
+    compoundShape->addChildShape(invShift * btT, shape);
+}
 
+
+void BulletLink::deleteCollisionShape()
+{
     btCompoundShape* compoundShape = dynamic_cast<btCompoundShape*>(collisionShape);
     if(compoundShape){
         int num = compoundShape->getNumChildShapes();
         for(int i=0; i<num; i++){
-            delete compoundShape->getChildShape(i);
+            btCollisionShape* child = compoundShape->getChildShape(i);
+            if(!meshShape || child != meshShape->shape){
+                delete child;
+            }
         }
         delete compoundShape;
     }else{
-        if(collisionShape)
+        if(collisionShape && (!meshShape || collisionShape != meshShape->shape))
             delete collisionShape;
     }
+    collisionShape = 0;
+    meshShape.reset();
+}
+
+
+BulletLink::~BulletLink()
+{
+    deleteCollisionShape();
+
     if(motionState)
         delete motionState;
     if(body){
@@ -1368,6 +1428,100 @@ void BulletSimulatorItem::setAllLinkPositionOutputMode(bool on)
 }
 */
 
+MeshShape::MeshShape
+(const vector<SgMesh*>& meshes_, const Affine3Array& transforms,
+ vector<btScalar>& vertices_, vector<int>& triangles_,
+ bool isStatic, const btTransform& shift, btScalar margin)
+    : transforms(transforms),
+      shift(shift),
+      margin(margin),
+      isInvalidated(false)
+{
+    for(auto& mesh : meshes_){
+        meshes.push_back(mesh);
+        meshUpdateConnections.add(
+            mesh->sigUpdated().connect([this](const SgUpdate&){ isInvalidated = true; }));
+    }
+
+    vertices.swap(vertices_);
+    triangles.swap(triangles_);
+
+    meshData = new btTriangleIndexVertexArray(triangles.size()/3, &triangles[0], sizeof(int)*3,
+                                              vertices.size()/3, &vertices[0], sizeof(btScalar)*3);
+    if(isStatic){
+        shape = new btBvhTriangleMeshShape(meshData, true);
+        shape->setMargin(margin);
+    } else {
+        btGImpactMeshShape* gimpactShape = new btGImpactMeshShape(meshData);
+        gimpactShape->setLocalScaling(btVector3(1.f,1.f,1.f));
+        gimpactShape->setMargin(margin);
+        gimpactShape->updateBound();
+        shape = gimpactShape;
+    }
+}
+
+
+MeshShape::~MeshShape()
+{
+    delete shape;
+    delete meshData;
+}
+
+
+bool MeshShape::isValidFor
+(const vector<SgMesh*>& meshes, const Affine3Array& transforms,
+ const btTransform& shift, btScalar margin) const
+{
+    if(isInvalidated || margin != this->margin || !(shift == this->shift) ||
+       meshes.size() != this->meshes.size()){
+        return false;
+    }
+    for(size_t i=0; i < meshes.size(); ++i){
+        if(this->meshes[i].lock() != meshes[i] ||
+           this->transforms[i].matrix() != transforms[i].matrix()){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+MeshShape* BulletSimulatorItemImpl::findMeshShape
+(const vector<SgMesh*>& meshes, const Affine3Array& transforms,
+ bool isStatic, const btTransform& shift)
+{
+    auto p = meshShapeMap.find(make_pair(weak_ref_ptr<SgMesh>(meshes.front()), isStatic));
+    if(p != meshShapeMap.end()){
+        for(auto& meshShape : p->second){
+            if(meshShape->isValidFor(meshes, transforms, shift, collisionMargin)){
+                return meshShape;
+            }
+        }
+    }
+    return nullptr;
+}
+
+
+MeshShape* BulletSimulatorItemImpl::createMeshShape
+(const vector<SgMesh*>& meshes, const Affine3Array& transforms,
+ bool isStatic, const btTransform& shift, vector<btScalar>& vertices, vector<int>& triangles)
+{
+    auto& shapes = meshShapeMap[make_pair(weak_ref_ptr<SgMesh>(meshes.front()), isStatic)];
+    // The invalidated shapes are replaced
+    auto p = shapes.begin();
+    while(p != shapes.end()){
+        if((*p)->isInvalidated || (*p)->margin != collisionMargin){
+            p = shapes.erase(p);
+        } else {
+            ++p;
+        }
+    }
+    MeshShape* meshShape = new MeshShape(meshes, transforms, vertices, triangles, isStatic, shift, collisionMargin);
+    shapes.push_back(meshShape);
+    return meshShape;
+}
+
+
 Item* BulletSimulatorItem::doDuplicate() const
 {
     return new BulletSimulatorItem(*this);
@@ -1394,6 +1548,16 @@ bool BulletSimulatorItemImpl::initializeSimulation(const std::vector<SimulationB
 {
     clear();
 
+    // Remove the shapes of the nodes which no longer exist
+    auto p = meshShapeMap.begin();
+    while(p != meshShapeMap.end()){
+        if(p->first.first.expired()){
+            p = meshShapeMap.erase(p);
+        } else {
+            ++p;
+        }
+    }
+
     collisionConfiguration = new btDefaultCollisionConfiguration();
     dispatcher = new btCollisionDispatcher(collisionConfiguration);
     broadphase = new btDbvtBroadphase();
@@ -14,6 +14,7 @@
 #include <cnoid/LazyCaller>
 #include <cnoid/PutPropertyFunction>
 #include <cnoid/Archive>
+#include <cnoid/ConnectionSet>
 #include <fmt/format.h>
 #include <unordered_map>
 #include <regex>
@@ -94,8 +95,24 @@ public:
     typedef MprProgram::iterator Iterator;
     Iterator iterator;
 
+    /*
+       The statements of a program are compiled into the functions executing them with the
+       pre-bound interpreters and pre-parsed expressions. The functions are stored in the
+       same order as the statements so that they can be accessed by the statement indices.
+    */
+    typedef function<bool()> ExecuteFunction;
+    struct CompiledProgram {
+        vector<ExecuteFunction> statements;
+        // Cleared by the update signals of the program to recompile it
+        bool isValid = false;
+        ScopedConnectionSet connections;
+    };
+    unordered_map<MprProgram*, CompiledProgram> compiledProgramMap;
+    CompiledProgram* currentCompiledProgram;
+
     struct ProgramPosition {
         MprProgramPtr program;
+        CompiledProgram* compiledProgram;
         Iterator current;
         Iterator next;
         vector<int> hierachicalPosition;
@@ -108,6 +125,9 @@ public:
 
     typedef function<bool(MprStatement* statement)> InterpretFunction;
     unordered_map<type_index, InterpretFunction> interpreterMap;
+    typedef function<ExecuteFunction(MprStatement* statement, MprProgram* program, Iterator position)> CompileFunction;
+    unordered_map<type_index, CompileFunction> compilerMap;
+    typedef function<stdx::optional<MprVariable::Value>()> TermFunction;
     DigitalIoDevicePtr ioDevice;
     double speedRatio;
 
@@ -123,6 +143,8 @@ public:
     regex boolPattern;
     regex stringPattern;
     regex variablePattern; // for the default variable expression syntax
+    bool isCompilingVariableExpression;
+    bool isDefaultVariableExpressionEvaluated;
 
     Impl(MprControllerItemBase* self);
     bool initialize(ControllerIO* io);
@@ -138,6 +160,8 @@ public:
     void updateVariableListInGui(MprVariableList* listInGui, MprVariable* variableForNotification);
     MprVariable* findVariable(const GeneralId& id);
 
+    CompiledProgram* getCompiledProgram(MprProgram* program);
+    void compileProgram(MprProgram* program, CompiledProgram& compiled);
     void setCurrent(MprProgram* program, MprProgram::iterator iter, MprProgram::iterator upperNext);
     bool control();
     void setCurrentProgramPositionToLog(MprControllerLog* log);
@@ -147,10 +171,17 @@ public:
     bool interpretIfStatement(MprIfStatement* statement);
     bool interpretWhileStatement(MprWhileStatement* statement);
     bool interpretCallStatement(MprCallStatement* statement);
+    ExecuteFunction compileIfStatement(MprIfStatement* statement, MprProgram* program, Iterator position);
+    ExecuteFunction compileWhileStatement(MprWhileStatement* statement);
     stdx::optional<bool> evalConditionalExpression(const string& expression);
+    function<stdx::optional<bool>()> compileConditionalExpression(const string& expression);
+    stdx::optional<bool> compareValues(
+        const MprVariable::Value& lhs, const string& cmpOp, const MprVariable::Value& rhs);
     stdx::optional<MprVariable::Value> getTermValue(string::const_iterator& pos, string::const_iterator end);
+    TermFunction compileTerm(string::const_iterator& pos, string::const_iterator end);
     stdx::optional<string> getComparisonOperator(string::const_iterator& pos, string::const_iterator end);
     bool interpretAssignStatement(MprAssignStatement* statement);
+    ExecuteFunction compileAssignStatement(MprAssignStatement* statement);
     bool applyBinaryOperation(MprVariable::Value& lhsValue, char op, const MprVariable::Value& rhsValue);
     bool interpretSetSignalStatement(MprSignalStatement* statement);
     bool interpretWaitStatement(MprWaitStatement* statement);
@@ -184,6 +215,9 @@ MprControllerItemBase::Impl::Impl(MprControllerItemBase* self)
     : self(self)
 {
     isControlActive = false;
+    currentCompiledProgram = nullptr;
+    isCompilingVariableExpression = false;
+    isDefaultVariableExpressionEvaluated = false;
     speedRatio = 1.0;
     currentLog = new MprControllerLog;
 }
@@ -199,6 +233,8 @@ void MprControllerItemBase::registerStatementInterpreter
 (std::type_index statementType, const std::function<bool(MprStatement* statement)>& interpret)
 {
     impl->interpreterMap[statementType] = interpret;
+    // The interpreter registered later has priority over the compiler of the base statement
+    impl->compilerMap.erase(statementType);
 }
 
 
@@ -242,6 +278,18 @@ void MprControllerItemBase::registerBaseStatementInterpreters()
         [impl_](MprDelayStatement* statement){
             return impl_->interpretDelayStatement(statement); });
 
+    impl->compilerMap[typeid(MprIfStatement)] =
+        [impl_](MprStatement* statement, MprProgram* program, Impl::Iterator position){
+            return impl_->compileIfStatement(static_cast<MprIfStatement*>(statement), program, position); };
+
+    impl->compilerMap[typeid(MprWhileStatement)] =
+        [impl_](MprStatement* statement, MprProgram*, Impl::Iterator){
+            return impl_->compileWhileStatement(static_cast<MprWhileStatement*>(statement)); };
+
+    impl->compilerMap[typeid(MprAssignStatement)] =
+        [impl_](MprStatement* statement, MprProgram*, Impl::Iterator){
+            return impl_->compileAssignStatement(static_cast<MprAssignStatement*>(statement)); };
+
     impl->termPattern.assign("^\\s*(.+)\\s*");
     impl->operatorPattern.assign("^\\s*([+-])\\s*");
     impl->cmpOperatorPattern.assign("^\\s*(=|==|!=|<|>|<=|>=)\\s*");
@@ -330,6 +378,12 @@ bool MprControllerItemBase::Impl::initialize(ControllerIO* io)
 
     iterator = currentProgram->begin();
 
+    // The programs are compiled after the variables are initialized to resolve them
+    currentCompiledProgram = getCompiledProgram(currentProgram);
+    for(auto& kv : otherProgramMap){
+        getCompiledProgram(kv.second);
+    }
+
     auto body = io->body();
     ioDevice = body->findDevice<DigitalIoDevice>();
 
@@ -484,6 +538,7 @@ MprVariable* MprControllerItemBase::Impl::findVariable(const GeneralId& id)
 stdx::optional<MprVariable::Value> MprControllerItemBase::evalExpressionAsVariableValue
 (std::string::const_iterator& io_expressionBegin, std::string::const_iterator expressionEnd)
 {
+    impl->isDefaultVariableExpressionEvaluated = true;
     std::smatch match;
     if(regex_search(io_expressionBegin, expressionEnd, match, impl->variablePattern)){
         io_expressionBegin = match[0].second;
@@ -491,12 +546,61 @@ stdx::optional<MprVariable::Value> MprControllerItemBase::evalExpressionAsVariab
         if(auto variable = impl->findVariable(id)){
             return variable->value();
         }
-        impl->io->os() << format(_("Variable {0} is not defined."), id.label()) << endl;
+        // The variable may be added by an assign statement after the compilation
+        if(!impl->isCompilingVariableExpression){
+            impl->io->os() << format(_("Variable {0} is not defined."), id.label()) << endl;
+        }
     }
     return stdx::nullopt;
 }
 
 
+std::function<stdx::optional<MprVariable::Value>()> MprControllerItemBase::compileExpressionAsVariableValue
+(std::string::const_iterator& io_expressionBegin, std::string::const_iterator expressionEnd)
+{
+    auto pos = io_expressionBegin;
+    impl->isCompilingVariableExpression = true;
+    impl->isDefaultVariableExpressionEvaluated = false;
+    evalExpressionAsVariableValue(pos, expressionEnd);
+    impl->isCompilingVariableExpression = false;
+    if(pos == io_expressionBegin){
+        return nullptr;
+    }
+
+    if(!impl->isDefaultVariableExpressionEvaluated){
+        // The term of the syntax customized by a subclass
+        string expression(io_expressionBegin, expressionEnd);
+        io_expressionBegin = pos;
+        return
+            [this, expression]() -> stdx::optional<MprVariable::Value> {
+                auto termBegin = expression.cbegin();
+                return evalExpressionAsVariableValue(termBegin, expression.cend());
+            };
+    }
+    
+    std::smatch match;
+    if(regex_search(io_expressionBegin, expressionEnd, match, impl->variablePattern)){
+        io_expressionBegin = match[0].second;
+        GeneralId id(std::stoi(match.str(1)));
+        MprVariablePtr variable = impl->findVariable(id);
+        auto impl_ = impl;
+        return
+            [impl_, id, variable]() mutable -> stdx::optional<MprVariable::Value> {
+                // The variable may be added by an assign statement after the compilation
+                if(!variable){
+                    variable = impl_->findVariable(id);
+                    if(!variable){
+                        impl_->io->os() << format(_("Variable {0} is not defined."), id.label()) << endl;
+                        return stdx::nullopt;
+                    }
+                }
+                return variable->value();
+            };
+    }
+    return nullptr;
+}
+
+
 std::function<bool(MprVariable::Value value)> MprControllerItemBase::evalExpressionAsVariableToAssginValue
 (const std::string& expression)
 {
@@ -574,6 +678,7 @@ void MprControllerItemBase::Impl::setCurrent
 {
     ProgramPosition upper;
     upper.program = currentProgram;
+    upper.compiledProgram = currentCompiledProgram;
     upper.current = iterator;
     upper.next = upperNext;
 
@@ -586,10 +691,68 @@ void MprControllerItemBase::Impl::setCurrent
     programStack.push_back(upper);
     
     currentProgram = program;
+    currentCompiledProgram = getCompiledProgram(program);
     iterator = iter;
 }
 
 
+MprControllerItemBase::Impl::CompiledProgram* MprControllerItemBase::Impl::getCompiledProgram(MprProgram* program)
+{
+    auto& compiled = compiledProgramMap[program];
+    if(compiled.connections.empty()){
+        auto invalidate = [&compiled](){ compiled.isValid = false; };
+        compiled.connections.add(
+            program->sigStatementInserted().connect(
+                [invalidate](MprProgram::iterator){ invalidate(); }));
+        compiled.connections.add(
+            program->sigStatementRemoved().connect(
+                [invalidate](MprProgram*, MprStatement*){ invalidate(); }));
+        compiled.connections.add(
+            program->sigStatementUpdated().connect(
+                [invalidate](MprStatement*){ invalidate(); }));
+    }
+    // The statement count is also checked for the modifications without the notifications
+    if(!compiled.isValid || static_cast<int>(compiled.statements.size()) != program->numStatements()){
+        compileProgram(program, compiled);
+    }
+    return &compiled;
+}
+
+
+void MprControllerItemBase::Impl::compileProgram(MprProgram* program, CompiledProgram& compiled)
+{
+    compiled.statements.clear();
+    compiled.statements.reserve(program->numStatements());
+    compiled.isValid = true;
+
+    for(auto it = program->begin(); it != program->end(); ++it){
+        auto statement = it->get();
+        type_index statementType = typeid(*statement);
+        ExecuteFunction execute;
+        auto p = compilerMap.find(statementType);
+        if(p != compilerMap.end()){
+            execute = p->second(statement, program, it);
+        } else {
+            auto q = interpreterMap.find(statementType);
+            if(q != interpreterMap.end()){
+                auto& interpret = q->second;
+                execute = [interpret, statement](){ return interpret(statement); };
+            }
+        }
+        compiled.statements.push_back(execute);
+    }
+
+    // The lower level programs are compiled in advance to avoid compiling them in the control loop
+    for(auto& statement : *program){
+        if(auto structured = dynamic_cast<MprStructuredStatement*>(statement.get())){
+            if(auto lowerLevelProgram = structured->lowerLevelProgram()){
+                getCompiledProgram(lowerLevelProgram);
+            }
+        }
+    }
+}
+
+
 MprProgram* MprControllerItemBase::findProgram(const std::string& name)
 {
     auto iter = impl->otherProgramMap.find(name);
@@ -671,6 +834,7 @@ bool MprControllerItemBase::Impl::control()
             auto& upper = programStack.back();
             iterator = upper.next;
             currentProgram = upper.program;
+            currentCompiledProgram = upper.compiledProgram;
             programStack.pop_back();
             hasNextStatement = (iterator != currentProgram->end());
         }
@@ -686,14 +850,18 @@ bool MprControllerItemBase::Impl::control()
         
         auto statement = iterator->get();
 
-        auto p = interpreterMap.find(typeid(*statement));
-        if(p == interpreterMap.end()){
+        if(!currentCompiledProgram->isValid ||
+           static_cast<int>(currentCompiledProgram->statements.size()) != currentProgram->numStatements()){
+            // The program has been modified after the compilation
+            currentCompiledProgram = getCompiledProgram(currentProgram);
+        }
+        auto& execute = currentCompiledProgram->statements[iterator - currentProgram->begin()];
+        if(!execute){
             io->os() << format(_("{0} cannot be executed because the interpreter for it is not found."),
                                statement->label(0)) << endl;
             ++iterator;
         } else {
-            auto& interpret = p->second;
-            if(!interpret(statement)){
+            if(!execute()){
                 isControlActive = false;
                 if(isLogEnabled){
                     currentLog->isErrorState_ = true;
@@ -787,6 +955,8 @@ void MprControllerItemBase::Impl::clear()
     variableLists.clear();
     programStack.clear();
     processorStack.clear();
+    compiledProgramMap.clear();
+    currentCompiledProgram = nullptr;
     topLevelProgramToSharedNameMap.clear();
 }
 
@@ -855,6 +1025,46 @@ bool MprControllerItemBase::Impl::interpretIfStatement(MprIfStatement* statement
 }
 
 
+MprControllerItemBase::Impl::ExecuteFunction
+MprControllerItemBase::Impl::compileIfStatement(MprIfStatement* statement, MprProgram* program, Iterator position)
+{
+    auto condition = compileConditionalExpression(statement->condition());
+    if(!condition){
+        // The interpreter reports the error of the expression when the statement is executed
+        return [this, statement](){ return interpretIfStatement(statement); };
+    }
+
+    int nextOffset = 1;
+    MprElseStatement* elseStatement = nullptr;
+    auto next = position + 1;
+    if(next != program->end()){
+        elseStatement = dynamic_cast<MprElseStatement*>(next->get());
+        if(elseStatement){
+            nextOffset = 2;
+        }
+    }
+
+    return [this, statement, condition, elseStatement, nextOffset](){
+        auto result = condition();
+        if(!result){
+            return false;
+        }
+        auto next = iterator + nextOffset;
+        if(*result){
+            auto program = statement->lowerLevelProgram();
+            setCurrent(program, program->begin(), next);
+        } else {
+            ++iterator;
+            if(elseStatement){
+                auto program = elseStatement->lowerLevelProgram();
+                setCurrent(program, program->begin(), next);
+            }
+        }
+        return true;
+    };
+}
+
+
 bool MprControllerItemBase::Impl::interpretWhileStatement(MprWhileStatement* statement)
 {
     auto condition = evalConditionalExpression(statement->condition());
@@ -873,6 +1083,30 @@ bool MprControllerItemBase::Impl::interpretWhileStatement(MprWhileStatement* sta
 }
 
 
+MprControllerItemBase::Impl::ExecuteFunction
+MprControllerItemBase::Impl::compileWhileStatement(MprWhileStatement* statement)
+{
+    auto condition = compileConditionalExpression(statement->condition());
+    if(!condition){
+        return [this, statement](){ return interpretWhileStatement(statement); };
+    }
+
+    return [this, statement, condition](){
+        auto result = condition();
+        if(!result){
+            return false;
+        }
+        if(*result){
+            auto program = statement->lowerLevelProgram();
+            setCurrent(program, program->begin(), iterator);
+        } else {
+            ++iterator;
+        }
+        return true;
+    };
+}
+
+
 bool MprControllerItemBase::Impl::interpretCallStatement(MprCallStatement* statement)
 {
     auto& programName = statement->programName();
@@ -949,15 +1183,67 @@ stdx::optional<bool> MprControllerItemBase::Impl::evalConditionalExpression(cons
         return stdx::nullopt;
     }
 
-    auto& lhs = *pLhs;
-
     if(!pRhs){
-        return MprVariable::toBool(lhs);
+        return MprVariable::toBool(*pLhs);
     }
-            
+
+    return compareValues(*pLhs, *pCmpOp, *pRhs);
+}
+
+
+/**
+   The expression is parsed into the functions to get the term values. This function returns nullptr
+   when the expression cannot be compiled, and evalConditionalExpression is used to evaluate the
+   expression in that case.
+*/
+function<stdx::optional<bool>()> MprControllerItemBase::Impl::compileConditionalExpression(const string& expression)
+{
+    if(expression.empty()){
+        return nullptr;
+    }
+    auto pos = expression.cbegin();
+    auto end = expression.cend();
+
+    TermFunction lhs = compileTerm(pos, end);
+    if(!lhs){
+        return nullptr;
+    }
+    TermFunction rhs;
+    string cmpOp;
+    if(pos != end){
+        auto pCmpOp = getComparisonOperator(pos, end);
+        if(!pCmpOp || pos == end){
+            return nullptr;
+        }
+        cmpOp = *pCmpOp;
+        rhs = compileTerm(pos, end);
+        if(!rhs || pos != end){
+            return nullptr;
+        }
+    }
+
+    return [this, expression, lhs, rhs, cmpOp]() -> stdx::optional<bool> {
+        auto pLhs = lhs();
+        stdx::optional<MprVariable::Value> pRhs;
+        if(pLhs && rhs){
+            pRhs = rhs();
+        }
+        if(!pLhs || (rhs && !pRhs)){
+            io->os() << format(_("Conditional expression \"{0}\" is invalid."), expression) << endl;
+            return stdx::nullopt;
+        }
+        if(!rhs){
+            return MprVariable::toBool(*pLhs);
+        }
+        return compareValues(*pLhs, cmpOp, *pRhs);
+    };
+}
+
+
+stdx::optional<bool> MprControllerItemBase::Impl::compareValues
+(const MprVariable::Value& lhs, const string& cmpOp, const MprVariable::Value& rhs)
+{
     stdx::optional<bool> pResult;
-    auto& rhs = *pRhs;
-    string& cmpOp = *pCmpOp;
 
     int rhsValueType = MprVariable::valueType(rhs);
     switch(MprVariable::valueType(lhs)){
@@ -1041,6 +1327,41 @@ stdx::optional<MprVariable::Value> MprControllerItemBase::Impl::getTermValue
 }
 
 
+MprControllerItemBase::Impl::TermFunction
+MprControllerItemBase::Impl::compileTerm(string::const_iterator& pos, string::const_iterator end)
+{
+    MprVariable::Value value;
+    std::smatch match;
+
+    if(regex_search(pos, end,  match, stringPattern)){
+        value = match.str(1);
+                
+    } else if(regex_search(pos, end, match, floatPattern)){
+        value = std::stod(match.str(0));
+            
+    } else if(regex_search(pos, end, match, intPattern)){
+        errno = 0;
+        long number = strtol(match.str(0).c_str(), nullptr, 10);
+        if(errno == ERANGE || number < INT_MIN || number > INT_MAX){
+            return nullptr;
+        }
+        value = static_cast<int>(number);
+
+    } else if(regex_search(pos, end, match, boolPattern)){
+        auto label = match.str(1);
+        std::transform(label.begin(), label.end(), label.begin(), ::tolower);
+        value = (label == "true") ? true : false;
+                
+    } else {
+        return self->compileExpressionAsVariableValue(pos, end);
+    }
+
+    pos = match[0].second;
+
+    return [value]() -> stdx::optional<MprVariable::Value> { return value; };
+}
+
+
 stdx::optional<string> MprControllerItemBase::Impl::getComparisonOperator
 (string::const_iterator& pos, string::const_iterator end)
 {
@@ -1143,6 +1464,84 @@ bool MprControllerItemBase::Impl::interpretAssignStatement(MprAssignStatement* s
 }
 
 
+/**
+   \note The assignment function given by evalExpressionAsVariableToAssginValue is obtained when the
+   statement is executed first because the function may create a new variable.
+*/
+MprControllerItemBase::Impl::ExecuteFunction
+MprControllerItemBase::Impl::compileAssignStatement(MprAssignStatement* statement)
+{
+    auto interpret = [this, statement](){ return interpretAssignStatement(statement); };
+
+    auto& expression = statement->valueExpression();
+    if(expression.empty()){
+        return interpret;
+    }
+
+    vector<TermFunction> terms;
+    vector<char> operators;
+    vector<string> termStrings;
+    auto pos = expression.cbegin();
+    auto end = expression.cend();
+    std::smatch match;
+    bool isNextTermOperator = false;
+
+    while(pos != end){
+        if(!isNextTermOperator){
+            auto pos0 = pos;
+            auto term = compileTerm(pos, end);
+            if(!term){
+                return interpret;
+            }
+            terms.push_back(term);
+            termStrings.push_back(string(pos0, pos));
+            isNextTermOperator = true;
+        } else {
+            if(!regex_search(pos, end, match, operatorPattern)){
+                return interpret;
+            }
+            operators.push_back(match.str(1)[0]);
+            pos = match[0].second;
+            isNextTermOperator = false;
+        }
+    }
+    if(terms.empty() || !isNextTermOperator){
+        return interpret;
+    }
+
+    std::function<bool(MprVariable::Value value)> assignValue;
+
+    return [this, statement, terms, operators, termStrings, assignValue]() mutable {
+        auto pValue = terms[0]();
+        if(!pValue){
+            io->os() << format(_("Term \"{0}\" is invalid."), termStrings[0]) << endl;
+            return false;
+        }
+        MprVariable::Value value = *pValue;
+        for(size_t i=0; i < operators.size(); ++i){
+            auto pRhs = terms[i+1]();
+            if(!pRhs){
+                io->os() << format(_("Term \"{0}\" is invalid."), termStrings[i+1]) << endl;
+                return false;
+            }
+            if(!applyBinaryOperation(value, operators[i], *pRhs)){
+                io->os() << format(_("Type mismatch in expresion \"{0} {1} {2}\""),
+                                   termStrings[i], operators[i], termStrings[i+1]) << endl;
+                return false;
+            }
+        }
+        if(!assignValue){
+            assignValue = self->evalExpressionAsVariableToAssginValue(statement->variableExpression());
+        }
+        if(assignValue && assignValue(value)){
+            ++iterator;
+            return true;
+        }
+        return false;
+    };
+}
+
+
 template<class ResultType, class LhsType, class RhsType>
 static ResultType applyNumericalOperation(char op, LhsType lhs, RhsType rhs)
 {
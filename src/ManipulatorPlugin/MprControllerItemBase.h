@@ -88,6 +88,18 @@ protected:
     virtual std::function<bool(MprVariable::Value value)> evalExpressionAsVariableToAssginValue(
         const std::string& expression);
 
+    /**
+       This function is used to compile the variable expressions in the programs before starting
+       the control. The function returned by this function is called to get the variable value
+       when the statement is executed. The default implementation calls evalExpressionAsVariableValue
+       once to find the end of the term. A term handled by the default implementation of
+       evalExpressionAsVariableValue is compiled into the direct access to the variable, and the
+       other terms are evaluated by evalExpressionAsVariableValue every time they are executed.
+       A subclass customizing the syntax can override this function to compile its own terms.
+    */
+    virtual std::function<stdx::optional<MprVariable::Value>()> compileExpressionAsVariableValue(
+        std::string::const_iterator& io_expressionBegin, std::string::const_iterator expressionEnd);
+
     virtual void onDisconnectedFromRoot() override;
     virtual void doPutProperties(PutPropertyFunction& putProperty) override;
     virtual bool store(Archive& archive) override;
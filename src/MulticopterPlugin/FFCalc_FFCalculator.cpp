@@ -94,78 +94,155 @@ void FFCalculator::calcAddMass (LinkForce* pLinkForceT, LinkForce* pLinkForceR)
     return;
 }
 
-void FFCalculator::calcSurfaceGeneral(LinkForce* pLinkForceN, LinkForce* pLinkForceT,int degreeNumber)
+void SurfaceQuadrature::build (const std::vector<LinkTriangleAttribute>& triAttrAry, int degreeNumber)
 {
-
-    const int numIP = degreeNumber;
-
-    for (const auto& triAttr : _triAttrAry)
+    // More points than the Gauss quadrature defines cannot be used. SimulationManager::setDegreeNumber
+    // reports the clamping when such a degree number is given.
+    const int numIP = std::min (degreeNumber, (degreeNumber == 1) ? 1 : MaxNumGaussPoints);
+
+    std::vector<Vector3> positions;
+    std::vector<Vector3> normals;
+    std::vector<double>  coefficients;
+    positions.reserve (triAttrAry.size() * numIP);
+    normals.reserve (triAttrAry.size() * numIP);
+    coefficients.reserve (triAttrAry.size() * numIP);
+
+    for (const auto& triAttr : triAttrAry)
     {
-        const GaussTriangle3d tri (triAttr.triangle(), _linkState.trans());
+        const GaussTriangle3d tri (triAttr.triangle());
+
+        // A degenerate triangle does not produce any force
+        if (!(tri.area() > 0.0))
+            continue;
 
         for (int iIP=0; iIP<numIP; ++iIP)
         {
-
             const double cutCoef = triAttr.cutoffCoefficient(iIP);
             if (cutCoef < 1.0e-12)
                 continue;
 
-            const Vector3 posIP = tri.getGaussPoint(iIP,numIP);
+            positions.push_back (tri.getGaussPoint(iIP,degreeNumber));
+            normals.push_back (tri.normal());
+            coefficients.push_back (cutCoef * tri.getGaussWeight(iIP,degreeNumber) * tri.area());
+        }
+    }
 
-            FluidEnvironment::FluidValue fluid;
-            bool inBounds = _fluidEnv.get (posIP, fluid);
+    const int n = coefficients.size();
+    _positions.resize (3, n);
+    _normals.resize (3, n);
+    _coefficients.resize (n);
+    for (int i=0; i<n; ++i)
+    {
+        _positions.col(i) = positions[i];
+        _normals.col(i)   = normals[i];
+        _coefficients[i]  = coefficients[i];
+    }
 
-            if ( inBounds==false  && _fluidEnvAll.isFluid ==false)
-                continue;
+    return;
+}
 
-            if(inBounds==true){
-                if(fluid.isFluid ==true){
-                }else continue;
-            }else if(_fluidEnvAll.isFluid == true){
-                fluid=_fluidEnvAll;
-            }else continue;
-
-            const double coefIP = cutCoef * tri.getGaussWeight(iIP,numIP) * tri.area();
-
-            double velPerp;
-            double velPara;
-            Vector3 vePara;
-
-            Vector3 velRelative = fluid.velocity - _linkState.translationalVelocityAt(posIP);
-            _calcVectorDecomp (velRelative, -tri.normal(), &velPerp, &velPara, &vePara);
-
-            if (velPerp >= TINY_VELOCITY)
-            {
-                double pressure = 0.5 * fluid.density * std::pow (std::max (0.0, velPerp), 2);
-                Vector3 force = -tri.normal() * pressure;
-                pLinkForceN->addForce (coefIP * force, posIP);
-            }
-
-            if (velPara >= TINY_VELOCITY)
-            {
-
-                double repLength = std::pow (_linkVolume, 1.0/3.0);
-
-                double coefReynolds = fluid.density * velPara * repLength / fluid.viscosity;
-
-                if (coefReynolds < 4.0e5)
-                {
-                    Vector3 forceT = 0.664 * velPara * vePara *
-                                     std::sqrt (fluid.viscosity * fluid.density * velPara / repLength);
-                    pLinkForceT->addForce (coefIP * forceT, posIP);
-                }
-                else
-                {
-                    double coefResist = 0.455 / std::pow (std::log10(coefReynolds), 2.58) - 1700.0 / coefReynolds;
-                    if (coefReynolds < 6.0e5)
-                        coefResist = std::max (coefResist, 1.328 / std::sqrt(coefReynolds));
-
-                    Vector3 forceT = coefResist * 0.5 * fluid.density * velPara * velPara * vePara;
-                    pLinkForceT->addForce (coefIP * forceT, posIP);
-                }
-            }
-        }
+void FFCalculator::calcSurfaceGeneral(LinkForce* pLinkForceN, LinkForce* pLinkForceT,int degreeNumber)
+{
+    calcSurfaceGeneral (pLinkForceN, pLinkForceT, SurfaceQuadrature (_triAttrAry, degreeNumber));
+    return;
+}
+
+void FFCalculator::calcSurfaceGeneral(LinkForce* pLinkForceN, LinkForce* pLinkForceT, const SurfaceQuadrature& quadrature)
+{
+
+    const int numIP = quadrature.size();
+    if (numIP == 0)
+        return;
+
+    if (_fluidEnv.isNull() && _fluidEnvAll.isFluid == false)
+        return;
+
+    // The Gauss points are processed by the blocks of the following size as the columns of
+    // the matrices and arrays, which are kept in the stack and are evaluated with the SIMD
+    // instructions by Eigen
+    constexpr int BlockSize = 128;
+    typedef Eigen::Array<double, Eigen::Dynamic, 1, 0, BlockSize, 1> BlockArray;
+    typedef Eigen::Matrix<double, 3, Eigen::Dynamic, 0, 3, BlockSize> BlockMatrix3X;
+
+    const Transform3& trans = _linkState.trans();
+    const Matrix3 rot = trans.linear();
+    const Vector3 origin = trans.translation();
+
+    const Vector3  tvel = _linkState.translationalVelocityAt (origin);
+    const Vector3& rvel = _linkState.rotationalVelocity();
+
+    const double repLength = std::cbrt (_linkVolume);
+    const double ln10 = std::log (10.0);
+
+    // The forces are summed up with the moments about the link origin
+    Vector3 forceN  = Vector3::Zero();
+    Vector3 momentN = Vector3::Zero();
+    Vector3 forceT  = Vector3::Zero();
+    Vector3 momentT = Vector3::Zero();
+
+    BlockArray    densities;
+    BlockArray    viscosities;
+    BlockMatrix3X velocities;
+
+    for (int head=0; head<numIP; head+=BlockSize)
+    {
+        const int n = std::min (BlockSize, numIP - head);
+
+        const BlockMatrix3X offsets   = rot * quadrature.positions().middleCols (head, n);
+        const BlockMatrix3X normals   = rot * quadrature.normals().middleCols (head, n);
+        const BlockMatrix3X positions = offsets.colwise() + origin;
+        const BlockArray    coefs     = quadrature.coefficients().segment (head, n).array();
+
+        densities.resize (n);
+        viscosities.resize (n);
+        velocities.resize (3, n);
+        _fluidEnv.get (positions, _fluidEnvAll, densities, viscosities, velocities);
+
+        // The density of a point without fluid is zero, which makes its forces zero
+        viscosities = (densities > 0.0).select (viscosities, 1.0);
+
+        const BlockMatrix3X velRelative = (velocities.colwise() - tvel) + offsets.colwise().cross (rvel);
+
+        // Decomposition of the relative velocities into the components along -normal and on the surface
+        BlockArray velPerp = -(velRelative.array() * normals.array()).colwise().sum().transpose();
+        const BlockMatrix3X vePlane = velRelative + normals * velPerp.matrix().asDiagonal();
+        const BlockArray velPara = vePlane.colwise().norm().transpose().array();
+        velPerp = (velPerp > TINY_VELOCITY).select (velPerp, 0.0);
+
+        const BlockArray normalScales = -coefs * 0.5 * densities * velPerp.square();
+
+        const BlockArray coefReynolds = densities * velPara * repLength / viscosities;
+
+        const BlockArray laminarStresses =
+            0.664 * velPara * (viscosities * densities * velPara / repLength).sqrt();
+
+        // pow (log10 (Re), -2.58) is evaluated as exp (-2.58 * log (log10 (Re))) to be vectorized
+        const BlockArray turbulentReynolds = coefReynolds.max (4.0e5);
+        BlockArray coefResists =
+            0.455 * (-2.58 * (turbulentReynolds.log() / ln10).log()).exp() - 1700.0 / turbulentReynolds;
+        coefResists =
+            (turbulentReynolds < 6.0e5).select (coefResists.max (1.328 / turbulentReynolds.sqrt()), coefResists);
+        const BlockArray turbulentStresses = coefResists * 0.5 * densities * velPara.square();
+
+        // The tangential force is applied along vePlane / velPara
+        const BlockArray tangentialScales =
+            (velPara > TINY_VELOCITY).select (
+                coefs * (coefReynolds < 4.0e5).select (laminarStresses, turbulentStresses) / velPara, 0.0);
+
+        const BlockMatrix3X forcesN = normals * normalScales.matrix().asDiagonal();
+        const BlockMatrix3X forcesT = vePlane * tangentialScales.matrix().asDiagonal();
+
+        forceN  += forcesN.rowwise().sum();
+        momentN += _sumCrossProducts (offsets, forcesN);
+        forceT  += forcesT.rowwise().sum();
+        momentT += _sumCrossProducts (offsets, forcesT);
     }
+
+    pLinkForceN->addForce (forceN, origin);
+    pLinkForceN->addMoment (momentN);
+    pLinkForceT->addForce (forceT, origin);
+    pLinkForceT->addMoment (momentT);
+
     return;
 }
 
@@ -196,6 +273,15 @@ void FFCalculator::_calcFrameAxisDirection (
     return;
 }
 
+Vector3 FFCalculator::_sumCrossProducts (
+    const Eigen::Ref<const Eigen::Matrix3Xd>& vectors1, const Eigen::Ref<const Eigen::Matrix3Xd>& vectors2)
+{
+    return Vector3 (
+        vectors1.row(1).dot(vectors2.row(2)) - vectors1.row(2).dot(vectors2.row(1)),
+        vectors1.row(2).dot(vectors2.row(0)) - vectors1.row(0).dot(vectors2.row(2)),
+        vectors1.row(0).dot(vectors2.row(1)) - vectors1.row(1).dot(vectors2.row(0)));
+}
+
 void FFCalculator::_calcVectorDecomp (
     const Vector3& vec, const Vector3& vDirection, double* normDir,
     double* normPlane, Vector3* vePlane)
@@ -8,6 +8,57 @@
 namespace Multicopter {
 namespace FFCalc {
 
+/**
+   Gauss points of the surface triangles of a link in the link local frame.
+   The points are stored as the columns of matrices so that they can be transformed at once,
+   and the points with negligible cutoff coefficients are excluded when the data is built.
+*/
+class SurfaceQuadrature
+{
+private:
+    Eigen::Matrix3Xd _positions;
+
+    Eigen::Matrix3Xd _normals;
+
+    // Gauss weight * triangle area * cutoff coefficient
+    Eigen::VectorXd  _coefficients;
+
+public:
+
+    // The number of the points of the largest Gauss quadrature rule of a triangle
+    static constexpr int MaxNumGaussPoints = 4;
+
+    SurfaceQuadrature () { }
+
+    SurfaceQuadrature (const std::vector<LinkTriangleAttribute>& triAttrAry, int degreeNumber)
+    {
+        build (triAttrAry, degreeNumber);
+    }
+
+    void build (const std::vector<LinkTriangleAttribute>& triAttrAry, int degreeNumber);
+
+    int size() const
+    {
+        return static_cast<int>(_coefficients.size());
+    }
+
+    const Eigen::Matrix3Xd& positions() const
+    {
+        return _positions;
+    }
+
+    const Eigen::Matrix3Xd& normals() const
+    {
+        return _normals;
+    }
+
+    const Eigen::VectorXd& coefficients() const
+    {
+        return _coefficients;
+    }
+};
+
+
 class FFCalculator
 {
 private:
@@ -53,6 +104,8 @@ public:
 
     void calcSurfaceGeneral (LinkForce* pLinkForceN, LinkForce* pLinkForceT,int);
 
+    void calcSurfaceGeneral (LinkForce* pLinkForceN, LinkForce* pLinkForceT, const SurfaceQuadrature& quadrature);
+
     void calcGravity_forDebug (LinkForce* pLinkForce);
 
 private:
@@ -64,6 +117,9 @@ private:
     void _calcVectorDecomp (
         const Vector3& vec, const Vector3& vDirection, double* normDir,
         double* normPlane, Vector3* vePlane);
+
+    static Vector3 _sumCrossProducts (
+        const Eigen::Ref<const Eigen::Matrix3Xd>& vectors1, const Eigen::Ref<const Eigen::Matrix3Xd>& vectors2);
 };
 
 
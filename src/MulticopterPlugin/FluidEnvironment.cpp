@@ -52,6 +52,44 @@ FluidEnvironment::get(const Eigen::Vector3d& pos, FluidValue& val) const{
     return true;    
 }
 
+void
+FluidEnvironment::get(const Eigen::Ref<const Eigen::Matrix3Xd>& positions, const FluidValue& outsideValue,
+                      Eigen::Ref<Eigen::ArrayXd> out_densities, Eigen::Ref<Eigen::ArrayXd> out_viscosities,
+                      Eigen::Ref<Eigen::Matrix3Xd> out_velocities) const{
+
+    const int n = positions.cols();
+
+    if(_isNull){
+        if(outsideValue.isFluid == true){
+            out_densities.setConstant(outsideValue.density);
+            out_viscosities.setConstant(outsideValue.viscosity);
+            out_velocities.colwise() = outsideValue.velocity;
+        }else{
+            out_densities.setZero();
+            out_viscosities.setZero();
+            out_velocities.setZero();
+        }
+        return;
+    }
+
+    FluidValue val;
+    for(int i=0 ; i<n ; ++i){
+        const FluidValue* pVal = &val;
+        if( get(positions.col(i), val) == false ){
+            pVal = &outsideValue;
+        }
+        if(pVal->isFluid == true){
+            out_densities[i] = pVal->density;
+            out_viscosities[i] = pVal->viscosity;
+            out_velocities.col(i) = pVal->velocity;
+        }else{
+            out_densities[i] = 0.0;
+            out_viscosities[i] = 0.0;
+            out_velocities.col(i).setZero();
+        }
+    }
+}
+
 bool
 FluidEnvironment::isFluidCell(int ix, int iy, int iz) const
 {
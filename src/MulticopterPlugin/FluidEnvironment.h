@@ -46,6 +46,16 @@ public:
 
     bool get(const Eigen::Vector3d& pos, FluidValue& val) const;
 
+    /**
+       Get the values at the positions given as the columns of a matrix.
+       The outside value is used for the positions out of the boundary,
+       and zero density is stored for the positions where no fluid exists.
+       The outputs must have the same number of elements as the positions.
+    */
+    void get(const Eigen::Ref<const Eigen::Matrix3Xd>& positions, const FluidValue& outsideValue,
+             Eigen::Ref<Eigen::ArrayXd> out_densities, Eigen::Ref<Eigen::ArrayXd> out_viscosities,
+             Eigen::Ref<Eigen::Matrix3Xd> out_velocities) const;
+
     bool load(const std::string& fileName);
 
     Boxd boundary() const{
@@ -5,9 +5,12 @@
 #include "MulticopterPluginHeader.h"
 #include "MulticopterSimulatorItem.h"
 #include <cnoid/YAMLBodyLoader>
+#include <cnoid/ThreadPool>
 #include <fmt/format.h>
 #include <cmath>
 #include <random>
+#include <thread>
+#include <atomic>
 
 using namespace std;
 using namespace cnoid;
@@ -152,6 +155,17 @@ SimulationManager::initializeSimulation(SimulatorItem* simItem, MulticopterSimul
 
     calculateSurfaceCuttoffCoefficient(_fluidLinkBodyMap,_linkPolygonMap);
 
+    for(auto& linkPolygon : _linkPolygonMap){
+        _linkQuadratureMap[linkPolygon.first].build(linkPolygon.second, getDegreeNumber());
+    }
+
+    if(!_threadPool){
+        int numThreads = std::min(8, static_cast<int>(std::thread::hardware_concurrency()));
+        if(numThreads >= 2){
+            _threadPool.reset(new ThreadPool(numThreads));
+        }
+    }
+
     double curTime = simItem->currentTime();
     _nextLogTime         = curTime;
 
@@ -309,6 +323,7 @@ void
 SimulationManager::clearLinkPolygon()
 {
     _linkPolygonMap.clear();
+    _linkQuadratureMap.clear();
 }
 
 void
@@ -520,6 +535,28 @@ SimulationManager::midDynamicFunction(SimulatorItem* simItem, MulticopterSimulat
     _rotorOutValAry.clear();
     _linkOutValAry.clear();
 
+    // The link states are updated first so that the surface forces, which are the most
+    // expensive part of the fluid forces, can be calculated for all the links in parallel
+    vector<Link*> targetLinkAry;
+    for(auto itb = begin(_bodyLinkMap) ; itb != end(_bodyLinkMap) ; ++itb){
+        for(auto itl = begin(itb->second) ; itl != end(itb->second) ; ++itl){
+            try{
+                _linkStateMap[*itl]->update (simItem->currentTime(), **itl);
+                targetLinkAry.push_back(*itl);
+            }
+            catch(runtime_error& err){
+                UtilityImpl::printErrorMessage(
+                    format("{0:s} in {1:s} at {2:lf}",
+                           err.what(), (*itl)->name(), simItem->currentTime()));
+                targetLinkAry.push_back(nullptr);
+            }
+        }
+    }
+
+    vector<FFCalc::LinkForce> surfaceForceAry;
+    calcSurfaceForces(targetLinkAry, surfaceForceAry);
+
+    int linkIndex = 0;
     for(auto itb = begin(_bodyLinkMap) ; itb != end(_bodyLinkMap) ; ++itb){
         std::map<int,std::tuple<double,Vector3>> effectMap;
         bool calFlag=false;
@@ -554,13 +591,17 @@ SimulationManager::midDynamicFunction(SimulatorItem* simItem, MulticopterSimulat
 
         for(auto itl = begin(linkAry) ; itl != end(linkAry) ; ++itl){
 
+            const int index = linkIndex++;
+            if(!targetLinkAry[index]){
+                continue;
+            }
+
             try{
                 FFCalc::LinkStatePtr pLinkState;
                 pLinkState = _linkStateMap[*itl];
-                pLinkState->update (simItem->currentTime(), **itl);
 
                 std::unique_ptr<FFCalc::LinkForce> pLinkForce = midDynamicFunctionLink (
-                    simItem, multicopterSimItem, **itl, *pLinkState,effectMap,calFlag);
+                    simItem, multicopterSimItem, **itl, *pLinkState, surfaceForceAry[index], effectMap,calFlag);
 
                 (*itl)->f_ext()   += pLinkForce->getForce();
                 (*itl)->tau_ext() += pLinkForce->getMoment();
@@ -577,8 +618,69 @@ SimulationManager::midDynamicFunction(SimulatorItem* simItem, MulticopterSimulat
 }
 
 
+void
+SimulationManager::calcSurfaceForces(const vector<Link*>& linkAry, vector<FFCalc::LinkForce>& out_forces)
+{
+    const int numLinks = linkAry.size();
+    out_forces.assign(numLinks, FFCalc::LinkForce(Vector3::Zero()));
+
+    const FluidEnvironment& fluidEnv = *fluidEnvironmentSim();
+    int numTotalPoints = 0;
+    vector<const FFCalc::SurfaceQuadrature*> quadratureAry(numLinks, nullptr);
+
+    for(int i=0 ; i<numLinks ; ++i){
+        Link* link = linkAry[i];
+        if(!link){
+            continue;
+        }
+        const LinkAttribute& linkAttr = linkAttribute(link);
+        if(linkAttr.isNull() || linkAttr.linkForceApplyFlgAry()[3] == false){
+            continue;
+        }
+        auto it = _linkQuadratureMap.find(link);
+        if(it != _linkQuadratureMap.end() && it->second.size() > 0){
+            quadratureAry[i] = &it->second;
+            numTotalPoints += it->second.size();
+        }
+    }
+
+    // Each link force is calculated by one thread, so the result does not depend on the scheduling
+    auto calcLinkSurfaceForce = [&](int i){
+        Link* link = linkAry[i];
+        const LinkAttribute linkAttr = linkAttribute(link);
+        const FFCalc::LinkState& linkState = *_linkStateMap.find(link)->second;
+        FFCalc::FFCalculator ffc (_gravity, fluidEnv, _fluEnvAllSim, *link, linkAttr, linkState, _linkPolygonMap.find(link)->second);
+        ffc.calcSurfaceGeneral (&out_forces[i], &out_forces[i], *quadratureAry[i]);
+    };
+
+    constexpr int MinNumPointsToParallelize = 2000;
+
+    if(!_threadPool || numTotalPoints < MinNumPointsToParallelize){
+        for(int i=0 ; i<numLinks ; ++i){
+            if(quadratureAry[i]){
+                calcLinkSurfaceForce(i);
+            }
+        }
+    } else {
+        std::atomic<int> nextIndex(0);
+        for(int i=0 ; i<_threadPool->size() ; ++i){
+            _threadPool->start([&](){
+                int index;
+                while((index = nextIndex++) < numLinks){
+                    if(quadratureAry[index]){
+                        calcLinkSurfaceForce(index);
+                    }
+                }
+            });
+        }
+        _threadPool->wait();
+    }
+}
+
+
 std::unique_ptr<FFCalc::LinkForce> SimulationManager::midDynamicFunctionLink (
     SimulatorItem* simItem, MulticopterSimulatorItem* multicopterSimItem, cnoid::Link& link, const FFCalc::LinkState& linkState,
+    const FFCalc::LinkForce& surfaceForce,
     std::map<int,std::tuple<double,Vector3>> effectMap,bool calFlag=false)
 {
 
@@ -620,7 +722,7 @@ std::unique_ptr<FFCalc::LinkForce> SimulationManager::midDynamicFunctionLink (
         FFCalc::LinkForce lfGenSurface(pLinkForce->point());
 
         if(linkForceApplyTarget[3] == true){
-            ffc.calcSurfaceGeneral (&lfGenSurface, &lfGenSurface,getDegreeNumber());
+            lfGenSurface.add(surfaceForce);
             lfSurface.add(lfGenSurface);
         }
         pLinkForce->add(lfSurface);
@@ -806,6 +908,13 @@ SimulationManager::logProc(SimulatorItem* simItem, MulticopterSimulatorItem* mul
 void
 SimulationManager::setDegreeNumber(int degreeNumber)
 {
+    // The Gauss quadrature of a triangle is only defined for up to four points
+    const int maxDegreeNumber = FFCalc::SurfaceQuadrature::MaxNumGaussPoints;
+    if(degreeNumber > maxDegreeNumber){
+        UtilityImpl::printWarningMessage(
+            format(_("Degree number {0} is not supported. {1} is used instead."), degreeNumber, maxDegreeNumber));
+        degreeNumber = maxDegreeNumber;
+    }
     _degree=degreeNumber;
 }
 
@@ -6,6 +6,7 @@
 
 namespace cnoid {
 class MulticopterSimulatorItem;
+class ThreadPool;
 }
 
 namespace Multicopter {
@@ -136,8 +137,10 @@ protected:
 
     void calcCuttoffCoef (const FFCalc::CutoffCoef& cutoffCalc, const FFCalc::GaussTriangle3d& tri, const std::vector<FFCalc::GaussTriangle3d>& trgTriAry,double coefs[]);
 
+    void calcSurfaceForces(const std::vector<cnoid::Link*>& linkAry, std::vector<FFCalc::LinkForce>& out_forces);
+
     std::unique_ptr<FFCalc::LinkForce>
-    midDynamicFunctionLink(cnoid::SimulatorItem* simItem, cnoid::MulticopterSimulatorItem* fluidSimItem, cnoid::Link& link, const FFCalc::LinkState& linkState,std::map<int,std::tuple<double,cnoid::Vector3>> effectMap,bool calFlag);
+    midDynamicFunctionLink(cnoid::SimulatorItem* simItem, cnoid::MulticopterSimulatorItem* fluidSimItem, cnoid::Link& link, const FFCalc::LinkState& linkState, const FFCalc::LinkForce& surfaceForce, std::map<int,std::tuple<double,cnoid::Vector3>> effectMap,bool calFlag);
 
     std::list<RotorDevice*> targetRotorDevices() const;
     std::list<RotorDevice*> targetRotorDevices(cnoid::Link* link) const;
@@ -156,6 +159,7 @@ private:
     std::map<cnoid::Link*, std::tuple<cnoid::Body*, LinkAttribute> >_fluidLinkBodyMap;
     std::map<cnoid::Link*, std::tuple<cnoid::Body*, LinkAttribute> > _effectLinkBodyMap;
     std::map<cnoid::Link*, std::vector<LinkTriangleAttribute>>_linkPolygonMap;
+    std::map<cnoid::Link*, FFCalc::SurfaceQuadrature> _linkQuadratureMap;
     std::map<const cnoid::Link*, FFCalc::LinkStatePtr> _linkStateMap;
 
     std::list<RotorOutValue> _rotorOutValAry;
@@ -186,6 +190,7 @@ private:
 
     MulticopterMonitorView* _multicopterMonitorView;
     cnoid::AISTCollisionDetectorPtr _collisionDetector;
+    std::unique_ptr<cnoid::ThreadPool> _threadPool;
 
     QUuid _simStartEndEvId;
     QUuid _simStepEvId;
@@ -68,6 +68,34 @@ inline void toInternal(const Vector3& v, Vector3& out_v) {
     out_v << v.x(), v.z(), -v.y();
 }
 
+/**
+   The trimesh data of a mesh in the local coordinate of the mesh. The data is shared by the
+   geometries of the links which have the mesh without scaling, and it is kept by the
+   simulator item over the simulation runs as long as the mesh exists.
+
+   The data is invalidated when the mesh notifies an update. The modification of the vertices
+   or the triangles without the notification is not detected unless their numbers change.
+*/
+class TriMeshData : public Referenced
+{
+public:
+    dTriMeshDataID id;
+    vector<Vertex> vertices;
+    vector<Triangle> triangles;
+    weak_ref_ptr<SgVertexArray> orgVertices;
+    int numOrgVertices;
+    int numOrgTriangles;
+    bool isInvalidated;
+    ScopedConnection meshUpdateConnection;
+
+    TriMeshData(SgMesh* mesh);
+    ~TriMeshData();
+    bool isValidFor(SgMesh* mesh) const;
+};
+typedef ref_ptr<TriMeshData> TriMeshDataPtr;
+
+typedef map<weak_ref_ptr<SgMesh>, TriMeshDataPtr> TriMeshDataMap;
+
 class ODEBody;
 
 class ODELink : public Referenced
@@ -80,6 +108,7 @@ public:
     dTriMeshDataID triMeshDataID;
     vector<Vertex> vertices;
     vector<Triangle> triangles;
+    vector<TriMeshDataPtr> sharedTriMeshData;
     typedef map< dGeomID, Position, std::less<dGeomID>, 
                  Eigen::aligned_allocator< pair<const dGeomID, Position> > > OffsetMap;
     OffsetMap offsetMap;
@@ -89,14 +118,15 @@ public:
             const Vector3& parentOrigin, Link* link);
     ~ODELink();
     void createLinkBody(ODESimulatorItemImpl* simImpl, dWorldID worldID, ODELink* parent, const Vector3& origin);
-    void createGeometry(ODEBody* odeBody);
+    void createGeometry(ODESimulatorItemImpl* simImpl, ODEBody* odeBody);
     void setKinematicStateToODE();
     void setKinematicStateToODEflip();
     void setTorqueToODE();
     void setVelocityToODE();
     void getKinematicStateFromODE();
     void getKinematicStateFromODEflip();
-    void addMesh(MeshExtractor* extractor, ODEBody* odeBody);
+    void addMesh(MeshExtractor* extractor, ODESimulatorItemImpl* simImpl, ODEBody* odeBody);
+    void addGeometry(dGeomID geomId, const Affine3& T);
 };
 typedef ref_ptr<ODELink> ODELinkPtr;
 
@@ -154,6 +184,7 @@ public:
     double surfaceLayerDepth;
     bool useWorldCollisionDetector;
     BodyCollisionDetector bodyCollisionDetector;
+    TriMeshDataMap triMeshDataMap;
 
     double physicsTime;
     QElapsedTimer physicsTimer;
@@ -167,6 +198,7 @@ public:
     void clear();
     bool initializeSimulation(const std::vector<SimulationBody*>& simBodies);
     void addBody(ODEBody* odeBody);
+    TriMeshData* getOrCreateTriMeshData(SgMesh* mesh);
     bool stepSimulation(const std::vector<SimulationBody*>& activeSimBodies);
     void doPutProperties(PutPropertyFunction& putProperty);
     void store(Archive& archive);
@@ -194,7 +226,7 @@ ODELink::ODELink
         createLinkBody(simImpl, odeBody->worldID, parent, o);
     }
     if(!simImpl->useWorldCollisionDetector){
-        createGeometry(odeBody);
+        createGeometry(simImpl, odeBody);
     }
 
     for(Link* child = link->child(); child; child = child->sibling()){
@@ -340,12 +372,12 @@ void ODELink::createLinkBody(ODESimulatorItemImpl* simImpl, dWorldID worldID, OD
 }
 
 
-void ODELink::createGeometry(ODEBody* odeBody)
+void ODELink::createGeometry(ODESimulatorItemImpl* simImpl, ODEBody* odeBody)
 {
     if(link->collisionShape()){
         MeshExtractor* extractor = new MeshExtractor;
         if(extractor->extract(
-               link->collisionShape(), [&](){ addMesh(extractor, odeBody); })){
+               link->collisionShape(), [&](){ addMesh(extractor, simImpl, odeBody); })){
             if(!vertices.empty()){
                 triMeshDataID = dGeomTriMeshDataCreate();
                 dGeomTriMeshDataBuildSingle(triMeshDataID,
@@ -362,7 +394,7 @@ void ODELink::createGeometry(ODEBody* odeBody)
 }
 
 
-void ODELink::addMesh(MeshExtractor* extractor, ODEBody* odeBody)
+void ODELink::addMesh(MeshExtractor* extractor, ODESimulatorItemImpl* simImpl, ODEBody* odeBody)
 {
     SgMesh* mesh = extractor->currentMesh();
     const Affine3& T = extractor->currentTransform();
@@ -429,8 +461,6 @@ void ODELink::addMesh(MeshExtractor* extractor, ODEBody* odeBody)
                 break;
             }
             if(created){
-                geomID.push_back(geomId);
-                dGeomSetBody(geomId, bodyID);
                 Affine3 T_ = extractor->currentTransformWithoutScaling();
                 if(translation){
                     T_ *= Translation3(*translation);
@@ -438,21 +468,21 @@ void ODELink::addMesh(MeshExtractor* extractor, ODEBody* odeBody)
                 if(mesh->primitiveType()==SgMesh::CYLINDER ||
                         mesh->primitiveType()==SgMesh::CAPSULE )
                     T_ *= AngleAxis(radian(90), Vector3::UnitX());
-                Vector3 p = T_.translation()-link->c();
-                dMatrix3 R = { T_(0,0), T_(0,1), T_(0,2), 0.0,
-                               T_(1,0), T_(1,1), T_(1,2), 0.0,
-                               T_(2,0), T_(2,1), T_(2,2), 0.0 };
-                if(bodyID){
-                    dGeomSetOffsetPosition(geomId, p.x(), p.y(), p.z());
-                    dGeomSetOffsetRotation(geomId, R);
-                }else{
-                    offsetMap.insert(OffsetMap::value_type(geomId,T_));
-                }
+                addGeometry(geomId, T_);
                 meshAdded = true;
             }
         }
     }
 
+    if(!meshAdded && !extractor->isCurrentScaled() && mesh->numTriangles() > 0){
+        // The trimesh data is shared with the other links having the same mesh
+        TriMeshData* data = simImpl->getOrCreateTriMeshData(mesh);
+        sharedTriMeshData.push_back(data);
+        dGeomID geomId = dCreateTriMesh(odeBody->spaceID, data->id, 0, 0, 0);
+        addGeometry(geomId, T);
+        meshAdded = true;
+    }
+
     if(!meshAdded){
         const int vertexIndexTop = vertices.size();
 
@@ -476,6 +506,23 @@ void ODELink::addMesh(MeshExtractor* extractor, ODEBody* odeBody)
 }
 
 
+void ODELink::addGeometry(dGeomID geomId, const Affine3& T)
+{
+    geomID.push_back(geomId);
+    dGeomSetBody(geomId, bodyID);
+    if(bodyID){
+        Vector3 p = T.translation() - link->c();
+        dMatrix3 R = { T(0,0), T(0,1), T(0,2), 0.0,
+                       T(1,0), T(1,1), T(1,2), 0.0,
+                       T(2,0), T(2,1), T(2,2), 0.0 };
+        dGeomSetOffsetPosition(geomId, p.x(), p.y(), p.z());
+        dGeomSetOffsetRotation(geomId, R);
+    } else {
+        offsetMap.insert(OffsetMap::value_type(geomId, T));
+    }
+}
+
+
 ODELink::~ODELink()
 {
     for(vector<dGeomID>::iterator it=geomID.begin(); it!=geomID.end(); it++)
@@ -855,6 +902,52 @@ void ODESimulatorItem::initializeClass(ExtensionManager* ext)
 }
 
 
+TriMeshData::TriMeshData(SgMesh* mesh)
+{
+    const SgVertexArray& orgVertices_ = *mesh->vertices();
+    orgVertices = mesh->vertices();
+    numOrgVertices = orgVertices_.size();
+    numOrgTriangles = mesh->numTriangles();
+
+    vertices.reserve(numOrgVertices);
+    for(auto& v : orgVertices_){
+        vertices.push_back(Vertex(v.x(), v.y(), v.z()));
+    }
+    triangles.resize(numOrgTriangles);
+    for(int i=0; i < numOrgTriangles; ++i){
+        SgMesh::TriangleRef src = mesh->triangle(i);
+        Triangle& tri = triangles[i];
+        tri.indices[0] = src[0];
+        tri.indices[1] = src[1];
+        tri.indices[2] = src[2];
+    }
+
+    id = dGeomTriMeshDataCreate();
+    dGeomTriMeshDataBuildSingle(id,
+                                &vertices[0], sizeof(Vertex), vertices.size(),
+                                &triangles[0], triangles.size() * 3, sizeof(Triangle));
+
+    isInvalidated = false;
+    meshUpdateConnection =
+        mesh->sigUpdated().connect([this](const SgUpdate&){ isInvalidated = true; });
+}
+
+
+TriMeshData::~TriMeshData()
+{
+    dGeomTriMeshDataDestroy(id);
+}
+
+
+bool TriMeshData::isValidFor(SgMesh* mesh) const
+{
+    return (!isInvalidated &&
+            orgVertices.lock() == mesh->vertices() &&
+            numOrgVertices == static_cast<int>(mesh->vertices()->size()) &&
+            numOrgTriangles == mesh->numTriangles());
+}
+
+
 ODESimulatorItem::ODESimulatorItem()
 {
     impl = new ODESimulatorItemImpl(this);
@@ -1051,6 +1144,16 @@ void ODESimulatorItemImpl::clear()
 }    
 
 
+TriMeshData* ODESimulatorItemImpl::getOrCreateTriMeshData(SgMesh* mesh)
+{
+    TriMeshDataPtr& data = triMeshDataMap[mesh];
+    if(!data || !data->isValidFor(mesh)){
+        data = new TriMeshData(mesh);
+    }
+    return data;
+}
+
+
 Item* ODESimulatorItem::doDuplicate() const
 {
     return new ODESimulatorItem(*this);
@@ -1073,6 +1176,16 @@ bool ODESimulatorItemImpl::initializeSimulation(const std::vector<SimulationBody
 {
     clear();
 
+    // Remove the trimesh data of the meshes which no longer exist
+    auto p = triMeshDataMap.begin();
+    while(p != triMeshDataMap.end()){
+        if(p->first.expired()){
+            p = triMeshDataMap.erase(p);
+        } else {
+            ++p;
+        }
+    }
+
     flipYZ = is2Dmode;
 
     Vector3 g = gravity;
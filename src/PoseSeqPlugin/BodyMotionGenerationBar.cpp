@@ -515,6 +515,30 @@ bool BodyMotionGenerationBar::shapeBodyMotion
 }
         
 
+bool BodyMotionGenerationBar::updateBodyMotion
+(BodyPtr body, PoseProvider* provider, BodyMotionItemPtr motionItem,
+ double lowerTime, double upperTime, bool putMessages)
+{
+    auto motion = motionItem->motion();
+
+    if((balancerToggle->isChecked() && balancer) ||
+       setup->onlyTimeBarRangeCheck.isChecked() ||
+       motion->frameRate() != timeBar->frameRate()){
+        return shapeBodyMotion(body, provider, motionItem, putMessages);
+    }
+
+    poseProviderToBodyMotionConverter->setFullTimeRange();
+    poseProviderToBodyMotionConverter->setAllLinkPositionOutput(setup->se3Check.isChecked());
+
+    bool result = poseProviderToBodyMotionConverter->update(body, provider, *motion, lowerTime, upperTime);
+    
+    if(result){
+        motionItem->notifyUpdate();
+    }
+    return result;
+}
+
+
 bool BodyMotionGenerationBar::shapeBodyMotionWithSimpleInterpolation
 (BodyPtr& body, PoseProvider* provider, BodyMotionItemPtr motionItem)
 {
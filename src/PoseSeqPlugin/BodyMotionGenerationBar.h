@@ -35,6 +35,15 @@ public:
     bool shapeBodyMotion(
         BodyPtr body, PoseProvider* provider, BodyMotionItemPtr motionItem, bool putMessages = false);
 
+    /**
+       Regenerate the motion in the given time range while keeping the other frames.
+       The whole motion is regenerated when the balancer is used or the existing motion
+       is not compatible with the current settings.
+    */
+    bool updateBodyMotion(
+        BodyPtr body, PoseProvider* provider, BodyMotionItemPtr motionItem,
+        double lowerTime, double upperTime, bool putMessages = false);
+
     class Balancer
     {
     public:
@@ -36,10 +36,10 @@ struct Coeff
 {
     double y;    // sample value
     double yp;   // derivative value
-    double a;
-    double a_end;
-    double b;
-    double c;
+    double a = 0.0;
+    double a_end = 0.0;
+    double b = 0.0;
+    double c = 0.0;
 };
 
 struct LinkSample
@@ -262,6 +262,11 @@ public:
 
     bool needUpdate;
 
+    // The time range where the interpolation has been changed since the range was reset
+    bool isWholeTimeRangeUpdated;
+    double updatedTimeLower;
+    double updatedTimeUpper;
+
     ConnectionSet poseSeqConnections;
 
     vector<JointInfo> jointInfos;
@@ -331,6 +336,7 @@ public:
 
     Signal<void()> sigUpdated;
 
+    void copyConfiguration(const PSIImpl& org);
     void setBody(Body* body0);
     void setLinearInterpolationJoint(int jointId);
     void addFootLink(int linkIndex, const Vector3& soleCenter);
@@ -372,6 +378,10 @@ public:
     void adjustZmpAndFootKeyPoses();
     void insertAuxKeyPosesForStealthySteps();
     bool update();
+    void updateChangedTimeRange(
+        vector<JointSample::Seq>& prevJointSamples, LinkInfoMap& prevIkLinkInfos,
+        ZmpSample::Seq& prevZmpSamples, vector<LipSyncSample>& prevLipSyncSeq);
+    void expandUpdatedTimeRange(double lower, double upper);
     LinkInfo* getIkLinkInfo(int linkIndex);
     void onPoseInserted(PoseSeq::iterator it);
     void onPoseRemoving(PoseSeq::iterator it, bool isMoving);
@@ -779,6 +789,108 @@ void appendSample(typename SampleType::Seq& samples, const SampleType& sample)
     samples.push_back(sample);
 }
 
+
+template <class SampleType>
+bool hasSameAttributes(const SampleType&, const SampleType&)
+{
+    return true;
+}
+
+
+bool hasSameAttributes(const LinkSample& s1, const LinkSample& s2)
+{
+    return (s1.isBaseLink == s2.isBaseLink &&
+            s1.isTouching == s2.isTouching &&
+            s1.isSlave == s2.isSlave &&
+            s1.isAux == s2.isAux);
+}
+
+
+template <class SampleType>
+bool isAuxSample(const SampleType&)
+{
+    return false;
+}
+
+
+bool isAuxSample(const LinkSample& s)
+{
+    return s.isAux;
+}
+
+
+/**
+   @return true if the interpolation using the two samples gives the same values
+*/
+template <int dim, class SampleType>
+bool isSameSample(const SampleType& s1, const SampleType& s2)
+{
+    if(s1.x != s2.x || s1.segmentType != s2.segmentType ||
+       s1.isEndPoint != s2.isEndPoint || s1.isDirty != s2.isDirty || !hasSameAttributes(s1, s2)){
+        return false;
+    }
+    for(int i=0; i < dim; ++i){
+        const Coeff& c1 = s1.c[i];
+        const Coeff& c2 = s2.c[i];
+        if(c1.y != c2.y || c1.yp != c2.yp || c1.a != c2.a || c1.a_end != c2.a_end || c1.b != c2.b || c1.c != c2.c){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+   Compare the common head and tail samples of the sequences to detect the time range
+   where the interpolation results may differ.
+   @return false if the sequences give the same interpolation results
+*/
+template <int dim, class SampleType>
+bool detectChangedTimeRange
+(const typename SampleType::Seq& samples1, const typename SampleType::Seq& samples2,
+ double& out_lower, double& out_upper)
+{
+    out_lower = -std::numeric_limits<double>::max();
+    out_upper = std::numeric_limits<double>::max();
+    
+    auto p1 = samples1.begin();
+    auto p2 = samples2.begin();
+    auto lastSame = samples1.end();
+    int numSameHeadSamples = 0;
+    while(p1 != samples1.end() && p2 != samples2.end() && isSameSample<dim>(*p1, *p2)){
+        lastSame = p1++;
+        ++p2;
+        ++numSameHeadSamples;
+    }
+    if(p1 == samples1.end() && p2 == samples2.end()){
+        return false;
+    }
+    if(lastSame != samples1.end()){
+        // The interpolation around a link sample refers to the adjacent non-aux samples
+        while(lastSame != samples1.begin() && isAuxSample(*lastSame)){
+            --lastSame;
+        }
+        out_lower = lastSame->x;
+    }
+
+    const int maxNumSameTailSamples = std::min(samples1.size(), samples2.size()) - numSameHeadSamples;
+    auto r1 = samples1.rbegin();
+    auto r2 = samples2.rbegin();
+    auto firstSame = samples1.rend();
+    for(int i=0; i < maxNumSameTailSamples && isSameSample<dim>(*r1, *r2); ++i){
+        firstSame = r1++;
+        ++r2;
+    }
+    if(firstSame != samples1.rend()){
+        while(firstSame != samples1.rbegin() && isAuxSample(*firstSame)){
+            --firstSame;
+        }
+        out_upper = firstSame->x;
+    }
+    
+    return true;
+}
+
 }
 
 
@@ -804,6 +916,7 @@ PSIImpl::PSIImpl(PoseSeqInterpolator* self)
     isLipSyncMixEnabled = false;
     
     needUpdate = true;
+    isWholeTimeRangeUpdated = true;
 }
 
 
@@ -833,6 +946,7 @@ void PSIImpl::setBody(Body* body0)
         invalidateCurrentInterpolation();
     }
     needUpdate = true;
+    isWholeTimeRangeUpdated = true;
 }
 
 
@@ -852,6 +966,8 @@ void PSIImpl::setLinearInterpolationJoint(int jointId)
 {
     if(jointId < (int)jointInfos.size()){
         jointInfos[jointId].useLinearInterpolation = true;
+        needUpdate = true;
+        isWholeTimeRangeUpdated = true;
     }
 }
 
@@ -867,6 +983,7 @@ void PSIImpl::addFootLink(int linkIndex, const Vector3& soleCenter)
     footLinkIndices.push_back(linkIndex);
     soleCenters.push_back(soleCenter);
     needUpdate = true;
+    isWholeTimeRangeUpdated = true;
 }
 
 
@@ -876,6 +993,7 @@ void PSIImpl::clearLipSyncShapes()
     lipSyncLinkIndices.clear();
     lipSyncSeq.clear();
     needUpdate = true;
+    isWholeTimeRangeUpdated = true;
 }
 
 
@@ -978,7 +1096,7 @@ void PSIImpl::setPoseSeq(PoseSeqPtr seq)
     poseSeqConnections.disconnect();
     poseSeq = seq;
 
-    // for auto update mode (not implemented yet)
+    // The time range changed by the edits is detected in the next update
     poseSeqConnections = seq->connectSignalSet(
         [&](PoseSeq::iterator it, bool /* isMoving */){ onPoseInserted(it); },
         [&](PoseSeq::iterator it, bool isMoving){ onPoseRemoving(it, isMoving); },
@@ -986,12 +1104,17 @@ void PSIImpl::setPoseSeq(PoseSeqPtr seq)
     
     invalidateCurrentInterpolation();
     needUpdate = true;
+    isWholeTimeRangeUpdated = true;
 }
 
 
 void PoseSeqInterpolator::setTimeScaleRatio(double ratio)
 {
-    impl->timeScaleRatio = ratio;
+    if(ratio != impl->timeScaleRatio){
+        impl->timeScaleRatio = ratio;
+        impl->invalidateCurrentInterpolation();
+        impl->isWholeTimeRangeUpdated = true;
+    }
 }
 
 
@@ -1065,7 +1188,11 @@ void PSIImpl::setStealthyStepParameters
 
 void PoseSeqInterpolator::enableLipSyncMix(bool on)
 {
-    impl->isLipSyncMixEnabled = on;
+    if(on != impl->isLipSyncMixEnabled){
+        impl->isLipSyncMixEnabled = on;
+        impl->invalidateCurrentInterpolation();
+        impl->isWholeTimeRangeUpdated = true;
+    }
 }
 
 
@@ -1081,6 +1208,81 @@ SignalProxy<void()> PoseSeqInterpolator::sigUpdated()
 }
 
 
+bool PoseSeqInterpolator::getUpdatedTimeRange(double& out_lower, double& out_upper) const
+{
+    if(impl->isWholeTimeRangeUpdated || impl->needUpdate){
+        out_lower = beginningTime();
+        out_upper = endingTime();
+        return false;
+    }
+    out_lower = impl->timeScaleRatio * impl->updatedTimeLower;
+    out_upper = impl->timeScaleRatio * impl->updatedTimeUpper;
+    return true;
+}
+
+
+void PoseSeqInterpolator::resetUpdatedTimeRange()
+{
+    impl->isWholeTimeRangeUpdated = false;
+    impl->updatedTimeLower = std::numeric_limits<double>::max();
+    impl->updatedTimeUpper = -std::numeric_limits<double>::max();
+}
+
+
+void PSIImpl::expandUpdatedTimeRange(double lower, double upper)
+{
+    updatedTimeLower = std::min(updatedTimeLower, lower);
+    updatedTimeUpper = std::max(updatedTimeUpper, upper);
+}
+
+
+PoseProvider* PoseSeqInterpolator::clone() const
+{
+    auto interpolator = new PoseSeqInterpolator;
+    interpolator->impl->copyConfiguration(*impl);
+    return interpolator;
+}
+
+
+/**
+   The pose sequence is shared without connecting its signals and the interpolation is
+   updated here so that the copied interpolator can be used in another thread.
+*/
+void PSIImpl::copyConfiguration(const PSIImpl& org)
+{
+    setBody(org.body.get());
+    for(size_t i=0; i < jointInfos.size(); ++i){
+        jointInfos[i].useLinearInterpolation = org.jointInfos[i].useLinearInterpolation;
+    }
+    footLinkIndices = org.footLinkIndices;
+    soleCenters = org.soleCenters;
+
+    isAutoZmpAdjustmentMode = org.isAutoZmpAdjustmentMode;
+    minZmpTransitionTime = org.minZmpTransitionTime;
+    zmpCenteringTimeThresh = org.zmpCenteringTimeThresh;
+    zmpTimeMarginBeforeLifting = org.zmpTimeMarginBeforeLifting;
+    zmpMaxDistanceFromCenterSqr = org.zmpMaxDistanceFromCenterSqr;
+
+    isStealthyStepMode = org.isStealthyStepMode;
+    setStealthyStepParameters(
+        org.stealthyHeightRatioThresh, org.flatLiftingHeight, org.flatLandingHeight,
+        org.impactReductionHeight, org.impactReductionTime);
+
+    isLipSyncMixEnabled = org.isLipSyncMixEnabled;
+    lipSyncJoints = org.lipSyncJoints;
+    lipSyncLinkIndices = org.lipSyncLinkIndices;
+    lipSyncShapes = org.lipSyncShapes;
+    lipSyncMaxTransitionTime = org.lipSyncMaxTransitionTime;
+
+    timeScaleRatio = org.timeScaleRatio;
+    poseSeq = org.poseSeq;
+
+    if(poseSeq){
+        update();
+    }
+}
+
+
 bool PoseSeqInterpolator::interpolate(double time)
 {
     return impl->interpolate(time, -1, Vector3::Zero());
@@ -1514,16 +1716,21 @@ bool PSIImpl::update()
         return false;
     }
     
+    // The previous samples are kept to detect the changed time range
+    vector<JointSample::Seq> prevJointSamples(jointInfos.size());
     for(size_t i=0; i < jointInfos.size(); ++i){
+        prevJointSamples[i].swap(jointInfos[i].samples);
         jointInfos[i].clear();
     }
-    ikLinkInfos.clear();
-    zmpSamples.clear();
-
-    lipSyncSeq.clear();
+    LinkInfoMap prevIkLinkInfos;
+    prevIkLinkInfos.swap(ikLinkInfos);
+    ZmpSample::Seq prevZmpSamples;
+    prevZmpSamples.swap(zmpSamples);
+    vector<LipSyncSample> prevLipSyncSeq;
+    prevLipSyncSeq.swap(lipSyncSeq);
 
+    footLinkInfos.clear();
     if(isAutoZmpAdjustmentMode || isStealthyStepMode){
-        footLinkInfos.clear();
         for(size_t i=0; i < footLinkIndices.size(); ++i){
             LinkInfo* info = getIkLinkInfo(footLinkIndices[i]);
             if(info){
@@ -1604,6 +1811,10 @@ bool PSIImpl::update()
 
     lipSyncIter = lipSyncSeq.begin();
 
+    if(!isWholeTimeRangeUpdated){
+        updateChangedTimeRange(prevJointSamples, prevIkLinkInfos, prevZmpSamples, prevLipSyncSeq);
+    }
+
     invalidateCurrentInterpolation();
     needUpdate = false;
 
@@ -1613,6 +1824,74 @@ bool PSIImpl::update()
 }
 
 
+void PSIImpl::updateChangedTimeRange
+(vector<JointSample::Seq>& prevJointSamples, LinkInfoMap& prevIkLinkInfos,
+ ZmpSample::Seq& prevZmpSamples, vector<LipSyncSample>& prevLipSyncSeq)
+{
+    double lower, upper;
+
+    for(size_t i=0; i < jointInfos.size(); ++i){
+        if(detectChangedTimeRange<1, JointSample>(prevJointSamples[i], jointInfos[i].samples, lower, upper)){
+            expandUpdatedTimeRange(lower, upper);
+        }
+    }
+
+    const LinkSample::Seq emptyLinkSamples;
+    const LinkZSample::Seq emptyLinkZSamples;
+    auto p = prevIkLinkInfos.begin();
+    auto q = ikLinkInfos.begin();
+    while(p != prevIkLinkInfos.end() || q != ikLinkInfos.end()){
+        const LinkInfo* prevInfo = nullptr;
+        const LinkInfo* info = nullptr;
+        if(q == ikLinkInfos.end() || (p != prevIkLinkInfos.end() && p->first < q->first)){
+            prevInfo = &(p++)->second;
+        } else if(p == prevIkLinkInfos.end() || q->first < p->first){
+            info = &(q++)->second;
+        } else {
+            prevInfo = &(p++)->second;
+            info = &(q++)->second;
+        }
+        if(detectChangedTimeRange<6, LinkSample>(
+               prevInfo ? prevInfo->samples : emptyLinkSamples,
+               info ? info->samples : emptyLinkSamples, lower, upper)){
+            expandUpdatedTimeRange(lower, upper);
+        }
+        if(detectChangedTimeRange<1, LinkZSample>(
+               (prevInfo && prevInfo->isFootLink) ? prevInfo->zSamples : emptyLinkZSamples,
+               (info && info->isFootLink) ? info->zSamples : emptyLinkZSamples, lower, upper)){
+            expandUpdatedTimeRange(lower, upper);
+        }
+    }
+
+    if(detectChangedTimeRange<3, ZmpSample>(prevZmpSamples, zmpSamples, lower, upper)){
+        expandUpdatedTimeRange(lower, upper);
+    }
+
+    // A lip shape is blended with the adjacent shapes within the max transition time
+    const size_t numLipSyncSamples = std::min(prevLipSyncSeq.size(), lipSyncSeq.size());
+    size_t head = 0;
+    while(head < numLipSyncSamples &&
+          prevLipSyncSeq[head].time == lipSyncSeq[head].time &&
+          prevLipSyncSeq[head].shapeId == lipSyncSeq[head].shapeId){
+        ++head;
+    }
+    if(head < prevLipSyncSeq.size() || head < lipSyncSeq.size()){
+        size_t tail = 0;
+        while(head + tail < numLipSyncSamples){
+            auto& s1 = prevLipSyncSeq[prevLipSyncSeq.size() - tail - 1];
+            auto& s2 = lipSyncSeq[lipSyncSeq.size() - tail - 1];
+            if(s1.time != s2.time || s1.shapeId != s2.shapeId){
+                break;
+            }
+            ++tail;
+        }
+        lower = (head > 0) ? (lipSyncSeq[head - 1].time - lipSyncMaxTransitionTime) : -std::numeric_limits<double>::max();
+        upper = (tail > 0) ? (lipSyncSeq[lipSyncSeq.size() - tail].time + lipSyncMaxTransitionTime) : std::numeric_limits<double>::max();
+        expandUpdatedTimeRange(lower, upper);
+    }
+}
+
+
 void PSIImpl::appendLinkSamples(PoseSeq::iterator poseIter, PosePtr& pose)
 {
     for(Pose::LinkInfoMap::iterator it = pose->ikLinkBegin(); it != pose->ikLinkEnd(); ++it){
@@ -60,6 +60,16 @@ public:
     bool update();
 
     SignalProxy<void()> sigUpdated();
+
+    /**
+       Get the time range where the interpolated poses have been changed by the updates
+       since resetUpdatedTimeRange() was called. The range is empty (lower > upper)
+       if the updates did not change any pose.
+       @return false if the poses in the whole time range may have been changed
+       or the interpolation has not been updated since the sequence was modified
+    */
+    bool getUpdatedTimeRange(double& out_lower, double& out_upper) const;
+    void resetUpdatedTimeRange();
             
     bool interpolate(double time);
     bool interpolate(double time, int waistLinkIndex, const Vector3& waistTranslation);
@@ -78,6 +88,12 @@ public:
 
     virtual void getJointPositions(std::vector<stdx::optional<double>>& out_q) const;
 
+    /**
+       The cloned interpolator shares the pose sequence but is not updated when the
+       sequence is modified.
+    */
+    virtual PoseProvider* clone() const;
+
 private:
 
     PSIImpl* impl;
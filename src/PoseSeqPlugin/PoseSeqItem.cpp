@@ -6,6 +6,7 @@
 #include "PoseSeqItem.h"
 #include "BodyMotionGenerationBar.h"
 #include <cnoid/ItemManager>
+#include <cnoid/TimeBar>
 #include <cnoid/ItemTreeView>
 #include <cnoid/MenuManager>
 #include <cnoid/MessageView>
@@ -132,6 +133,8 @@ void PoseSeqItem::init()
     clearEditHistory();
 
     generationBar = BodyMotionGenerationBar::instance();
+    timeBar = TimeBar::instance();
+    isLastGenerationSettingsValid = false;
 
     isSelectedPoseMoving = false;
 }
@@ -201,6 +204,7 @@ void PoseSeqItem::onPositionChanged()
 
         interpolator_->setLipSyncShapes(*ownerBodyItem->body()->info()->findMapping("lipSyncShapes"));
         bodyMotionItem_->motion()->setNumJoints(interpolator_->body()->numJoints());
+        isLastGenerationSettingsValid = false;
 
         if(generationBar->isAutoGenerationForNewBodyEnabled()){
             updateTrajectory(true);
@@ -362,8 +366,33 @@ bool PoseSeqItem::updateTrajectory(bool putMessages)
     bool result = false;
 
     if(ownerBodyItem){
-        result = generationBar->shapeBodyMotion(
-            ownerBodyItem->body(), interpolator_.get(), bodyMotionItem_, putMessages);
+        /*
+          The interpolation must be updated with the current generation parameters
+          so that the updated time range covers all the modifications of the sequence.
+        */
+        if(!updateInterpolation()){
+            return false;
+        }
+        GenerationSettings settings;
+        settings.isBalancerEnabled = generationBar->isBalancerEnabled();
+        settings.isTimeBarRangeOnly = generationBar->isTimeBarRangeOnly();
+        settings.isSe3Enabled = generationBar->isSe3Enabled();
+        settings.frameRate = timeBar->frameRate();
+
+        double lower, upper;
+        if(isLastGenerationSettingsValid && settings == lastGenerationSettings &&
+           interpolator_->getUpdatedTimeRange(lower, upper)){
+            result = generationBar->updateBodyMotion(
+                ownerBodyItem->body(), interpolator_.get(), bodyMotionItem_, lower, upper, putMessages);
+        } else {
+            result = generationBar->shapeBodyMotion(
+                ownerBodyItem->body(), interpolator_.get(), bodyMotionItem_, putMessages);
+        }
+        if(result){
+            interpolator_->resetUpdatedTimeRange();
+            lastGenerationSettings = settings;
+        }
+        isLastGenerationSettingsValid = result;
     }
 
     return result;
@@ -111,6 +111,25 @@ protected:
     BodyMotionGenerationBar* generationBar;
     TimeBar* timeBar;
 
+    /*
+      The settings of the last generation. The motion is partially updated only when
+      it has been generated with the same settings.
+    */
+    struct GenerationSettings {
+        bool isBalancerEnabled;
+        bool isTimeBarRangeOnly;
+        bool isSe3Enabled;
+        double frameRate;
+        bool operator==(const GenerationSettings& rhs) const {
+            return isBalancerEnabled == rhs.isBalancerEnabled &&
+                isTimeBarRangeOnly == rhs.isTimeBarRangeOnly &&
+                isSe3Enabled == rhs.isSe3Enabled &&
+                frameRate == rhs.frameRate;
+        }
+    };
+    GenerationSettings lastGenerationSettings;
+    bool isLastGenerationSettingsValid;
+
     bool isSelectedPoseMoving;
 
     double barLength_;
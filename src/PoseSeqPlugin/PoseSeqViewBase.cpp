@@ -1860,9 +1860,11 @@ void PoseSeqViewBase::doAutomaticInterpolationUpdate()
 {
     BodyMotionGenerationBar* generationBar = BodyMotionGenerationBar::instance();
     if(generationBar->isAutoInterpolationUpdateMode()){
-        currentPoseSeqItem->updateInterpolation(); // not needed ?
+        // updateTrajectory also updates the interpolation
         if(generationBar->isAutoGenerationMode()){
             currentPoseSeqItem->updateTrajectory();
+        } else {
+            currentPoseSeqItem->updateInterpolation();
         }
     }
 }
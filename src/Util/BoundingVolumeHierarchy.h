@@ -0,0 +1,215 @@
+/**
+   @author Shin'ichiro Nakaoka
+*/
+
+#ifndef CNOID_UTIL_BOUNDING_VOLUME_HIERARCHY_H
+#define CNOID_UTIL_BOUNDING_VOLUME_HIERARCHY_H
+
+#include "BoundingBox.h"
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+namespace cnoid {
+
+/**
+   Axis-aligned bounding box tree of primitives given as bounding boxes.
+   The tree is used to find the primitives intersecting with a ray or any other region
+   which can be tested against the node boxes.
+*/
+class BoundingVolumeHierarchy
+{
+public:
+    BoundingVolumeHierarchy() { }
+
+    void clear() {
+        nodes.clear();
+        indices.clear();
+    }
+
+    bool empty() const { return nodes.empty(); }
+
+    /**
+       \param boxes The bounding boxes of the primitives. The primitives with empty boxes are ignored.
+    */
+    void build(const std::vector<BoundingBoxf>& boxes, int maxLeafSize = 4) {
+
+        clear();
+
+        const int n = boxes.size();
+        std::vector<Vector3f> centers;
+        centers.reserve(n);
+        indices.reserve(n);
+        for(int i=0; i < n; ++i){
+            centers.push_back(boxes[i].empty() ? Vector3f::Zero() : boxes[i].center());
+            if(!boxes[i].empty()){
+                indices.push_back(i);
+            }
+        }
+        if(indices.empty()){
+            return;
+        }
+        nodes.reserve(2 * indices.size() / maxLeafSize + 1);
+
+        struct Range { int node; int begin; int end; };
+        std::vector<Range> stack;
+        nodes.emplace_back();
+        stack.push_back({ 0, 0, static_cast<int>(indices.size()) });
+
+        while(!stack.empty()){
+            const Range range = stack.back();
+            stack.pop_back();
+
+            Vector3f min = boxes[indices[range.begin]].min();
+            Vector3f max = boxes[indices[range.begin]].max();
+            Vector3f cmin = centers[indices[range.begin]];
+            Vector3f cmax = cmin;
+            for(int i = range.begin + 1; i < range.end; ++i){
+                const auto& box = boxes[indices[i]];
+                min = min.cwiseMin(box.min());
+                max = max.cwiseMax(box.max());
+                const Vector3f& c = centers[indices[i]];
+                cmin = cmin.cwiseMin(c);
+                cmax = cmax.cwiseMax(c);
+            }
+            nodes[range.node].min = min;
+            nodes[range.node].max = max;
+
+            const int count = range.end - range.begin;
+            int axis;
+            const float extent = (cmax - cmin).maxCoeff(&axis);
+            if(count <= maxLeafSize || extent <= 0.0f){
+                nodes[range.node].begin = range.begin;
+                nodes[range.node].count = count;
+                continue;
+            }
+
+            const int middle = range.begin + count / 2;
+            std::nth_element(
+                indices.begin() + range.begin, indices.begin() + middle, indices.begin() + range.end,
+                [&centers, axis](int i1, int i2){ return centers[i1][axis] < centers[i2][axis]; });
+
+            // The two children are stored consecutively
+            const int left = nodes.size();
+            const int right = left + 1;
+            nodes.resize(nodes.size() + 2);
+            nodes[range.node].count = 0;
+            nodes[range.node].begin = left;
+            stack.push_back({ right, middle, range.end });
+            stack.push_back({ left, range.begin, middle });
+        }
+    }
+
+    /**
+       Visit the primitives whose bounding boxes intersect with the ray segment
+       origin + t * direction (0 <= t <= io_maxDistance) in the near-to-far order of the nodes.
+       \param intersect The function called as intersect(primitiveIndex, io_maxDistance).
+       The function should shorten io_maxDistance when the primitive is hit.
+    */
+    template<class IntersectFunction>
+    void traverseRay(
+        const Vector3f& origin, const Vector3f& direction, float& io_maxDistance,
+        IntersectFunction intersect) const {
+
+        if(nodes.empty()){
+            return;
+        }
+        // Avoid the division by zero, which may cause NaN in the slab test
+        Vector3f invDirection;
+        for(int i=0; i < 3; ++i){
+            const float d = direction[i];
+            invDirection[i] = 1.0f / ((d >= 0.0f) ? std::max(d, 1.0e-20f) : std::min(d, -1.0e-20f));
+        }
+        // The depth of the tree is at most log2 of the number of primitives
+        int stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while(top > 0){
+            const Node& node = nodes[stack[--top]];
+            float t;
+            if(!entryDistance(node, origin, invDirection, io_maxDistance, t)){
+                continue;
+            }
+            if(node.count > 0){
+                for(int i = node.begin; i < node.begin + node.count; ++i){
+                    intersect(indices[i], io_maxDistance);
+                }
+            } else {
+                int near = node.begin;
+                int far = node.begin + 1;
+                float t1, t2;
+                const bool hit1 = entryDistance(nodes[near], origin, invDirection, io_maxDistance, t1);
+                const bool hit2 = entryDistance(nodes[far], origin, invDirection, io_maxDistance, t2);
+                if(hit1 && hit2){
+                    if(t2 < t1){
+                        std::swap(near, far);
+                    }
+                    stack[top++] = far;
+                    stack[top++] = near;
+                } else if(hit1){
+                    stack[top++] = near;
+                } else if(hit2){
+                    stack[top++] = far;
+                }
+            }
+        }
+    }
+
+    /**
+       Visit the primitives in the leaves reached through the nodes accepted by a test.
+       \param isNodeAccepted The function called as isNodeAccepted(min, max) with the corners of
+       the bounding box of a node. The subtree of the node is skipped when it returns false.
+       \param visit The function called as visit(primitiveIndex).
+    */
+    template<class NodeTestFunction, class VisitFunction>
+    void traverse(NodeTestFunction isNodeAccepted, VisitFunction visit) const {
+
+        if(nodes.empty()){
+            return;
+        }
+        int stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while(top > 0){
+            const Node& node = nodes[stack[--top]];
+            if(!isNodeAccepted(node.min, node.max)){
+                continue;
+            }
+            if(node.count > 0){
+                for(int i = node.begin; i < node.begin + node.count; ++i){
+                    visit(indices[i]);
+                }
+            } else {
+                stack[top++] = node.begin + 1;
+                stack[top++] = node.begin;
+            }
+        }
+    }
+
+private:
+    struct Node {
+        Vector3f min;
+        Vector3f max;
+        // The first primitive index of a leaf, or the left child index of an internal node
+        int begin;
+        // The number of primitives of a leaf, or zero for an internal node
+        int count;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int> indices;
+
+    static bool entryDistance(
+        const Node& node, const Vector3f& origin, const Vector3f& invDirection, float maxDistance, float& out_t) {
+        const Vector3f t1 = (node.min - origin).cwiseProduct(invDirection);
+        const Vector3f t2 = (node.max - origin).cwiseProduct(invDirection);
+        const float tmin = std::max(t1.cwiseMin(t2).maxCoeff(), 0.0f);
+        const float tmax = std::min(t1.cwiseMax(t2).minCoeff(), maxDistance);
+        out_t = tmin;
+        return tmin <= tmax;
+    }
+};
+
+}
+
+#endif
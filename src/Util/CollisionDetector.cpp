@@ -152,3 +152,21 @@ CollisionDetector::~CollisionDetector()
 {
 
 }
+
+
+int CollisionDetectorDistanceAPI::detectDistances
+(const std::vector<GeometryPair>& pairs, double maxDistance, std::vector<DistanceResult>& out_results)
+{
+    out_results.clear();
+    DistanceResult result;
+    for(auto& pair : pairs){
+        double d = detectDistance(pair.first, pair.second, result.point1, result.point2);
+        if(d >= 0.0 && d < maxDistance){
+            result.geometry1 = pair.first;
+            result.geometry2 = pair.second;
+            result.distance = d;
+            out_results.push_back(result);
+        }
+    }
+    return out_results.size();
+}
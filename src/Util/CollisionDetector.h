@@ -60,12 +60,34 @@ public:
 typedef ref_ptr<CollisionDetector> CollisionDetectorPtr;
 
 
-class CollisionDetectorDistanceAPI
+class CNOID_EXPORT CollisionDetectorDistanceAPI
 {
 public:
     virtual double detectDistance(
         CollisionDetector::GeometryHandle geometry1, CollisionDetector::GeometryHandle geometry2,
         Vector3& out_point1, Vector3& out_point2) = 0;
+
+    typedef std::pair<CollisionDetector::GeometryHandle, CollisionDetector::GeometryHandle> GeometryPair;
+
+    struct DistanceResult
+    {
+        CollisionDetector::GeometryHandle geometry1;
+        CollisionDetector::GeometryHandle geometry2;
+        double distance;
+        Vector3 point1;
+        Vector3 point2;
+    };
+
+    /**
+       Computes the distances of the geometry pairs at once. Only the results of the pairs whose
+       distances are less than maxDistance are output in the order of the given pairs.
+       Detectors can make the computation faster by using the threshold to terminate the computation
+       of far pairs, by using the results of the previous call, and by processing the pairs in parallel.
+       The default implementation calls detectDistance for each pair.
+       \return The number of the output results
+    */
+    virtual int detectDistances(
+        const std::vector<GeometryPair>& pairs, double maxDistance, std::vector<DistanceResult>& out_results);
 };
 
 
@@ -403,13 +403,14 @@ private:
                         allocator.construct(p++, *q++);
                     }
                 } else {
-                    for(ElementType* r = buf; r != qend && p != pend; ++r){
-                        allocator.construct(p++, *r);
-                    }
+                    // The elements from the offset to the end of the memory are the front ones
                     ElementType* qterm = buf + capacity_;
                     for(ElementType* r = q; r != qterm && p != pend; ++r){
                         allocator.construct(p++, *r);
                     }
+                    for(ElementType* r = buf; r != qend && p != pend; ++r){
+                        allocator.construct(p++, *r);
+                    }
                 }
             }
             // destory the old elements
@@ -541,6 +542,21 @@ public:
         resize(newRowSize, colSize_);
     }
 
+    /**
+       Allocate the memory for the given number of rows in advance so that the rows can
+       be appended up to the number without reallocation. The memory is kept when the rows
+       are removed by pop_front, so the container with the reserved rows can be used as a
+       fixed capacity ring buffer. The column size must be set before calling this function.
+    */
+    void reserveRows(int numRows){
+        // The area for the 'end' iterator should be reserved
+        const int newCapacity = (numRows + 1) * colSize_;
+        if(colSize_ > 0 && newCapacity > capacity_){
+            reallocMemory(colSize_, size_, newCapacity, true);
+            end_ = iterator(*this, buf + (offset + size_) % capacity_);
+        }
+    }
+
     int colSize() const {
         return colSize_;
     }
@@ -639,6 +655,52 @@ public:
         pop_front(1);
     }
 
+    /**
+       Whether all the elements are stored in a single contiguous memory block
+       starting from data() in the row-major order.
+    */
+    bool isContiguous() const {
+        return (offset + size_ <= capacity_);
+    }
+
+    /**
+       Rearrange the internal ring buffer so that the elements are stored contiguously.
+       This does nothing when the elements are already contiguous.
+    */
+    void makeContiguous() {
+        if(!isContiguous()){
+            ElementType* newBuf = allocator.allocate(capacity_);
+            ElementType* p = newBuf;
+            ElementType* const qterm = buf + capacity_;
+            ElementType* const qend = buf + (offset + size_) % capacity_;
+            for(ElementType* q = buf + offset; q != qterm; ++q){
+                allocator.construct(p++, *q);
+                allocator.destroy(q);
+            }
+            for(ElementType* q = buf; q != qend; ++q){
+                allocator.construct(p++, *q);
+                allocator.destroy(q);
+            }
+            allocator.deallocate(buf, capacity_);
+            buf = newBuf;
+            offset = 0;
+            end_ = iterator(*this, buf + size_ % capacity_);
+        }
+    }
+
+    /**
+       Pointer to the first element.
+       The elements can be accessed as a row-major array only when isContiguous() is true.
+       Any operation that changes the size may invalidate the pointer.
+    */
+    ElementType* data() {
+        return buf + offset;
+    }
+
+    const ElementType* data() const {
+        return buf + offset;
+    }
+
 
 private:
     Allocator allocator;
@@ -11,6 +11,8 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <array>
+#include <queue>
+#include <cstring>
 
 using namespace std;
 using namespace cnoid;
@@ -645,3 +647,703 @@ void MeshFilterImpl::setVertexNormals(SgMesh* mesh, float givenCreaseAngle)
         }
     }
 }
+
+
+namespace {
+
+class MeshDecimator
+{
+public:
+    struct Candidate {
+        double cost;
+        int vertex1;
+        int vertex2;
+        int stamp1;
+        int stamp2;
+        Vector3 position;
+        // The top of the priority queue is the candidate with the minimum cost
+        bool operator<(const Candidate& rhs) const { return cost > rhs.cost; }
+    };
+
+    vector<Vector3> vertices;
+    vector<Matrix4> quadrics;
+    vector<int> stamps; // incremented when a vertex is modified and -1 for a removed vertex
+    vector<Array3i> faces;
+    vector<bool> faceValidities;
+    vector<vector<int>> facesOfVertex;
+    vector<int> vertexMarks;
+    int currentMark;
+    int numValidFaces;
+    priority_queue<Candidate> candidates;
+
+    void initialize(SgMesh* mesh);
+    void addPlaneQuadric(const Array3i& face, const Vector3& normal, double distance, double weight);
+    void pushCandidates(int vertex, bool onlyGreaterIndices);
+    void setCandidate(int vertex1, int vertex2, Candidate& candidate);
+    bool checkCollapse(int vertex1, int vertex2, const Vector3& position);
+    bool checkFaceFlip(int vertex, int otherVertex, const Vector3& position);
+    void collapse(int vertex1, int vertex2, const Vector3& position);
+    bool decimate(int maxNumTriangles);
+    void output(SgMesh* mesh);
+};
+
+struct Vector3fHash
+{
+    std::size_t operator()(const Vector3f& v) const {
+        std::size_t seed = 0;
+        for(int i=0; i < 3; ++i){
+            uint32_t bits;
+            std::memcpy(&bits, &v[i], sizeof(bits));
+            seed ^= std::hash<uint32_t>()(bits) + 0x9e3779b9 + (seed<<6) + (seed>>2);
+        }
+        return seed;
+    }
+};
+
+struct Vector3fEqual
+{
+    bool operator()(const Vector3f& v1, const Vector3f& v2) const {
+        return v1 == v2;
+    }
+};
+
+}
+
+
+void MeshDecimator::initialize(SgMesh* mesh)
+{
+    const auto& orgVertices = *mesh->vertices();
+    const int numOrgVertices = orgVertices.size();
+
+    // Merge the vertices at the same position so that the faces are connected
+    unordered_map<Vector3f, int, Vector3fHash, Vector3fEqual> vertexIndexMap;
+    vector<int> indexMap(numOrgVertices);
+    for(int i=0; i < numOrgVertices; ++i){
+        const Vector3f& v = orgVertices[i];
+        auto inserted = vertexIndexMap.emplace(v, static_cast<int>(vertices.size()));
+        if(inserted.second){
+            vertices.push_back(v.cast<double>());
+        }
+        indexMap[i] = inserted.first->second;
+    }
+
+    const int numVertices = vertices.size();
+    quadrics.resize(numVertices, Matrix4::Zero());
+    stamps.resize(numVertices, 0);
+    facesOfVertex.resize(numVertices);
+    vertexMarks.resize(numVertices, 0);
+    currentMark = 0;
+
+    const int numTriangles = mesh->numTriangles();
+    faces.reserve(numTriangles);
+    unordered_map<IdPair<int>, int> edgeCounts;
+
+    for(int i=0; i < numTriangles; ++i){
+        auto triangle = mesh->triangle(i);
+        Array3i face(indexMap[triangle[0]], indexMap[triangle[1]], indexMap[triangle[2]]);
+        if(face[0] == face[1] || face[1] == face[2] || face[2] == face[0]){
+            continue;
+        }
+        const Vector3 n = (vertices[face[1]] - vertices[face[0]]).cross(vertices[face[2]] - vertices[face[0]]);
+        const double area2 = n.norm();
+        if(area2 > 0.0){
+            const Vector3 normal = n / area2;
+            addPlaneQuadric(face, normal, -normal.dot(vertices[face[0]]), area2 / 2.0);
+        }
+        const int faceIndex = faces.size();
+        faces.push_back(face);
+        for(int j=0; j < 3; ++j){
+            facesOfVertex[face[j]].push_back(faceIndex);
+            ++edgeCounts[IdPair<int>(face[j], face[(j + 1) % 3])];
+        }
+    }
+    faceValidities.resize(faces.size(), true);
+    numValidFaces = faces.size();
+
+    // Constrain the open boundaries by the planes perpendicular to the faces along them
+    static const double boundaryWeight = 100.0;
+    for(auto& face : faces){
+        const Vector3 n = (vertices[face[1]] - vertices[face[0]]).cross(vertices[face[2]] - vertices[face[0]]);
+        for(int j=0; j < 3; ++j){
+            const int v1 = face[j];
+            const int v2 = face[(j + 1) % 3];
+            if(edgeCounts[IdPair<int>(v1, v2)] == 1){
+                const Vector3 edge = vertices[v2] - vertices[v1];
+                const Vector3 b = edge.cross(n);
+                const double norm = b.norm();
+                if(norm > 0.0){
+                    const Vector3 normal = b / norm;
+                    const double weight = boundaryWeight * edge.squaredNorm();
+                    Vector4 plane;
+                    plane << normal, -normal.dot(vertices[v1]);
+                    const Matrix4 K = weight * plane * plane.transpose();
+                    quadrics[v1] += K;
+                    quadrics[v2] += K;
+                }
+            }
+        }
+    }
+
+    for(int i=0; i < numVertices; ++i){
+        pushCandidates(i, true);
+    }
+}
+
+
+void MeshDecimator::addPlaneQuadric(const Array3i& face, const Vector3& normal, double distance, double weight)
+{
+    Vector4 plane;
+    plane << normal, distance;
+    const Matrix4 K = weight * plane * plane.transpose();
+    for(int i=0; i < 3; ++i){
+        quadrics[face[i]] += K;
+    }
+}
+
+
+void MeshDecimator::pushCandidates(int vertex, bool onlyGreaterIndices)
+{
+    ++currentMark;
+    vertexMarks[vertex] = currentMark;
+    for(auto& faceIndex : facesOfVertex[vertex]){
+        if(!faceValidities[faceIndex]){
+            continue;
+        }
+        auto& face = faces[faceIndex];
+        for(int i=0; i < 3; ++i){
+            const int other = face[i];
+            if(vertexMarks[other] != currentMark && (!onlyGreaterIndices || other > vertex)){
+                vertexMarks[other] = currentMark;
+                Candidate candidate;
+                setCandidate(vertex, other, candidate);
+                candidates.push(candidate);
+            }
+        }
+    }
+}
+
+
+void MeshDecimator::setCandidate(int vertex1, int vertex2, Candidate& candidate)
+{
+    candidate.vertex1 = vertex1;
+    candidate.vertex2 = vertex2;
+    candidate.stamp1 = stamps[vertex1];
+    candidate.stamp2 = stamps[vertex2];
+
+    const Matrix4 Q = quadrics[vertex1] + quadrics[vertex2];
+    const Vector3& p1 = vertices[vertex1];
+    const Vector3& p2 = vertices[vertex2];
+
+    auto error = [&Q](const Vector3& p){
+        Vector4 v;
+        v << p, 1.0;
+        return std::max(0.0, v.dot(Q * v));
+    };
+
+    bool solved = false;
+    Eigen::FullPivLU<Matrix3> lu(Q.topLeftCorner<3, 3>());
+    lu.setThreshold(1.0e-6);
+    if(lu.isInvertible()){
+        const Vector3 p = lu.solve(-Q.topRightCorner<3, 1>());
+        // Reject the optimal position far from the edge, which may be caused by an ill-conditioned quadric
+        if((p - (p1 + p2) / 2.0).squaredNorm() <= (p2 - p1).squaredNorm()){
+            candidate.position = p;
+            candidate.cost = error(p);
+            solved = true;
+        }
+    }
+    if(!solved){
+        const Vector3 pm = (p1 + p2) / 2.0;
+        const double e1 = error(p1);
+        const double e2 = error(p2);
+        const double em = error(pm);
+        if(e1 <= e2 && e1 <= em){
+            candidate.position = p1;
+            candidate.cost = e1;
+        } else if(e2 <= em){
+            candidate.position = p2;
+            candidate.cost = e2;
+        } else {
+            candidate.position = pm;
+            candidate.cost = em;
+        }
+    }
+}
+
+
+bool MeshDecimator::checkCollapse(int vertex1, int vertex2, const Vector3& position)
+{
+    // Check the link condition to keep the topology of the surface
+    ++currentMark;
+    int numSharedFaces = 0;
+    for(auto& faceIndex : facesOfVertex[vertex1]){
+        if(faceValidities[faceIndex]){
+            auto& face = faces[faceIndex];
+            for(int i=0; i < 3; ++i){
+                vertexMarks[face[i]] = currentMark;
+            }
+            if(face[0] == vertex2 || face[1] == vertex2 || face[2] == vertex2){
+                ++numSharedFaces;
+            }
+        }
+    }
+    const int mark = currentMark;
+    ++currentMark;
+    int numSharedNeighbors = 0;
+    for(auto& faceIndex : facesOfVertex[vertex2]){
+        if(faceValidities[faceIndex]){
+            auto& face = faces[faceIndex];
+            for(int i=0; i < 3; ++i){
+                const int v = face[i];
+                if(v != vertex1 && v != vertex2 && vertexMarks[v] == mark){
+                    vertexMarks[v] = currentMark;
+                    ++numSharedNeighbors;
+                }
+            }
+        }
+    }
+    if(numSharedNeighbors > numSharedFaces){
+        return false;
+    }
+
+    return checkFaceFlip(vertex1, vertex2, position) && checkFaceFlip(vertex2, vertex1, position);
+}
+
+
+bool MeshDecimator::checkFaceFlip(int vertex, int otherVertex, const Vector3& position)
+{
+    for(auto& faceIndex : facesOfVertex[vertex]){
+        if(!faceValidities[faceIndex]){
+            continue;
+        }
+        auto& face = faces[faceIndex];
+        if(face[0] == otherVertex || face[1] == otherVertex || face[2] == otherVertex){
+            continue;
+        }
+        Vector3 p[3];
+        for(int i=0; i < 3; ++i){
+            p[i] = vertices[face[i]];
+        }
+        const Vector3 n0 = (p[1] - p[0]).cross(p[2] - p[0]);
+        for(int i=0; i < 3; ++i){
+            if(face[i] == vertex){
+                p[i] = position;
+            }
+        }
+        const Vector3 n1 = (p[1] - p[0]).cross(p[2] - p[0]);
+        if(n1.dot(n0) <= 0.2 * n1.norm() * n0.norm()){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void MeshDecimator::collapse(int vertex1, int vertex2, const Vector3& position)
+{
+    vertices[vertex1] = position;
+    quadrics[vertex1] += quadrics[vertex2];
+
+    auto& faces1 = facesOfVertex[vertex1];
+    for(auto& faceIndex : facesOfVertex[vertex2]){
+        if(!faceValidities[faceIndex]){
+            continue;
+        }
+        auto& face = faces[faceIndex];
+        if(face[0] == vertex1 || face[1] == vertex1 || face[2] == vertex1){
+            faceValidities[faceIndex] = false;
+            --numValidFaces;
+        } else {
+            for(int i=0; i < 3; ++i){
+                if(face[i] == vertex2){
+                    face[i] = vertex1;
+                }
+            }
+            faces1.push_back(faceIndex);
+        }
+    }
+    facesOfVertex[vertex2].clear();
+    stamps[vertex2] = -1;
+    ++stamps[vertex1];
+
+    faces1.erase(
+        std::remove_if(faces1.begin(), faces1.end(), [&](int index){ return !faceValidities[index]; }),
+        faces1.end());
+
+    pushCandidates(vertex1, false);
+}
+
+
+bool MeshDecimator::decimate(int maxNumTriangles)
+{
+    while(numValidFaces > maxNumTriangles && !candidates.empty()){
+        const Candidate candidate = candidates.top();
+        candidates.pop();
+        if(stamps[candidate.vertex1] != candidate.stamp1 || stamps[candidate.vertex2] != candidate.stamp2){
+            continue; // outdated
+        }
+        if(checkCollapse(candidate.vertex1, candidate.vertex2, candidate.position)){
+            collapse(candidate.vertex1, candidate.vertex2, candidate.position);
+        }
+    }
+    return numValidFaces <= maxNumTriangles;
+}
+
+
+void MeshDecimator::output(SgMesh* mesh)
+{
+    auto& outVertices = *mesh->vertices();
+    outVertices.clear();
+    auto& triangles = mesh->triangleVertices();
+    triangles.clear();
+    triangles.reserve(numValidFaces * 3);
+
+    vector<int> indexMap(vertices.size(), -1);
+    for(size_t i=0; i < faces.size(); ++i){
+        if(faceValidities[i]){
+            auto& face = faces[i];
+            for(int j=0; j < 3; ++j){
+                int& index = indexMap[face[j]];
+                if(index < 0){
+                    index = outVertices.size();
+                    outVertices.push_back(vertices[face[j]].cast<float>());
+                }
+                triangles.push_back(index);
+            }
+        }
+    }
+    outVertices.shrink_to_fit();
+
+    mesh->setNormals(nullptr);
+    mesh->normalIndices().clear();
+    mesh->setColors(nullptr);
+    mesh->colorIndices().clear();
+    mesh->setTexCoords(nullptr);
+    mesh->texCoordIndices().clear();
+    mesh->setPrimitive(SgMesh::MESH);
+    mesh->updateBoundingBox();
+}
+
+
+bool MeshFilter::decimate(SgMesh* mesh, int maxNumTriangles)
+{
+    if(!mesh->hasVertices()){
+        return false;
+    }
+    if(mesh->numTriangles() <= maxNumTriangles){
+        return true;
+    }
+    MeshDecimator decimator;
+    decimator.initialize(mesh);
+    bool reduced = decimator.decimate(maxNumTriangles);
+    decimator.output(mesh);
+    return reduced;
+}
+
+
+namespace {
+
+class ConvexHullBuilder
+{
+public:
+    struct Face {
+        Array3i vertices;
+        // The face adjacent to the edge from vertices[i] to vertices[(i + 1) % 3]
+        Array3i neighbors;
+        Vector3 normal;
+        double offset;
+        vector<int> outsidePoints;
+        int visitMark;
+        bool isValid;
+        double distance(const Vector3& p) const { return normal.dot(p) + offset; }
+    };
+
+    vector<Vector3> points;
+    vector<Face> faces;
+    double epsilon;
+    int currentVisitMark;
+
+    // Buffers used in addPoint
+    vector<int> visibleFaces;
+    vector<pair<int, int>> horizon; // (visible face, edge index)
+    vector<int> faceStack;
+    vector<int> orphans;
+
+    bool build();
+    bool initializeSimplex();
+    int addFace(int v0, int v1, int v2);
+    void assignPoints(const vector<int>& pointIndices, int firstFaceIndex);
+    void addPoint(int faceIndex);
+    SgMesh* createMesh();
+};
+
+}
+
+
+int ConvexHullBuilder::addFace(int v0, int v1, int v2)
+{
+    Face face;
+    face.vertices << v0, v1, v2;
+    face.neighbors << -1, -1, -1;
+    const Vector3 n = (points[v1] - points[v0]).cross(points[v2] - points[v0]);
+    const double norm = n.norm();
+    face.normal = (norm > 0.0) ? Vector3(n / norm) : Vector3::Zero();
+    face.offset = -face.normal.dot(points[v0]);
+    face.visitMark = 0;
+    face.isValid = true;
+    faces.push_back(std::move(face));
+    return faces.size() - 1;
+}
+
+
+bool ConvexHullBuilder::initializeSimplex()
+{
+    const int numPoints = points.size();
+
+    int extremes[6] = { 0, 0, 0, 0, 0, 0 };
+    for(int i=1; i < numPoints; ++i){
+        for(int j=0; j < 3; ++j){
+            if(points[i][j] < points[extremes[j * 2]][j]){
+                extremes[j * 2] = i;
+            }
+            if(points[i][j] > points[extremes[j * 2 + 1]][j]){
+                extremes[j * 2 + 1] = i;
+            }
+        }
+    }
+    
+    int i0 = 0, i1 = 0;
+    double maxDistance = 0.0;
+    for(int i=0; i < 6; ++i){
+        for(int j=i+1; j < 6; ++j){
+            double d = (points[extremes[i]] - points[extremes[j]]).squaredNorm();
+            if(d > maxDistance){
+                maxDistance = d;
+                i0 = extremes[i];
+                i1 = extremes[j];
+            }
+        }
+    }
+    if(maxDistance == 0.0){
+        return false;
+    }
+    // The vertices are given in single precision
+    epsilon = 1.0e-6 * sqrt(maxDistance);
+
+    const Vector3 axis = (points[i1] - points[i0]).normalized();
+    int i2 = -1;
+    maxDistance = epsilon;
+    for(int i=0; i < numPoints; ++i){
+        const Vector3 v = points[i] - points[i0];
+        double d = (v - v.dot(axis) * axis).norm();
+        if(d > maxDistance){
+            maxDistance = d;
+            i2 = i;
+        }
+    }
+    if(i2 < 0){
+        return false;
+    }
+
+    const Vector3 normal = (points[i1] - points[i0]).cross(points[i2] - points[i0]).normalized();
+    int i3 = -1;
+    maxDistance = epsilon;
+    for(int i=0; i < numPoints; ++i){
+        double d = fabs(normal.dot(points[i] - points[i0]));
+        if(d > maxDistance){
+            maxDistance = d;
+            i3 = i;
+        }
+    }
+    if(i3 < 0){
+        return false;
+    }
+
+    if(normal.dot(points[i3] - points[i0]) > 0.0){
+        std::swap(i1, i2);
+    }
+    addFace(i0, i1, i2);
+    addFace(i0, i3, i1);
+    addFace(i1, i3, i2);
+    addFace(i2, i3, i0);
+
+    // Connect the faces sharing the edges in the opposite directions
+    for(int i=0; i < 4; ++i){
+        for(int j=0; j < 3; ++j){
+            const int a = faces[i].vertices[j];
+            const int b = faces[i].vertices[(j + 1) % 3];
+            for(int k=0; k < 4; ++k){
+                for(int l=0; l < 3; ++l){
+                    if(faces[k].vertices[l] == b && faces[k].vertices[(l + 1) % 3] == a){
+                        faces[i].neighbors[j] = k;
+                    }
+                }
+            }
+        }
+    }
+
+    vector<int> pointIndices;
+    pointIndices.reserve(numPoints);
+    for(int i=0; i < numPoints; ++i){
+        if(i != i0 && i != i1 && i != i2 && i != i3){
+            pointIndices.push_back(i);
+        }
+    }
+    assignPoints(pointIndices, 0);
+
+    return true;
+}
+
+
+void ConvexHullBuilder::assignPoints(const vector<int>& pointIndices, int firstFaceIndex)
+{
+    const int numFaces = faces.size();
+    for(auto& index : pointIndices){
+        const Vector3& p = points[index];
+        for(int i = firstFaceIndex; i < numFaces; ++i){
+            Face& face = faces[i];
+            if(face.isValid && face.distance(p) > epsilon){
+                face.outsidePoints.push_back(index);
+                break;
+            }
+        }
+    }
+}
+
+
+void ConvexHullBuilder::addPoint(int faceIndex)
+{
+    int eye = -1;
+    double maxDistance = 0.0;
+    for(auto& index : faces[faceIndex].outsidePoints){
+        double d = faces[faceIndex].distance(points[index]);
+        if(d > maxDistance){
+            maxDistance = d;
+            eye = index;
+        }
+    }
+    const Vector3 p = points[eye];
+
+    /*
+      Collect the faces visible from the eye point by traversing the adjacent faces.
+      The horizon consists of the edges between the visible faces and the invisible faces.
+    */
+    ++currentVisitMark;
+    visibleFaces.clear();
+    horizon.clear();
+    faceStack.clear();
+    faceStack.push_back(faceIndex);
+    faces[faceIndex].visitMark = currentVisitMark;
+    while(!faceStack.empty()){
+        const int index = faceStack.back();
+        faceStack.pop_back();
+        visibleFaces.push_back(index);
+        for(int j=0; j < 3; ++j){
+            const int neighbor = faces[index].neighbors[j];
+            Face& face = faces[neighbor];
+            if(face.visitMark == currentVisitMark){
+                continue;
+            }
+            if(face.distance(p) > epsilon){
+                face.visitMark = currentVisitMark;
+                faceStack.push_back(neighbor);
+            } else {
+                horizon.emplace_back(index, j);
+            }
+        }
+    }
+
+    orphans.clear();
+    for(auto& index : visibleFaces){
+        Face& face = faces[index];
+        face.isValid = false;
+        orphans.insert(orphans.end(), face.outsidePoints.begin(), face.outsidePoints.end());
+        vector<int>().swap(face.outsidePoints);
+    }
+
+    // The new faces keep the directions of the horizon edges in the visible faces
+    const int firstNewFaceIndex = faces.size();
+    unordered_map<int, int> newFaceStartingAt;
+    for(auto& edge : horizon){
+        const int a = faces[edge.first].vertices[edge.second];
+        const int b = faces[edge.first].vertices[(edge.second + 1) % 3];
+        const int outer = faces[edge.first].neighbors[edge.second];
+        const int newFace = addFace(a, b, eye);
+        faces[newFace].neighbors[0] = outer;
+        auto& outerNeighbors = faces[outer].neighbors;
+        for(int j=0; j < 3; ++j){
+            if(outerNeighbors[j] == edge.first){
+                outerNeighbors[j] = newFace;
+                break;
+            }
+        }
+        newFaceStartingAt[a] = newFace;
+    }
+    for(int i = firstNewFaceIndex; i < static_cast<int>(faces.size()); ++i){
+        Face& face = faces[i];
+        // The edge from b to eye is shared with the new face starting at b
+        const int next = newFaceStartingAt[face.vertices[1]];
+        face.neighbors[1] = next;
+        faces[next].neighbors[2] = i;
+    }
+
+    assignPoints(orphans, firstNewFaceIndex);
+}
+
+
+bool ConvexHullBuilder::build()
+{
+    currentVisitMark = 0;
+    if(points.size() < 4 || !initializeSimplex()){
+        return false;
+    }
+    // New faces are appended to the face array, so a single scan processes all the faces
+    for(size_t i=0; i < faces.size(); ++i){
+        if(faces[i].isValid && !faces[i].outsidePoints.empty()){
+            addPoint(i);
+        }
+    }
+    return true;
+}
+
+
+SgMesh* ConvexHullBuilder::createMesh()
+{
+    auto mesh = new SgMesh;
+    auto& vertices = *mesh->getOrCreateVertices();
+    auto& triangles = mesh->triangleVertices();
+    vector<int> indexMap(points.size(), -1);
+    for(auto& face : faces){
+        if(face.isValid){
+            for(int i=0; i < 3; ++i){
+                int& index = indexMap[face.vertices[i]];
+                if(index < 0){
+                    index = vertices.size();
+                    vertices.push_back(points[face.vertices[i]].cast<float>());
+                }
+                triangles.push_back(index);
+            }
+        }
+    }
+    mesh->setSolid(true);
+    mesh->updateBoundingBox();
+    return mesh;
+}
+
+
+SgMesh* MeshFilter::createConvexHull(const SgMesh* mesh)
+{
+    if(!mesh->hasVertices()){
+        return nullptr;
+    }
+    ConvexHullBuilder builder;
+    auto& vertices = *mesh->vertices();
+    builder.points.reserve(vertices.size());
+    for(auto& v : vertices){
+        builder.points.push_back(v.cast<double>());
+    }
+    if(!builder.build()){
+        return nullptr;
+    }
+    return builder.createMesh();
+}
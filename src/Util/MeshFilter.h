@@ -46,6 +46,20 @@ public:
     void setMinCreaseAngle(float angle);
     void setMaxCreaseAngle(float angle);
     
+    /**
+       Reduce the number of triangles to maxNumTriangles or less by collapsing the edges in
+       ascending order of the quadric error metric. The vertices at the same position are
+       merged and the normals, colors and texture coordinates of the mesh are removed.
+       \return false if the number of triangles cannot be reduced to the target number.
+    */
+    bool decimate(SgMesh* mesh, int maxNumTriangles);
+
+    /**
+       Create a new mesh of the convex hull of the vertices of a given mesh.
+       \return nullptr if the vertices do not span a volume.
+    */
+    SgMesh* createConvexHull(const SgMesh* mesh);
+
     // Deprecated. Use enableNormalOverwriting()
     void setOverwritingEnabled(bool on);
 
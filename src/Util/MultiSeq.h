@@ -200,6 +200,15 @@ public:
         Container::pop_front();
     }
 
+    void popFrontFrames(int numFrames) {
+        Container::pop_front(numFrames);
+    }
+
+    //! \see Deque2D::reserveRows
+    void reserveFrames(int numFrames) {
+        Container::reserveRows(numFrames);
+    }
+
     Frame appendFrame() {
         return Container::append();
     }
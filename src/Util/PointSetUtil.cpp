@@ -7,16 +7,28 @@
 #include <cnoid/EasyScanner>
 #include <cnoid/Exception>
 #include <cnoid/UTF8>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <fmt/format.h>
 #include <fstream>
 #include <iomanip>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <limits>
 
 using namespace std;
 using namespace boost;
 using namespace cnoid;
+using fmt::format;
 
 namespace {
 
-enum Element { E_X, E_Y, E_Z, E_NORMAL_X,E_NORMAL_Y, E_NORMAL_Z, E_RGB };
+const size_t NumPointsPerThread = 200000;
+const size_t NumPointsPerWriteBlock = 65536;
+
+enum Element { E_X, E_Y, E_Z, E_NORMAL_X,E_NORMAL_Y, E_NORMAL_Z, E_RGB, E_IGNORED };
 
 typedef union {
     struct {
@@ -28,6 +40,170 @@ typedef union {
     float float_value;
 } RGBValue;
 
+struct Field
+{
+    Element element;
+    char type; // 'F', 'U' or 'I'
+    int size;
+    int count;
+};
+
+struct Header
+{
+    vector<Field> fields;
+    int numPoints;
+    int numHeaderLines;
+    string dataType;
+    size_t dataOffset;
+
+    size_t pointSize() const {
+        size_t size = 0;
+        for(auto& field : fields){
+            size += field.size * field.count;
+        }
+        return size;
+    }
+};
+
+
+Element getElement(const string& name)
+{
+    if(name == "x"){
+        return E_X;
+    } else if(name == "y"){
+        return E_Y;
+    } else if(name == "z"){
+        return E_Z;
+    } else if(name == "normal_x"){
+        return E_NORMAL_X;
+    } else if(name == "normal_y"){
+        return E_NORMAL_Y;
+    } else if(name == "normal_z"){
+        return E_NORMAL_Z;
+    } else if(name == "rgb" || name == "rgba"){
+        return E_RGB;
+    }
+    return E_IGNORED;
+}
+
+
+void throwHeaderError(const string& filename, int lineNumber, const string& message)
+{
+    throw file_read_error() << error_info_message(
+        format("{0} at line {1} of \"{2}\".", message, lineNumber, filename));
+}
+
+
+void readHeader(const char* data, size_t size, const string& filename, Header& header)
+{
+    header.numPoints = -1;
+    int width = -1;
+    int height = 1;
+    vector<string> names;
+    vector<int> sizes;
+    vector<char> types;
+    vector<int> counts;
+
+    size_t pos = 0;
+    int lineNumber = 0;
+
+    while(pos < size){
+        size_t end = pos;
+        while(end < size && data[end] != '\n'){
+            ++end;
+        }
+        ++lineNumber;
+        string line(data + pos, end - pos);
+        pos = end + 1;
+
+        auto commentPos = line.find('#');
+        if(commentPos != string::npos){
+            line.resize(commentPos);
+        }
+        istringstream iss(line);
+        string key;
+        if(!(iss >> key)){
+            continue;
+        }
+        if(key == "FIELDS"){
+            string name;
+            while(iss >> name){
+                names.push_back(name);
+            }
+        } else if(key == "SIZE"){
+            int s;
+            while(iss >> s){
+                sizes.push_back(s);
+            }
+        } else if(key == "TYPE"){
+            char t;
+            while(iss >> t){
+                types.push_back(t);
+            }
+        } else if(key == "COUNT"){
+            int c;
+            while(iss >> c){
+                counts.push_back(c);
+            }
+        } else if(key == "WIDTH"){
+            if(!(iss >> width)){
+                throwHeaderError(filename, lineNumber, "The 'WIDTH' field is not correctly specified");
+            }
+        } else if(key == "HEIGHT"){
+            if(!(iss >> height)){
+                throwHeaderError(filename, lineNumber, "The 'HEIGHT' field is not correctly specified");
+            }
+        } else if(key == "POINTS"){
+            if(!(iss >> header.numPoints)){
+                throwHeaderError(filename, lineNumber, "The 'POINTS' field is not correctly specified");
+            }
+        } else if(key == "DATA"){
+            if(!(iss >> header.dataType)){
+                throwHeaderError(filename, lineNumber, "The 'DATA' field is not correctly specified");
+            }
+            header.dataOffset = std::min(pos, size);
+            header.numHeaderLines = lineNumber;
+            break;
+        }
+    }
+
+    if(header.dataType.empty()){
+        throw file_read_error() << error_info_message(
+            format("The 'DATA' field is not found in \"{}\".", filename));
+    }
+    if(names.empty()){
+        throw file_read_error() << error_info_message(
+            format("The specification of field elements is not found in \"{}\".", filename));
+    }
+    if(header.numPoints < 0){
+        header.numPoints = (width >= 0) ? (width * height) : 0;
+    }
+
+    /*
+      The SIZE, TYPE and COUNT fields may be omitted in the ascii format.
+      The default values used by PCL are assumed then.
+    */
+    const size_t numFields = names.size();
+    if((!sizes.empty() && sizes.size() != numFields) ||
+       (!types.empty() && types.size() != numFields) ||
+       (!counts.empty() && counts.size() != numFields)){
+        throw file_read_error() << error_info_message(
+            format("The numbers of the FIELDS, SIZE, TYPE and COUNT values are inconsistent in \"{}\".",
+                   filename));
+    }
+    header.fields.resize(numFields);
+    for(size_t i=0; i < numFields; ++i){
+        auto& field = header.fields[i];
+        field.element = getElement(names[i]);
+        field.size = sizes.empty() ? 4 : sizes[i];
+        field.type = types.empty() ? 'F' : types[i];
+        field.count = counts.empty() ? 1 : counts[i];
+        if(field.count != 1 && field.element != E_IGNORED){
+            field.element = E_IGNORED;
+        }
+    }
+}
+
 
 void readPoints(SgPointSet* out_pointSet, EasyScanner& scanner, const std::vector<Element>& elements, int numPoints)
 {
@@ -43,9 +219,11 @@ void readPoints(SgPointSet* out_pointSet, EasyScanner& scanner, const std::vecto
     for(int i=0; i < numElements; ++i){
         Element element = elements[i];
         if(element >= E_NORMAL_X && element <= E_NORMAL_Z){
-            hasNormals = true;
-            normals = new SgNormalArray();
-            normals->reserve(numPoints);
+            if(!hasNormals){
+                hasNormals = true;
+                normals = new SgNormalArray();
+                normals->reserve(numPoints);
+            }
         } else if(element == E_RGB){
             hasColors = true;
             colors = new SgColorArray();
@@ -69,7 +247,7 @@ void readPoints(SgPointSet* out_pointSet, EasyScanner& scanner, const std::vecto
                 hasIllegalValue = true;
                 scanner.skipToLineEnd();
                 break;
-                    
+
             } else {
                 double value = scanner.doubleValue;
                 switch(elements[i]){
@@ -85,6 +263,8 @@ void readPoints(SgPointSet* out_pointSet, EasyScanner& scanner, const std::vecto
                     color[1] = rgb.green / 255.0;
                     color[2] = rgb.blue / 255.0;
                     break;
+                default:
+                    break;
                 }
             }
         }
@@ -111,94 +291,485 @@ void readPoints(SgPointSet* out_pointSet, EasyScanner& scanner, const std::vecto
     }
 }
 
+
+void readAsciiPoints(SgPointSet* out_pointSet, const char* data, size_t size, const Header& header)
+{
+    std::vector<Element> elements;
+    for(auto& field : header.fields){
+        for(int i=0; i < field.count; ++i){
+            elements.push_back(field.element);
+        }
+    }
+    EasyScanner scanner;
+    scanner.setCommentChar('#');
+    scanner.setLineNumberOffset(header.numHeaderLines + 1);
+    scanner.setText(data, size);
+    readPoints(out_pointSet, scanner, elements, header.numPoints);
 }
 
 
-void cnoid::loadPCD(SgPointSet* out_pointSet, const std::string& filename)
+/**
+   Accessor to the values of a field. The values are stored with a constant stride,
+   which is the point size in the binary format and the field size in the
+   binary_compressed format.
+*/
+class FieldReader
 {
-    try {
-        EasyScanner scanner(filename);
-        scanner.setCommentChar('#');
-
-        int numPoints = 0;
-
-        std::vector<Element> elements;
-
-        while(true){
-            scanner.skipBlankLines();
-            scanner.readWordEx("Illegal header key");
-
-            if(scanner.stringValue == "FIELDS"){
-                while(scanner.readWord()){
-                    if(scanner.stringValue == "x"){
-                        elements.push_back(E_X);
-                    } else if(scanner.stringValue == "y"){
-                        elements.push_back(E_Y);
-                    } else if(scanner.stringValue == "z"){
-                        elements.push_back(E_Z);
-                    } else if(scanner.stringValue == "normal_x"){
-                        elements.push_back(E_NORMAL_X);
-                    } else if(scanner.stringValue == "normal_y"){
-                        elements.push_back(E_NORMAL_Y);
-                    } else if(scanner.stringValue == "normal_z"){
-                        elements.push_back(E_NORMAL_Z);
-                    } else if(scanner.stringValue == "rgb"){
-                        elements.push_back(E_RGB);
+    const char* top;
+    size_t stride;
+    char type;
+    int size;
+
+    template<typename T> T get(const char* p) const {
+        T value;
+        std::memcpy(&value, p, sizeof(T));
+        return value;
+    }
+
+public:
+    FieldReader() : top(nullptr) { }
+    FieldReader(const char* top, size_t stride, const Field& field)
+        : top(top), stride(stride), type(field.type), size(field.size) { }
+
+    bool isValid() const { return top != nullptr; }
+
+    float read(size_t index) const {
+        const char* p = top + index * stride;
+        switch(type){
+        case 'F':
+            if(size == 4){
+                return get<float>(p);
+            } else if(size == 8){
+                return get<double>(p);
+            }
+            break;
+        case 'U':
+            switch(size){
+            case 1: return get<uint8_t>(p);
+            case 2: return get<uint16_t>(p);
+            case 4: return get<uint32_t>(p);
+            case 8: return get<uint64_t>(p);
+            }
+            break;
+        case 'I':
+            switch(size){
+            case 1: return get<int8_t>(p);
+            case 2: return get<int16_t>(p);
+            case 4: return get<int32_t>(p);
+            case 8: return get<int64_t>(p);
+            }
+            break;
+        }
+        return std::numeric_limits<float>::quiet_NaN();
+    }
+
+    Vector3f readColor(size_t index) const {
+        RGBValue rgb;
+        std::memcpy(&rgb, top + index * stride, sizeof(rgb));
+        return Vector3f(rgb.red / 255.0f, rgb.green / 255.0f, rgb.blue / 255.0f);
+    }
+};
+
+
+class BinaryPointDecoder
+{
+public:
+    FieldReader readers[E_IGNORED];
+    Vector3f* vertices;
+    Vector3f* normals;
+    Vector3f* colors;
+
+    BinaryPointDecoder(const Header& header, const char* data, bool isFieldMajor) {
+        const size_t pointSize = header.pointSize();
+        size_t offset = 0;
+        for(auto& field : header.fields){
+            const size_t fieldSize = field.size * field.count;
+            if(field.element != E_IGNORED){
+                if(field.element != E_RGB || field.size == 4){
+                    if(isFieldMajor){
+                        readers[field.element] = FieldReader(data + offset * header.numPoints, fieldSize, field);
+                    } else {
+                        readers[field.element] = FieldReader(data + offset, pointSize, field);
                     }
                 }
-            } else if(scanner.stringValue == "POINTS"){
-                numPoints = scanner.readIntEx("The 'POINTS' field is not correctly specified.");
-            } else if(scanner.stringValue == "DATA"){
-                scanner.readWordEx("The 'DATA' field is not correctly specified.");
-                if(scanner.stringValue == "ascii"){
-                    scanner.readLFex();
-                    if(elements.empty()){
-                        scanner.throwException("The specification of field elements is not found.");
+            }
+            offset += fieldSize;
+        }
+    }
+
+    bool hasVertices() const {
+        return readers[E_X].isValid() && readers[E_Y].isValid() && readers[E_Z].isValid();
+    }
+    bool hasNormals() const {
+        return readers[E_NORMAL_X].isValid() && readers[E_NORMAL_Y].isValid() && readers[E_NORMAL_Z].isValid();
+    }
+    bool hasColors() const {
+        return readers[E_RGB].isValid();
+    }
+
+    /**
+       Decode the points in [begin, end) into the output arrays from index 'begin'.
+       Invalid (non finite) points are skipped and the number of stored points is returned.
+    */
+    size_t decode(size_t begin, size_t end) const {
+        size_t outIndex = begin;
+        for(size_t i = begin; i < end; ++i){
+            Vector3f v(readers[E_X].read(i), readers[E_Y].read(i), readers[E_Z].read(i));
+            if(!v.allFinite()){
+                continue;
+            }
+            vertices[outIndex] = v;
+            if(normals){
+                normals[outIndex] << readers[E_NORMAL_X].read(i), readers[E_NORMAL_Y].read(i), readers[E_NORMAL_Z].read(i);
+            }
+            if(colors){
+                colors[outIndex] = readers[E_RGB].readColor(i);
+            }
+            ++outIndex;
+        }
+        return outIndex - begin;
+    }
+};
+
+
+void readBinaryPoints(SgPointSet* out_pointSet, const char* data, const Header& header, bool isFieldMajor)
+{
+    if(header.numPoints == 0){
+        throw file_read_error() << error_info_message("No valid points");
+    }
+    BinaryPointDecoder decoder(header, data, isFieldMajor);
+    if(!decoder.hasVertices()){
+        throw file_read_error() << error_info_message("The x, y, z fields are not found");
+    }
+
+    const size_t numPoints = header.numPoints;
+    SgVertexArrayPtr vertices = new SgVertexArray(numPoints);
+    decoder.vertices = &vertices->front();
+    SgNormalArrayPtr normals;
+    decoder.normals = nullptr;
+    if(decoder.hasNormals()){
+        normals = new SgNormalArray(numPoints);
+        decoder.normals = &normals->front();
+    }
+    SgColorArrayPtr colors;
+    decoder.colors = nullptr;
+    if(decoder.hasColors()){
+        colors = new SgColorArray(numPoints);
+        decoder.colors = &colors->front();
+    }
+
+    size_t numThreads = std::max((unsigned)1, thread::hardware_concurrency());
+    numThreads = std::min(numThreads, std::max(size_t(1), numPoints / NumPointsPerThread));
+    const size_t numPointsPerThread = numPoints / numThreads;
+    vector<size_t> begins(numThreads + 1);
+    for(size_t i=0; i < numThreads; ++i){
+        begins[i] = i * numPointsPerThread;
+    }
+    begins[numThreads] = numPoints;
+    vector<size_t> numDecodedPoints(numThreads);
+
+    vector<thread> threads;
+    for(size_t i=0; i < numThreads - 1; ++i){
+        threads.emplace_back(
+            [&decoder, &begins, &numDecodedPoints, i](){
+                numDecodedPoints[i] = decoder.decode(begins[i], begins[i + 1]);
+            });
+    }
+    numDecodedPoints.back() = decoder.decode(begins[numThreads - 1], numPoints);
+    for(auto& t : threads){
+        t.join();
+    }
+
+    // Pack the decoded points of each block when there are invalid points
+    size_t numValidPoints = numDecodedPoints[0];
+    for(size_t i=1; i < numThreads; ++i){
+        const size_t n = numDecodedPoints[i];
+        if(numValidPoints != begins[i]){
+            const size_t src = begins[i];
+            std::copy(vertices->begin() + src, vertices->begin() + src + n, vertices->begin() + numValidPoints);
+            if(normals){
+                std::copy(normals->begin() + src, normals->begin() + src + n, normals->begin() + numValidPoints);
+            }
+            if(colors){
+                std::copy(colors->begin() + src, colors->begin() + src + n, colors->begin() + numValidPoints);
+            }
+        }
+        numValidPoints += n;
+    }
+
+    if(numValidPoints == 0){
+        throw file_read_error() << error_info_message("No valid points");
+    }
+    if(numValidPoints < numPoints){
+        vertices->resize(numValidPoints);
+        if(normals){
+            normals->resize(numValidPoints);
+        }
+        if(colors){
+            colors->resize(numValidPoints);
+        }
+    }
+
+    out_pointSet->setVertices(vertices);
+    out_pointSet->setNormals(normals);
+    out_pointSet->normalIndices().clear();
+    out_pointSet->setColors(colors);
+    out_pointSet->colorIndices().clear();
+}
+
+
+/**
+   Decompressor of the LZF format used in the binary_compressed PCD data.
+*/
+bool decompressLZF(const unsigned char* in, size_t inSize, unsigned char* out, size_t outSize)
+{
+    const unsigned char* ip = in;
+    const unsigned char* const inEnd = in + inSize;
+    unsigned char* op = out;
+    unsigned char* const outEnd = out + outSize;
+
+    while(ip < inEnd){
+        size_t ctrl = *ip++;
+        if(ctrl < 32){ // literal run
+            ++ctrl;
+            if(ip + ctrl > inEnd || op + ctrl > outEnd){
+                return false;
+            }
+            std::memcpy(op, ip, ctrl);
+            ip += ctrl;
+            op += ctrl;
+        } else { // back reference
+            size_t len = ctrl >> 5;
+            if(len == 7){
+                if(ip >= inEnd){
+                    return false;
+                }
+                len += *ip++;
+            }
+            if(ip >= inEnd){
+                return false;
+            }
+            const size_t distance = ((ctrl & 0x1f) << 8) + *ip++ + 1;
+            len += 2;
+            if(distance > size_t(op - out) || op + len > outEnd){
+                return false;
+            }
+            // The referenced area may overlap the output area
+            const unsigned char* ref = op - distance;
+            for(size_t i=0; i < len; ++i){
+                *op++ = *ref++;
+            }
+        }
+    }
+    return op == outEnd;
+}
+
+
+void compressLZF(const unsigned char* in, size_t inSize, vector<unsigned char>& out)
+{
+    const int HashLog = 16;
+    const size_t MaxDistance = 1 << 13;
+    const size_t MaxMatchLength = 264;
+    const size_t MaxLiteralLength = 32;
+
+    vector<size_t> hashTable(1 << HashLog, 0); // Stores the position + 1
+    out.clear();
+    out.reserve(inSize + inSize / 32 + 16);
+
+    size_t literalLength = 0;
+    size_t literalControlPos = out.size();
+    out.push_back(0);
+
+    size_t ip = 0;
+    while(ip < inSize){
+        if(ip + 2 < inSize){
+            const uint32_t v = (in[ip] << 16) | (in[ip + 1] << 8) | in[ip + 2];
+            const uint32_t h = ((v * 2654435761u) >> (32 - HashLog)) & ((1 << HashLog) - 1);
+            const size_t ref = hashTable[h];
+            hashTable[h] = ip + 1;
+            if(ref > 0 && ip - (ref - 1) <= MaxDistance){
+                const size_t r = ref - 1;
+                if(in[r] == in[ip] && in[r + 1] == in[ip + 1] && in[r + 2] == in[ip + 2]){
+                    const size_t maxLength = std::min(inSize - ip, MaxMatchLength);
+                    size_t length = 3;
+                    while(length < maxLength && in[r + length] == in[ip + length]){
+                        ++length;
                     }
-                    readPoints(out_pointSet, scanner, elements, numPoints);
-                    break;
-                } else {
-                    scanner.throwException("The 'ascii' format is only supported for the point DATA.");
+                    if(literalLength == 0){
+                        out.pop_back();
+                    } else {
+                        out[literalControlPos] = literalLength - 1;
+                    }
+                    const size_t distance = ip - r - 1;
+                    const size_t len = length - 2;
+                    if(len < 7){
+                        out.push_back((distance >> 8) + (len << 5));
+                    } else {
+                        out.push_back((distance >> 8) + (7 << 5));
+                        out.push_back(len - 7);
+                    }
+                    out.push_back(distance & 0xff);
+                    ip += length;
+                    literalLength = 0;
+                    literalControlPos = out.size();
+                    out.push_back(0);
+                    continue;
                 }
-            } else {
-                scanner.skipToLineEnd();
             }
-            scanner.readLFEOFex("The field value is not correctly specified.");
         }
-    } catch(EasyScanner::Exception& ex){
-        throw file_read_error() << error_info_message(ex.getFullMessage());
+        out.push_back(in[ip++]);
+        if(++literalLength == MaxLiteralLength){
+            out[literalControlPos] = literalLength - 1;
+            literalLength = 0;
+            literalControlPos = out.size();
+            out.push_back(0);
+        }
+    }
+    if(literalLength == 0){
+        out.pop_back();
+    } else {
+        out[literalControlPos] = literalLength - 1;
+    }
+}
+
+
+uint32_t readUInt32(const char* p)
+{
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return u[0] + (u[1] << 8) + (u[2] << 16) + (uint32_t(u[3]) << 24);
+}
+
+
+void writeUInt32(ostream& os, uint32_t value)
+{
+    char buf[4];
+    buf[0] = value & 0xff;
+    buf[1] = (value >> 8) & 0xff;
+    buf[2] = (value >> 16) & 0xff;
+    buf[3] = (value >> 24) & 0xff;
+    os.write(buf, 4);
+}
+
+}
+
+
+void cnoid::loadPCD(SgPointSet* out_pointSet, const std::string& filename)
+{
+    iostreams::mapped_file_source file;
+    try {
+        file.open(fromUTF8(filename));
+    } catch(const std::exception& ex){
+        throw file_read_error() << error_info_message(
+            format("\"{0}\" cannot be opened: {1}", filename, ex.what()));
+    }
+    const char* data = file.data();
+    const size_t size = file.size();
+
+    Header header;
+    readHeader(data, size, filename, header);
+
+    const char* pointData = data + header.dataOffset;
+    const size_t pointDataSize = size - header.dataOffset;
+
+    if(header.dataType == "ascii"){
+        try {
+            readAsciiPoints(out_pointSet, pointData, pointDataSize, header);
+        } catch(EasyScanner::Exception& ex){
+            throw file_read_error() << error_info_message(ex.getFullMessage());
+        }
+
+    } else if(header.dataType == "binary"){
+        if(pointDataSize < header.pointSize() * header.numPoints){
+            throw file_read_error() << error_info_message(
+                format("The binary point data of \"{}\" is truncated.", filename));
+        }
+        readBinaryPoints(out_pointSet, pointData, header, false);
+
+    } else if(header.dataType == "binary_compressed"){
+        if(pointDataSize < 8){
+            throw file_read_error() << error_info_message(
+                format("The compressed point data of \"{}\" is truncated.", filename));
+        }
+        const size_t compressedSize = readUInt32(pointData);
+        const size_t uncompressedSize = readUInt32(pointData + 4);
+        if(uncompressedSize != header.pointSize() * header.numPoints ||
+           compressedSize > pointDataSize - 8){
+            throw file_read_error() << error_info_message(
+                format("The compressed point data of \"{}\" is inconsistent with the header.", filename));
+        }
+        vector<char> buf(uncompressedSize);
+        if(!decompressLZF(reinterpret_cast<const unsigned char*>(pointData + 8), compressedSize,
+                          reinterpret_cast<unsigned char*>(buf.data()), uncompressedSize)){
+            throw file_read_error() << error_info_message(
+                format("The compressed point data of \"{}\" cannot be decompressed.", filename));
+        }
+        readBinaryPoints(out_pointSet, buf.data(), header, true);
+
+    } else {
+        throw file_read_error() << error_info_message(
+            format("The data type \"{0}\" of \"{1}\" is not supported.", header.dataType, filename));
     }
 }
 
 
 void cnoid::savePCD(SgPointSet* pointSet, const std::string& filename, const Affine3& viewpoint)
+{
+    savePCD(pointSet, filename, viewpoint, PCD_ASCII);
+}
+
+
+void cnoid::savePCD(SgPointSet* pointSet, const std::string& filename, const Affine3& viewpoint, PCDDataType dataType)
 {
     if(!pointSet->hasVertices()){
         throw empty_data_error() << error_info_message("Empty pointset");
     }
 
-    bool hasColors = pointSet->hasColors() && pointSet->colorIndices().empty();
+    const SgVertexArray& points = *pointSet->vertices();
+    const int numPoints = points.size();
+
+    bool hasNormals =
+        pointSet->hasNormals() && pointSet->normalIndices().empty() && pointSet->normals()->size() == points.size();
+    bool hasColors =
+        pointSet->hasColors() && pointSet->colorIndices().empty() && pointSet->colors()->size() == points.size();
 
     ofstream ofs;
-    ofs.open(fromUTF8(filename.c_str()));
+    if(dataType == PCD_ASCII){
+        ofs.open(fromUTF8(filename.c_str()));
+    } else {
+        ofs.open(fromUTF8(filename.c_str()), ios::out | ios::binary);
+    }
+    if(!ofs.is_open()){
+        throw file_write_error() << error_info_message(format("\"{}\" cannot be opened.", filename));
+    }
     ofs << scientific << setprecision(9);
 
     ofs << "# .PCD v.7 - Point Cloud Data file format\n";
     ofs << "VERSION .7\n";
+
+    int numFields = 3;
+    ofs << "FIELDS x y z";
+    if(hasNormals){
+        ofs << " normal_x normal_y normal_z";
+        numFields += 3;
+    }
     if(hasColors){
-        ofs << "FIELDS x y z rgb\n";
-        ofs << "SIZE 4 4 4 4\n";
-        ofs << "TYPE F F F F\n";
-        ofs << "COUNT 1 1 1 1\n";
-    } else {
-        ofs << "FIELDS x y z\n";
-        ofs << "SIZE 4 4 4\n";
-        ofs << "TYPE F F F\n";
-        ofs << "COUNT 1 1 1\n";
+        ofs << " rgb";
+        numFields += 1;
+    }
+    ofs << "\nSIZE";
+    for(int i=0; i < numFields; ++i){
+        ofs << " 4";
     }
+    ofs << "\nTYPE";
+    for(int i=0; i < numFields; ++i){
+        ofs << " F";
+    }
+    ofs << "\nCOUNT";
+    for(int i=0; i < numFields; ++i){
+        ofs << " 1";
+    }
+    ofs << "\n";
 
-    const SgVertexArray& points = *pointSet->vertices();
-    const int numPoints = points.size();
     ofs << "WIDTH " << numPoints << "\n";
     ofs << "HEIGHT 1\n";
 
@@ -209,26 +780,85 @@ void cnoid::savePCD(SgPointSet* pointSet, const std::string& filename, const Aff
     ofs << q.w() << " " << q.x() << " " << q.y() << " " << q.z() << "\n";
 
     ofs << "POINTS " << numPoints << "\n";
-    
-    ofs << "DATA ascii\n";
 
-    if(hasColors){
+    auto getPackedColor = [pointSet](int index){
+        const Vector3f& c = (*pointSet->colors())[index];
         RGBValue rgb;
-        rgb.alpha = 0.0;
-        const SgColorArray& colors = *pointSet->colors();
+        rgb.alpha = 0;
+        rgb.red = (unsigned char)(255.0 * c[0]);
+        rgb.green = (unsigned char)(255.0 * c[1]);
+        rgb.blue = (unsigned char)(255.0 * c[2]);
+        return rgb.float_value;
+    };
+
+    if(dataType == PCD_ASCII){
+        ofs << "DATA ascii\n";
         for(int i=0; i < numPoints; ++i){
             const Vector3f& p = points[i];
-            const Vector3f& c = colors[i];
-            rgb.red = (unsigned char)(255.0 * c[0]);
-            rgb.green = (unsigned char)(255.0 * c[1]);
-            rgb.blue = (unsigned char)(255.0 * c[2]);
-            ofs << p.x() << " " << p.y() << " " << p.z() << " " << rgb.float_value << "\n";
+            ofs << p.x() << " " << p.y() << " " << p.z();
+            if(hasNormals){
+                const Vector3f& n = (*pointSet->normals())[i];
+                ofs << " " << n.x() << " " << n.y() << " " << n.z();
+            }
+            if(hasColors){
+                ofs << " " << getPackedColor(i);
+            }
+            ofs << "\n";
         }
-    } else {
+
+    } else if(dataType == PCD_BINARY){
+        ofs << "DATA binary\n";
+        vector<float> block;
+        block.reserve(NumPointsPerWriteBlock * numFields);
         for(int i=0; i < numPoints; ++i){
             const Vector3f& p = points[i];
-            ofs << p.x() << " " << p.y() << " " << p.z() << "\n";
+            block.insert(block.end(), p.data(), p.data() + 3);
+            if(hasNormals){
+                const Vector3f& n = (*pointSet->normals())[i];
+                block.insert(block.end(), n.data(), n.data() + 3);
+            }
+            if(hasColors){
+                block.push_back(getPackedColor(i));
+            }
+            if(block.size() == NumPointsPerWriteBlock * numFields || i == numPoints - 1){
+                ofs.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(float));
+                block.clear();
+            }
+        }
+
+    } else if(dataType == PCD_BINARY_COMPRESSED){
+        ofs << "DATA binary_compressed\n";
+        // The values are stored field by field in the compressed data
+        vector<float> values(numPoints * numFields);
+        for(int i=0; i < 3; ++i){
+            float* column = &values[i * numPoints];
+            for(int j=0; j < numPoints; ++j){
+                column[j] = points[j][i];
+            }
+        }
+        int fieldIndex = 3;
+        if(hasNormals){
+            const SgNormalArray& normals = *pointSet->normals();
+            for(int i=0; i < 3; ++i){
+                float* column = &values[(fieldIndex + i) * numPoints];
+                for(int j=0; j < numPoints; ++j){
+                    column[j] = normals[j][i];
+                }
+            }
+            fieldIndex += 3;
+        }
+        if(hasColors){
+            float* column = &values[fieldIndex * numPoints];
+            for(int j=0; j < numPoints; ++j){
+                column[j] = getPackedColor(j);
+            }
         }
+        const size_t uncompressedSize = values.size() * sizeof(float);
+        vector<unsigned char> compressed;
+        compressLZF(reinterpret_cast<const unsigned char*>(values.data()), uncompressedSize, compressed);
+        writeUInt32(ofs, compressed.size());
+        writeUInt32(ofs, uncompressedSize);
+        ofs.write(reinterpret_cast<const char*>(compressed.data()), compressed.size());
     }
 
     ofs.close();
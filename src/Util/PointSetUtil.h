@@ -11,8 +11,16 @@
 
 namespace cnoid {
 
+enum PCDDataType { PCD_ASCII, PCD_BINARY, PCD_BINARY_COMPRESSED };
+
+/**
+   Load a point cloud from a PCD file.
+   The ascii, binary and binary_compressed data types are supported.
+*/
 CNOID_EXPORT void loadPCD(SgPointSet* out_pointSet, const std::string& filename);
+
 CNOID_EXPORT void savePCD(SgPointSet* pointSet, const std::string& filename, const Affine3d& viewpoint = Affine3d::Identity());
+CNOID_EXPORT void savePCD(SgPointSet* pointSet, const std::string& filename, const Affine3d& viewpoint, PCDDataType dataType);
 
 }
 
@@ -5,11 +5,73 @@
 #include "PyReferenced.h"
 #include "PyEigenTypes.h"
 #include "../SceneGraph.h"
+#include "../SceneDrawables.h"
 #include "../CloneMap.h"
+#include "../Image.h"
+#include <pybind11/numpy.h>
+#include <cstring>
 
 using namespace cnoid;
 namespace py = pybind11;
 
+namespace {
+
+typedef py::array_t<float, py::array::c_style | py::array::forcecast> FloatArray;
+typedef py::array_t<unsigned char, py::array::c_style | py::array::forcecast> ByteArray;
+
+/**
+   The returned array shares the memory of the vector array. It must be obtained again
+   after the size of the vector array is changed.
+*/
+py::array getSgVertexArrayArray(py::object pyarray)
+{
+    auto& vertices = pyarray.cast<SgVertexArray&>();
+    if(vertices.empty()){
+        return py::array_t<float>(std::vector<ssize_t>{ 0, 3 });
+    }
+    return py::array_t<float>(
+        { static_cast<ssize_t>(vertices.size()), ssize_t(3) },
+        { static_cast<ssize_t>(sizeof(Vector3f)), static_cast<ssize_t>(sizeof(float)) },
+        vertices.data(), pyarray);
+}
+
+void setSgVertexArrayArray(SgVertexArray& vertices, FloatArray array)
+{
+    if(array.ndim() != 2 || array.shape(1) != 3){
+        throw py::value_error("The array must have the shape (n, 3)");
+    }
+    vertices.resize(array.shape(0));
+    if(array.size() > 0){
+        std::memcpy(vertices.data(), array.data(), array.size() * sizeof(float));
+    }
+}
+
+py::array getImagePixelArray(py::object pyimage)
+{
+    auto& image = pyimage.cast<Image&>();
+    const ssize_t nc = image.numComponents();
+    if(image.empty()){
+        return py::array_t<unsigned char>({ ssize_t(0), ssize_t(0), nc });
+    }
+    return py::array_t<unsigned char>(
+        { static_cast<ssize_t>(image.height()), static_cast<ssize_t>(image.width()), nc },
+        { static_cast<ssize_t>(image.width() * nc), nc, ssize_t(1) },
+        image.pixels(), pyimage);
+}
+
+void setImagePixelArray(Image& image, ByteArray array)
+{
+    if(array.ndim() != 3){
+        throw py::value_error("The array must have the shape (height, width, components)");
+    }
+    image.setSize(array.shape(1), array.shape(0), array.shape(2));
+    if(array.size() > 0){
+        std::memcpy(image.pixels(), array.data(), array.size());
+    }
+}
+
+}
+
 namespace cnoid {
 
 void exportPySceneGraph(py::module& m)
@@ -93,6 +155,53 @@ void exportPySceneGraph(py::module& m)
         .def("getTranslation", (Affine3::TranslationPart (SgPosTransform::*)()) &SgPosTransform::translation)
         .def("getRotation", (Affine3::LinearPart (SgPosTransform::*)()) &SgPosTransform::rotation)
         ;
+
+    py::class_<SgVertexArray, SgVertexArrayPtr, SgObject>(m, "SgVertexArray")
+        .def(py::init<>())
+        .def(py::init<size_t>())
+        .def_property_readonly("size", &SgVertexArray::size)
+        .def("resize", [](SgVertexArray& self, size_t size){ self.resize(size); })
+        .def("clear", &SgVertexArray::clear)
+        .def_property_readonly("array", &getSgVertexArrayArray)
+        .def("setArray", &setSgVertexArrayArray)
+        ;
+
+    // The normal and color arrays are the same type as the vertex array
+    m.attr("SgNormalArray") = m.attr("SgVertexArray");
+    m.attr("SgColorArray") = m.attr("SgVertexArray");
+
+    py::class_<SgPlot, SgPlotPtr, SgNode>(m, "SgPlot")
+        .def_property("vertices", (SgVertexArray*(SgPlot::*)()) &SgPlot::vertices, &SgPlot::setVertices)
+        .def("setVertices", &SgPlot::setVertices)
+        .def("getOrCreateVertices", [](SgPlot& self){ return self.getOrCreateVertices(); })
+        .def_property("normals", (SgNormalArray*(SgPlot::*)()) &SgPlot::normals, &SgPlot::setNormals)
+        .def("setNormals", &SgPlot::setNormals)
+        .def("getOrCreateNormals", &SgPlot::getOrCreateNormals)
+        .def_property("colors", (SgColorArray*(SgPlot::*)()) &SgPlot::colors, &SgPlot::setColors)
+        .def("setColors", &SgPlot::setColors)
+        .def("getOrCreateColors", [](SgPlot& self){ return self.getOrCreateColors(); })
+        .def("updateBoundingBox", &SgPlot::updateBoundingBox)
+        ;
+
+    py::class_<SgPointSet, SgPointSetPtr, SgPlot>(m, "SgPointSet")
+        .def(py::init<>())
+        .def_property("pointSize", &SgPointSet::pointSize, &SgPointSet::setPointSize)
+        .def("setPointSize", &SgPointSet::setPointSize)
+        ;
+
+    py::class_<Image>(m, "Image")
+        .def(py::init<>())
+        .def_property_readonly("empty", &Image::empty)
+        .def_property_readonly("width", &Image::width)
+        .def_property_readonly("height", &Image::height)
+        .def_property_readonly("numComponents", &Image::numComponents)
+        .def("setSize", (void(Image::*)(int, int, int)) &Image::setSize)
+        .def("clear", &Image::clear)
+        .def("load", &Image::load)
+        .def("save", &Image::save)
+        .def_property_readonly("pixels", &getImagePixelArray)
+        .def("setPixels", &setImagePixelArray)
+        ;
 }
 
 }
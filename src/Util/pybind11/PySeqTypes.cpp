@@ -3,18 +3,145 @@
 */
 
 #include "../MultiValueSeq.h"
+#include "../MultiSE3Seq.h"
 #include "../ValueTree.h"
 #include "../YAMLWriter.h"
 #include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <algorithm>
+#include <cstring>
 
 namespace py = pybind11;
 using namespace cnoid;
 
+namespace {
+
+typedef py::array_t<double, py::array::c_style | py::array::forcecast> DoubleArray;
+
+/**
+   The returned array shares the memory of the sequence and keeps the Python object
+   of the sequence alive when the frames are stored contiguously. Otherwise a copy of
+   the frames is returned because rearranging the ring buffer here would invalidate the
+   memory used by the other holders of the sequence. Call makeContiguous explicitly to
+   obtain a shared array in that case. The shared array is invalidated when the number
+   of frames or parts is changed, so it should be obtained again after such an operation.
+*/
+py::array getMultiValueSeqArray(py::object pyseq)
+{
+    auto& seq = pyseq.cast<MultiValueSeq&>();
+    const ssize_t m = seq.numFrames();
+    const ssize_t n = seq.numParts();
+    if(m == 0 || n == 0){
+        return py::array_t<double>({ m, n });
+    }
+    if(!seq.isContiguous()){
+        py::array_t<double> array({ m, n });
+        double* p = array.mutable_data();
+        for(int i=0; i < m; ++i){
+            auto frame = seq.frame(i);
+            std::copy(frame.begin(), frame.end(), p);
+            p += n;
+        }
+        return array;
+    }
+    return py::array_t<double>(
+        { m, n }, { static_cast<ssize_t>(n * sizeof(double)), static_cast<ssize_t>(sizeof(double)) },
+        seq.data(), pyseq);
+}
+
+py::array getMultiValueSeqFrameArray(py::object pyseq, int frameIndex)
+{
+    auto& seq = pyseq.cast<MultiValueSeq&>();
+    if(frameIndex < 0 || frameIndex >= seq.numFrames()){
+        throw py::index_error();
+    }
+    auto frame = seq.frame(frameIndex);
+    return py::array_t<double>(
+        { static_cast<ssize_t>(frame.size()) }, { static_cast<ssize_t>(sizeof(double)) },
+        frame.begin(), pyseq);
+}
+
+void setMultiValueSeqArray(MultiValueSeq& seq, DoubleArray array)
+{
+    if(array.ndim() != 2){
+        throw py::value_error("The array must be two-dimensional (frames x parts)");
+    }
+    seq.setDimension(array.shape(0), array.shape(1));
+    seq.makeContiguous();
+    if(array.size() > 0){
+        std::memcpy(seq.data(), array.data(), array.size() * sizeof(double));
+    }
+}
+
+/**
+   SE3 consists of a translation vector and a quaternion which may be separated by
+   a padding for the alignment, so the translation and rotation parts are exposed as
+   separate strided views of the same memory. As with getMultiValueSeqArray, a copy
+   is returned when the frames are not stored contiguously.
+*/
+py::array getMultiSE3SeqComponentArray(py::object pyseq, bool isRotation)
+{
+    auto& seq = pyseq.cast<MultiSE3Seq&>();
+    const ssize_t m = seq.numFrames();
+    const ssize_t n = seq.numParts();
+    const ssize_t k = isRotation ? 4 : 3;
+    if(m == 0 || n == 0){
+        return py::array_t<double>({ m, n, k });
+    }
+    if(!seq.isContiguous()){
+        py::array_t<double> array({ m, n, k });
+        double* p = array.mutable_data();
+        for(int i=0; i < m; ++i){
+            for(auto& x : seq.frame(i)){
+                const double* q = isRotation ? x.rotation().coeffs().data() : x.translation().data();
+                std::copy(q, q + k, p);
+                p += k;
+            }
+        }
+        return array;
+    }
+    SE3* top = seq.data();
+    double* data = isRotation ? top->rotation().coeffs().data() : top->translation().data();
+    return py::array_t<double>(
+        { m, n, k },
+        { static_cast<ssize_t>(n * sizeof(SE3)), static_cast<ssize_t>(sizeof(SE3)),
+          static_cast<ssize_t>(sizeof(double)) },
+        data, pyseq);
+}
+
+void setMultiSE3SeqArrays(MultiSE3Seq& seq, DoubleArray translations, DoubleArray rotations)
+{
+    if(translations.ndim() != 3 || translations.shape(2) != 3 ||
+       rotations.ndim() != 3 || rotations.shape(2) != 4 ||
+       translations.shape(0) != rotations.shape(0) ||
+       translations.shape(1) != rotations.shape(1)){
+        throw py::value_error(
+            "The arrays must have the shapes (frames, parts, 3) and (frames, parts, 4)");
+    }
+    const int numFrames = translations.shape(0);
+    const int numParts = translations.shape(1);
+    seq.setDimension(numFrames, numParts);
+    seq.makeContiguous();
+    SE3* p = seq.data();
+    const double* t = translations.data();
+    const double* q = rotations.data();
+    const int size = numFrames * numParts;
+    for(int i=0; i < size; ++i){
+        p->translation() = Eigen::Map<const Vector3>(t);
+        p->rotation().coeffs() = Eigen::Map<const Vector4>(q);
+        ++p;
+        t += 3;
+        q += 4;
+    }
+}
+
+}
+
 namespace cnoid {
 
 void exportPySeqTypes(py::module& m)
 {
-    py::class_<AbstractSeq>(m, "AbstractSeq")
+    py::class_<AbstractSeq, std::shared_ptr<AbstractSeq>>(m, "AbstractSeq")
         .def("cloneSeq", &AbstractSeq::cloneSeq)
         .def("copySeqProperties", &AbstractSeq::copySeqProperties)
         .def_property_readonly("seqType", &AbstractSeq::seqType)
@@ -54,7 +181,7 @@ void exportPySeqTypes(py::module& m)
         .def("getDefaultFrameRate", &AbstractSeq::defaultFrameRate)
         ;
 
-    py::class_<AbstractMultiSeq, AbstractSeq>(m, "AbstractMultiSeq")
+    py::class_<AbstractMultiSeq, std::shared_ptr<AbstractMultiSeq>, AbstractSeq>(m, "AbstractMultiSeq")
         .def("copySeqProperties", &AbstractMultiSeq::copySeqProperties)
         .def("setDimension", [](AbstractMultiSeq& self, int numFrames, int numParts){ self.setDimension(numFrames, numParts); })
         .def("setDimension", [](AbstractMultiSeq& self, int numFrames, int numParts, bool clearNewElements){
@@ -84,7 +211,13 @@ void exportPySeqTypes(py::module& m)
         .def("getSize", &Deque2DDouble::Row::size)
         ;
 
-    py::class_<MultiValueSeq, AbstractMultiSeq>(m, "MultiValueSeq")
+    /*
+      The seq classes also inherit Deque2D, which is not exposed, so py::multiple_inheritance
+      is required to apply the pointer offset of AbstractMultiSeq when its functions are called.
+    */
+    py::class_<MultiValueSeq, std::shared_ptr<MultiValueSeq>, AbstractMultiSeq>(m, "MultiValueSeq", py::multiple_inheritance())
+        .def(py::init<>())
+        .def(py::init<int, int>())
         .def_property_readonly("empty", &MultiValueSeq::empty)
         .def("resize", &MultiValueSeq::resize)
         .def("clear", &MultiValueSeq::clear)
@@ -98,6 +231,11 @@ void exportPySeqTypes(py::module& m)
         .def("getClampFrameIndex", &MultiValueSeq::clampFrameIndex)
         .def("frame", (MultiValueSeq::Frame (MultiValueSeq::*)(int)) &MultiValueSeq::frame)
         .def("part", (MultiValueSeq::Part (MultiValueSeq::*)(int)) &MultiValueSeq::part)
+        .def_property_readonly("isContiguous", &MultiValueSeq::isContiguous)
+        .def("makeContiguous", &MultiValueSeq::makeContiguous)
+        .def_property_readonly("array", &getMultiValueSeqArray)
+        .def("frameArray", &getMultiValueSeqFrameArray)
+        .def("setArray", &setMultiValueSeqArray)
         .def("loadPlainFormat",
              [](MultiValueSeq& self, const std::string& filename){
                  return self.loadPlainFormat(filename); })
@@ -110,6 +248,24 @@ void exportPySeqTypes(py::module& m)
         .def("getFrame", (MultiValueSeq::Frame (MultiValueSeq::*)(int)) &MultiValueSeq::frame)
         .def("getPart", (MultiValueSeq::Part (MultiValueSeq::*)(int)) &MultiValueSeq::part)
         ;
+
+    py::class_<MultiSE3Seq, std::shared_ptr<MultiSE3Seq>, AbstractMultiSeq>(m, "MultiSE3Seq", py::multiple_inheritance())
+        .def(py::init<>())
+        .def(py::init<int, int>())
+        .def_property_readonly("empty", &MultiSE3Seq::empty)
+        .def("clear", &MultiSE3Seq::clear)
+        .def("pop_back", &MultiSE3Seq::pop_back)
+        .def("pop_front", (void (MultiSE3Seq::*)(int)) &MultiSE3Seq::pop_front)
+        .def("pop_front", (void (MultiSE3Seq::*)()) &MultiSE3Seq::pop_front)
+        .def("clampFrameIndex", &MultiSE3Seq::clampFrameIndex)
+        .def_property_readonly("isContiguous", &MultiSE3Seq::isContiguous)
+        .def("makeContiguous", &MultiSE3Seq::makeContiguous)
+        .def_property_readonly(
+            "translationArray", [](py::object self){ return getMultiSE3SeqComponentArray(self, false); })
+        .def_property_readonly(
+            "rotationArray", [](py::object self){ return getMultiSE3SeqComponentArray(self, true); })
+        .def("setArrays", &setMultiSE3SeqArrays)
+        ;
 }
 
 }
@@ -0,0 +1,303 @@
+/**
+   This test checks that the solutions of BatchInverseKinematics are the same as the ones
+   obtained by solving the targets one by one with a single joint path or kit, and that
+   ReachabilityMap gives the same map for the global region with and without the kit frames.
+*/
+
+#include <cnoid/BatchInverseKinematics>
+#include <cnoid/ReachabilityMap>
+#include <cnoid/Body>
+#include <cnoid/JointPath>
+#include <cnoid/LinkKinematicsKit>
+#include <cnoid/CoordinateFrame>
+#include <cnoid/CoordinateFrameList>
+#include <cnoid/EigenUtil>
+#include <random>
+#include <iostream>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+int numErrors = 0;
+
+void check(bool condition, const string& message)
+{
+    if(!condition){
+        cerr << "Error: " << message << endl;
+        ++numErrors;
+    }
+}
+
+BodyPtr createArm()
+{
+    BodyPtr body = new Body;
+    Link* root = body->createLink();
+    root->setName("BASE");
+    root->setJointType(Link::FixedJoint);
+    body->setRootLink(root);
+
+    const Vector3 axes[] = {
+        Vector3::UnitZ(), Vector3::UnitY(), Vector3::UnitY(),
+        Vector3::UnitX(), Vector3::UnitY(), Vector3::UnitZ() };
+    Link* parent = root;
+    for(int i=0; i < 6; ++i){
+        Link* link = body->createLink();
+        link->setName(string("J") + std::to_string(i + 1));
+        link->setJointType(Link::RevoluteJoint);
+        link->setJointId(i);
+        link->setJointAxis(axes[i]);
+        link->setOffsetTranslation(Vector3(0.0, 0.0, (i == 0) ? 0.2 : 0.25));
+        parent->appendChild(link);
+        parent = link;
+    }
+    body->updateLinkTree();
+    for(int i=0; i < body->numJoints(); ++i){
+        body->joint(i)->q() = 0.3;
+    }
+    body->calcForwardKinematics();
+    return body;
+}
+
+Link* endLink(Body* body)
+{
+    return body->link(body->numLinks() - 1);
+}
+
+vector<Position> createTargets(Body* body, int numTargets)
+{
+    BodyPtr clone = body->clone();
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> angle(-0.2, 0.8);
+    vector<Position> targets;
+    for(int i=0; i < numTargets; ++i){
+        for(int j=0; j < clone->numJoints(); ++j){
+            clone->joint(j)->q() = angle(random);
+        }
+        clone->calcForwardKinematics();
+        Position T = endLink(clone)->T();
+        if(i % 5 == 4){
+            // Out of reach
+            T.translation() *= 3.0;
+        }
+        targets.push_back(T);
+    }
+    return targets;
+}
+
+void compareSolutions
+(const vector<BatchInverseKinematics::Solution>& solutions, const vector<bool>& solved,
+ const vector<VectorXd>& qs, const string& caseName)
+{
+    int numSolved = 0;
+    for(size_t i=0; i < solutions.size(); ++i){
+        auto& solution = solutions[i];
+        check(solution.isSolved == solved[i],
+              caseName + ": solved state of target " + std::to_string(i) + " differs");
+        check(solution.q.size() == qs[i].size() && (solution.q - qs[i]).cwiseAbs().maxCoeff() < 1.0e-9,
+              caseName + ": joint displacements of target " + std::to_string(i) + " differ");
+        if(solution.isSolved){
+            ++numSolved;
+        }
+    }
+    check(numSolved > 0, caseName + ": no target is solved");
+}
+
+void testPath(Body* body, const vector<Position>& targets)
+{
+    BodyPtr single = body->clone();
+    auto path = JointPath::getCustomPath(single, single->rootLink(), endLink(single));
+    vector<bool> solved;
+    vector<VectorXd> qs;
+    for(auto& T : targets){
+        for(int i=0; i < path->numJoints(); ++i){
+            path->joint(i)->q() = body->link(path->joint(i)->index())->q();
+        }
+        path->calcForwardKinematics();
+        solved.push_back(path->calcInverseKinematics(T));
+        VectorXd q(path->numJoints());
+        for(int i=0; i < path->numJoints(); ++i){
+            q[i] = path->joint(i)->q();
+        }
+        qs.push_back(q);
+    }
+
+    for(int numThreads : { 1, 4 }){
+        const string caseName = "Path with " + std::to_string(numThreads) + " threads";
+        BatchInverseKinematics batch(body, body->rootLink(), endLink(body));
+        batch.setNumThreads(numThreads);
+        vector<BatchInverseKinematics::Solution> solutions;
+        batch.solve(targets, solutions);
+        compareSolutions(solutions, solved, qs, caseName);
+    }
+
+    // The root link is used if the base link is not specified
+    LinkKinematicsKitPtr kit = new LinkKinematicsKit(endLink(body));
+    check(!kit->baseLink(), "The kit without a base link has a base link");
+    BatchInverseKinematics batch(kit);
+    check(batch.baseLink() == body->rootLink(), "The root link is not used as the base link");
+    vector<BatchInverseKinematics::Solution> solutions;
+    batch.solve(targets, solutions);
+    compareSolutions(solutions, solved, qs, "Kit without a base link");
+}
+
+void setFrames(LinkKinematicsKit* kit, CoordinateFrameList* baseFrames, CoordinateFrameList* offsetFrames)
+{
+    kit->setBaseFrames(baseFrames);
+    kit->setOffsetFrames(offsetFrames);
+    kit->setCurrentBaseFrame(1);
+    kit->setCurrentOffsetFrame(1);
+}
+
+void createFrames(CoordinateFrameListPtr& baseFrames, CoordinateFrameListPtr& offsetFrames,
+                  Position& T_base, Position& T_offset)
+{
+    baseFrames = new CoordinateFrameList;
+    baseFrames->setFrameType(CoordinateFrameList::Base);
+    CoordinateFramePtr baseFrame = new CoordinateFrame(1);
+    T_base.linear() = rotFromRpy(0.1, -0.2, 0.5);
+    T_base.translation() << 0.1, -0.05, 0.2;
+    baseFrame->setPosition(T_base);
+    baseFrames->append(baseFrame);
+
+    offsetFrames = new CoordinateFrameList;
+    offsetFrames->setFrameType(CoordinateFrameList::Offset);
+    CoordinateFramePtr offsetFrame = new CoordinateFrame(1);
+    T_offset.linear() = rotFromRpy(0.0, 0.3, 0.0);
+    T_offset.translation() << 0.0, 0.0, 0.1;
+    offsetFrame->setPosition(T_offset);
+    offsetFrames->append(offsetFrame);
+}
+
+void testKitFrames(Body* body, const vector<Position>& globalTargets)
+{
+    CoordinateFrameListPtr baseFrames;
+    CoordinateFrameListPtr offsetFrames;
+    Position T_base;
+    Position T_offset;
+    createFrames(baseFrames, offsetFrames, T_base, T_offset);
+
+    // The targets are given in the base frame with the offset frame
+    vector<Position> targets;
+    for(auto& T : globalTargets){
+        targets.push_back(T_base.inverse(Eigen::Isometry) * T * T_offset);
+    }
+
+    BodyPtr single = body->clone();
+    LinkKinematicsKitPtr singleKit = new LinkKinematicsKit(endLink(single));
+    singleKit->setBaseLink(single->rootLink());
+    setFrames(singleKit, baseFrames, offsetFrames);
+    auto path = singleKit->jointPath();
+    vector<bool> solved;
+    vector<VectorXd> qs;
+    for(auto& T : targets){
+        for(int i=0; i < path->numJoints(); ++i){
+            path->joint(i)->q() = body->link(path->joint(i)->index())->q();
+        }
+        path->calcForwardKinematics();
+        solved.push_back(singleKit->setEndPosition(T));
+        VectorXd q(path->numJoints());
+        for(int i=0; i < path->numJoints(); ++i){
+            q[i] = path->joint(i)->q();
+        }
+        qs.push_back(q);
+    }
+
+    LinkKinematicsKitPtr kit = new LinkKinematicsKit(endLink(body));
+    kit->setBaseLink(body->rootLink());
+    setFrames(kit, baseFrames, offsetFrames);
+    for(int numThreads : { 1, 4 }){
+        const string caseName = "Kit frames with " + std::to_string(numThreads) + " threads";
+        BatchInverseKinematics batch(kit);
+        batch.setNumThreads(numThreads);
+        vector<BatchInverseKinematics::Solution> solutions;
+        batch.solve(targets, solutions);
+        compareSolutions(solutions, solved, qs, caseName);
+    }
+}
+
+void testReachabilityMap(Body* body)
+{
+    vector<Matrix3> orientations;
+    orientations.push_back(endLink(body)->R());
+    orientations.push_back(rotFromRpy(0.0, M_PI / 2.0, 0.0));
+
+    ReachabilityMap map;
+    map.setRegion(Vector3(-1.2, -1.2, -0.6), Vector3(1.2, 1.2, 1.6), 0.2);
+    map.setEndOrientations(orientations);
+    BatchInverseKinematics batch(body, body->rootLink(), endLink(body));
+    check(map.build(batch), "The reachability map is not built");
+
+    int numReachable = 0;
+    for(auto& value : map.reachabilities()){
+        if(value > 0.0f){
+            ++numReachable;
+        }
+    }
+    check(numReachable > 0 && numReachable < map.numVoxels(),
+          "Reachability map: " + std::to_string(numReachable) + " of " +
+          std::to_string(map.numVoxels()) + " voxels are reachable");
+    check(map.reachability(Vector3(0.0, 0.0, 5.0)) == 0.0f,
+          "Reachability map: the position outside the region is reachable");
+
+    // The region and the orientations are global even if the kit has the base and offset frames
+    CoordinateFrameListPtr baseFrames;
+    CoordinateFrameListPtr offsetFrames;
+    Position T_base;
+    Position T_offset;
+    createFrames(baseFrames, offsetFrames, T_base, T_offset);
+    LinkKinematicsKitPtr kit = new LinkKinematicsKit(endLink(body));
+    kit->setBaseLink(body->rootLink());
+    setFrames(kit, baseFrames, offsetFrames);
+    BatchInverseKinematics kitBatch(kit);
+    Position T_end = endLink(body)->T();
+    Position T_global = T_base * kitBatch.targetFromGlobalEndPosition(T_end) * T_offset.inverse(Eigen::Isometry);
+    check(T_global.isApprox(T_end), "The global end position is not converted into the kit frames");
+    ReachabilityMap kitMap;
+    kitMap.setRegion(Vector3(-1.2, -1.2, -0.6), Vector3(1.2, 1.2, 1.6), 0.2);
+    kitMap.setEndOrientations(orientations);
+    check(kitMap.build(kitBatch), "The reachability map with the kit is not built");
+    int numMismatches = 0;
+    for(int i=0; i < map.numVoxels(); ++i){
+        if(map.reachabilities()[i] != kitMap.reachabilities()[i]){
+            ++numMismatches;
+        }
+    }
+    check(numMismatches == 0,
+          "Reachability map with the kit: " + std::to_string(numMismatches) + " voxels are different");
+
+    // The current global orientation of the end link is used by default
+    ReachabilityMap defaultMap;
+    defaultMap.setRegion(Vector3(-1.2, -1.2, -0.6), Vector3(1.2, 1.2, 1.6), 0.2);
+    defaultMap.build(kitBatch);
+    orientations.resize(1);
+    map.setEndOrientations(orientations);
+    map.build(batch);
+    check(defaultMap.reachabilities() == map.reachabilities(),
+          "Reachability map: the default orientation is not the global orientation of the end link");
+}
+
+}
+
+
+int main()
+{
+    BodyPtr body = createArm();
+    auto targets = createTargets(body, 40);
+    BodyPtr original = body->clone();
+
+    testPath(body, targets);
+    testKitFrames(body, targets);
+    testReachabilityMap(body);
+
+    for(int i=0; i < body->numLinks(); ++i){
+        check(body->link(i)->q() == original->link(i)->q(), "The original body is changed");
+    }
+
+    if(numErrors > 0){
+        cerr << numErrors << " errors" << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,226 @@
+/**
+   This test checks that the collision shape proxies of BodyCollisionDetector do not miss the
+   collisions of the original shapes and that they are shared through the proxy caches.
+*/
+
+#include <cnoid/BodyCollisionDetector>
+#include <cnoid/AISTCollisionDetector>
+#include <cnoid/Body>
+#include <cnoid/MeshGenerator>
+#include <cnoid/MeshExtractor>
+#include <cnoid/SceneDrawables>
+#include <cnoid/EigenUtil>
+#include <cnoid/stdx/filesystem>
+#include <iostream>
+
+using namespace std;
+using namespace cnoid;
+namespace filesystem = cnoid::stdx::filesystem;
+
+namespace {
+
+int numErrors = 0;
+
+void check(bool condition, const string& message)
+{
+    if(!condition){
+        cerr << "Error: " << message << endl;
+        ++numErrors;
+    }
+}
+
+/**
+   The geometries given to the detector are recorded to inspect the proxies.
+*/
+class RecordingCollisionDetector : public AISTCollisionDetector
+{
+public:
+    vector<SgNodePtr> geometries;
+
+    virtual stdx::optional<GeometryHandle> addGeometry(SgNode* geometry) override {
+        geometries.push_back(geometry);
+        return AISTCollisionDetector::addGeometry(geometry);
+    }
+};
+
+typedef ref_ptr<RecordingCollisionDetector> RecordingCollisionDetectorPtr;
+
+const char* proxyTypeNames[] = { "none", "decimation", "convex hull", "convex decomposition" };
+
+const int maxNumProxyTriangles = 200;
+
+BodyPtr createShapeBody(SgMesh* mesh)
+{
+    BodyPtr body = new Body;
+    Link* link = body->createLink();
+    link->setJointType(Link::FixedJoint);
+    SgShapePtr shape = new SgShape;
+    shape->setMesh(mesh);
+    link->addCollisionShapeNode(shape);
+    body->setRootLink(link);
+    body->updateLinkTree();
+    body->calcForwardKinematics();
+    return body;
+}
+
+BodyPtr createProbeBody()
+{
+    // A thin bar which crosses the surface of the shape along its normal
+    MeshGenerator meshGenerator;
+    BodyPtr body = new Body;
+    Link* link = body->createLink();
+    link->setJointType(Link::FreeJoint);
+    SgShapePtr shape = new SgShape;
+    shape->setMesh(meshGenerator.generateBox(Vector3(0.004, 0.004, 0.3)));
+    link->addCollisionShapeNode(shape);
+    body->setRootLink(link);
+    body->updateLinkTree();
+    return body;
+}
+
+int countTriangles(SgNode* node)
+{
+    MeshExtractor meshExtractor;
+    SgMeshPtr mesh = meshExtractor.integrate(node);
+    return mesh ? mesh->numTriangles() : 0;
+}
+
+/**
+   The probe is placed so that it penetrates the original surface by 2 mm at sample vertices
+   and extends outward. A proxy which does not enclose the original surface there misses it.
+*/
+void testProxy(const string& shapeName, SgMesh* mesh, int proxyType, const string& cacheDirectory)
+{
+    const string caseName = shapeName + " with " + proxyTypeNames[proxyType];
+
+    BodyPtr shapeBody = createShapeBody(mesh);
+    BodyPtr probe = createProbeBody();
+
+    RecordingCollisionDetectorPtr detector = new RecordingCollisionDetector;
+    BodyCollisionDetector bodyCollisionDetector;
+    bodyCollisionDetector.setCollisionDetector(detector);
+    bodyCollisionDetector.setCollisionShapeProxyCacheDirectory(cacheDirectory);
+    bodyCollisionDetector.setDefaultCollisionShapeProxy(proxyType, maxNumProxyTriangles);
+    bodyCollisionDetector.addBody(shapeBody, false);
+    bodyCollisionDetector.addBody(probe, false);
+    bodyCollisionDetector.makeReady();
+
+    SgNode* geometry = detector->geometries.front();
+    const int numTriangles = countTriangles(geometry);
+    if(proxyType == BodyCollisionDetector::NO_PROXY){
+        check(numTriangles == mesh->numTriangles(), caseName + ": the original shape is not used");
+    } else {
+        check(numTriangles > 0 && numTriangles <= maxNumProxyTriangles,
+              caseName + ": the proxy has " + std::to_string(numTriangles) + " triangles");
+    }
+
+    auto& vertices = *mesh->vertices();
+    vector<Vector3> normals(vertices.size(), Vector3::Zero());
+    for(int i=0; i < mesh->numTriangles(); ++i){
+        auto triangle = mesh->triangle(i);
+        const Vector3 a = vertices[triangle[0]].cast<double>();
+        const Vector3 b = vertices[triangle[1]].cast<double>();
+        const Vector3 c = vertices[triangle[2]].cast<double>();
+        const Vector3 n = (b - a).cross(c - a);
+        for(int j=0; j < 3; ++j){
+            normals[triangle[j]] += n;
+        }
+    }
+
+    int numMissed = 0;
+    int numSamples = 0;
+    for(size_t i=0; i < vertices.size(); i += 17){
+        if(normals[i].norm() < 1.0e-12){
+            continue;
+        }
+        const Vector3 n = normals[i].normalized();
+        Link* link = probe->rootLink();
+        link->setRotation(Quaternion::FromTwoVectors(Vector3::UnitZ(), n).toRotationMatrix());
+        link->setTranslation(vertices[i].cast<double>() + n * (0.15 - 0.002));
+        bodyCollisionDetector.updatePositions();
+        bool detected = false;
+        bodyCollisionDetector.detectCollisions(
+            [&](const CollisionPair&){ detected = true; });
+        if(!detected){
+            ++numMissed;
+        }
+        ++numSamples;
+    }
+    check(numSamples > 0, caseName + ": no sample is tested");
+    check(numMissed == 0,
+          caseName + ": " + std::to_string(numMissed) + " of " + std::to_string(numSamples) + " collisions are missed");
+}
+
+void testCache(SgMesh* mesh, const string& cacheDirectory)
+{
+    auto addBody = [&](RecordingCollisionDetector* detector, BodyCollisionDetector& bodyCollisionDetector){
+        bodyCollisionDetector.setCollisionDetector(detector);
+        bodyCollisionDetector.setCollisionShapeProxyCacheDirectory(cacheDirectory);
+        bodyCollisionDetector.setDefaultCollisionShapeProxy(
+            BodyCollisionDetector::CONVEX_HULL_PROXY, maxNumProxyTriangles);
+        bodyCollisionDetector.addBody(createShapeBody(mesh), false);
+    };
+
+    SgNodePtr proxy;
+    {
+        RecordingCollisionDetectorPtr detector1 = new RecordingCollisionDetector;
+        BodyCollisionDetector bodyCollisionDetector1;
+        addBody(detector1, bodyCollisionDetector1);
+        RecordingCollisionDetectorPtr detector2 = new RecordingCollisionDetector;
+        BodyCollisionDetector bodyCollisionDetector2;
+        addBody(detector2, bodyCollisionDetector2);
+        check(detector1->geometries.front() == detector2->geometries.front(),
+              "The proxy is not shared by the detectors in the same process");
+        proxy = detector1->geometries.front();
+    }
+
+    int numCacheFiles = 0;
+    for(auto& entry : filesystem::directory_iterator(cacheDirectory)){
+        if(entry.path().extension() == ".csp"){
+            ++numCacheFiles;
+        }
+    }
+    check(numCacheFiles > 0, "The proxy is not stored in the cache directory");
+
+    // The proxy is loaded from the cache file after the in-process proxy is released
+    const int numTriangles = countTriangles(proxy);
+    proxy.reset();
+    RecordingCollisionDetectorPtr detector = new RecordingCollisionDetector;
+    BodyCollisionDetector bodyCollisionDetector;
+    addBody(detector, bodyCollisionDetector);
+    check(countTriangles(detector->geometries.front()) == numTriangles,
+          "The proxy loaded from the cache file is different");
+}
+
+}
+
+
+int main()
+{
+    auto cacheDirectory = filesystem::temp_directory_path() / "cnoid-collision-shape-proxy-test";
+    filesystem::remove_all(cacheDirectory);
+
+    MeshGenerator meshGenerator;
+    meshGenerator.setDivisionNumber(60);
+    SgMeshPtr sphere = meshGenerator.generateSphere(0.5);
+    SgMeshPtr torus = meshGenerator.generateTorus(0.4, 0.1);
+
+    for(int proxyType = BodyCollisionDetector::NO_PROXY;
+        proxyType <= BodyCollisionDetector::CONVEX_DECOMPOSITION_PROXY; ++proxyType){
+        testProxy("Sphere", sphere, proxyType, cacheDirectory.string());
+        if(proxyType != BodyCollisionDetector::CONVEX_HULL_PROXY){
+            // The probes on the inner side of a torus end inside its convex hull without crossing it
+            testProxy("Torus", torus, proxyType, cacheDirectory.string());
+        }
+    }
+
+    testCache(sphere, (cacheDirectory / "cache").string());
+
+    filesystem::remove_all(cacheDirectory);
+
+    if(numErrors > 0){
+        cerr << numErrors << " errors" << endl;
+        return 1;
+    }
+    return 0;
+}
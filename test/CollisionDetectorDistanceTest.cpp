@@ -0,0 +1,129 @@
+/**
+   This test checks that the results of AISTCollisionDetector::detectDistances are the same as
+   the ones obtained by calling detectDistance for each pair.
+*/
+
+#include <cnoid/AISTCollisionDetector>
+#include <cnoid/MeshGenerator>
+#include <cnoid/SceneDrawables>
+#include <random>
+#include <limits>
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+typedef CollisionDetectorDistanceAPI::GeometryPair GeometryPair;
+typedef CollisionDetectorDistanceAPI::DistanceResult DistanceResult;
+
+int numErrors = 0;
+
+void check(bool condition, const string& message)
+{
+    if(!condition){
+        cerr << "Error: " << message << endl;
+        ++numErrors;
+    }
+}
+
+void testDistances(int numThreads)
+{
+    const string caseName = std::to_string(numThreads) + " threads";
+
+    AISTCollisionDetector detector;
+    detector.setNumThreads(numThreads);
+
+    MeshGenerator meshGenerator;
+    vector<CollisionDetector::GeometryHandle> geometries;
+    for(int i=0; i < 20; ++i){
+        SgShapePtr shape = new SgShape;
+        if(i % 2 == 0){
+            shape->setMesh(meshGenerator.generateBox(Vector3(0.5, 0.4, 0.3)));
+        } else {
+            shape->setMesh(meshGenerator.generateSphere(0.3));
+        }
+        geometries.push_back(*detector.addGeometry(shape));
+    }
+    detector.makeReady();
+
+    vector<GeometryPair> pairs;
+    for(size_t i=0; i < geometries.size(); ++i){
+        for(size_t j=i+1; j < geometries.size(); ++j){
+            pairs.emplace_back(geometries[i], geometries[j]);
+        }
+    }
+    // A duplicated pair must also be output for each occurrence
+    pairs.push_back(pairs[5]);
+
+    std::mt19937 random(3);
+    std::uniform_real_distribution<double> position(0.0, 4.0);
+
+    int numFarPairs = 0;
+    for(int step=0; step < 5; ++step){
+        for(auto& geometry : geometries){
+            Position T = Position::Identity();
+            T.translation() << position(random), position(random), position(random);
+            detector.updatePosition(geometry, T);
+        }
+        for(double maxDistance : { std::numeric_limits<double>::max(), 0.8 }){
+            vector<DistanceResult> expected;
+            for(auto& pair : pairs){
+                DistanceResult result;
+                result.geometry1 = pair.first;
+                result.geometry2 = pair.second;
+                result.distance = detector.detectDistance(pair.first, pair.second, result.point1, result.point2);
+                if(result.distance < maxDistance){
+                    expected.push_back(result);
+                } else {
+                    ++numFarPairs;
+                }
+            }
+
+            vector<DistanceResult> results;
+            const int n = detector.detectDistances(pairs, maxDistance, results);
+
+            const string stepName =
+                caseName + ", step " + std::to_string(step) + ", max distance " +
+                ((maxDistance < std::numeric_limits<double>::max()) ? std::to_string(maxDistance) : string("unlimited"));
+            check(n == static_cast<int>(results.size()), stepName + ": the returned number is wrong");
+            if(results.size() != expected.size()){
+                check(false, stepName + ": the number of the results is " + std::to_string(results.size()) +
+                      " instead of " + std::to_string(expected.size()));
+                continue;
+            }
+            for(size_t i=0; i < results.size(); ++i){
+                auto& result = results[i];
+                auto& ref = expected[i];
+                check(result.geometry1 == ref.geometry1 && result.geometry2 == ref.geometry2,
+                      stepName + ": the pair of result " + std::to_string(i) + " differs");
+                check(fabs(result.distance - ref.distance) < 1.0e-5,
+                      stepName + ": the distance of result " + std::to_string(i) + " differs");
+                // The points of an intersecting pair are not the closest points
+                if(result.distance > 0.0){
+                    check(fabs((result.point1 - result.point2).norm() - result.distance) < 1.0e-4,
+                          stepName + ": the points of result " + std::to_string(i) + " do not match the distance");
+                }
+            }
+        }
+    }
+    check(numFarPairs > 0, caseName + ": the threshold does not exclude any pair");
+}
+
+}
+
+
+int main()
+{
+    for(int numThreads : { 0, 1, 4 }){
+        testDistances(numThreads);
+    }
+
+    if(numErrors > 0){
+        cerr << numErrors << " errors" << endl;
+        return 1;
+    }
+    return 0;
+}
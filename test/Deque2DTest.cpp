@@ -0,0 +1,119 @@
+/**
+   This test checks that Deque2D keeps the order of the rows when the memory is reallocated
+   while the rows are wrapped around the end of the memory.
+*/
+
+#include <cnoid/Deque2D>
+#include <iostream>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+int numErrors = 0;
+
+void check(bool condition, const string& message)
+{
+    if(!condition){
+        cerr << "Error: " << message << endl;
+        ++numErrors;
+    }
+}
+
+const int numCols = 3;
+
+void setRow(Deque2D<int>& deque, int rowIndex, int value)
+{
+    auto row = deque.row(rowIndex);
+    for(int i=0; i < numCols; ++i){
+        row[i] = value * 10 + i;
+    }
+}
+
+void checkRows(Deque2D<int>& deque, int firstValue, int numRows, const string& caseName)
+{
+    check(deque.rowSize() >= numRows, caseName + ": the row size is " + std::to_string(deque.rowSize()));
+    for(int i=0; i < numRows && i < deque.rowSize(); ++i){
+        auto row = deque.row(i);
+        for(int j=0; j < numCols; ++j){
+            if(row[j] != (firstValue + i) * 10 + j){
+                check(false, caseName + ": row " + std::to_string(i) + " is " + std::to_string(row[j] / 10));
+                return;
+            }
+        }
+    }
+}
+
+/**
+   The rows are appended after removing the front rows so that the last rows are stored
+   at the beginning of the memory.
+*/
+void makeWrappedDeque(Deque2D<int>& deque, int numRows)
+{
+    deque.resize(numRows, numCols);
+    for(int i=0; i < numRows; ++i){
+        setRow(deque, i, i);
+    }
+    deque.pop_front(numRows / 2);
+    for(int i=numRows; i < numRows + numRows / 2; ++i){
+        deque.append();
+        setRow(deque, deque.rowSize() - 1, i);
+    }
+}
+
+void testResize()
+{
+    Deque2D<int> deque;
+    makeWrappedDeque(deque, 8);
+    check(!deque.isContiguous(), "Resize: the rows are not wrapped");
+    checkRows(deque, 4, 8, "Resize before the reallocation");
+
+    // Growing beyond the capacity reallocates the memory
+    deque.resizeRow(100);
+    checkRows(deque, 4, 8, "Resize");
+}
+
+void testReserveRows()
+{
+    Deque2D<int> deque;
+    makeWrappedDeque(deque, 8);
+    check(!deque.isContiguous(), "Reserve: the rows are not wrapped");
+    deque.reserveRows(100);
+    checkRows(deque, 4, 8, "Reserve");
+
+    // The reserved memory works as a ring buffer without changing the order
+    for(int i=12; i < 500; ++i){
+        if(deque.rowSize() == 100){
+            deque.pop_front();
+        }
+        deque.append();
+        setRow(deque, deque.rowSize() - 1, i);
+    }
+    checkRows(deque, 400, 100, "Ring buffer");
+}
+
+void testColumnResize()
+{
+    Deque2D<int> deque;
+    makeWrappedDeque(deque, 8);
+    deque.resizeColumn(numCols + 1);
+    // The elements are not kept when the column size is changed, but the row size is kept
+    check(deque.rowSize() == 8 && deque.colSize() == numCols + 1, "Column resize: the size is wrong");
+}
+
+}
+
+
+int main()
+{
+    testResize();
+    testReserveRows();
+    testColumnResize();
+
+    if(numErrors > 0){
+        cerr << numErrors << " errors" << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,195 @@
+/**
+   This test checks that the fixed-size numerical inverse kinematics of JointPath for 6 and 7
+   joints gives the same solutions as the generic one and measures the solving speeds.
+*/
+
+#include <cnoid/JointPath>
+#include <cnoid/Jacobian>
+#include <cnoid/Body>
+#include <cnoid/EigenUtil>
+#include <random>
+#include <chrono>
+#include <iostream>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+int numErrors = 0;
+
+void check(bool condition, const string& message)
+{
+    if(!condition){
+        cerr << "Error: " << message << endl;
+        ++numErrors;
+    }
+}
+
+BodyPtr createArm(int numJoints)
+{
+    BodyPtr body = new Body;
+    Link* root = body->createLink();
+    root->setName("BASE");
+    root->setJointType(Link::FixedJoint);
+    body->setRootLink(root);
+
+    const Vector3 axes[] = {
+        Vector3::UnitZ(), Vector3::UnitY(), Vector3::UnitZ(), Vector3::UnitY(),
+        Vector3::UnitZ(), Vector3::UnitY(), Vector3::UnitX() };
+    Link* parent = root;
+    for(int i=0; i < numJoints; ++i){
+        Link* link = body->createLink();
+        link->setName(string("J") + std::to_string(i + 1));
+        link->setJointType(Link::RevoluteJoint);
+        link->setJointId(i);
+        link->setJointAxis(axes[i]);
+        link->setOffsetTranslation(Vector3(0.0, 0.0, (i == 0) ? 0.2 : 0.15));
+        parent->appendChild(link);
+        parent = link;
+    }
+    body->updateLinkTree();
+    return body;
+}
+
+struct Problem
+{
+    vector<double> q0;
+    Position T;
+};
+
+vector<Problem, Eigen::aligned_allocator<Problem>> createProblems(Body* body, int numProblems)
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> angle(-1.0, 1.0);
+    std::uniform_real_distribution<double> perturbation(-0.2, 0.2);
+    const int n = body->numJoints();
+    vector<Problem, Eigen::aligned_allocator<Problem>> problems(numProblems);
+    for(auto& problem : problems){
+        // The target is given by a posture near the initial one so that most problems are solved
+        problem.q0.resize(n);
+        for(int i=0; i < n; ++i){
+            problem.q0[i] = angle(random);
+            body->joint(i)->q() = problem.q0[i] + perturbation(random);
+        }
+        body->calcForwardKinematics();
+        problem.T = body->link(n)->T();
+    }
+    return problems;
+}
+
+/**
+   The target customized with the same error and Jacobian as the default target makes the
+   path use the generic implementation.
+*/
+shared_ptr<JointPath> createGenericPath(Body* body, Position& T)
+{
+    auto path = make_shared<JointPath>(body->rootLink(), body->link(body->numLinks() - 1));
+    JointPath* p = path.get();
+    path->customizeTarget(
+        6,
+        [p, &T](VectorXd& out_error){
+            Link* target = p->endLink();
+            out_error.head<3>() = T.translation() - target->p();
+            out_error.segment<3>(3) = target->R() * omegaFromRot(target->R().transpose() * T.linear());
+            return out_error.squaredNorm();
+        },
+        [p](MatrixXd& out_Jacobian){
+            setJacobian<0x3f, 0, 0>(*p, p->endLink(), out_Jacobian);
+        });
+    return path;
+}
+
+void setPosture(Body* body, const vector<double>& q)
+{
+    for(size_t i=0; i < q.size(); ++i){
+        body->joint(i)->q() = q[i];
+    }
+    body->calcForwardKinematics();
+}
+
+void testInverseKinematics(int numJoints)
+{
+    const string caseName = std::to_string(numJoints) + " joints";
+
+    BodyPtr body = createArm(numJoints);
+    BodyPtr genericBody = body->clone();
+    auto problems = createProblems(body, 2000);
+
+    JointPath path(body->rootLink(), body->link(numJoints));
+    Position genericTarget;
+    auto genericPath = createGenericPath(genericBody, genericTarget);
+
+    int numSolved = 0;
+    int numMismatches = 0;
+    int numIterations = 0;
+    for(auto& problem : problems){
+        setPosture(body, problem.q0);
+        setPosture(genericBody, problem.q0);
+        genericTarget = problem.T;
+        const bool solved = path.calcInverseKinematics(problem.T);
+        const bool genericSolved = genericPath->calcInverseKinematics();
+        numIterations += path.numIterations();
+        bool isSame = (solved == genericSolved) && (path.numIterations() == genericPath->numIterations());
+        for(int i=0; i < numJoints; ++i){
+            if(fabs(body->joint(i)->q() - genericBody->joint(i)->q()) > 1.0e-6){
+                isSame = false;
+            }
+        }
+        if(!isSame){
+            ++numMismatches;
+        }
+        if(solved){
+            ++numSolved;
+        }
+    }
+    check(numMismatches == 0,
+          caseName + ": " + std::to_string(numMismatches) + " solutions are different from the generic ones");
+    check(numSolved > static_cast<int>(problems.size()) / 2,
+          caseName + ": only " + std::to_string(numSolved) + " problems are solved");
+
+    // Timing
+    auto measure = [&](std::function<void(Problem& problem)> solve){
+        auto start = std::chrono::steady_clock::now();
+        for(int i=0; i < 5; ++i){
+            for(auto& problem : problems){
+                solve(problem);
+            }
+        }
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    const double time = measure(
+        [&](Problem& problem){
+            setPosture(body, problem.q0);
+            path.calcInverseKinematics(problem.T);
+        });
+    const double genericTime = measure(
+        [&](Problem& problem){
+            setPosture(genericBody, problem.q0);
+            genericTarget = problem.T;
+            genericPath->calcInverseKinematics();
+        });
+    const double numTotalIterations = 5.0 * numIterations;
+    cout << caseName << ": " << static_cast<int>(numTotalIterations / time) << " iterations/s with the fixed-size kernel, "
+         << static_cast<int>(numTotalIterations / genericTime) << " iterations/s with the generic one" << endl;
+
+#ifdef NDEBUG
+    // The margin avoids the failures caused by the fluctuation of the measurement
+    check(time < genericTime * 1.2, caseName + ": the fixed-size kernel is slower than the generic one");
+#endif
+}
+
+}
+
+
+int main()
+{
+    testInverseKinematics(6);
+    testInverseKinematics(7);
+
+    if(numErrors > 0){
+        cerr << numErrors << " errors" << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,228 @@
+/**
+   This test checks that PoseProviderToBodyMotionConverter::update regenerates the frames in
+   the updated time range and gives the same motion as the conversion of the whole motion.
+*/
+
+#include <cnoid/PoseProviderToBodyMotionConverter>
+#include <cnoid/PoseProvider>
+#include <cnoid/BodyMotion>
+#include <cnoid/Body>
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+int numErrors = 0;
+
+void check(bool condition, const string& message)
+{
+    if(!condition){
+        cerr << "Error: " << message << endl;
+        ++numErrors;
+    }
+}
+
+BodyPtr createArm()
+{
+    BodyPtr body = new Body;
+    Link* root = body->createLink();
+    root->setName("BASE");
+    root->setJointType(Link::FixedJoint);
+    body->setRootLink(root);
+
+    Link* parent = root;
+    for(int i=0; i < 3; ++i){
+        Link* link = body->createLink();
+        link->setName(string("J") + std::to_string(i + 1));
+        link->setJointType(Link::RevoluteJoint);
+        link->setJointId(i);
+        link->setJointAxis((i == 0) ? Vector3::UnitZ() : Vector3::UnitY());
+        link->setOffsetTranslation(Vector3(0.0, 0.0, 0.3));
+        parent->appendChild(link);
+        parent = link;
+    }
+    body->updateLinkTree();
+    body->calcForwardKinematics();
+    return body;
+}
+
+/**
+   The joint angles are given as sine waves. A bump can be added to the waves in a time range
+   to simulate an edit of a pose sequence.
+*/
+class WavePoseProvider : public PoseProvider
+{
+public:
+    BodyPtr body_;
+    double endingTime_;
+    double bumpLower;
+    double bumpUpper;
+    double time;
+
+    WavePoseProvider(Body* body, double endingTime)
+        : body_(body),
+          endingTime_(endingTime),
+          bumpLower(-1.0),
+          bumpUpper(-1.0),
+          time(0.0)
+    { }
+
+    virtual Body* body() const override { return body_; }
+    virtual double beginningTime() const override { return 0.0; }
+    virtual double endingTime() const override { return endingTime_; }
+    virtual bool seek(double time) override {
+        this->time = time;
+        return true;
+    }
+    virtual bool seek(double time, int /* waistLinkIndex */, const Vector3& /* waistTranslation */) override {
+        return seek(time);
+    }
+    virtual int baseLinkIndex() const override { return 0; }
+    virtual bool getBaseLinkPosition(Position& out_T) const override {
+        out_T.setIdentity();
+        return true;
+    }
+    virtual void getJointPositions(std::vector<stdx::optional<double>>& out_q) const override {
+        for(size_t i=0; i < out_q.size(); ++i){
+            double q = 0.5 * sin(time + i);
+            if(time >= bumpLower && time <= bumpUpper){
+                q += 0.2;
+            }
+            out_q[i] = q;
+        }
+    }
+    virtual stdx::optional<Vector3> ZMP() const override {
+        return Vector3(time, 0.0, 0.0);
+    }
+    virtual PoseProvider* clone() const override {
+        auto provider = new WavePoseProvider(*this);
+        provider->body_ = body_->clone();
+        return provider;
+    }
+};
+
+bool isSameMotion(BodyMotion& motion1, BodyMotion& motion2)
+{
+    if(motion1.numFrames() != motion2.numFrames() ||
+       motion1.numJoints() != motion2.numJoints() ||
+       motion1.numLinks() != motion2.numLinks()){
+        return false;
+    }
+    auto& qseq1 = *motion1.jointPosSeq();
+    auto& qseq2 = *motion2.jointPosSeq();
+    auto& pseq1 = *motion1.linkPosSeq();
+    auto& pseq2 = *motion2.linkPosSeq();
+    for(int frame=0; frame < motion1.numFrames(); ++frame){
+        for(int i=0; i < motion1.numJoints(); ++i){
+            if(qseq1(frame, i) != qseq2(frame, i)){
+                return false;
+            }
+        }
+        for(int i=0; i < motion1.numLinks(); ++i){
+            if(!pseq1(frame, i).translation().isApprox(pseq2(frame, i).translation()) ||
+               !pseq1(frame, i).rotation().isApprox(pseq2(frame, i).rotation())){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void convert(Body* body, WavePoseProvider& provider, BodyMotion& motion, bool isSe3Enabled = true)
+{
+    PoseProviderToBodyMotionConverter converter;
+    converter.setAllLinkPositionOutput(isSe3Enabled);
+    motion.setFrameRate(100.0);
+    converter.convert(body, &provider, motion);
+}
+
+void update(Body* body, WavePoseProvider& provider, BodyMotion& motion, double lower, double upper, bool isSe3Enabled = true)
+{
+    PoseProviderToBodyMotionConverter converter;
+    converter.setAllLinkPositionOutput(isSe3Enabled);
+    check(converter.update(body, &provider, motion, lower, upper), "The update failed");
+}
+
+void testPartialUpdate()
+{
+    BodyPtr body = createArm();
+    WavePoseProvider provider(body, 10.0);
+    BodyMotion motion;
+    convert(body, provider, motion);
+    check(motion.numFrames() == 1001, "The number of frames is " + std::to_string(motion.numFrames()));
+
+    // The frames out of the updated range must be kept
+    const double sentinel = 100.0;
+    motion.jointPosSeq()->at(100, 0) = sentinel;
+
+    provider.bumpLower = 4.0;
+    provider.bumpUpper = 6.0;
+    update(body, provider, motion, 4.0, 6.0);
+    check(motion.jointPosSeq()->at(100, 0) == sentinel, "A frame out of the updated range is regenerated");
+    motion.jointPosSeq()->at(100, 0) = 0.5 * sin(1.0);
+
+    BodyMotion expected;
+    convert(body, provider, expected);
+    check(isSameMotion(motion, expected), "The partially updated motion is different from the converted one");
+}
+
+void testExtension()
+{
+    BodyPtr body = createArm();
+    WavePoseProvider provider(body, 5.0);
+    BodyMotion motion;
+    convert(body, provider, motion);
+
+    // The appended frames are generated even if they are out of the updated range
+    provider.endingTime_ = 8.0;
+    provider.bumpLower = 1.0;
+    provider.bumpUpper = 2.0;
+    update(body, provider, motion, 1.0, 2.0);
+
+    BodyMotion expected;
+    convert(body, provider, expected);
+    check(isSameMotion(motion, expected), "The extended motion is different from the converted one");
+
+    // The removed frames are truncated
+    provider.endingTime_ = 3.0;
+    update(body, provider, motion, 3.0, 3.0);
+    convert(body, provider, expected);
+    check(isSameMotion(motion, expected), "The shortened motion is different from the converted one");
+}
+
+void testDimensionChange()
+{
+    BodyPtr body = createArm();
+    WavePoseProvider provider(body, 5.0);
+    BodyMotion motion;
+    convert(body, provider, motion, false);
+    check(motion.numLinks() == 1, "Only the root link position should be output");
+
+    // The whole motion is generated when the link position output is switched
+    provider.bumpLower = 1.0;
+    provider.bumpUpper = 2.0;
+    update(body, provider, motion, 1.0, 2.0, true);
+
+    BodyMotion expected;
+    convert(body, provider, expected, true);
+    check(isSameMotion(motion, expected), "The motion is not generated as a whole for the new dimension");
+}
+
+}
+
+
+int main()
+{
+    testPartialUpdate();
+    testExtension();
+    testDimensionChange();
+
+    if(numErrors > 0){
+        cerr << numErrors << " errors" << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+# This test checks that the Python modules can be imported and that the NumPy arrays of
+# the sequences share the memory only when the frames are stored contiguously.
+
+import unittest
+import numpy as np
+# The modules fail to be imported when the classes are not registered correctly
+import cnoid.Util
+import cnoid.Body
+from cnoid.Util import MultiValueSeq, MultiSE3Seq
+
+class MultiValueSeqArrayTest(unittest.TestCase):
+
+    def makeRingBufferSeq(self, seq):
+        # Removing the front frames and adding new ones wraps the frames around the buffer
+        seq.pop_front(5)
+        seq.setNumFrames(10)
+        self.assertFalse(seq.isContiguous)
+
+    def test_sharedArray(self):
+        seq = MultiValueSeq(10, 2)
+        values = np.arange(20.0).reshape(10, 2)
+        seq.setArray(values)
+        self.assertTrue(seq.isContiguous)
+        array = seq.array
+        self.assertEqual(array.shape, (10, 2))
+        self.assertTrue(np.array_equal(array, values))
+        array[3, 1] = -1.0
+        self.assertEqual(seq.frame(3)[1], -1.0)
+        self.assertTrue(np.array_equal(seq.frameArray(3), [6.0, -1.0]))
+
+    def test_nonContiguousArray(self):
+        seq = MultiValueSeq(10, 2)
+        seq.setArray(np.arange(20.0).reshape(10, 2))
+        self.makeRingBufferSeq(seq)
+        array = seq.array
+        self.assertTrue(np.array_equal(array[:5], np.arange(10.0, 20.0).reshape(5, 2)))
+        self.assertTrue(np.array_equal(array[5:], np.zeros((5, 2))))
+        # Reading the array must not rearrange the buffer
+        self.assertFalse(seq.isContiguous)
+        array[0, 0] = -1.0
+        self.assertEqual(seq.frame(0)[0], 10.0)
+
+        seq.makeContiguous()
+        self.assertTrue(seq.isContiguous)
+        array = seq.array
+        self.assertTrue(np.array_equal(array[:5], np.arange(10.0, 20.0).reshape(5, 2)))
+        array[0, 0] = -1.0
+        self.assertEqual(seq.frame(0)[0], -1.0)
+
+    def test_baseClassFunctions(self):
+        seq = MultiValueSeq(10, 2)
+        seq.frameRate = 50.0
+        self.assertEqual(seq.frameRate, 50.0)
+        self.assertEqual(seq.numParts, 2)
+        self.assertEqual(seq.numFrames, 10)
+
+    def test_emptyArray(self):
+        seq = MultiValueSeq()
+        self.assertEqual(seq.array.shape, (0, seq.numParts))
+
+class MultiSE3SeqArrayTest(unittest.TestCase):
+
+    def setArrays(self, seq):
+        translations = np.arange(30.0).reshape(5, 2, 3)
+        rotations = np.tile([0.0, 0.0, 0.0, 1.0], (5, 2, 1))
+        seq.setArrays(translations, rotations)
+        return translations, rotations
+
+    def test_sharedArrays(self):
+        seq = MultiSE3Seq(5, 2)
+        translations, rotations = self.setArrays(seq)
+        self.assertTrue(np.array_equal(seq.translationArray, translations))
+        self.assertTrue(np.array_equal(seq.rotationArray, rotations))
+        seq.translationArray[4, 1, 2] = -1.0
+        self.assertEqual(seq.translationArray[4, 1, 2], -1.0)
+
+    def test_nonContiguousArrays(self):
+        seq = MultiSE3Seq(5, 2)
+        translations, rotations = self.setArrays(seq)
+        seq.pop_front(2)
+        seq.setNumFrames(5)
+        self.assertFalse(seq.isContiguous)
+        self.assertTrue(np.array_equal(seq.translationArray[:3], translations[2:]))
+        self.assertTrue(np.array_equal(seq.rotationArray[:3], rotations[2:]))
+        self.assertFalse(seq.isContiguous)
+
+        seq.makeContiguous()
+        self.assertTrue(seq.isContiguous)
+        self.assertTrue(np.array_equal(seq.translationArray[:3], translations[2:]))
+
+if __name__ == "__main__":
+    unittest.main()
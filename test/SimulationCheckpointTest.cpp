@@ -0,0 +1,268 @@
+/**
+   This test checks that a simulation resumed from a checkpoint file continues bit-exactly in the
+   same way as the simulation which is not interrupted, and that broken checkpoint files are
+   rejected without allocating the memory for the sizes written in them.
+*/
+
+#include <cnoid/SimulationCheckpoint>
+#include <cnoid/DyWorld>
+#include <cnoid/DyBody>
+#include <cnoid/ConstraintForceSolver>
+#include <cnoid/AISTCollisionDetector>
+#include <cnoid/MeshGenerator>
+#include <cnoid/SceneDrawables>
+#include <cnoid/EigenUtil>
+#include <cnoid/stdx/filesystem>
+#include <fstream>
+#include <cstdint>
+#include <iostream>
+
+using namespace std;
+using namespace cnoid;
+namespace filesystem = cnoid::stdx::filesystem;
+
+namespace {
+
+int numErrors = 0;
+
+void check(bool condition, const string& message)
+{
+    if(!condition){
+        cerr << "Error: " << message << endl;
+        ++numErrors;
+    }
+}
+
+const double timeStep = 0.001;
+
+void addBox(Link* link, const Vector3& size)
+{
+    MeshGenerator meshGenerator;
+    SgShapePtr shape = new SgShape;
+    shape->setMesh(meshGenerator.generateBox(size));
+    link->addCollisionShapeNode(shape);
+}
+
+BodyPtr createFloor()
+{
+    BodyPtr body = new Body;
+    body->setName("Floor");
+    Link* link = body->createLink();
+    link->setJointType(Link::FixedJoint);
+    addBox(link, Vector3(2.0, 2.0, 0.1));
+    link->setTranslation(Vector3(0.0, 0.0, -0.05));
+    body->setRootLink(link);
+    body->updateLinkTree();
+    return body;
+}
+
+//! A box with a swinging arm, which is dropped on the floor
+BodyPtr createBox()
+{
+    BodyPtr body = new Body;
+    body->setName("Box");
+    Link* root = body->createLink();
+    root->setName("ROOT");
+    root->setJointType(Link::FreeJoint);
+    root->setMass(1.0);
+    root->setInertia(Matrix3::Identity() * 0.01);
+    addBox(root, Vector3(0.2, 0.2, 0.2));
+    body->setRootLink(root);
+
+    Link* arm = body->createLink();
+    arm->setName("ARM");
+    arm->setJointType(Link::RevoluteJoint);
+    arm->setJointId(0);
+    arm->setJointAxis(Vector3::UnitX());
+    arm->setOffsetTranslation(Vector3(0.0, 0.0, 0.15));
+    arm->setCenterOfMass(Vector3(0.0, 0.0, 0.1));
+    arm->setMass(0.2);
+    arm->setInertia(Matrix3::Identity() * 0.001);
+    root->appendChild(arm);
+
+    body->updateLinkTree();
+    root->setTranslation(Vector3(0.0, 0.0, 0.15));
+    root->setRotation(rotFromRpy(0.2, 0.1, 0.0));
+    root->w() << 1.0, -2.0, 0.5;
+    arm->dq() = 2.0;
+    body->calcForwardKinematics();
+    return body;
+}
+
+struct Simulation
+{
+    World<ConstraintForceSolver> world;
+    vector<DyBodyPtr> bodies;
+
+    Simulation(const vector<BodyPtr>& orgBodies, const SimulationCheckpoint* checkpoint = nullptr)
+    {
+        world.setTimeStep(timeStep);
+        world.setCurrentTime(0.0);
+        world.setGravityAcceleration(Vector3(0.0, 0.0, -9.80665));
+        for(size_t i=0; i < orgBodies.size(); ++i){
+            DyBodyPtr body = new DyBody;
+            body->copyFrom(orgBodies[i]);
+            if(checkpoint){
+                // The dynamics is initialized with the positions in the checkpoint as the simulator item does
+                SimulationCheckpoint::restoreLinkStates(body, checkpoint->bodies[i].linkStates);
+            }
+            bodies.push_back(body);
+            int index = world.addBody(body);
+            world.constraintForceSolver.setSelfCollisionDetectionEnabled(index, false);
+        }
+        world.constraintForceSolver.setCollisionDetector(new AISTCollisionDetector);
+        world.initialize();
+    }
+
+    void step(int numSteps){
+        for(int i=0; i < numSteps; ++i){
+            world.calcNextState();
+            world.constraintForceSolver.clearExternalForces();
+        }
+    }
+
+    void store(SimulationCheckpoint& checkpoint, int frame){
+        checkpoint.frame = frame;
+        checkpoint.timeStep = timeStep;
+        checkpoint.bodies.resize(bodies.size());
+        for(size_t i=0; i < bodies.size(); ++i){
+            auto& data = checkpoint.bodies[i];
+            data.index = i;
+            data.name = bodies[i]->name();
+            SimulationCheckpoint::storeLinkStates(bodies[i], data.linkStates);
+        }
+        checkpoint.engineData.resize(world.stateSize());
+        world.writeState(checkpoint.engineData.data());
+        checkpoint.hasEngineData = true;
+    }
+
+    bool restore(const SimulationCheckpoint& checkpoint){
+        for(size_t i=0; i < bodies.size(); ++i){
+            if(!SimulationCheckpoint::restoreLinkStates(bodies[i], checkpoint.bodies[i].linkStates)){
+                return false;
+            }
+        }
+        const double* end = world.readState(checkpoint.engineData.data());
+        world.setCurrentTime(checkpoint.frame * timeStep);
+        return end == checkpoint.engineData.data() + checkpoint.engineData.size();
+    }
+};
+
+void testResume(const string& filename)
+{
+    vector<BodyPtr> bodies = { createFloor(), createBox() };
+    const int checkpointFrame = 300;
+    const int numFrames = 800;
+
+    Simulation simulation(bodies);
+    simulation.step(checkpointFrame);
+    SimulationCheckpoint checkpoint;
+    simulation.store(checkpoint, checkpointFrame);
+    checkpoint.bodies[1].controllerData.emplace_back("Controller", vector<char>{ 'a', 'b', 'c' });
+    check(checkpoint.write(filename), "The checkpoint is not written");
+    simulation.step(numFrames - checkpointFrame);
+
+    Link* box = simulation.bodies[1]->rootLink();
+    check(box->p().z() < 0.11 && box->p().z() > 0.05, "The box is not on the floor");
+
+    SimulationCheckpoint loaded;
+    check(loaded.read(filename), "The checkpoint is not read");
+    check(loaded.frame == checkpointFrame && loaded.timeStep == timeStep &&
+          loaded.bodies.size() == 2 && loaded.bodies[1].name == "Box" &&
+          loaded.bodies[1].linkStates == checkpoint.bodies[1].linkStates &&
+          loaded.bodies[1].controllerData == checkpoint.bodies[1].controllerData &&
+          loaded.hasEngineData && loaded.engineData == checkpoint.engineData,
+          "The checkpoint read from the file is different from the written one");
+
+    Simulation resumed(bodies, &loaded);
+    check(resumed.restore(loaded), "The simulation state is not restored");
+    resumed.step(numFrames - checkpointFrame);
+
+    for(size_t i=0; i < bodies.size(); ++i){
+        vector<double> states;
+        vector<double> resumedStates;
+        SimulationCheckpoint::storeLinkStates(simulation.bodies[i], states);
+        SimulationCheckpoint::storeLinkStates(resumed.bodies[i], resumedStates);
+        check(states == resumedStates,
+              "The resumed simulation of " + bodies[i]->name() + " is different from the continued one");
+    }
+}
+
+template<class T>
+void write(ofstream& os, const T& value)
+{
+    os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+//! A file with the header of the checkpoint and a size which is larger than the file
+void writeBrokenFile(const string& filename, bool isBodySizeBroken)
+{
+    ofstream os(filename, ios::binary);
+    os.write("CNOIDSCP", 8);
+    write(os, static_cast<uint32_t>(2));
+    write(os, static_cast<int32_t>(10));
+    write(os, timeStep);
+    if(isBodySizeBroken){
+        write(os, static_cast<uint32_t>(0xffffffff));
+    } else {
+        write(os, static_cast<uint32_t>(1));
+        write(os, static_cast<int32_t>(0));
+        write(os, static_cast<uint32_t>(0));
+        // The number of the link state elements
+        write(os, static_cast<uint32_t>(0xfffffff0));
+    }
+    for(int i=0; i < 16; ++i){
+        write(os, 0.0);
+    }
+}
+
+void testBrokenFiles(const string& filename, const string& brokenFilename)
+{
+    auto size = filesystem::file_size(filename);
+    {
+        ifstream is(filename, ios::binary);
+        vector<char> data(size / 2);
+        is.read(data.data(), data.size());
+        ofstream os(brokenFilename, ios::binary);
+        os.write(data.data(), data.size());
+    }
+    SimulationCheckpoint checkpoint;
+    check(!checkpoint.read(brokenFilename), "The truncated file is read");
+
+    for(bool isBodySizeBroken : { true, false }){
+        writeBrokenFile(brokenFilename, isBodySizeBroken);
+        bool isRead = true;
+        try {
+            isRead = checkpoint.read(brokenFilename);
+        }
+        catch(const std::bad_alloc&){
+            check(false, "The memory is allocated for the size in the broken file");
+        }
+        check(!isRead, isBodySizeBroken ? "The file with a broken body number is read" :
+              "The file with a broken array size is read");
+    }
+
+    check(!checkpoint.read(brokenFilename + ".none"), "The file which does not exist is read");
+}
+
+}
+
+
+int main()
+{
+    auto directory = filesystem::temp_directory_path() / "cnoid-simulation-checkpoint-test";
+    filesystem::remove_all(directory);
+    filesystem::create_directories(directory);
+    const string filename = (directory / "test.cpt").string();
+
+    testResume(filename);
+    testBrokenFiles(filename, (directory / "broken.cpt").string());
+
+    filesystem::remove_all(directory);
+
+    if(numErrors > 0){
+        cerr << numErrors << " errors" << endl;
+        return 1;
+    }
+    return 0;
+}